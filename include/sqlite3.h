@@ -11153,6 +11153,316 @@ SQLITE_API int sqlite3_deserialize(
 #define SQLITE_DESERIALIZE_RESIZEABLE  2 /* Resize using sqlite3_realloc64() */
 #define SQLITE_DESERIALIZE_READONLY    4 /* Database is read-only */
 
+/*
+** CAPI3REF: Key-Value Store Interface
+** KEYWORDS: {key-value store} sqlite3_kv sqlite3_kv_iter sqlite3_kv_batch
+** KEYWORDS: sqlite3_kv_pinned
+** EXPERIMENTAL
+**
+** These interfaces read and write a table used as an ordered key-value
+** store without preparing or running SQL.  They operate directly on the
+** b-tree of the table, in the ordinary file format, so SQL statements
+** see every change made through them and vice versa.
+**
+** ^The sqlite3_kv_open(D,S,T,F,P) interface opens a store on table T of
+** the database named S (or the first attached database that has a table
+** T if S is NULL) of [database connection] D and writes a handle for it
+** to *P.  ^The table must be a [WITHOUT ROWID] table with exactly two
+** columns that have no type affinity (declared BLOB or with no type),
+** the first of them the PRIMARY KEY, and with no other indexes, triggers,
+** CHECK constraints, generated columns or foreign keys.  ^If the
+** [SQLITE_KV_CREATE] bit is set in F, a table
+** "T(key BLOB PRIMARY KEY, value BLOB NOT NULL) WITHOUT ROWID" is created
+** if it does not already exist.  ^Changes to the schema, by this or
+** another connection, are picked up automatically.
+**
+** ^sqlite3_kv_get(K,P,N,V,L) looks up the N-byte key P.  ^If it is
+** present, *V and *L are set to its value and its size in bytes and
+** SQLITE_OK is returned; the value remains valid until the next call on
+** store K.  ^If the key is not present, SQLITE_NOTFOUND is returned.
+** ^sqlite3_kv_exists(K,P,N,X) sets *X to true if the key is present.
+** ^sqlite3_kv_put(K,P,N,V,L) stores the L-byte value V for the key,
+** replacing any existing value, and sqlite3_kv_delete(K,P,N) removes the
+** key if it is present.  ^Keys and values are stored as BLOBs.
+**
+** ^Three read-modify-write operations read the value of a key and write
+** its new value in one write transaction and a single descent of the
+** b-tree, instead of a read followed by a separate write.  ^A new value of
+** the same size as the old one is written over it in place.
+** ^sqlite3_kv_cas(K,P,N,O,M,V,L,X) sets the value of key P to the L-byte
+** value V, or removes the key if V is NULL, only if its current value is
+** the M-byte value O, or only if the key is not present if O is NULL.
+** ^*X is set to true if the value was swapped and false otherwise; either
+** way SQLITE_OK is returned.  ^A version number kept in the value can be
+** checked the same way.  ^sqlite3_kv_increment(K,P,N,D,R) adds D to the
+** counter stored under key P and sets *R, unless R is NULL, to the
+** result.  ^A counter is an 8-byte big-endian signed integer, and a
+** missing key counts as 0.  ^It fails with [SQLITE_MISMATCH] if the value
+** is not 8 bytes long and with [SQLITE_TOOBIG] if the result would
+** overflow.  ^sqlite3_kv_merge(K,P,N,X,C) calls X(C,V,L,&W,&M) with the
+** L-byte value V of key P, or with V NULL if the key is not present.
+** ^If X returns SQLITE_OK, the value of the key becomes the M-byte value
+** W, or the key is removed if W is NULL; ^if it returns SQLITE_DONE the
+** key is left as it is; ^any other return code is returned by
+** sqlite3_kv_merge().  ^V is valid only for the duration of the call,
+** and X must not use the database connection.
+**
+** ^sqlite3_kv_multi_get(K,N,P,L,V,M) looks up the N keys P[0..N-1],
+** of L[0..N-1] bytes each, in a single read transaction.  ^The keys are
+** visited in index order, whatever order they are passed in, so that
+** neighbouring keys share the search path from the root of the b-tree.
+** ^V[i] and M[i] are set to the value and size of key P[i], or to NULL
+** and 0 if that key is not present; the values remain valid until the
+** next call on store K.  ^The same key may be passed more than once.
+**
+** ^Each of these calls runs in its own transaction if the connection is
+** in [autocommit mode], and as part of the open transaction otherwise,
+** exactly like a single SQL statement.
+**
+** ^sqlite3_kv_iter_open(K,P,N,I) opens an iterator over the entries of
+** store K in key order, starting at the first key greater than or equal
+** to the N-byte key P, or at the first key if P is NULL, and writes it to
+** *I.  ^sqlite3_kv_iter_next(I) moves the iterator to its first, and
+** then to its next, entry and returns [SQLITE_ROW], or [SQLITE_DONE]
+** once there are no more entries.  ^sqlite3_kv_iter_key(I,L) and
+** sqlite3_kv_iter_value(I,L) return the key and value of the current
+** entry, setting *L to their size; they remain valid until the iterator
+** is stepped or closed, or the database is modified.  ^An open iterator
+** holds a read transaction, like a prepared statement that has been
+** stepped but not reset.  ^sqlite3_kv_iter_close() closes it.
+**
+** ^sqlite3_kv_pin(K,P,N,X) looks up the N-byte key P like
+** sqlite3_kv_get(), but instead of copying the value out it pins it in
+** place, in the page cache or in the memory-mapped database file, and
+** writes a handle to *X.  ^A value that spills onto overflow pages is
+** pinned as several extents, one per page, in order.
+** ^sqlite3_kv_pinned_size(X) returns the size of the value,
+** sqlite3_kv_pinned_count(X) the number of extents, and
+** sqlite3_kv_pinned_extent(X,I,L) a pointer to extent I, for I from 0 to
+** sqlite3_kv_pinned_count(X)-1, setting *L to its size; together they
+** form a read-only iovec list of the value.  ^The pointers remain valid
+** until the value is released by sqlite3_kv_unpin(X), or the database
+** is modified through the same connection.  ^A pinned value holds a read
+** transaction, like an open iterator.  ^If the key is not present,
+** sqlite3_kv_pin() returns SQLITE_NOTFOUND and sets *X to NULL.
+**
+** ^sqlite3_kv_batch_open(K,B) creates an empty write batch for store K
+** and writes it to *B.  ^sqlite3_kv_batch_put() and
+** sqlite3_kv_batch_delete() add a put or a delete to the batch, with the
+** same arguments as sqlite3_kv_put() and sqlite3_kv_delete(), without
+** touching the database; the key and value are copied into the batch.
+** ^sqlite3_kv_batch_write(B) then applies all the operations of batch B
+** atomically, as one SQL statement would:  either all of them take
+** effect or, if an error is returned, none does.  ^When a key is the
+** subject of more than one operation, the last one added wins.  ^The
+** operations are applied in key order in one pass over the b-tree, so a
+** large batch is much cheaper than the same operations made one by one.
+** ^A successful sqlite3_kv_batch_write() empties the batch;
+** sqlite3_kv_batch_reset() empties it without writing it, and
+** sqlite3_kv_batch_count() returns the number of operations it holds.
+** ^sqlite3_kv_batch_close() frees a batch.
+**
+** ^sqlite3_kv_load(K,F,G,X,C) fills the empty store K with the entries
+** returned by successive calls to X(C,&P,&N,&V,&L).  ^Each call either
+** sets P and N to the key of the next entry and V and L to its value, and
+** returns [SQLITE_ROW], or returns [SQLITE_DONE] at the end of the input;
+** ^any other return value stops the load with that error code.  ^The
+** key and value must remain valid until the next call of X, which must
+** not use the database connection.  ^Instead of being inserted one by
+** one, the entries are written straight into new b-tree pages, each
+** page once and in key order, and the interior pages are built above
+** them, so that the table ends up as compact and unfragmented as the file
+** format allows.  ^Each page is filled to F percent of its capacity, or
+** completely if F is 0; a lower F leaves room for later inserts.
+** ^The entries must be passed in strictly increasing key order unless
+** the [SQLITE_KV_LOAD_UNSORTED] bit is set in G, in which case they are
+** first sorted in temporary storage, as for CREATE INDEX.  ^The load is
+** atomic, like a batch write.  ^It fails with SQLITE_ERROR if the table is
+** not empty or a key arrives out of order, and with
+** [SQLITE_CONSTRAINT_PRIMARYKEY] if the same key is passed twice.
+**
+** ^sqlite3_kv_split(K,S,F) sets how later writes through store K split
+** and rebalance b-tree pages that run out of room.  ^S is one of the
+** [SQLITE_KV_SPLIT_DEFAULT | split policies], which decides where the
+** free space goes among the pages that share the cells; ^F is the
+** percentage of each leaf page to fill, from 50 to 100, or 0 to fill
+** leaves completely.  ^A lower F leaves room for later inserts and for
+** values that grow, at the cost of more pages.  ^The setting belongs to
+** the handle, not to the table:  it is not stored in the database and
+** does not apply to SQL statements or to other handles on the table.
+** ^It returns SQLITE_MISUSE if S or F is out of range.
+**
+** ^sqlite3_kv_snapshot_open(K,S) takes a snapshot of store K as last
+** committed and writes it to *S.  ^The snapshot is a read transaction
+** held open on a private read-only connection to the same database file,
+** which must be in [WAL mode]; ^otherwise SQLITE_ERROR is returned.
+** ^sqlite3_kv_snapshot_iter(S,P,N,E,M,I) opens an iterator over the
+** entries of snapshot S with keys from the N-byte key P, or the first
+** key if P is NULL, up to but excluding the M-byte key E, or to the end
+** if E is NULL.  ^Any number of iterators may be open on one snapshot at
+** once, and all of them see the same state of the table whatever is
+** committed in the meantime; they are stepped and closed like those of
+** sqlite3_kv_iter_open().  ^Because a checkpoint cannot copy back into
+** the database file any frame of the WAL that the snapshot might still
+** need, the WAL grows for as long as the snapshot is open under a steady
+** write load.  ^sqlite3_kv_snapshot_frames(S) returns the number of
+** frames the snapshot currently keeps from being checkpointed.
+** ^sqlite3_kv_snapshot_close(S) releases the snapshot; it fails with
+** SQLITE_BUSY while the snapshot has open iterators.
+**
+** ^sqlite3_kv_close() closes a store; it fails with SQLITE_BUSY while
+** the store has open iterators or batches, or pinned values.
+** ^[sqlite3_close()] returns SQLITE_BUSY while the connection has open
+** stores.
+*/
+typedef struct sqlite3_kv sqlite3_kv;
+typedef struct sqlite3_kv_iter sqlite3_kv_iter;
+SQLITE_API int sqlite3_kv_open(
+  sqlite3 *db,                /* Database connection */
+  const char *zDb,            /* Schema name, or NULL */
+  const char *zTable,         /* Table name */
+  int flags,                  /* SQLITE_KV_* flags */
+  sqlite3_kv **ppKv           /* OUT: New store handle */
+);
+SQLITE_API int sqlite3_kv_close(sqlite3_kv*);
+SQLITE_API int sqlite3_kv_get(sqlite3_kv*, const void *pKey, int nKey,
+                              const void **ppVal, int *pnVal);
+SQLITE_API int sqlite3_kv_exists(sqlite3_kv*, const void *pKey, int nKey,
+                                 int *pbExists);
+SQLITE_API int sqlite3_kv_put(sqlite3_kv*, const void *pKey, int nKey,
+                              const void *pVal, int nVal);
+SQLITE_API int sqlite3_kv_delete(sqlite3_kv*, const void *pKey, int nKey);
+SQLITE_API int sqlite3_kv_cas(sqlite3_kv*, const void *pKey, int nKey,
+                              const void *pOld, int nOld,
+                              const void *pNew, int nNew, int *pbSwapped);
+SQLITE_API int sqlite3_kv_increment(sqlite3_kv*, const void *pKey, int nKey,
+                                    sqlite3_int64 iDelta,
+                                    sqlite3_int64 *piNew);
+SQLITE_API int sqlite3_kv_merge(
+  sqlite3_kv*,
+  const void *pKey, int nKey,
+  int (*xMerge)(void*, const void *pOld, int nOld,
+                const void **ppNew, int *pnNew),
+  void *pCtx                  /* First argument to xMerge */
+);
+SQLITE_API int sqlite3_kv_multi_get(sqlite3_kv*, int nKey,
+                                    const void *const *apKey, const int *anKey,
+                                    const void **apVal, int *anVal);
+SQLITE_API int sqlite3_kv_iter_open(sqlite3_kv*, const void *pStart,
+                                    int nStart, sqlite3_kv_iter **ppIter);
+SQLITE_API int sqlite3_kv_iter_next(sqlite3_kv_iter*);
+SQLITE_API const void *sqlite3_kv_iter_key(sqlite3_kv_iter*, int *pnKey);
+SQLITE_API const void *sqlite3_kv_iter_value(sqlite3_kv_iter*, int *pnVal);
+SQLITE_API int sqlite3_kv_iter_close(sqlite3_kv_iter*);
+typedef struct sqlite3_kv_pinned sqlite3_kv_pinned;
+SQLITE_API int sqlite3_kv_pin(sqlite3_kv*, const void *pKey, int nKey,
+                              sqlite3_kv_pinned **ppPin);
+SQLITE_API int sqlite3_kv_pinned_size(sqlite3_kv_pinned*);
+SQLITE_API int sqlite3_kv_pinned_count(sqlite3_kv_pinned*);
+SQLITE_API const void *sqlite3_kv_pinned_extent(sqlite3_kv_pinned*,
+                                                int iExtent, int *pnExtent);
+SQLITE_API int sqlite3_kv_unpin(sqlite3_kv_pinned*);
+typedef struct sqlite3_kv_batch sqlite3_kv_batch;
+SQLITE_API int sqlite3_kv_batch_open(sqlite3_kv*, sqlite3_kv_batch **ppBatch);
+SQLITE_API int sqlite3_kv_batch_put(sqlite3_kv_batch*, const void *pKey,
+                                    int nKey, const void *pVal, int nVal);
+SQLITE_API int sqlite3_kv_batch_delete(sqlite3_kv_batch*, const void *pKey,
+                                       int nKey);
+SQLITE_API int sqlite3_kv_batch_write(sqlite3_kv_batch*);
+SQLITE_API void sqlite3_kv_batch_reset(sqlite3_kv_batch*);
+SQLITE_API int sqlite3_kv_batch_count(sqlite3_kv_batch*);
+SQLITE_API int sqlite3_kv_batch_close(sqlite3_kv_batch*);
+SQLITE_API int sqlite3_kv_load(
+  sqlite3_kv*,
+  int nFill,                  /* Percentage of each page to fill, or 0 */
+  int flags,                  /* SQLITE_KV_LOAD_* flags */
+  int (*xNext)(void*, const void **ppKey, int *pnKey,
+               const void **ppVal, int *pnVal),
+  void *pCtx                  /* First argument to xNext */
+);
+SQLITE_API int sqlite3_kv_split(sqlite3_kv*, int eSplit, int nFill);
+typedef struct sqlite3_kv_snapshot sqlite3_kv_snapshot;
+SQLITE_API int sqlite3_kv_snapshot_open(sqlite3_kv*,
+                                        sqlite3_kv_snapshot **ppSnap);
+SQLITE_API int sqlite3_kv_snapshot_iter(
+  sqlite3_kv_snapshot*,
+  const void *pStart, int nStart,   /* First key, or NULL */
+  const void *pEnd, int nEnd,       /* Key to stop before, or NULL */
+  sqlite3_kv_iter **ppIter          /* OUT: New iterator */
+);
+SQLITE_API int sqlite3_kv_snapshot_frames(sqlite3_kv_snapshot*);
+SQLITE_API int sqlite3_kv_snapshot_close(sqlite3_kv_snapshot*);
+
+/*
+** CAPI3REF: Flags for sqlite3_kv_open()
+**
+** These bit values may be passed as the 4th argument of
+** [sqlite3_kv_open()].
+**
+** [[SQLITE_KV_CREATE]] <dt>SQLITE_KV_CREATE</dt>
+** <dd>Create the table if it does not exist.</dd>
+**
+** [[SQLITE_KV_COMPRESS]] <dt>SQLITE_KV_COMPRESS</dt>
+** <dd>Write the leaf pages of the table that are split or merged by
+** writes through the handle in a prefix-compressed format:  the bytes
+** that start every key on a leaf are stored once, in the page header,
+** so that more keys that share long prefixes fit on a page.  Leaves in
+** that format stay so whatever handle writes to them.  The flag is only
+** honoured by builds with SQLITE_ENABLE_PREFIX_LEAF, and is ignored by
+** others.  Builds without that option report a database that holds such
+** pages as corrupt.</dd>
+*/
+#define SQLITE_KV_CREATE   0x01
+#define SQLITE_KV_COMPRESS 0x02
+
+/*
+** CAPI3REF: Flags for sqlite3_kv_load()
+**
+** These bit values may be passed as the 3rd argument of
+** [sqlite3_kv_load()].
+**
+** [[SQLITE_KV_LOAD_UNSORTED]] <dt>SQLITE_KV_LOAD_UNSORTED</dt>
+** <dd>The entries may arrive in any order.  Sort them before loading.</dd>
+*/
+#define SQLITE_KV_LOAD_UNSORTED 0x01
+
+/*
+** CAPI3REF: Split policies for sqlite3_kv_split()
+**
+** These values may be passed as the 2nd argument of [sqlite3_kv_split()].
+** They decide how the cells of pages that are split or merged after a
+** write are spread over the resulting pages.
+**
+** <dl>
+** [[SQLITE_KV_SPLIT_DEFAULT]] <dt>SQLITE_KV_SPLIT_DEFAULT</dt>
+** <dd>As SQL statements do:  evenly, except that an entry added after the
+** last one in the table starts a new leaf of its own.</dd>
+**
+** [[SQLITE_KV_SPLIT_EVEN]] <dt>SQLITE_KV_SPLIT_EVEN</dt>
+** <dd>Evenly, always.</dd>
+**
+** [[SQLITE_KV_SPLIT_LEFT]] <dt>SQLITE_KV_SPLIT_LEFT</dt>
+** <dd>Left-heavy:  pages with smaller keys are filled first, and the free
+** space is left on the page with the largest keys.  Suits keys that are
+** inserted in ascending order.</dd>
+**
+** [[SQLITE_KV_SPLIT_RIGHT]] <dt>SQLITE_KV_SPLIT_RIGHT</dt>
+** <dd>Right-heavy:  the mirror image, for keys inserted in descending
+** order.  Either of these leaves pages nearly empty if keys arrive in
+** the opposite order.</dd>
+**
+** [[SQLITE_KV_SPLIT_ADAPTIVE]] <dt>SQLITE_KV_SPLIT_ADAPTIVE</dt>
+** <dd>Left-heavy when the entry that overflowed a page went in after all
+** others on it, right-heavy when it went in before them, and even
+** otherwise.</dd>
+** </dl>
+*/
+#define SQLITE_KV_SPLIT_DEFAULT  0
+#define SQLITE_KV_SPLIT_EVEN     1
+#define SQLITE_KV_SPLIT_LEFT     2
+#define SQLITE_KV_SPLIT_RIGHT    3
+#define SQLITE_KV_SPLIT_ADAPTIVE 4
+
 /*
 ** CAPI3REF: Bind array values to the CARRAY table-valued function
 **
@@ -11474,6 +11474,316 @@ SQLITE_API int sqlite3_deserialize(
 #define SQLITE_DESERIALIZE_RESIZEABLE  2 /* Resize using sqlite3_realloc64() */
 #define SQLITE_DESERIALIZE_READONLY    4 /* Database is read-only */
 
+/*
+** CAPI3REF: Key-Value Store Interface
+** KEYWORDS: {key-value store} sqlite3_kv sqlite3_kv_iter sqlite3_kv_batch
+** KEYWORDS: sqlite3_kv_pinned
+** EXPERIMENTAL
+**
+** These interfaces read and write a table used as an ordered key-value
+** store without preparing or running SQL.  They operate directly on the
+** b-tree of the table, in the ordinary file format, so SQL statements
+** see every change made through them and vice versa.
+**
+** ^The sqlite3_kv_open(D,S,T,F,P) interface opens a store on table T of
+** the database named S (or the first attached database that has a table
+** T if S is NULL) of [database connection] D and writes a handle for it
+** to *P.  ^The table must be a [WITHOUT ROWID] table with exactly two
+** columns that have no type affinity (declared BLOB or with no type),
+** the first of them the PRIMARY KEY, and with no other indexes, triggers,
+** CHECK constraints, generated columns or foreign keys.  ^If the
+** [SQLITE_KV_CREATE] bit is set in F, a table
+** "T(key BLOB PRIMARY KEY, value BLOB NOT NULL) WITHOUT ROWID" is created
+** if it does not already exist.  ^Changes to the schema, by this or
+** another connection, are picked up automatically.
+**
+** ^sqlite3_kv_get(K,P,N,V,L) looks up the N-byte key P.  ^If it is
+** present, *V and *L are set to its value and its size in bytes and
+** SQLITE_OK is returned; the value remains valid until the next call on
+** store K.  ^If the key is not present, SQLITE_NOTFOUND is returned.
+** ^sqlite3_kv_exists(K,P,N,X) sets *X to true if the key is present.
+** ^sqlite3_kv_put(K,P,N,V,L) stores the L-byte value V for the key,
+** replacing any existing value, and sqlite3_kv_delete(K,P,N) removes the
+** key if it is present.  ^Keys and values are stored as BLOBs.
+**
+** ^Three read-modify-write operations read the value of a key and write
+** its new value in one write transaction and a single descent of the
+** b-tree, instead of a read followed by a separate write.  ^A new value of
+** the same size as the old one is written over it in place.
+** ^sqlite3_kv_cas(K,P,N,O,M,V,L,X) sets the value of key P to the L-byte
+** value V, or removes the key if V is NULL, only if its current value is
+** the M-byte value O, or only if the key is not present if O is NULL.
+** ^*X is set to true if the value was swapped and false otherwise; either
+** way SQLITE_OK is returned.  ^A version number kept in the value can be
+** checked the same way.  ^sqlite3_kv_increment(K,P,N,D,R) adds D to the
+** counter stored under key P and sets *R, unless R is NULL, to the
+** result.  ^A counter is an 8-byte big-endian signed integer, and a
+** missing key counts as 0.  ^It fails with [SQLITE_MISMATCH] if the value
+** is not 8 bytes long and with [SQLITE_TOOBIG] if the result would
+** overflow.  ^sqlite3_kv_merge(K,P,N,X,C) calls X(C,V,L,&W,&M) with the
+** L-byte value V of key P, or with V NULL if the key is not present.
+** ^If X returns SQLITE_OK, the value of the key becomes the M-byte value
+** W, or the key is removed if W is NULL; ^if it returns SQLITE_DONE the
+** key is left as it is; ^any other return code is returned by
+** sqlite3_kv_merge().  ^V is valid only for the duration of the call,
+** and X must not use the database connection.
+**
+** ^sqlite3_kv_multi_get(K,N,P,L,V,M) looks up the N keys P[0..N-1],
+** of L[0..N-1] bytes each, in a single read transaction.  ^The keys are
+** visited in index order, whatever order they are passed in, so that
+** neighbouring keys share the search path from the root of the b-tree.
+** ^V[i] and M[i] are set to the value and size of key P[i], or to NULL
+** and 0 if that key is not present; the values remain valid until the
+** next call on store K.  ^The same key may be passed more than once.
+**
+** ^Each of these calls runs in its own transaction if the connection is
+** in [autocommit mode], and as part of the open transaction otherwise,
+** exactly like a single SQL statement.
+**
+** ^sqlite3_kv_iter_open(K,P,N,I) opens an iterator over the entries of
+** store K in key order, starting at the first key greater than or equal
+** to the N-byte key P, or at the first key if P is NULL, and writes it to
+** *I.  ^sqlite3_kv_iter_next(I) moves the iterator to its first, and
+** then to its next, entry and returns [SQLITE_ROW], or [SQLITE_DONE]
+** once there are no more entries.  ^sqlite3_kv_iter_key(I,L) and
+** sqlite3_kv_iter_value(I,L) return the key and value of the current
+** entry, setting *L to their size; they remain valid until the iterator
+** is stepped or closed, or the database is modified.  ^An open iterator
+** holds a read transaction, like a prepared statement that has been
+** stepped but not reset.  ^sqlite3_kv_iter_close() closes it.
+**
+** ^sqlite3_kv_pin(K,P,N,X) looks up the N-byte key P like
+** sqlite3_kv_get(), but instead of copying the value out it pins it in
+** place, in the page cache or in the memory-mapped database file, and
+** writes a handle to *X.  ^A value that spills onto overflow pages is
+** pinned as several extents, one per page, in order.
+** ^sqlite3_kv_pinned_size(X) returns the size of the value,
+** sqlite3_kv_pinned_count(X) the number of extents, and
+** sqlite3_kv_pinned_extent(X,I,L) a pointer to extent I, for I from 0 to
+** sqlite3_kv_pinned_count(X)-1, setting *L to its size; together they
+** form a read-only iovec list of the value.  ^The pointers remain valid
+** until the value is released by sqlite3_kv_unpin(X), or the database
+** is modified through the same connection.  ^A pinned value holds a read
+** transaction, like an open iterator.  ^If the key is not present,
+** sqlite3_kv_pin() returns SQLITE_NOTFOUND and sets *X to NULL.
+**
+** ^sqlite3_kv_batch_open(K,B) creates an empty write batch for store K
+** and writes it to *B.  ^sqlite3_kv_batch_put() and
+** sqlite3_kv_batch_delete() add a put or a delete to the batch, with the
+** same arguments as sqlite3_kv_put() and sqlite3_kv_delete(), without
+** touching the database; the key and value are copied into the batch.
+** ^sqlite3_kv_batch_write(B) then applies all the operations of batch B
+** atomically, as one SQL statement would:  either all of them take
+** effect or, if an error is returned, none does.  ^When a key is the
+** subject of more than one operation, the last one added wins.  ^The
+** operations are applied in key order in one pass over the b-tree, so a
+** large batch is much cheaper than the same operations made one by one.
+** ^A successful sqlite3_kv_batch_write() empties the batch;
+** sqlite3_kv_batch_reset() empties it without writing it, and
+** sqlite3_kv_batch_count() returns the number of operations it holds.
+** ^sqlite3_kv_batch_close() frees a batch.
+**
+** ^sqlite3_kv_load(K,F,G,X,C) fills the empty store K with the entries
+** returned by successive calls to X(C,&P,&N,&V,&L).  ^Each call either
+** sets P and N to the key of the next entry and V and L to its value, and
+** returns [SQLITE_ROW], or returns [SQLITE_DONE] at the end of the input;
+** ^any other return value stops the load with that error code.  ^The
+** key and value must remain valid until the next call of X, which must
+** not use the database connection.  ^Instead of being inserted one by
+** one, the entries are written straight into new b-tree pages, each
+** page once and in key order, and the interior pages are built above
+** them, so that the table ends up as compact and unfragmented as the file
+** format allows.  ^Each page is filled to F percent of its capacity, or
+** completely if F is 0; a lower F leaves room for later inserts.
+** ^The entries must be passed in strictly increasing key order unless
+** the [SQLITE_KV_LOAD_UNSORTED] bit is set in G, in which case they are
+** first sorted in temporary storage, as for CREATE INDEX.  ^The load is
+** atomic, like a batch write.  ^It fails with SQLITE_ERROR if the table is
+** not empty or a key arrives out of order, and with
+** [SQLITE_CONSTRAINT_PRIMARYKEY] if the same key is passed twice.
+**
+** ^sqlite3_kv_split(K,S,F) sets how later writes through store K split
+** and rebalance b-tree pages that run out of room.  ^S is one of the
+** [SQLITE_KV_SPLIT_DEFAULT | split policies], which decides where the
+** free space goes among the pages that share the cells; ^F is the
+** percentage of each leaf page to fill, from 50 to 100, or 0 to fill
+** leaves completely.  ^A lower F leaves room for later inserts and for
+** values that grow, at the cost of more pages.  ^The setting belongs to
+** the handle, not to the table:  it is not stored in the database and
+** does not apply to SQL statements or to other handles on the table.
+** ^It returns SQLITE_MISUSE if S or F is out of range.
+**
+** ^sqlite3_kv_snapshot_open(K,S) takes a snapshot of store K as last
+** committed and writes it to *S.  ^The snapshot is a read transaction
+** held open on a private read-only connection to the same database file,
+** which must be in [WAL mode]; ^otherwise SQLITE_ERROR is returned.
+** ^sqlite3_kv_snapshot_iter(S,P,N,E,M,I) opens an iterator over the
+** entries of snapshot S with keys from the N-byte key P, or the first
+** key if P is NULL, up to but excluding the M-byte key E, or to the end
+** if E is NULL.  ^Any number of iterators may be open on one snapshot at
+** once, and all of them see the same state of the table whatever is
+** committed in the meantime; they are stepped and closed like those of
+** sqlite3_kv_iter_open().  ^Because a checkpoint cannot copy back into
+** the database file any frame of the WAL that the snapshot might still
+** need, the WAL grows for as long as the snapshot is open under a steady
+** write load.  ^sqlite3_kv_snapshot_frames(S) returns the number of
+** frames the snapshot currently keeps from being checkpointed.
+** ^sqlite3_kv_snapshot_close(S) releases the snapshot; it fails with
+** SQLITE_BUSY while the snapshot has open iterators.
+**
+** ^sqlite3_kv_close() closes a store; it fails with SQLITE_BUSY while
+** the store has open iterators or batches, or pinned values.
+** ^[sqlite3_close()] returns SQLITE_BUSY while the connection has open
+** stores.
+*/
+typedef struct sqlite3_kv sqlite3_kv;
+typedef struct sqlite3_kv_iter sqlite3_kv_iter;
+SQLITE_API int sqlite3_kv_open(
+  sqlite3 *db,                /* Database connection */
+  const char *zDb,            /* Schema name, or NULL */
+  const char *zTable,         /* Table name */
+  int flags,                  /* SQLITE_KV_* flags */
+  sqlite3_kv **ppKv           /* OUT: New store handle */
+);
+SQLITE_API int sqlite3_kv_close(sqlite3_kv*);
+SQLITE_API int sqlite3_kv_get(sqlite3_kv*, const void *pKey, int nKey,
+                              const void **ppVal, int *pnVal);
+SQLITE_API int sqlite3_kv_exists(sqlite3_kv*, const void *pKey, int nKey,
+                                 int *pbExists);
+SQLITE_API int sqlite3_kv_put(sqlite3_kv*, const void *pKey, int nKey,
+                              const void *pVal, int nVal);
+SQLITE_API int sqlite3_kv_delete(sqlite3_kv*, const void *pKey, int nKey);
+SQLITE_API int sqlite3_kv_cas(sqlite3_kv*, const void *pKey, int nKey,
+                              const void *pOld, int nOld,
+                              const void *pNew, int nNew, int *pbSwapped);
+SQLITE_API int sqlite3_kv_increment(sqlite3_kv*, const void *pKey, int nKey,
+                                    sqlite3_int64 iDelta,
+                                    sqlite3_int64 *piNew);
+SQLITE_API int sqlite3_kv_merge(
+  sqlite3_kv*,
+  const void *pKey, int nKey,
+  int (*xMerge)(void*, const void *pOld, int nOld,
+                const void **ppNew, int *pnNew),
+  void *pCtx                  /* First argument to xMerge */
+);
+SQLITE_API int sqlite3_kv_multi_get(sqlite3_kv*, int nKey,
+                                    const void *const *apKey, const int *anKey,
+                                    const void **apVal, int *anVal);
+SQLITE_API int sqlite3_kv_iter_open(sqlite3_kv*, const void *pStart,
+                                    int nStart, sqlite3_kv_iter **ppIter);
+SQLITE_API int sqlite3_kv_iter_next(sqlite3_kv_iter*);
+SQLITE_API const void *sqlite3_kv_iter_key(sqlite3_kv_iter*, int *pnKey);
+SQLITE_API const void *sqlite3_kv_iter_value(sqlite3_kv_iter*, int *pnVal);
+SQLITE_API int sqlite3_kv_iter_close(sqlite3_kv_iter*);
+typedef struct sqlite3_kv_pinned sqlite3_kv_pinned;
+SQLITE_API int sqlite3_kv_pin(sqlite3_kv*, const void *pKey, int nKey,
+                              sqlite3_kv_pinned **ppPin);
+SQLITE_API int sqlite3_kv_pinned_size(sqlite3_kv_pinned*);
+SQLITE_API int sqlite3_kv_pinned_count(sqlite3_kv_pinned*);
+SQLITE_API const void *sqlite3_kv_pinned_extent(sqlite3_kv_pinned*,
+                                                int iExtent, int *pnExtent);
+SQLITE_API int sqlite3_kv_unpin(sqlite3_kv_pinned*);
+typedef struct sqlite3_kv_batch sqlite3_kv_batch;
+SQLITE_API int sqlite3_kv_batch_open(sqlite3_kv*, sqlite3_kv_batch **ppBatch);
+SQLITE_API int sqlite3_kv_batch_put(sqlite3_kv_batch*, const void *pKey,
+                                    int nKey, const void *pVal, int nVal);
+SQLITE_API int sqlite3_kv_batch_delete(sqlite3_kv_batch*, const void *pKey,
+                                       int nKey);
+SQLITE_API int sqlite3_kv_batch_write(sqlite3_kv_batch*);
+SQLITE_API void sqlite3_kv_batch_reset(sqlite3_kv_batch*);
+SQLITE_API int sqlite3_kv_batch_count(sqlite3_kv_batch*);
+SQLITE_API int sqlite3_kv_batch_close(sqlite3_kv_batch*);
+SQLITE_API int sqlite3_kv_load(
+  sqlite3_kv*,
+  int nFill,                  /* Percentage of each page to fill, or 0 */
+  int flags,                  /* SQLITE_KV_LOAD_* flags */
+  int (*xNext)(void*, const void **ppKey, int *pnKey,
+               const void **ppVal, int *pnVal),
+  void *pCtx                  /* First argument to xNext */
+);
+SQLITE_API int sqlite3_kv_split(sqlite3_kv*, int eSplit, int nFill);
+typedef struct sqlite3_kv_snapshot sqlite3_kv_snapshot;
+SQLITE_API int sqlite3_kv_snapshot_open(sqlite3_kv*,
+                                        sqlite3_kv_snapshot **ppSnap);
+SQLITE_API int sqlite3_kv_snapshot_iter(
+  sqlite3_kv_snapshot*,
+  const void *pStart, int nStart,   /* First key, or NULL */
+  const void *pEnd, int nEnd,       /* Key to stop before, or NULL */
+  sqlite3_kv_iter **ppIter          /* OUT: New iterator */
+);
+SQLITE_API int sqlite3_kv_snapshot_frames(sqlite3_kv_snapshot*);
+SQLITE_API int sqlite3_kv_snapshot_close(sqlite3_kv_snapshot*);
+
+/*
+** CAPI3REF: Flags for sqlite3_kv_open()
+**
+** These bit values may be passed as the 4th argument of
+** [sqlite3_kv_open()].
+**
+** [[SQLITE_KV_CREATE]] <dt>SQLITE_KV_CREATE</dt>
+** <dd>Create the table if it does not exist.</dd>
+**
+** [[SQLITE_KV_COMPRESS]] <dt>SQLITE_KV_COMPRESS</dt>
+** <dd>Write the leaf pages of the table that are split or merged by
+** writes through the handle in a prefix-compressed format:  the bytes
+** that start every key on a leaf are stored once, in the page header,
+** so that more keys that share long prefixes fit on a page.  Leaves in
+** that format stay so whatever handle writes to them.  The flag is only
+** honoured by builds with SQLITE_ENABLE_PREFIX_LEAF, and is ignored by
+** others.  Builds without that option report a database that holds such
+** pages as corrupt.</dd>
+*/
+#define SQLITE_KV_CREATE   0x01
+#define SQLITE_KV_COMPRESS 0x02
+
+/*
+** CAPI3REF: Flags for sqlite3_kv_load()
+**
+** These bit values may be passed as the 3rd argument of
+** [sqlite3_kv_load()].
+**
+** [[SQLITE_KV_LOAD_UNSORTED]] <dt>SQLITE_KV_LOAD_UNSORTED</dt>
+** <dd>The entries may arrive in any order.  Sort them before loading.</dd>
+*/
+#define SQLITE_KV_LOAD_UNSORTED 0x01
+
+/*
+** CAPI3REF: Split policies for sqlite3_kv_split()
+**
+** These values may be passed as the 2nd argument of [sqlite3_kv_split()].
+** They decide how the cells of pages that are split or merged after a
+** write are spread over the resulting pages.
+**
+** <dl>
+** [[SQLITE_KV_SPLIT_DEFAULT]] <dt>SQLITE_KV_SPLIT_DEFAULT</dt>
+** <dd>As SQL statements do:  evenly, except that an entry added after the
+** last one in the table starts a new leaf of its own.</dd>
+**
+** [[SQLITE_KV_SPLIT_EVEN]] <dt>SQLITE_KV_SPLIT_EVEN</dt>
+** <dd>Evenly, always.</dd>
+**
+** [[SQLITE_KV_SPLIT_LEFT]] <dt>SQLITE_KV_SPLIT_LEFT</dt>
+** <dd>Left-heavy:  pages with smaller keys are filled first, and the free
+** space is left on the page with the largest keys.  Suits keys that are
+** inserted in ascending order.</dd>
+**
+** [[SQLITE_KV_SPLIT_RIGHT]] <dt>SQLITE_KV_SPLIT_RIGHT</dt>
+** <dd>Right-heavy:  the mirror image, for keys inserted in descending
+** order.  Either of these leaves pages nearly empty if keys arrive in
+** the opposite order.</dd>
+**
+** [[SQLITE_KV_SPLIT_ADAPTIVE]] <dt>SQLITE_KV_SPLIT_ADAPTIVE</dt>
+** <dd>Left-heavy when the entry that overflowed a page went in after all
+** others on it, right-heavy when it went in before them, and even
+** otherwise.</dd>
+** </dl>
+*/
+#define SQLITE_KV_SPLIT_DEFAULT  0
+#define SQLITE_KV_SPLIT_EVEN     1
+#define SQLITE_KV_SPLIT_LEFT     2
+#define SQLITE_KV_SPLIT_RIGHT    3
+#define SQLITE_KV_SPLIT_ADAPTIVE 4
+
 /*
 ** CAPI3REF: Bind array values to the CARRAY table-valued function
 **
@@ -16565,6 +16875,10 @@ SQLITE_PRIVATE   void sqlite3PagerSnapshotUnlock(Pager *pPager);
 # endif
 #endif
 
+#if !defined(SQLITE_OMIT_WAL) && !defined(SQLITE_OMIT_KV)
+SQLITE_PRIVATE   u32 sqlite3PagerWalPinnedFrames(Pager*);
+#endif
+
 #if !defined(SQLITE_OMIT_WAL) && defined(SQLITE_ENABLE_SETLK_TIMEOUT)
 SQLITE_PRIVATE   int sqlite3PagerWalWriteLock(Pager*, int);
 SQLITE_PRIVATE   void sqlite3PagerWalDb(Pager*, sqlite3*);
@@ -16671,6 +16985,8 @@ typedef struct Btree Btree;
 typedef struct BtCursor BtCursor;
 typedef struct BtShared BtShared;
 typedef struct BtreePayload BtreePayload;
+typedef struct BtreeSpan BtreeSpan;
+typedef struct BtreeLoader BtreeLoader;
 
 
 SQLITE_PRIVATE int sqlite3BtreeOpen(
@@ -16832,9 +17148,37 @@ SQLITE_PRIVATE int sqlite3BtreeNewDb(Btree *p);
 ** selected will all have the same key.  In other words, the cursor will
 ** be used only for equality key searches.
 **
+** The BTREE_SEEK_ASC flag is set on index cursors that are sought to a
+** sequence of keys in ascending order.  Each seek then starts from the
+** lowest ancestor of the current leaf that must contain the new key,
+** rather than from the root.
+**
 */
 #define BTREE_BULKLOAD 0x00000001  /* Used to full index in sorted order */
 #define BTREE_SEEK_EQ  0x00000002  /* EQ seeks only - no range seeks */
+#define BTREE_SEEK_ASC 0x00000004  /* Seeks are in ascending key order */
+
+/*
+** Split policies that may be passed as the second argument to
+** sqlite3BtreeCursorSplit().  They decide how the cells of the pages
+** that balance_nonroot() redistributes after an insert through the
+** cursor are spread over the new pages:
+**
+**   BTREE_SPLIT_DEFAULT   Evenly, except that an entry appended to the
+**                         right-most leaf starts a new leaf of its own.
+**   BTREE_SPLIT_EVEN      Evenly.
+**   BTREE_SPLIT_LEFT      Left pages as full as allowed, the remainder on
+**                         the right-most page.  Suits ascending inserts.
+**   BTREE_SPLIT_RIGHT     Right pages as full as allowed, the remainder on
+**                         the left-most page.  Suits descending inserts.
+**   BTREE_SPLIT_ADAPTIVE  LEFT if the new entry went at the end of its
+**                         page, RIGHT if at the start, otherwise EVEN.
+*/
+#define BTREE_SPLIT_DEFAULT  0
+#define BTREE_SPLIT_EVEN     1
+#define BTREE_SPLIT_LEFT     2
+#define BTREE_SPLIT_RIGHT    3
+#define BTREE_SPLIT_ADAPTIVE 4
 
 /*
 ** Flags passed as the third argument to sqlite3BtreeCursor().
@@ -16876,6 +17220,12 @@ SQLITE_PRIVATE int sqlite3BtreeClosesWithCursor(Btree*,BtCursor*);
 #endif
 SQLITE_PRIVATE void sqlite3BtreeCursorZero(BtCursor*);
 SQLITE_PRIVATE void sqlite3BtreeCursorHintFlags(BtCursor*, unsigned);
+#ifndef SQLITE_OMIT_KV
+SQLITE_PRIVATE void sqlite3BtreeCursorSplit(BtCursor*, int eSplit, int nFill);
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+SQLITE_PRIVATE void sqlite3BtreeCursorPfxLeaf(BtCursor*, int);
+#endif
+#endif
 #ifdef SQLITE_ENABLE_CURSOR_HINTS
 SQLITE_PRIVATE void sqlite3BtreeCursorHint(BtCursor*, int, ...);
 #endif
@@ -16960,6 +17310,26 @@ SQLITE_PRIVATE i64 sqlite3BtreeOffset(BtCursor*);
 SQLITE_PRIVATE int sqlite3BtreePayload(BtCursor*, u32 offset, u32 amt, void*);
 SQLITE_PRIVATE const void *sqlite3BtreePayloadFetch(BtCursor*, u32 *pAmt);
 SQLITE_PRIVATE u32 sqlite3BtreePayloadSize(BtCursor*);
+
+/*
+** An extent of an entry's payload pinned in memory by
+** sqlite3BtreePayloadPin().
+*/
+struct BtreeSpan {
+  const u8 *z;            /* First byte of the extent */
+  u32 n;                  /* Number of bytes */
+  struct MemPage *pPage;  /* Referenced page holding them */
+};
+#ifndef SQLITE_OMIT_KV
+SQLITE_PRIVATE int sqlite3BtreePayloadPin(BtCursor*, u32 offset, u32 amt,
+                                          BtreeSpan **paSpan, int *pnSpan);
+SQLITE_PRIVATE void sqlite3BtreePayloadUnpin(BtreeSpan*, int nSpan);
+SQLITE_PRIVATE int sqlite3BtreeLoaderOpen(Btree*, Pgno iTable, int nFill,
+                                          BtreeLoader **ppLoader);
+SQLITE_PRIVATE int sqlite3BtreeLoaderAdd(BtreeLoader*, const u8 *pRec, int nRec);
+SQLITE_PRIVATE int sqlite3BtreeLoaderFinish(BtreeLoader*);
+SQLITE_PRIVATE void sqlite3BtreeLoaderFree(BtreeLoader*);
+#endif
 SQLITE_PRIVATE sqlite3_int64 sqlite3BtreeMaxRecordSize(BtCursor*);
 
 SQLITE_PRIVATE int sqlite3BtreeIntegrityCheck(
@@ -18288,6 +18658,8 @@ struct sqlite3 {
   int nVdbeWrite;               /* Number of active VDBEs that read and write */
   int nVdbeExec;                /* Number of nested calls to VdbeExec() */
   int nVDestroy;                /* Number of active OP_VDestroy operations */
+  int nKvOpen;                  /* Number of open sqlite3_kv handles */
+  int nKvIter;                  /* Number of open sqlite3_kv_iter handles */
   int nExtension;               /* Number of loaded extensions */
   void **aExtension;            /* Array of shared library handles */
   union {
@@ -19305,10 +19677,11 @@ struct UnpackedRecord {
   KeyInfo *pKeyInfo;  /* Comparison info for the index that is unpacked */
   Mem *aMem;          /* Values for columns of the index */
   union {
-    char *z;            /* Cache of aMem[0].z for vdbeRecordCompareString() */
+    char *z;            /* Cache of aMem[0].z for vdbeRecordCompareString()
+                        ** and vdbeRecordCompareBlob() */
     i64 i;              /* Cache of aMem[0].u.i for vdbeRecordCompareInt() */
   } u;
-  int n;              /* Cache of aMem[0].n used by vdbeRecordCompareString() */
+  int n;              /* Cache of aMem[0].n, as for u.z */
   u16 nField;         /* Number of entries in apMem[] */
   i8 default_rc;      /* Comparison result if keys are equal */
   u8 errCode;         /* Error detected by xRecordCompare (CORRUPT or NOMEM) */
@@ -22892,6 +23265,12 @@ static const char * const sqlite3azCompileOpt[] = {
 #ifdef SQLITE_ENABLE_PERCENTILE
   "ENABLE_PERCENTILE",
 #endif
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  "ENABLE_PREFIX_LEAF",
+#endif
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+  "ENABLE_PREFIX_SEARCH",
+#endif
 #ifdef SQLITE_ENABLE_PREUPDATE_HOOK
   "ENABLE_PREUPDATE_HOOK",
 #endif
@@ -58928,6 +59307,11 @@ SQLITE_PRIVATE int sqlite3WalFramesize(Wal *pWal);
 /* Return the sqlite3_file object for the WAL file */
 SQLITE_PRIVATE sqlite3_file *sqlite3WalFile(Wal *pWal);
 
+#ifndef SQLITE_OMIT_KV
+/* Number of frames a checkpoint cannot copy back because of this reader */
+SQLITE_PRIVATE u32 sqlite3WalPinnedFrames(Wal *pWal);
+#endif
+
 #ifdef SQLITE_ENABLE_SETLK_TIMEOUT
 SQLITE_PRIVATE int sqlite3WalWriteLock(Wal *pWal, int bLock);
 SQLITE_PRIVATE void sqlite3WalDb(Wal *pWal, sqlite3 *db);
@@ -66742,6 +67126,17 @@ SQLITE_PRIVATE int sqlite3PagerWalFramesize(Pager *pPager){
 }
 #endif
 
+#if !defined(SQLITE_OMIT_WAL) && !defined(SQLITE_OMIT_KV)
+/*
+** Return the number of WAL frames that the read transaction of the
+** pager keeps a checkpoint from copying into the database file, or 0
+** if it has none or the database is not in WAL mode.
+*/
+SQLITE_PRIVATE u32 sqlite3PagerWalPinnedFrames(Pager *pPager){
+  return pagerUseWal(pPager) ? sqlite3WalPinnedFrames(pPager->pWal) : 0;
+}
+#endif
+
 #if defined(SQLITE_USE_SEH) && !defined(SQLITE_OMIT_WAL)
 SQLITE_PRIVATE int sqlite3PagerWalSystemErrno(Pager *pPager){
   return sqlite3WalSystemErrno(pPager->pWal);
@@ -71372,6 +71767,32 @@ SQLITE_PRIVATE sqlite3_file *sqlite3WalFile(Wal *pWal){
   return pWal->pWalFd;
 }
 
+#ifndef SQLITE_OMIT_KV
+/*
+** Return the number of frames in the WAL that a checkpoint cannot copy
+** back into the database file while the read transaction of pWal stays
+** open, or 0 if pWal has none.  A reader of a snapshot that is partly in
+** the WAL blocks the frames committed after that snapshot.  A reader of
+** the database file alone blocks every frame not yet backfilled.  The
+** shared header is read without a lock, so the result is approximate.
+*/
+SQLITE_PRIVATE u32 sqlite3WalPinnedFrames(Wal *pWal){
+  u32 mxFrame = 0;
+  u32 iFrom = 0;
+  if( pWal->readLock<0 ) return 0;
+  SEH_TRY {
+    mxFrame = AtomicLoad(&walIndexHdr(pWal)->mxFrame);
+    if( pWal->readLock==0 ){
+      iFrom = AtomicLoad(&walCkptInfo(pWal)->nBackfill);
+    }else{
+      iFrom = pWal->hdr.mxFrame;
+    }
+  }
+  SEH_EXCEPT( return 0; )
+  return mxFrame>iFrom ? mxFrame-iFrom : 0;
+}
+#endif
+
 #endif /* #ifndef SQLITE_OMIT_WAL */
 
 /************** End of wal.c *************************************************/
@@ -71654,6 +72075,80 @@ typedef struct CellInfo CellInfo;
 #define PTF_ZERODATA  0x02
 #define PTF_LEAFDATA  0x04
 #define PTF_LEAF      0x08
+#define PTF_PFXLEAF   0x10
+
+/*
+** PTF_PFXLEAF is only valid on index leaf pages, so that 0x1a is the
+** only page type that uses it.  Such a page is written on request of
+** the cursor (see sqlite3BtreeCursorPfxLeaf()), by balance_nonroot(),
+** and prefix-compresses the keys of its cells against the page:
+**
+**    *  The 8-byte page header is followed by a 1-byte prefix length N
+**       and N bytes of prefix P, and then by the cell pointer array.
+**       P is the longest prefix that all the records of the page that
+**       are stored compressed share after their record header.  It is
+**       set when balance_nonroot() fills the page and kept as is by
+**       later inserts and deletes.
+**
+**    *  Each cell is the varint payload size, a 1-byte shared length S,
+**       and then the payload.  If S is zero the payload is stored just
+**       as on a 0x0a page, overflow and all.  Otherwise the whole payload
+**       is local, S<=N, and the cell holds the record header followed by
+**       the record body less its first S bytes, which are P[0..S-1].
+**
+** So a leaf is a single LevelDB-style restart block.  Pages of type 0x1a
+** are only read and written by builds with SQLITE_ENABLE_PREFIX_LEAF.
+** Other builds report them as corrupt.
+*/
+
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+/*
+** When SQLITE_ENABLE_PREFIX_SEARCH is defined, interior index b-tree
+** pages whose keys start with a BLOB get a search accelerator:  8 bytes
+** of the key of every nStride-th cell, as big-endian integers packed in
+** an array, so that sqlite3BtreeIndexMoveto() does most of its binary
+** search in a few cache lines instead of decoding a record at a random
+** offset of the page on every probe.  The bytes are taken after the
+** prefix that all the keys on the page share, which is kept alongside.
+**
+** The arrays are too large for the extra space the pager keeps with each
+** page, so they live in a small cache of BtPrefix slots that belongs to
+** the BtShared, BTREE_PREFIX_WAYS slots to a set chosen by page number.
+** Leaf pages are left out:  there are too many of them for the cache, and
+** every search visits the interior pages above them anyway.
+** A slot belongs to a page as long as its pPage and pgno match and the
+** MemPage.ePrefix of the page is PREFIX_READY.  An array is built by the
+** second search of a page after it was loaded or last changed, so that
+** pages read once or written between every search do not pay for it,
+** and every change to the cells of the page drops it.  Values of
+** MemPage.ePrefix:
+*/
+# define PREFIX_NEW   0    /* Not searched since it was loaded or changed */
+# define PREFIX_SEEN  1    /* Searched once.  Build on the next search */
+# define PREFIX_READY 2    /* Has a slot, unless another page took it */
+# define PREFIX_NONE  3    /* Some key does not start with a BLOB */
+
+# define BTREE_PREFIX_MAX   32   /* Most prefixes in a slot */
+# define BTREE_PREFIX_SKIP  24   /* Longest shared prefix skipped */
+# define BTREE_PREFIX_SETS  128  /* Sets of slots in the cache */
+# define BTREE_PREFIX_WAYS  2    /* Slots in each set */
+# define btreePrefixReset(P) ((P)->ePrefix = PREFIX_NEW)
+
+typedef struct BtPrefix BtPrefix;
+struct BtPrefix {
+  MemPage *pPage;      /* Page the slot was built for, or NULL */
+  Pgno pgno;           /* Its page number */
+  u32 iStamp;          /* BtShared.iPrefixStamp when built */
+  u8 bDesc;            /* Key in descending order: prefixes complemented */
+  u8 nSkip;            /* Bytes of aSkip[] shared by all keys on the page */
+  u16 nPrefix;         /* Number of entries in aPrefix[] */
+  u16 nStride;         /* aPrefix[i] is from cell i*nStride */
+  u8 aSkip[BTREE_PREFIX_SKIP];     /* Key prefix shared by all cells */
+  u64 aPrefix[BTREE_PREFIX_MAX];   /* Next 8 key bytes, in cell order */
+};
+#else
+# define btreePrefixReset(P)
+#endif
 
 /*
 ** An instance of this object stores information about each a single database
@@ -71679,6 +72174,13 @@ struct MemPage {
   u8 childPtrSize;     /* 0 if leaf==1.  4 if leaf==0 */
   u8 max1bytePayload;  /* min(maxLocal,127) */
   u8 nOverflow;        /* Number of overflow cell bodies in aCell[] */
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+  u8 ePrefix;          /* PREFIX_* state of the search accelerator */
+#endif
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  u8 bPfx;             /* True for a PTF_PFXLEAF page */
+  u8 nPfx;             /* Length of the prefix of a PTF_PFXLEAF page */
+#endif
   u16 maxLocal;        /* Copy of BtShared.maxLocal or BtShared.maxLeaf */
   u16 minLocal;        /* Copy of BtShared.minLocal or BtShared.minLeaf */
   u16 cellOffset;      /* Index in aData of first cell pointer */
@@ -71853,7 +72355,14 @@ struct BtShared {
   Btree *pWriter;       /* Btree with currently open write transaction */
 #endif
   u8 *pTmpSpace;        /* Temp space sufficient to hold a single cell */
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  u8 *pPfxSpace;        /* Record of a PTF_PFXLEAF cell, expanded */
+#endif
   int nPreformatSize;   /* Size of last cell written by TransferRow() */
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+  BtPrefix *aPrefix;    /* Search accelerators of index pages, or NULL */
+  u32 iPrefixStamp;     /* Number of accelerators built */
+#endif
 };
 
 /*
@@ -71948,6 +72457,11 @@ struct BtCursor {
   u8 curIntKey;             /* Value of apPage[0]->intKey */
   u16 ix;                   /* Current index for apPage[iPage] */
   u16 aiIdx[BTCURSOR_MAX_DEPTH-1];     /* Current index in apPage[i] */
+  u8 eSplit;                /* BTREE_SPLIT_* policy for balance_nonroot() */
+  u8 nFill;                 /* Percentage of leaves to fill, or 0 for all */
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  u8 bPfxLeaf;              /* Write index leaves as PTF_PFXLEAF pages */
+#endif
   struct KeyInfo *pKeyInfo;            /* Arg passed to comparison function */
   MemPage *pPage;                        /* Current page */
   MemPage *apPage[BTCURSOR_MAX_DEPTH-1]; /* Stack of parents of current page */
@@ -72082,6 +72596,17 @@ struct BtCursor {
 #define ISAUTOVACUUM(pBt) 0
 #endif
 
+/*
+** ISPFXLEAF(pPage) is true if pPage is a PTF_PFXLEAF page.  It is used in
+** conditions that the other page types share, so that builds without
+** SQLITE_ENABLE_PREFIX_LEAF compile the test away.
+*/
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+#define ISPFXLEAF(pPage) ((pPage)->bPfx)
+#else
+#define ISPFXLEAF(pPage) 0
+#endif
+
 
 /*
 ** This structure is passed around through all the PRAGMA integrity_check
@@ -73452,10 +73977,37 @@ SQLITE_PRIVATE void sqlite3BtreeCursorHint(BtCursor *pCur, int eHintType, ...){
 ** Provide flag hints to the cursor.
 */
 SQLITE_PRIVATE void sqlite3BtreeCursorHintFlags(BtCursor *pCur, unsigned x){
-  assert( x==BTREE_SEEK_EQ || x==BTREE_BULKLOAD || x==0 );
+  assert( x==BTREE_SEEK_EQ || x==BTREE_BULKLOAD || x==BTREE_SEEK_ASC
+       || x==(BTREE_SEEK_ASC|BTREE_BULKLOAD) || x==0 );
   pCur->hints = (u8)x;
 }
 
+#ifndef SQLITE_OMIT_KV
+/*
+** Set the split policy, one of the BTREE_SPLIT_* values, and the fill
+** factor of leaf pages, as a percentage between 50 and 100 or 0 for
+** full, that balancing after inserts through cursor pCur will use.
+*/
+SQLITE_PRIVATE void sqlite3BtreeCursorSplit(BtCursor *pCur, int eSplit, int nFill){
+  assert( eSplit>=BTREE_SPLIT_DEFAULT && eSplit<=BTREE_SPLIT_ADAPTIVE );
+  assert( nFill==0 || (nFill>=50 && nFill<=100) );
+  pCur->eSplit = (u8)eSplit;
+  pCur->nFill = (u8)(nFill==100 ? 0 : nFill);
+}
+
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+/*
+** If bPfx is true, leaf pages of the index b-tree of cursor pCur that
+** balance_nonroot() rebuilds after an insert through pCur are written
+** as prefix-compressed PTF_PFXLEAF pages.  Leaves that are already of
+** that type stay so either way.
+*/
+SQLITE_PRIVATE void sqlite3BtreeCursorPfxLeaf(BtCursor *pCur, int bPfx){
+  pCur->bPfxLeaf = bPfx!=0;
+}
+#endif /* SQLITE_ENABLE_PREFIX_LEAF */
+#endif /* SQLITE_OMIT_KV */
+
 
 #ifndef SQLITE_OMIT_AUTOVACUUM
 /*
@@ -73817,6 +74369,44 @@ static void btreeParseCellPtrIndex(
     btreeParseCellAdjustSizeForOverflow(pPage, pCell, pInfo);
   }
 }
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+static void btreeParseCellPtrPfx(
+  MemPage *pPage,         /* Page containing the cell */
+  u8 *pCell,              /* Pointer to the cell text. */
+  CellInfo *pInfo         /* Fill in this structure */
+){
+  u8 *pIter;              /* For scanning through pCell */
+  u32 nPayload;           /* Number of bytes of cell payload */
+  u32 nShared;            /* Bytes of the payload held in the page prefix */
+
+  assert( sqlite3_mutex_held(pPage->pBt->mutex) );
+  assert( pPage->bPfx && pPage->leaf );
+  pIter = pCell;
+  nPayload = *pIter;
+  if( nPayload>=0x80 ){
+    u8 *pEnd = &pIter[8];
+    nPayload &= 0x7f;
+    do{
+      nPayload = (nPayload<<7) | (*++pIter & 0x7f);
+    }while( *(pIter)>=0x80 && pIter<pEnd );
+  }
+  pIter++;
+  nShared = *(pIter++);
+  pInfo->nKey = nPayload;
+  pInfo->nPayload = nPayload;
+  pInfo->pPayload = pIter;
+  if( nPayload<=pPage->maxLocal ){
+    /* The payload is local.  nLocal counts the bytes taken from the
+    ** page prefix too, but nSize only those stored in the cell. */
+    if( nShared>nPayload ) nShared = nPayload;
+    pInfo->nSize = (u16)(nPayload - nShared) + (u16)(pIter - pCell);
+    if( pInfo->nSize<4 ) pInfo->nSize = 4;
+    pInfo->nLocal = (u16)nPayload;
+  }else{
+    btreeParseCellAdjustSizeForOverflow(pPage, pCell, pInfo);
+  }
+}
+#endif /* SQLITE_ENABLE_PREFIX_LEAF */
 static void btreeParseCell(
   MemPage *pPage,         /* Page containing the cell */
   int iCell,              /* The cell index.  First cell is 0 */
@@ -73825,6 +74415,181 @@ static void btreeParseCell(
   pPage->xParseCell(pPage, findCell(pPage, iCell), pInfo);
 }
 
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+/*
+** The cell of PTF_PFXLEAF page pPage parsed into *pInfo has a non-zero
+** shared length.  Set apSeg[] and anSeg[] to the three pieces its payload
+** is made of, in order:  the record header in the cell, the shared bytes
+** in the page prefix and the rest of the record body in the cell.  Return
+** SQLITE_CORRUPT if the cell does not describe such a payload.
+*/
+static int btreePfxSplit(
+  MemPage *pPage,         /* PTF_PFXLEAF page holding the cell */
+  CellInfo *pInfo,        /* The cell, parsed */
+  u8 **apSeg,             /* OUT: Start of each piece */
+  u32 *anSeg              /* OUT: Size of each piece */
+){
+  u8 *pPayload = pInfo->pPayload;
+  u32 nShared = pPayload[-1];
+  u32 nStored;            /* Bytes of payload stored in the cell */
+  u32 nHdr;               /* Size of the record header */
+
+  assert( pPage->bPfx && nShared>0 );
+  if( nShared>pPage->nPfx
+   || pInfo->nLocal!=pInfo->nPayload
+   || nShared>=pInfo->nPayload
+  ){
+    return SQLITE_CORRUPT_PAGE(pPage);
+  }
+  nStored = pInfo->nPayload - nShared;
+  if( SQLITE_WITHIN(pPayload, pPage->aData, pPage->aDataEnd)
+   && (uptr)(pPayload - pPage->aData)>pPage->pBt->usableSize - nStored
+  ){
+    return SQLITE_CORRUPT_PAGE(pPage);
+  }
+  getVarint32NR(pPayload, nHdr);
+  if( nHdr==0 || nHdr>nStored ){
+    return SQLITE_CORRUPT_PAGE(pPage);
+  }
+  apSeg[0] = pPayload;
+  anSeg[0] = nHdr;
+  apSeg[1] = &pPage->aData[pPage->hdrOffset+9];
+  anSeg[1] = nShared;
+  apSeg[2] = &pPayload[nHdr];
+  anSeg[2] = nStored - nHdr;
+  return SQLITE_OK;
+}
+
+/*
+** Copy amt bytes starting at offset of the payload split up by
+** btreePfxSplit() into pBuf.
+*/
+static void btreePfxCopy(
+  u8 **apSeg,
+  u32 *anSeg,
+  u32 offset,
+  u32 amt,
+  u8 *pBuf
+){
+  int i;
+  for(i=0; i<3 && amt>0; i++){
+    u32 n;
+    if( offset>=anSeg[i] ){
+      offset -= anSeg[i];
+      continue;
+    }
+    n = MIN(amt, anSeg[i] - offset);
+    memcpy(pBuf, &apSeg[i][offset], n);
+    pBuf += n;
+    amt -= n;
+    offset = 0;
+  }
+}
+
+/*
+** Return the size of the header of the nRec byte record aRec if it may
+** be stored prefix-compressed on PTF_PFXLEAF page pPage, or 0 if not.
+** Only records that are local and have a 1-byte header size qualify.
+*/
+static int btreePfxHeader(MemPage *pPage, const u8 *aRec, int nRec){
+  int nHdr;
+  if( nRec>pPage->maxLocal ) return 0;
+  nHdr = aRec[0];
+  return (nHdr>0 && nHdr<0x80 && nHdr<nRec) ? nHdr : 0;
+}
+
+/*
+** Return the number of leading bytes that a[] and b[] have in common,
+** up to n.
+*/
+static int btreePfxMatch(const u8 *a, const u8 *b, int n){
+  int i = 0;
+  while( i<n && a[i]==b[i] ) i++;
+  return i;
+}
+
+/*
+** Make sure pBt->pPfxSpace is allocated.
+*/
+static int btreePfxAllocSpace(BtShared *pBt){
+  if( pBt->pPfxSpace==0 ){
+    pBt->pPfxSpace = sqlite3PageMalloc(pBt->pageSize);
+    if( pBt->pPfxSpace==0 ) return SQLITE_NOMEM_BKPT;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Return a pointer to the record of cell pCell of PTF_PFXLEAF page pPage
+** and set *pnRec to its size, if the record is stored entirely on the
+** page.  A record that shares a prefix with the page is expanded into
+** BtShared.pPfxSpace, which stays valid until the next call.  Return
+** NULL if the record overflows, if it is corrupt, or if pPfxSpace cannot
+** be allocated:  the caller must then read the payload the slow way,
+** with accessPayload().
+*/
+static u8 *btreePfxRecord(MemPage *pPage, u8 *pCell, int *pnRec){
+  BtShared *pBt = pPage->pBt;
+  CellInfo info;
+  u8 *apSeg[3];
+  u32 anSeg[3];
+
+  btreeParseCellPtrPfx(pPage, pCell, &info);
+  if( info.nPayload>pPage->maxLocal ) return 0;
+  if( info.pPayload[-1]!=0 ){
+    if( btreePfxSplit(pPage, &info, apSeg, anSeg) ) return 0;
+    if( btreePfxAllocSpace(pBt) ) return 0;
+    btreePfxCopy(apSeg, anSeg, 0, info.nPayload, pBt->pPfxSpace);
+    info.pPayload = pBt->pPfxSpace;
+  }
+  *pnRec = (int)info.nPayload;
+  return info.pPayload;
+}
+
+/*
+** Write cell pCell of PTF_PFXLEAF page pPage, which is either on the page
+** or one of its overflow cells, to pOut as it is stored on an index leaf
+** page without prefix compression.  Set *pnOut to its size.
+*/
+static int btreePfxExpandCell(
+  MemPage *pPage,         /* PTF_PFXLEAF page the cell belongs to */
+  u8 *pCell,              /* The cell */
+  u8 *pOut,               /* Write the expanded cell here */
+  int *pnOut              /* OUT: Size of the expanded cell */
+){
+  CellInfo info;
+  int nVar;               /* Size of the payload size varint */
+  int n;                  /* Size of the expanded cell */
+
+  btreeParseCellPtrPfx(pPage, pCell, &info);
+  nVar = (int)(info.pPayload - pCell) - 1;
+  memcpy(pOut, pCell, nVar);
+  if( info.pPayload[-1]!=0 ){
+    u8 *apSeg[3];
+    u32 anSeg[3];
+    int rc = btreePfxSplit(pPage, &info, apSeg, anSeg);
+    if( rc ) return rc;
+    btreePfxCopy(apSeg, anSeg, 0, info.nPayload, &pOut[nVar]);
+    n = nVar + info.nPayload;
+  }else{
+    n = nVar + info.nLocal + (info.nLocal<info.nPayload ? 4 : 0);
+    if( SQLITE_WITHIN(pCell, pPage->aData, pPage->aDataEnd)
+     && (uptr)(info.pPayload - pPage->aData)
+                > pPage->pBt->usableSize - (u32)(n - nVar)
+    ){
+      return SQLITE_CORRUPT_PAGE(pPage);
+    }
+    memcpy(&pOut[nVar], info.pPayload, n - nVar);
+  }
+  if( n<4 ){
+    memset(&pOut[n], 0, 4 - n);
+    n = 4;
+  }
+  *pnOut = n;
+  return SQLITE_OK;
+}
+#endif /* SQLITE_ENABLE_PREFIX_LEAF */
+
 /*
 ** The following routines are implementations of the MemPage.xCellSize
 ** method.
@@ -73838,6 +74603,7 @@ static void btreeParseCell(
 ** cellSizePtrTableLeaf()    =>   table leaf nodes
 ** cellSizePtr()             =>   index internal nodes
 ** cellSizeIdxLeaf()         =>   index leaf nodes
+** cellSizePtrPfxLeaf()      =>   prefix-compressed index leaf nodes
 */
 static u16 cellSizePtr(MemPage *pPage, u8 *pCell){
   u8 *pIter = pCell + 4;                   /* For looping over bytes of pCell */
@@ -73923,6 +74689,49 @@ static u16 cellSizePtrIdxLeaf(MemPage *pPage, u8 *pCell){
   assert( nSize==debuginfo.nSize || CORRUPT_DB );
   return (u16)nSize;
 }
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+static u16 cellSizePtrPfxLeaf(MemPage *pPage, u8 *pCell){
+  u8 *pIter = pCell;                       /* For looping over bytes of pCell */
+  u8 *pEnd;                                /* End mark for a varint */
+  u32 nSize;                               /* Size value to return */
+  u32 nShared;                             /* Bytes held in the page prefix */
+
+#ifdef SQLITE_DEBUG
+  /* The value returned by this function should always be the same as
+  ** the (CellInfo.nSize) value found by doing a full parse of the
+  ** cell. If SQLITE_DEBUG is defined, an assert() at the bottom of
+  ** this function verifies that this invariant is not violated. */
+  CellInfo debuginfo;
+  pPage->xParseCell(pPage, pCell, &debuginfo);
+#endif
+
+  assert( pPage->bPfx && pPage->childPtrSize==0 );
+  nSize = *pIter;
+  if( nSize>=0x80 ){
+    pEnd = &pIter[8];
+    nSize &= 0x7f;
+    do{
+      nSize = (nSize<<7) | (*++pIter & 0x7f);
+    }while( *(pIter)>=0x80 && pIter<pEnd );
+  }
+  pIter++;
+  nShared = *(pIter++);
+  if( nSize<=pPage->maxLocal ){
+    nSize -= (nShared>nSize ? nSize : nShared);
+    nSize += (u32)(pIter - pCell);
+    if( nSize<4 ) nSize = 4;
+  }else{
+    int minLocal = pPage->minLocal;
+    nSize = minLocal + (nSize - minLocal) % (pPage->pBt->usableSize - 4);
+    if( nSize>pPage->maxLocal ){
+      nSize = minLocal;
+    }
+    nSize += 4 + (u16)(pIter - pCell);
+  }
+  assert( nSize==debuginfo.nSize || CORRUPT_DB );
+  return (u16)nSize;
+}
+#endif /* SQLITE_ENABLE_PREFIX_LEAF */
 static u16 cellSizePtrNoPayload(MemPage *pPage, u8 *pCell){
   u8 *pIter = pCell + 4; /* For looping over bytes of pCell */
   u8 *pEnd;              /* End mark for a varint */
@@ -74266,7 +75075,12 @@ static SQLITE_INLINE int allocateSpace(MemPage *pPage, int nByte, int *pIdx){
   assert( pPage->nOverflow==0 );
   assert( nByte < (int)(pPage->pBt->usableSize-8) );
 
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  assert( pPage->cellOffset == hdr + 12 - 4*pPage->leaf
+                                + (pPage->bPfx ? 1 + pPage->nPfx : 0) );
+#else
   assert( pPage->cellOffset == hdr + 12 - 4*pPage->leaf );
+#endif
   gap = pPage->cellOffset + 2*pPage->nCell;
   assert( gap<=65536 );
   /* EVIDENCE-OF: R-29356-02391 If the database uses a 65536-byte page size
@@ -74466,6 +75280,10 @@ static int decodeFlags(MemPage *pPage, int flagByte){
   assert( sqlite3_mutex_held(pPage->pBt->mutex) );
   pBt = pPage->pBt;
   pPage->max1bytePayload = pBt->max1bytePayload;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  pPage->bPfx = 0;
+  pPage->nPfx = 0;
+#endif
   if( flagByte>=(PTF_ZERODATA | PTF_LEAF) ){
     pPage->childPtrSize = 0;
     pPage->leaf = 1;
@@ -74483,6 +75301,16 @@ static int decodeFlags(MemPage *pPage, int flagByte){
       pPage->xParseCell = btreeParseCellPtrIndex;
       pPage->maxLocal = pBt->maxLocal;
       pPage->minLocal = pBt->minLocal;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+    }else if( flagByte==(PTF_PFXLEAF | PTF_ZERODATA | PTF_LEAF) ){
+      pPage->intKey = 0;
+      pPage->intKeyLeaf = 0;
+      pPage->bPfx = 1;
+      pPage->xCellSize = cellSizePtrPfxLeaf;
+      pPage->xParseCell = btreeParseCellPtrPfx;
+      pPage->maxLocal = pBt->maxLocal;
+      pPage->minLocal = pBt->minLocal;
+#endif
     }else{
       pPage->intKey = 0;
       pPage->intKeyLeaf = 0;
@@ -74548,7 +75376,7 @@ static int btreeComputeFreeSpace(MemPage *pPage){
   ** the start of the cell content area. A zero value for this integer is
   ** interpreted as 65536. */
   top = get2byteNotZero(&data[hdr+5]);
-  iCellFirst = hdr + 8 + pPage->childPtrSize + 2*pPage->nCell;
+  iCellFirst = pPage->cellOffset + 2*pPage->nCell;
   iCellLast = usableSize - 4;
 
   /* Compute the total free space on the page
@@ -74669,6 +75497,14 @@ static int btreeInitPage(MemPage *pPage){
   pPage->nOverflow = 0;
   pPage->cellOffset = (u16)(pPage->hdrOffset + 8 + pPage->childPtrSize);
   pPage->aCellIdx = data + pPage->childPtrSize + 8;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( pPage->bPfx ){
+    /* The prefix length and the prefix come before the cell index */
+    pPage->nPfx = data[8];
+    pPage->cellOffset += 1 + pPage->nPfx;
+    pPage->aCellIdx += 1 + pPage->nPfx;
+  }
+#endif
   pPage->aDataEnd = pPage->aData + pBt->pageSize;
   pPage->aDataOfst = pPage->aData + pPage->childPtrSize;
   /* EVIDENCE-OF: R-37002-32774 The two-byte integer at offset 3 gives the
@@ -74687,6 +75523,7 @@ static int btreeInitPage(MemPage *pPage){
        || get2byteNotZero(&data[5])==(int)pBt->usableSize
        || CORRUPT_DB );
   pPage->nFree = -1;  /* Indicate that this value is yet uncomputed */
+  btreePrefixReset(pPage);
   pPage->isInit = 1;
   if( pBt->db->flags & SQLITE_CellSizeCk ){
     return btreeCellSizeCheck(pPage);
@@ -74716,6 +75553,12 @@ static void zeroPage(MemPage *pPage, int flags){
   first = hdr + ((flags&PTF_LEAF)==0 ? 12 : 8);
   memset(&data[hdr+1], 0, 4);
   data[hdr+7] = 0;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( flags & PTF_PFXLEAF ){
+    /* An empty prefix.  btreePfxBuildPage() may set a longer one. */
+    data[first++] = 0;
+  }
+#endif
   put2byte(&data[hdr+5], pBt->usableSize);
   pPage->nFree = (u16)(pBt->usableSize - first);
   decodeFlags(pPage, flags);
@@ -74727,6 +75570,7 @@ static void zeroPage(MemPage *pPage, int flags){
   assert( pBt->pageSize>=512 && pBt->pageSize<=65536 );
   pPage->maskPage = (u16)(pBt->pageSize - 1);
   pPage->nCell = 0;
+  btreePrefixReset(pPage);
   pPage->isInit = 1;
 }
 
@@ -75343,6 +76187,10 @@ static void freeTempSpace(BtShared *pBt){
     sqlite3PageFree(pBt->pTmpSpace);
     pBt->pTmpSpace = 0;
   }
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  sqlite3PageFree(pBt->pPfxSpace);
+  pBt->pPfxSpace = 0;
+#endif
 }
 
 /*
@@ -75393,6 +76241,9 @@ SQLITE_PRIVATE int sqlite3BtreeClose(Btree *p){
     }
     sqlite3DbFree(0, pBt->pSchema);
     freeTempSpace(pBt);
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+    sqlite3_free(pBt->aPrefix);
+#endif
     sqlite3_free(pBt);
   }
 
@@ -77135,6 +77986,11 @@ static int btreeCursor(
   ** variables and link the cursor into the BtShared list.  */
   pCur->pgnoRoot = iTable;
   pCur->iPage = -1;
+  pCur->eSplit = BTREE_SPLIT_DEFAULT;
+  pCur->nFill = 0;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  pCur->bPfxLeaf = 0;
+#endif
   pCur->pKeyInfo = pKeyInfo;
   pCur->pBtree = p;
   pCur->pBt = pBt;
@@ -77557,6 +78413,18 @@ static int accessPayload(
   assert( offset+amt <= pCur->info.nPayload );
 
   assert( aPayload > pPage->aData );
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( pPage->bPfx && aPayload[-1]!=0 ){
+    /* A prefix-compressed cell.  The payload is all on the page, but in
+    ** pieces.  Only index b-trees have such cells, so this is a read. */
+    u8 *apSeg[3];
+    u32 anSeg[3];
+    assert( eOp==0 );
+    rc = btreePfxSplit(pPage, &pCur->info, apSeg, anSeg);
+    if( rc==SQLITE_OK ) btreePfxCopy(apSeg, anSeg, offset, amt, pBuf);
+    return rc;
+  }
+#endif
   if( (uptr)(aPayload - pPage->aData) > (pBt->usableSize - pCur->info.nLocal) ){
     /* Trying to read or write past the end of the data is an error.  The
     ** conditional above is really:
@@ -77816,6 +78684,18 @@ static const void *fetchPayload(
     assert( CORRUPT_DB );
     amt = MAX(0, (int)(pCur->pPage->aDataEnd - pCur->info.pPayload));
   }
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( pCur->pPage->bPfx && pCur->info.pPayload[-1]!=0 ){
+    /* Only the record header of a prefix-compressed cell is stored as
+    ** is.  The caller reads the rest with accessPayload(). */
+    u8 *apSeg[3];
+    u32 anSeg[3];
+    amt = 0;
+    if( btreePfxSplit(pCur->pPage, &pCur->info, apSeg, anSeg)==SQLITE_OK ){
+      amt = (int)anSeg[0];
+    }
+  }
+#endif
   *pAmt = (u32)amt;
   return (void*)pCur->info.pPayload;
 }
@@ -77840,6 +78720,170 @@ SQLITE_PRIVATE const void *sqlite3BtreePayloadFetch(BtCursor *pCur, u32 *pAmt){
 }
 
 
+#ifndef SQLITE_OMIT_KV
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+/*
+** The sqlite3BtreePayloadPin() case of an entry stored as a prefix-
+** compressed cell, which is local but in up to three pieces.
+*/
+static int btreePfxPin(
+  BtCursor *pCur,
+  u32 offset,
+  u32 amt,
+  BtreeSpan **paSpan,
+  int *pnSpan
+){
+  MemPage *pPage = pCur->pPage;
+  u8 *apSeg[3];
+  u32 anSeg[3];
+  BtreeSpan *aSpan;
+  MemPage *pRef;
+  int nSpan = 0;
+  int rc;
+  int i;
+
+  if( (u64)offset + amt > pCur->info.nPayload ){
+    return SQLITE_CORRUPT_PAGE(pPage);
+  }
+  rc = btreePfxSplit(pPage, &pCur->info, apSeg, anSeg);
+  if( rc ) return rc;
+  if( amt==0 ) return SQLITE_OK;
+  aSpan = (BtreeSpan*)sqlite3Malloc(3 * sizeof(BtreeSpan));
+  if( aSpan==0 ) return SQLITE_NOMEM_BKPT;
+  for(i=0; i<3 && amt>0; i++){
+    if( offset>=anSeg[i] ){
+      offset -= anSeg[i];
+      continue;
+    }
+    rc = btreeGetPage(pCur->pBt, pPage->pgno, &pRef, PAGER_GET_READONLY);
+    if( rc ){
+      sqlite3BtreePayloadUnpin(aSpan, nSpan);
+      return rc;
+    }
+    aSpan[nSpan].z = &pRef->aData[&apSeg[i][offset] - pPage->aData];
+    aSpan[nSpan].n = MIN(amt, anSeg[i] - offset);
+    aSpan[nSpan].pPage = pRef;
+    amt -= aSpan[nSpan].n;
+    nSpan++;
+    offset = 0;
+  }
+  *paSpan = aSpan;
+  *pnSpan = nSpan;
+  return SQLITE_OK;
+}
+#endif /* SQLITE_ENABLE_PREFIX_LEAF */
+
+/*
+** Pin the amt bytes of payload starting at offset of the entry pCur
+** points to, without copying them.  On success *paSpan is set to an array
+** of *pnSpan extents, allocated with sqlite3_malloc(), that together
+** hold the bytes in order: the part stored on the b-tree page itself and
+** then one extent per overflow page.  Each extent holds a reference on
+** its page, so the bytes stay in place, in the page cache or in the
+** memory-mapped file, after the cursor moves or is closed, until they
+** are released by sqlite3BtreePayloadUnpin().  Pages are requested read-
+** only and the caller must hold a read transaction for that long.
+*/
+SQLITE_PRIVATE int sqlite3BtreePayloadPin(
+  BtCursor *pCur,
+  u32 offset,
+  u32 amt,
+  BtreeSpan **paSpan,
+  int *pnSpan
+){
+  BtShared *pBt = pCur->pBt;
+  MemPage *pPage = pCur->pPage;
+  const u32 ovflSize = pBt->usableSize - 4;
+  const u8 *aPayload;
+  BtreeSpan *aSpan;
+  MemPage *pRef;
+  int nSpan = 0;
+  int rc;
+
+  assert( cursorHoldsMutex(pCur) );
+  assert( pCur->eState==CURSOR_VALID );
+  *paSpan = 0;
+  *pnSpan = 0;
+  if( pCur->ix>=pPage->nCell ) return SQLITE_CORRUPT_PAGE(pPage);
+  getCellInfo(pCur);
+  aPayload = pCur->info.pPayload;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( pPage->bPfx && aPayload[-1]!=0 ){
+    return btreePfxPin(pCur, offset, amt, paSpan, pnSpan);
+  }
+#endif
+  if( (uptr)(aPayload - pPage->aData) > (pBt->usableSize - pCur->info.nLocal)
+   || (u64)offset + amt > pCur->info.nPayload
+  ){
+    return SQLITE_CORRUPT_PAGE(pPage);
+  }
+  if( amt==0 ) return SQLITE_OK;
+  aSpan = (BtreeSpan*)sqlite3Malloc(
+      (2 + (u64)amt/ovflSize + 1) * sizeof(BtreeSpan)
+  );
+  if( aSpan==0 ) return SQLITE_NOMEM_BKPT;
+
+  if( offset<pCur->info.nLocal ){
+    /* Take a reference of our own on the page:  a memory-mapped page
+    ** object may only be referenced once, so this is a second one. */
+    rc = btreeGetPage(pBt, pPage->pgno, &pRef, PAGER_GET_READONLY);
+    if( rc ) goto pin_failed;
+    aSpan[0].z = &pRef->aData[&aPayload[offset] - pPage->aData];
+    aSpan[0].n = MIN(amt, pCur->info.nLocal - offset);
+    aSpan[0].pPage = pRef;
+    nSpan = 1;
+    amt -= aSpan[0].n;
+    offset = 0;
+  }else{
+    offset -= pCur->info.nLocal;
+  }
+  if( amt>0 ){
+    Pgno nextPage = get4byte(&aPayload[pCur->info.nLocal]);
+    while( amt>0 ){
+      if( nextPage<2 || nextPage>btreePagecount(pBt) ){
+        rc = SQLITE_CORRUPT_BKPT;
+        goto pin_failed;
+      }
+      rc = btreeGetPage(pBt, nextPage, &pRef, PAGER_GET_READONLY);
+      if( rc ) goto pin_failed;
+      nextPage = get4byte(pRef->aData);
+      if( offset>=ovflSize ){
+        offset -= ovflSize;
+        releasePageNotNull(pRef);
+        continue;
+      }
+      aSpan[nSpan].z = &pRef->aData[4 + offset];
+      aSpan[nSpan].n = MIN(amt, ovflSize - offset);
+      aSpan[nSpan].pPage = pRef;
+      amt -= aSpan[nSpan].n;
+      nSpan++;
+      offset = 0;
+    }
+  }
+  *paSpan = aSpan;
+  *pnSpan = nSpan;
+  return SQLITE_OK;
+
+ pin_failed:
+  sqlite3BtreePayloadUnpin(aSpan, nSpan);
+  return rc;
+}
+
+/*
+** Release the page references of the nSpan extents of aSpan[], obtained
+** from sqlite3BtreePayloadPin(), and free the array.  The caller must
+** hold the mutex of the b-tree the extents came from.
+*/
+SQLITE_PRIVATE void sqlite3BtreePayloadUnpin(BtreeSpan *aSpan, int nSpan){
+  int i;
+  for(i=0; i<nSpan; i++){
+    assert( sqlite3_mutex_held(aSpan[i].pPage->pBt->mutex) );
+    releasePageNotNull(aSpan[i].pPage);
+  }
+  sqlite3_free(aSpan);
+}
+#endif /* SQLITE_OMIT_KV */
+
 /*
 ** Move the cursor down to a new child page.  The newPgno argument is the
 ** page number of the child page to move to.
@@ -78369,6 +79413,12 @@ static int indexCellCompare(
   int nCell;  /* Size of the pCell cell in bytes */
   u8 *pCell = findCellPastPtr(pPage, idx);
 
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( pPage->bPfx ){
+    u8 *pRec = btreePfxRecord(pPage, pCell, &nCell);
+    return pRec ? xRecordCompare(nCell, (void*)pRec, pIdxKey) : 99;
+  }
+#endif
   nCell = pCell[0];
   if( nCell<=pPage->max1bytePayload ){
     /* This branch runs if the record-size field of the cell is a
@@ -78391,6 +79441,66 @@ static int indexCellCompare(
   return c;
 }
 
+/*
+** Return true if cell idx of index page pPage is stored entirely on
+** the page, so that indexCellCompare() computes an exact result for it.
+*/
+static int indexCellIsLocal(MemPage *pPage, int idx){
+  u8 *pCell = findCellPastPtr(pPage, idx);
+  int nCell = pCell[0];
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( pPage->bPfx ){
+    return btreePfxRecord(pPage, pCell, &nCell)!=0;
+  }
+#endif
+  return nCell<=pPage->max1bytePayload
+      || (!(pCell[1] & 0x80)
+          && ((nCell&0x7f)<<7) + pCell[1]<=pPage->maxLocal);
+}
+
+/*
+** Cursor pCur points into a leaf page of an index.  Return the level
+** of the page, in pCur->apPage[] terms, from which a search for pIdxKey
+** may start instead of from the root, or -1 if there is none.
+**
+** pIdxKey must be no smaller than the first cell of the leaf; every
+** ancestor subtree then starts below it.  The search may start at the
+** lowest page whose subtree also ends above it:  the leaf itself if its
+** last cell is not smaller than pIdxKey, or otherwise the child below
+** the nearest separator cell larger than pIdxKey, or the page holding
+** a separator equal to it.
+*/
+static int indexSeekLevel(
+  BtCursor *pCur,
+  UnpackedRecord *pIdxKey,
+  RecordCompare xRecordCompare
+){
+  MemPage *pPage = pCur->pPage;
+  int i, c;
+
+  assert( pPage->leaf && pPage->nCell>0 );
+  if( !indexCellIsLocal(pPage, 0)
+   || indexCellCompare(pPage, 0, pIdxKey, xRecordCompare)>0
+  ){
+    return -1;
+  }
+  if( indexCellIsLocal(pPage, pPage->nCell-1)
+   && indexCellCompare(pPage, pPage->nCell-1, pIdxKey, xRecordCompare)>=0
+  ){
+    return pCur->iPage;
+  }
+  for(i=pCur->iPage-1; i>=0; i--){
+    int ix = pCur->aiIdx[i];
+    pPage = pCur->apPage[i];
+    if( ix>=pPage->nCell ) continue;   /* Right-most child: no bound here */
+    if( !indexCellIsLocal(pPage, ix) ) return -1;
+    c = indexCellCompare(pPage, ix, pIdxKey, xRecordCompare);
+    if( c>0 ) return i+1;
+    if( c==0 ) return i;
+  }
+  return -1;
+}
+
 /*
 ** Return true (non-zero) if pCur is current pointing to the last
 ** page of a table.
@@ -78405,6 +79515,177 @@ static int cursorOnLastPage(BtCursor *pCur){
   return 1;
 }
 
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+/*
+** Return the first 8 of the n bytes at a[] as a big-endian integer,
+** padded with zeros, or its complement if bDesc is true.  When two keys
+** that share everything before a[] have different prefixes, the keys are
+** in the same order as the prefixes.
+*/
+static u64 btreePrefixOf(const u8 *a, int n, int bDesc){
+  u64 x = 0;
+  int i;
+  for(i=0; i<8; i++){
+    x = (x<<8) | (i<n ? a[i] : 0);
+  }
+  return bDesc ? ~x : x;
+}
+
+/*
+** Set *ppKey to the first field of the key of cell iCell of index page
+** pPage and *pnKey to its size, and return the number of bytes of it
+** that are on the page.  Return -1 if the field is not a BLOB.
+*/
+static int btreePrefixCellKey(
+  MemPage *pPage,
+  int iCell,
+  const u8 **ppKey,
+  u32 *pnKey
+){
+  u8 *pCell = findCellPastPtr(pPage, iCell);
+  u32 nPayload, nHdr, t, nLocal, n;
+  u8 *a = pCell + getVarint32(pCell, nPayload);
+  nLocal = nPayload<=pPage->maxLocal ? nPayload : pPage->minLocal;
+  n = getVarint32(a, nHdr);
+  if( nHdr<=n || nHdr>nLocal || a+nHdr>pPage->aDataEnd ) return -1;
+  getVarint32(&a[n], t);
+  if( t<12 || (t&1)!=0 ) return -1;
+  *ppKey = &a[nHdr];
+  *pnKey = (t-12)/2;
+  n = nLocal - nHdr;
+  if( n>*pnKey ) n = *pnKey;
+  if( n>(u32)(pPage->aDataEnd - *ppKey) ) n = (u32)(pPage->aDataEnd - *ppKey);
+  return (int)n;
+}
+
+/*
+** Return the slot of the search accelerator of pPage, or NULL if it
+** has none.
+*/
+static BtPrefix *btreePrefixFind(BtShared *pBt, MemPage *pPage){
+  BtPrefix *p;
+  int i;
+  if( pPage->ePrefix!=PREFIX_READY || pBt->aPrefix==0 ) return 0;
+  p = &pBt->aPrefix[(pPage->pgno % BTREE_PREFIX_SETS)*BTREE_PREFIX_WAYS];
+  for(i=0; i<BTREE_PREFIX_WAYS; i++, p++){
+    if( p->pPage==pPage && p->pgno==pPage->pgno ) return p;
+  }
+  return 0;
+}
+
+/*
+** Build the search accelerator of interior index page pPage and return
+** its slot.
+** Set MemPage.ePrefix to PREFIX_NONE and return NULL if some key on the
+** page does not start with a BLOB, or the bytes needed are not on the
+** page, or to PREFIX_SEEN to try again later if out of memory.
+*/
+static BtPrefix *btreePrefixBuild(BtShared *pBt, MemPage *pPage, int bDesc){
+  int nCell = pPage->nCell;
+  int nStride = (nCell + BTREE_PREFIX_MAX - 1)/BTREE_PREFIX_MAX;
+  const u8 *aFirst, *aLast, *aKey;
+  u32 nFirst, nLast, nKey;
+  int nSkip, n, i, j;
+  BtPrefix *p, *pSet;
+
+  assert( pPage->intKey==0 && pPage->leaf==0 );
+  assert( pPage->nOverflow==0 && nCell>0 );
+  pPage->ePrefix = PREFIX_NONE;
+  if( pBt->aPrefix==0 ){
+    pBt->aPrefix = (BtPrefix*)sqlite3MallocZero(
+        sizeof(BtPrefix)*BTREE_PREFIX_SETS*BTREE_PREFIX_WAYS);
+    if( pBt->aPrefix==0 ){
+      pPage->ePrefix = PREFIX_SEEN;
+      return 0;
+    }
+  }
+
+  /* All keys on the page share the bytes the first and last share */
+  nSkip = btreePrefixCellKey(pPage, 0, &aFirst, &nFirst);
+  n = btreePrefixCellKey(pPage, nCell-1, &aLast, &nLast);
+  if( nSkip<0 || n<0 ) return 0;
+  if( n<nSkip ) nSkip = n;
+  if( nSkip>BTREE_PREFIX_SKIP ) nSkip = BTREE_PREFIX_SKIP;
+  for(n=0; n<nSkip && aFirst[n]==aLast[n]; n++){}
+  nSkip = n;
+
+  /* The slot of the set that is free, or else was built longest ago */
+  pSet = &pBt->aPrefix[(pPage->pgno % BTREE_PREFIX_SETS)*BTREE_PREFIX_WAYS];
+  p = pSet;
+  for(i=0; i<BTREE_PREFIX_WAYS && pSet[i].pPage; i++){
+    if( pSet[i].pPage==pPage && pSet[i].pgno==pPage->pgno ) break;
+    if( pSet[i].iStamp<p->iStamp ) p = &pSet[i];
+  }
+  if( i<BTREE_PREFIX_WAYS ) p = &pSet[i];
+  p->pPage = 0;
+
+  for(i=j=0; i<nCell; i+=nStride, j++){
+    n = btreePrefixCellKey(pPage, i, &aKey, &nKey);
+    if( n<nSkip || (u32)n<(nKey<(u32)nSkip+8 ? nKey : (u32)nSkip+8) ){
+      return 0;
+    }
+    p->aPrefix[j] = btreePrefixOf(&aKey[nSkip], n-nSkip, bDesc);
+  }
+  memcpy(p->aSkip, aFirst, nSkip);
+  p->pPage = pPage;
+  p->pgno = pPage->pgno;
+  p->iStamp = ++pBt->iPrefixStamp;
+  p->bDesc = (u8)bDesc;
+  p->nSkip = (u8)nSkip;
+  p->nPrefix = (u16)j;
+  p->nStride = (u16)nStride;
+  pPage->ePrefix = PREFIX_READY;
+  return p;
+}
+
+/*
+** Narrow the range of cells *pLwr..*pUpr of a page of nCell cells that a
+** search for key a[0..n-1] has to look at to those that the accelerator
+** p of the page does not show to be smaller or larger than the key.  The
+** range may end up empty, with *pLwr one past *pUpr.
+*/
+static void btreePrefixBounds(
+  BtPrefix *p,
+  const u8 *a, int n,
+  int nCell,
+  int *pLwr, int *pUpr
+){
+  u64 iPrefix;
+  const u64 *a64 = p->aPrefix;
+  int nPrefix = p->nPrefix;
+  int i, c = 0;
+
+  if( p->nSkip>0 ){
+    c = n>0 ? memcmp(a, p->aSkip, n<p->nSkip ? n : p->nSkip) : 0;
+    if( c==0 && n<p->nSkip ) c = -1;
+  }
+  if( c ){
+    /* The key sorts before or after every key on the page */
+    if( (c<0)==(p->bDesc==0) ){
+      *pLwr = 0;
+      *pUpr = -1;
+    }else{
+      *pLwr = nCell;
+      *pUpr = nCell-1;
+    }
+    return;
+  }
+  iPrefix = btreePrefixOf(&a[p->nSkip], n - p->nSkip, p->bDesc);
+
+  /* First entry not smaller than the key, by a binary search without
+  ** branches the CPU has to guess, then the first entry larger */
+  while( nPrefix>1 ){
+    int nHalf = nPrefix>>1;
+    a64 = a64[nHalf-1]<iPrefix ? &a64[nHalf] : a64;
+    nPrefix -= nHalf;
+  }
+  i = (int)(a64 - p->aPrefix) + (a64[0]<iPrefix);
+  if( i>0 ) *pLwr = (i-1)*p->nStride + 1;
+  while( i<p->nPrefix && p->aPrefix[i]==iPrefix ) i++;
+  if( i<p->nPrefix ) *pUpr = i*p->nStride - 1;
+}
+#endif /* SQLITE_ENABLE_PREFIX_SEARCH */
+
 /* Move the cursor so that it points to an entry in an index table
 ** near the key pIdxKey.   Return a success code.
 **
@@ -78438,6 +79719,11 @@ SQLITE_PRIVATE int sqlite3BtreeIndexMoveto(
 ){
   int rc;
   RecordCompare xRecordCompare;
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+  Mem *pKey0;                     /* First field of the search key */
+  int bPrefix;                    /* True if it can be searched by prefix */
+  int bDesc;                      /* True if in descending order */
+#endif
 
   assert( cursorOwnsBtShared(pCur) );
   assert( sqlite3_mutex_held(pCur->pBtree->db->mutex) );
@@ -78492,6 +79778,23 @@ SQLITE_PRIVATE int sqlite3BtreeIndexMoveto(
     pIdxKey->errCode = SQLITE_OK;
   }
 
+  /*    (3) If seeks on the cursor come in ascending key order and it is
+  **        on a leaf page, climb only as far as the lowest ancestor page
+  **        that must contain pIdxKey and start the search there.
+  */
+  if( (pCur->hints & BTREE_SEEK_ASC)!=0
+   && pCur->eState==CURSOR_VALID
+   && pCur->pPage->leaf
+  ){
+    int iLevel = indexSeekLevel(pCur, pIdxKey, xRecordCompare);
+    if( iLevel>=0 && pIdxKey->errCode==SQLITE_OK ){
+      while( pCur->iPage>iLevel ) moveToParent(pCur);
+      pCur->curFlags &= ~(BTCF_ValidOvfl|BTCF_AtLast);
+      goto bypass_moveto_root;
+    }
+    pIdxKey->errCode = SQLITE_OK;
+  }
+
   rc = moveToRoot(pCur);
   if( rc ){
     if( rc==SQLITE_EMPTY ){
@@ -78509,6 +79812,14 @@ bypass_moveto_root:
   assert( pCur->pPage->nCell > 0 );
   assert( pCur->curIntKey==0 );
   assert( pIdxKey!=0 );
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+  /* Prefixes do not order values of other types than BLOB, nor TEXT under
+  ** a collating sequence. */
+  pKey0 = &pIdxKey->aMem[0];
+  bPrefix = (pKey0->flags & (MEM_Blob|MEM_Zero|MEM_Null|MEM_Str|MEM_Int
+                             |MEM_Real|MEM_IntReal))==MEM_Blob;
+  bDesc = (pIdxKey->pKeyInfo->aSortFlags[0] & KEYINFO_ORDER_DESC)!=0;
+#endif
   for(;;){
     int lwr, upr, idx, c;
     Pgno chldPg;
@@ -78525,9 +79836,40 @@ bypass_moveto_root:
     assert( pPage->intKey==0 );
     lwr = 0;
     upr = pPage->nCell-1;
-    idx = upr>>1; /* idx = (lwr+upr)/2; */
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+    if( bPrefix && pPage->leaf==0 && pPage->ePrefix!=PREFIX_NONE ){
+      BtPrefix *pSlot = btreePrefixFind(pCur->pBt, pPage);
+      if( pSlot==0 ){
+        if( pPage->ePrefix==PREFIX_NEW ){
+          pPage->ePrefix = PREFIX_SEEN;
+        }else{
+          pSlot = btreePrefixBuild(pCur->pBt, pPage, bDesc);
+        }
+      }
+      if( pSlot && pSlot->bDesc==bDesc ){
+        btreePrefixBounds(pSlot, (const u8*)pKey0->z, pKey0->n,
+                          pPage->nCell, &lwr, &upr);
+        if( lwr>upr ){
+          /* No key on the page has the prefix of the search key.  Cell
+          ** lwr, if there is one, is the first cell larger than it. */
+          if( lwr<pPage->nCell ){
+            idx = lwr;
+            c = +1;
+          }else{
+            idx = upr;
+            c = -1;
+          }
+          goto moveto_index_bounded;
+        }
+      }
+    }
+#endif
+    idx = (lwr+upr)>>1; /* idx = (lwr+upr)/2; */
     for(;;){
       int nCell;  /* Size of the pCell cell in bytes */
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+      u8 *pRec;   /* Record of a prefix-compressed cell */
+#endif
       pCell = findCellPastPtr(pPage, idx);
 
       /* The maximum supported page-size is 65536 bytes. This means that
@@ -78539,13 +79881,20 @@ bypass_moveto_root:
       ** 2 bytes of the cell.
       */
       nCell = pCell[0];
-      if( nCell<=pPage->max1bytePayload ){
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+      if( pPage->bPfx && (pRec = btreePfxRecord(pPage, pCell, &nCell))!=0 ){
+        /* A cell of a prefix-compressed leaf stored entirely on the page.
+        ** Other cells of such a page take the last branch. */
+        c = xRecordCompare(nCell, (void*)pRec, pIdxKey);
+      }else
+#endif
+      if( nCell<=pPage->max1bytePayload && !ISPFXLEAF(pPage) ){
         /* This branch runs if the record-size field of the cell is a
         ** single byte varint and the record fits entirely on the main
         ** b-tree page.  */
         testcase( pCell+nCell+1==pPage->aDataEnd );
         c = xRecordCompare(nCell, (void*)&pCell[1], pIdxKey);
-      }else if( !(pCell[1] & 0x80)
+      }else if( !ISPFXLEAF(pPage) && !(pCell[1] & 0x80)
         && (nCell = ((nCell&0x7f)<<7) + pCell[1])<=pPage->maxLocal
       ){
         /* The record-size field is a 2 byte varint and the record
@@ -78611,6 +79960,9 @@ bypass_moveto_root:
       assert( lwr+upr>=0 );
       idx = (lwr+upr)>>1;  /* idx = (lwr+upr)/2 */
     }
+#ifdef SQLITE_ENABLE_PREFIX_SEARCH
+moveto_index_bounded:
+#endif
     assert( lwr==upr+1 || (pPage->intKey && !pPage->leaf) );
     assert( pPage->isInit );
     if( pPage->leaf ){
@@ -79504,6 +80856,31 @@ static int fillInCell(
     nSrc = nPayload = (int)pX->nKey;
     pSrc = pX->pKey;
     nHeader += putVarint32(&pCell[nHeader], nPayload);
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+    if( pPage->bPfx ){
+      /* Leave out the bytes of the record body that the page prefix
+      ** holds, if any. */
+      int nHdr = btreePfxHeader(pPage, pSrc, nPayload);
+      int nShared = 0;
+      if( nHdr ){
+        nShared = btreePfxMatch(&pPage->aData[pPage->hdrOffset+9],
+                                &pSrc[nHdr], MIN(pPage->nPfx, nPayload-nHdr));
+      }
+      pCell[nHeader++] = (u8)nShared;
+      if( nShared ){
+        pPayload = &pCell[nHeader];
+        memcpy(pPayload, pSrc, nHdr);
+        memcpy(&pPayload[nHdr], &pSrc[nHdr+nShared], nPayload-nHdr-nShared);
+        n = nHeader + nPayload - nShared;
+        if( n<4 ){
+          n = 4;
+          pCell[3] = 0;
+        }
+        *pnSize = n;
+        return SQLITE_OK;
+      }
+    }
+#endif
   }
 
   /* Fill in the payload */
@@ -79689,6 +81066,7 @@ static void dropCell(MemPage *pPage, int idx, int sz, int *pRC){
     *pRC = rc;
     return;
   }
+  btreePrefixReset(pPage);
   pPage->nCell--;
   if( pPage->nCell==0 ){
     memset(&data[hdr+1], 0, 4);
@@ -79745,6 +81123,7 @@ static int insertCell(
   assert( sz==pPage->xCellSize(pPage, pCell) || CORRUPT_DB );
   assert( pPage->nFree>=0 );
   assert( iChild>0 );
+  btreePrefixReset(pPage);
   if( pPage->nOverflow || sz+2>pPage->nFree ){
     if( pTemp ){
       memcpy(pTemp, pCell, sz);
@@ -79840,6 +81219,7 @@ static int insertCellFast(
   assert( sz==pPage->xCellSize(pPage, pCell) || CORRUPT_DB );
   assert( pPage->nFree>=0 );
   assert( pPage->nOverflow==0 );
+  btreePrefixReset(pPage);
   if( sz+2>pPage->nFree ){
     j = pPage->nOverflow++;
     /* Comparison against ArraySize-1 since we hold back one extra slot
@@ -80057,6 +81437,7 @@ static int rebuildPage(
 
   assert( nCell>0 );
   assert( i<iEnd );
+  btreePrefixReset(pPg);
   j = get2byte(&aData[hdr+5]);
   if( j>(u32)usableSize ){ j = 0; }
   memcpy(&pTmp[j], &aData[j], usableSize - j);
@@ -80289,6 +81670,7 @@ static int editPage(
 
   /* Remove cells from the start and end of the page */
   assert( nCell>=0 );
+  btreePrefixReset(pPg);
   if( iOld<iNew ){
     int nShift = pageFreeArray(pPg, iOld, iNew-iOld, pCArray);
     if( NEVER(nShift>nCell) ) return SQLITE_CORRUPT_BKPT;
@@ -80394,10 +81776,19 @@ static int editPage(
 ** which is also the right-most entry on the page.
 **
 ** The pSpace buffer is used to store a temporary copy of the divider
-** cell that will be inserted into pParent. Such a cell consists of a 4
-** byte page number followed by a variable length integer. In other
-** words, at most 13 bytes. Hence the pSpace buffer must be at
-** least 13 bytes in size.
+** cell that will be inserted into pParent. For an intkey table such a
+** cell consists of a 4 byte page number followed by a variable length
+** integer. In other words, at most 13 bytes. Hence the pSpace buffer
+** must be at least 13 bytes in size.
+**
+** An index b-tree keeps its entries on interior pages too, so there the
+** divider is the largest entry of pPage itself, moved up into pParent
+** with pPage as its left child.  pPage is left as full as it was before
+** the insert, less that one cell, instead of being split in half by
+** balance_nonroot(), which is what keeps a b-tree that is filled in key
+** order from ending up with half-empty leaves.  pSpace must then be a
+** page in size and must remain valid until pParent has been balanced,
+** as the divider may become an overflow cell of pParent.
 */
 static int balance_quick(MemPage *pParent, MemPage *pPage, u8 *pSpace){
   BtShared *const pBt = pPage->pBt;    /* B-Tree Database */
@@ -80428,8 +81819,10 @@ static int balance_quick(MemPage *pParent, MemPage *pPage, u8 *pSpace){
     CellArray b;
 
     assert( sqlite3PagerIswriteable(pNew->pDbPage) );
-    assert( CORRUPT_DB || pPage->aData[0]==(PTF_INTKEY|PTF_LEAFDATA|PTF_LEAF) );
-    zeroPage(pNew, PTF_INTKEY|PTF_LEAFDATA|PTF_LEAF);
+    assert( CORRUPT_DB || pPage->aData[0]==(PTF_INTKEY|PTF_LEAFDATA|PTF_LEAF)
+                       || pPage->aData[0]==(PTF_ZERODATA|PTF_LEAF) );
+    zeroPage(pNew, pPage->intKeyLeaf ? PTF_INTKEY|PTF_LEAFDATA|PTF_LEAF
+                                     : PTF_ZERODATA|PTF_LEAF);
     b.nCell = 1;
     b.pRef = pPage;
     b.apCell = &pCell;
@@ -80474,10 +81867,36 @@ static int balance_quick(MemPage *pParent, MemPage *pPage, u8 *pSpace){
     ** cell on pPage into the pSpace buffer.
     */
     pCell = findCell(pPage, pPage->nCell-1);
-    pStop = &pCell[9];
-    while( (*(pCell++)&0x80) && pCell<pStop );
-    pStop = &pCell[9];
-    while( ((*(pOut++) = *(pCell++))&0x80) && pCell<pStop );
+    if( pPage->intKeyLeaf ){
+      pStop = &pCell[9];
+      while( (*(pCell++)&0x80) && pCell<pStop );
+      pStop = &pCell[9];
+      while( ((*(pOut++) = *(pCell++))&0x80) && pCell<pStop );
+    }else{
+      /* Move the largest entry of pPage up into pParent.  A cell of less
+      ** than 4 bytes is padded to 4 on the leaf, so the size of the
+      ** divider is taken from pParent once it has been copied.  Its
+      ** overflow pages, if any, now belong to pParent.  An overflow cell
+      ** is added without writing to the page, so pPage may not be
+      ** writable yet. */
+      szCell = pPage->xCellSize(pPage, pCell);
+      if( pCell+szCell>pPage->aDataEnd ){
+        rc = SQLITE_CORRUPT_PAGE(pPage);
+      }else if( rc==SQLITE_OK
+             && (rc = sqlite3PagerWrite(pPage->pDbPage))==SQLITE_OK ){
+        memcpy(pOut, pCell, szCell);
+        pOut = &pSpace[pParent->xCellSize(pParent, pSpace)];
+        if( ISAUTOVACUUM(pBt) ){
+          CellInfo info;
+          pPage->xParseCell(pPage, pCell, &info);
+          if( info.nLocal<info.nPayload ){
+            ptrmapPut(pBt, get4byte(&pCell[info.nSize-4]), PTRMAP_OVERFLOW1,
+                      pParent->pgno, &rc);
+          }
+        }
+        dropCell(pPage, pPage->nCell-1, szCell, &rc);
+      }
+    }
 
     /* Insert the new divider cell into pParent. */
     if( rc==SQLITE_OK ){
@@ -80597,6 +82016,213 @@ static void copyNodeContent(MemPage *pFrom, MemPage *pTo, int *pRC){
   }
 }
 
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+/*
+** Write cell pCell, which is stored as on an index leaf page without prefix
+** compression, to pOut as it is stored on PTF_PFXLEAF page pPage when the
+** prefix of that page is aPfx[0..nPfx-1].  Return its size there.  If pOut
+** is NULL, only compute the size.
+*/
+static int balancePfxEncode(
+  MemPage *pPage,         /* An index leaf page of the b-tree */
+  u8 *pCell,              /* The cell, not prefix-compressed */
+  const u8 *aPfx,         /* Prefix of the page the cell is for */
+  int nPfx,               /* Size of aPfx[] */
+  u8 *pOut                /* Write the cell here, or NULL */
+){
+  CellInfo info;
+  int nVar;               /* Size of the payload size varint */
+  int nHdr;               /* Size of the record header, or 0 */
+  int nShared = 0;        /* Bytes of the record body in aPfx[] */
+  int n;                  /* Size of the cell */
+
+  btreeParseCellPtrIndex(pPage, pCell, &info);
+  nVar = (int)(info.pPayload - pCell);
+  nHdr = btreePfxHeader(pPage, info.pPayload, info.nPayload);
+  if( nHdr ){
+    nShared = btreePfxMatch(aPfx, &info.pPayload[nHdr],
+                            MIN(nPfx, (int)info.nPayload - nHdr));
+  }
+  n = nVar + 1 + info.nLocal + (info.nLocal<info.nPayload ? 4 : 0) - nShared;
+  if( pOut ){
+    memcpy(pOut, pCell, nVar);
+    pOut[nVar] = (u8)nShared;
+    memcpy(&pOut[nVar+1], info.pPayload, nHdr);
+    memcpy(&pOut[nVar+1+nHdr], &info.pPayload[nHdr+nShared],
+           n - nVar - 1 - nHdr);
+    if( n<4 ) memset(&pOut[n], 0, 4 - n);
+  }
+  return n<4 ? 4 : n;
+}
+
+/*
+** balance_nonroot() has gathered the cells of the nOld index leaves apOld[]
+** and the dividers between them in *pArray, the last cell of apOld[i] being
+** cell cntOld[i]-1.  Prepare them to be written to PTF_PFXLEAF pages:  copy
+** each of them into a single allocation, returned in *paSpace, as it is
+** stored on an index leaf page without prefix compression, with 4 bytes of
+** slack in front for a child page number.  Then find the longest prefix
+** that the bodies of all the records that may be stored compressed share,
+** set *pnGlobal to its size and pArray->szCell[] to the sizes of the cells
+** on a page with that prefix, which balance_nonroot() packs pages with.
+*/
+static int balancePfxPrepare(
+  CellArray *pArray,      /* Cells gathered by balance_nonroot() */
+  MemPage **apOld,        /* Leaves the cells were gathered from */
+  int nOld,               /* Number of pages in apOld[] */
+  int *cntOld,            /* Index in pArray of the cell after each leaf */
+  u8 **paSpace,           /* OUT: Allocation holding the copied cells */
+  int *pnGlobal           /* OUT: Size of the common prefix */
+){
+  MemPage *pRef = pArray->pRef;
+  u64 nSpace = 0;         /* Bytes needed for the copies */
+  u8 *pOut;               /* Next copy goes here */
+  const u8 *aPfx = 0;     /* Common prefix */
+  int nPfx = 0;           /* Size of aPfx[] */
+  int iOld = 0;           /* Index in apOld[] of the page of cell i */
+  int i;
+  int rc = SQLITE_OK;
+
+  /* Size each cell will have once expanded.  Dividers are sized already */
+  for(i=0; i<pArray->nCell; i++){
+    MemPage *pOld;
+    while( i>cntOld[iOld] ) iOld++;
+    pOld = apOld[iOld];
+    if( i<cntOld[iOld] && pOld->bPfx ){
+      CellInfo info;
+      int n;
+      btreeParseCellPtrPfx(pOld, pArray->apCell[i], &info);
+      n = (int)(info.pPayload - pArray->apCell[i]) - 1;
+      if( info.pPayload[-1]!=0 ){
+        n += info.nPayload;
+      }else{
+        n += info.nLocal + (info.nLocal<info.nPayload ? 4 : 0);
+      }
+      pArray->szCell[i] = (u16)(n<4 ? 4 : n);
+    }else if( pArray->szCell[i]==0 ){
+      pArray->szCell[i] = pOld->xCellSize(pOld, pArray->apCell[i]);
+    }
+    nSpace += 4 + pArray->szCell[i];
+  }
+
+  *paSpace = pOut = sqlite3Malloc(nSpace);
+  if( pOut==0 ) return SQLITE_NOMEM_BKPT;
+  for(i=iOld=0; i<pArray->nCell; i++){
+    MemPage *pOld;
+    u8 *pCell = pArray->apCell[i];
+    int sz = pArray->szCell[i];
+    while( i>cntOld[iOld] ) iOld++;
+    pOld = apOld[iOld];
+    if( i<cntOld[iOld] && pOld->bPfx ){
+      rc = btreePfxExpandCell(pOld, pCell, &pOut[4], &sz);
+      if( rc ) return rc;
+      assert( sz==pArray->szCell[i] );
+    }else{
+      if( SQLITE_WITHIN(pCell, pOld->aData, pOld->aDataEnd)
+       && pCell+sz>&pOld->aData[pOld->pBt->usableSize]
+      ){
+        return SQLITE_CORRUPT_PAGE(pOld);
+      }
+      memcpy(&pOut[4], pCell, sz);
+    }
+    pArray->apCell[i] = &pOut[4];
+    pOut += 4 + sz;
+  }
+
+  /* Find the common prefix, then size the cells with it */
+  for(i=0; i<pArray->nCell; i++){
+    CellInfo info;
+    int nHdr;
+    btreeParseCellPtrIndex(pRef, pArray->apCell[i], &info);
+    nHdr = btreePfxHeader(pRef, info.pPayload, info.nPayload);
+    if( nHdr==0 ) continue;
+    if( aPfx==0 ){
+      aPfx = &info.pPayload[nHdr];
+      nPfx = MIN(255, (int)info.nPayload - nHdr);
+    }else{
+      nPfx = btreePfxMatch(aPfx, &info.pPayload[nHdr],
+                           MIN(nPfx, (int)info.nPayload - nHdr));
+    }
+  }
+  for(i=0; i<pArray->nCell; i++){
+    pArray->szCell[i] = (u16)balancePfxEncode(pRef, pArray->apCell[i],
+                                              aPfx, nPfx, 0);
+  }
+  *pnGlobal = nPfx;
+  return SQLITE_OK;
+}
+
+/*
+** Make pPg a PTF_PFXLEAF page holding the nCell cells of pArray that start
+** at iFirst, as prepared by balancePfxPrepare().  Its prefix is the one all
+** the records on it that may be stored compressed share, or the first
+** nGlobal bytes of it if the cells would not fit on the page otherwise,
+** which balance_nonroot() has made sure they do.
+*/
+static int balancePfxBuildPage(
+  MemPage *pPg,           /* The page to rebuild */
+  CellArray *pArray,      /* Cells prepared by balancePfxPrepare() */
+  int iFirst,             /* First cell of pArray on the page */
+  int nCell,              /* Number of cells on the page */
+  int nGlobal             /* Size of the prefix shared by all cells */
+){
+  const int usableSize = pPg->pBt->usableSize;
+  const int hdr = pPg->hdrOffset;
+  u8 * const data = pPg->aData;
+  const u8 *aPfx = 0;     /* Prefix of the page */
+  int nPfx = 0;           /* Size of aPfx[] */
+  int nByte;              /* Space the prefix and the cells take */
+  u8 *pData;              /* Next cell goes before this */
+  u8 *pCellptr;           /* Next cell pointer goes here */
+  int i;
+
+  zeroPage(pPg, PTF_PFXLEAF|PTF_ZERODATA|PTF_LEAF);
+  for(i=iFirst; i<iFirst+nCell; i++){
+    CellInfo info;
+    int nHdr;
+    btreeParseCellPtrIndex(pPg, pArray->apCell[i], &info);
+    nHdr = btreePfxHeader(pPg, info.pPayload, info.nPayload);
+    if( nHdr==0 ) continue;
+    if( aPfx==0 ){
+      aPfx = &info.pPayload[nHdr];
+      nPfx = MIN(255, (int)info.nPayload - nHdr);
+    }else{
+      nPfx = btreePfxMatch(aPfx, &info.pPayload[nHdr],
+                           MIN(nPfx, (int)info.nPayload - nHdr));
+    }
+  }
+  while( 1 ){
+    nByte = nPfx;
+    for(i=iFirst; i<iFirst+nCell; i++){
+      nByte += 2 + balancePfxEncode(pPg, pArray->apCell[i], aPfx, nPfx, 0);
+    }
+    if( pPg->cellOffset+nByte<=usableSize ) break;
+    if( nPfx<=nGlobal ) return SQLITE_CORRUPT_BKPT;
+    nPfx = nGlobal;
+  }
+
+  data[hdr+8] = (u8)nPfx;
+  if( nPfx ) memcpy(&data[hdr+9], aPfx, nPfx);
+  pPg->nPfx = (u8)nPfx;
+  pPg->cellOffset += nPfx;
+  pPg->aCellIdx += nPfx;
+  pData = &data[usableSize];
+  pCellptr = pPg->aCellIdx;
+  for(i=iFirst; i<iFirst+nCell; i++){
+    int sz = balancePfxEncode(pPg, pArray->apCell[i], aPfx, nPfx, 0);
+    pData -= sz;
+    balancePfxEncode(pPg, pArray->apCell[i], aPfx, nPfx, pData);
+    put2byte(pCellptr, (pData - data));
+    pCellptr += 2;
+  }
+  pPg->nCell = (u16)nCell;
+  put2byte(&data[hdr+3], nCell);
+  put2byte(&data[hdr+5], pData - data);
+  pPg->nFree = (int)(pData - pCellptr);
+  return SQLITE_OK;
+}
+#endif /* SQLITE_ENABLE_PREFIX_LEAF */
+
 /*
 ** This routine redistributes cells on the iParentIdx'th child of pParent
 ** (hereafter "the page") and up to 2 siblings so that all pages have about the
@@ -80636,13 +82262,25 @@ static void copyNodeContent(MemPage *pFrom, MemPage *pTo, int *pRC){
 **
 ** If aOvflSpace is set to a null pointer, this function returns
 ** SQLITE_NOMEM.
+**
+** eSplit is one of the BTREE_SPLIT_* policies, and decides how the cells
+** are spread over the pages once it is known how many pages are needed.
+** If nFill is not zero, leaf pages are only filled to nFill percent of
+** their capacity, or as close to it as NB+1 pages allow.
+**
+** In builds with SQLITE_ENABLE_PREFIX_LEAF, index leaves are written as
+** PTF_PFXLEAF pages if bPfxLeaf is true or if any of the siblings is one
+** already.
 */
 static int balance_nonroot(
   MemPage *pParent,               /* Parent page of siblings being balanced */
   int iParentIdx,                 /* Index of "the page" in pParent */
   u8 *aOvflSpace,                 /* page-size bytes of space for parent ovfl */
   int isRoot,                     /* True if pParent is a root-page */
-  int bBulk                       /* True if this call is part of a bulk load */
+  int bBulk,                      /* True if this call is part of a bulk load */
+  int eSplit,                     /* BTREE_SPLIT_* policy */
+  int nFill,                      /* Percentage of leaves to fill, or 0 */
+  int bPfxLeaf                    /* Write PTF_PFXLEAF leaves */
 ){
   BtShared *pBt;               /* The whole database */
   int nMaxCells = 0;           /* Allocated size of apCell, szCell, aFrom. */
@@ -80654,6 +82292,7 @@ static int balance_nonroot(
   u16 leafCorrection;          /* 4 if pPage is a leaf.  0 if not */
   int leafData;                /* True if pPage is a leaf of a LEAFDATA tree */
   int usableSpace;             /* Bytes in pPage beyond the header */
+  int szLimit;                 /* Bytes of usableSpace to fill on each page */
   int pageFlags;               /* Value of pPage->aData[0] */
   int iSpace1 = 0;             /* First unused byte of aSpace1[] */
   int iOvflSpace = 0;          /* First unused byte of aOvflSpace[] */
@@ -80670,6 +82309,11 @@ static int balance_nonroot(
   u8 abDone[NB+2];             /* True after i'th new page is populated */
   Pgno aPgno[NB+2];            /* Page numbers of new pages before shuffling */
   CellArray b;                 /* Parsed information on cells being balanced */
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  int bPfx = 0;                /* True if writing PTF_PFXLEAF pages */
+  int nPfxGlobal = 0;          /* Prefix size all PTF_PFXLEAF pages can have */
+  u8 *aPfxSpace = 0;           /* Cells expanded for PTF_PFXLEAF pages */
+#endif
 
   memset(abDone, 0, sizeof(abDone));
   assert( sizeof(b) - sizeof(b.ixNx) == offsetof(CellArray,ixNx) );
@@ -80830,12 +82474,21 @@ static int balance_nonroot(
     VVA_ONLY( int nCellAtStart = b.nCell; )
 
     /* Verify that all sibling pages are of the same "type" (table-leaf,
-    ** table-interior, index-leaf, or index-interior).
+    ** table-interior, index-leaf, or index-interior).  Index leaves may
+    ** be prefix-compressed or not.
     */
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+    if( (pOld->aData[0]|PTF_PFXLEAF)!=(apOld[0]->aData[0]|PTF_PFXLEAF) ){
+      rc = SQLITE_CORRUPT_PAGE(pOld);
+      goto balance_cleanup;
+    }
+    bPfx |= pOld->bPfx;
+#else
     if( pOld->aData[0]!=apOld[0]->aData[0] ){
       rc = SQLITE_CORRUPT_PAGE(pOld);
       goto balance_cleanup;
     }
+#endif
 
     /* Load b.apCell[] with pointers to all cells in pOld.  If pOld
     ** contains overflow cells, include them in the b.apCell[] array
@@ -80861,6 +82514,14 @@ static int balance_nonroot(
         goto balance_cleanup;
       }
       limit = pOld->aiOvfl[0];
+      if( eSplit==BTREE_SPLIT_ADAPTIVE ){
+        /* Leave room where the new cell went in */
+        if( limit==pOld->nCell ){
+          eSplit = BTREE_SPLIT_LEFT;
+        }else if( limit==0 ){
+          eSplit = BTREE_SPLIT_RIGHT;
+        }
+      }
       for(j=0; j<limit; j++){
         b.apCell[b.nCell] = aData + (maskPage & get2byteAligned(piCell));
         piCell += 2;
@@ -80916,6 +82577,21 @@ static int balance_nonroot(
     }
   }
 
+  /* Prefix-compressed leaves are written from cells that balancePfxPrepare()
+  ** has expanded, and packed using the size of the cells on a page whose
+  ** prefix all of them share.  */
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( leafCorrection && !b.pRef->intKey && (bPfx || bPfxLeaf) ){
+    bPfx = 1;
+    rc = balancePfxPrepare(&b, apOld, nOld, cntOld, &aPfxSpace, &nPfxGlobal);
+    if( rc ) goto balance_cleanup;
+  }else{
+    bPfx = 0;
+  }
+#else
+  UNUSED_PARAMETER(bPfxLeaf);
+#endif
+
   /*
   ** Figure out the number of pages needed to hold all b.nCell cells.
   ** Store this number in "k".  Also compute szNew[] which is the total
@@ -80930,9 +82606,19 @@ static int balance_nonroot(
   **   cntNew[i]: Index in b.apCell[] and b.szCell[] for the first cell to
   **              the right of the i-th sibling page.
   ** usableSpace: Number of bytes of space available on each sibling.
+  **     szLimit: Number of those bytes to fill, less than usableSpace on
+  **              leaves with a fill factor.  If the cells need more than
+  **              NB+1 pages at that, it is raised and the packing redone.
   **
   */
+  if( eSplit==BTREE_SPLIT_ADAPTIVE ) eSplit = BTREE_SPLIT_EVEN;
   usableSpace = pBt->usableSize - 12 + leafCorrection;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( bPfx ) usableSpace -= 1 + nPfxGlobal;
+#endif
+  szLimit = usableSpace;
+  if( nFill && leafCorrection ) szLimit = (int)(((i64)usableSpace*nFill)/100);
+balance_pack:
   for(i=k=0; i<nOld; i++, k++){
     MemPage *p = apOld[i];
     b.apEnd[k] = p->aDataEnd;
@@ -80946,18 +82632,34 @@ static int balance_nonroot(
       b.ixNx[k] = cntOld[i]+1;
     }
     assert( p->nFree>=0 );
-    szNew[i] = usableSpace - p->nFree;
-    for(j=0; j<p->nOverflow; j++){
-      szNew[i] += 2 + p->xCellSize(p, p->apOvfl[j]);
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+    if( bPfx ){
+      szNew[i] = 0;
+      for(j=(i ? cntOld[i-1]+1 : 0); j<cntOld[i]; j++){
+        szNew[i] += 2 + b.szCell[j];
+      }
+    }else
+#endif
+    {
+      szNew[i] = usableSpace - p->nFree;
+      for(j=0; j<p->nOverflow; j++){
+        szNew[i] += 2 + p->xCellSize(p, p->apOvfl[j]);
+      }
     }
     cntNew[i] = cntOld[i];
   }
   k = nOld;
   for(i=0; i<k; i++){
     int sz;
-    while( szNew[i]>usableSpace ){
+    while( szNew[i]>szLimit ){
       if( i+1>=k ){
         k = i+2;
+        if( k>NB+1 && szLimit<usableSpace ){
+          /* No more pages than a full packing could need, so that the
+          ** parent never gets more than NB overflow dividers */
+          szLimit += (usableSpace - szLimit + 1)/2;
+          goto balance_pack;
+        }
         if( k>NB+2 ){ rc = SQLITE_CORRUPT_BKPT; goto balance_cleanup; }
         szNew[k-1] = 0;
         cntNew[k-1] = b.nCell;
@@ -80976,7 +82678,7 @@ static int balance_nonroot(
     }
     while( cntNew[i]<b.nCell ){
       sz = 2 + cachedCellSize(&b, cntNew[i]);
-      if( szNew[i]+sz>usableSpace ) break;
+      if( szNew[i]+sz>szLimit ) break;
       szNew[i] += sz;
       cntNew[i]++;
       if( !leafData ){
@@ -81006,6 +82708,12 @@ static int balance_nonroot(
   ** This adjustment is more than an optimization.  The packing above might
   ** be so out of balance as to be illegal.  For example, the right-most
   ** sibling might be completely empty.  This adjustment is not optional.
+  **
+  ** For a bulk load or BTREE_SPLIT_LEFT it goes no further than that.
+  ** For BTREE_SPLIT_RIGHT it fills each sibling from its left neighbour
+  ** up to szLimit instead, leaving at least one cell on the neighbour.
+  ** The first cell of the neighbour is cntNew[i-2], or the one after it
+  ** in an index b-tree, where cell cntNew[i-2] is the divider to its left.
   */
   for(i=k-1; i>0; i--){
     int szRight = szNew[i];  /* Size of sibling on the right */
@@ -81022,9 +82730,17 @@ static int balance_nonroot(
       assert( r<nMaxCells );
       szR = cachedCellSize(&b, r);
       szD = b.szCell[d];
-      if( szRight!=0
-       && (bBulk || szRight+szD+2 > szLeft-(szR+(i==k-1?0:2)))){
-        break;
+      if( szRight!=0 ){
+        if( bBulk || eSplit==BTREE_SPLIT_LEFT ) break;
+        if( eSplit==BTREE_SPLIT_RIGHT ){
+          if( szRight+szD+2>szLimit
+           || r<=(i>1 ? cntNew[i-2]+1-leafData : 0)
+          ){
+            break;
+          }
+        }else if( szRight+szD+2 > szLeft-(szR+(i==k-1?0:2)) ){
+          break;
+        }
       }
       szRight += szD + 2;
       szLeft -= szR + 2;
@@ -81058,6 +82774,9 @@ static int balance_nonroot(
   ** Allocate k new pages.  Reuse old pages where possible.
   */
   pageFlags = apOld[0]->aData[0];
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( bPfx ) pageFlags |= PTF_PFXLEAF;
+#endif
   for(i=0; i<k; i++){
     MemPage *pNew;
     if( i<nOld ){
@@ -81213,6 +82932,17 @@ static int balance_nonroot(
         if( !leafCorrection ){
           ptrmapPut(pBt, get4byte(pCell), PTRMAP_BTREE, pNew->pgno, &rc);
         }
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+        if( bPfx ){
+          /* The cell is expanded, whatever the type of pNew is yet */
+          CellInfo info;
+          btreeParseCellPtrIndex(pNew, pCell, &info);
+          if( info.nLocal<info.nPayload ){
+            ptrmapPut(pBt, get4byte(&pCell[info.nSize-4]), PTRMAP_OVERFLOW1,
+                      pNew->pgno, &rc);
+          }
+        }else
+#endif
         if( cachedCellSize(&b,i)>pNew->minLocal ){
           ptrmapPutOvflPtr(pNew, pOld, pCell, &rc);
         }
@@ -81262,7 +82992,11 @@ static int balance_nonroot(
       ** and WITHOUT ROWID tables with exactly one column which is the
       ** primary key.
       */
-      if( b.szCell[j]==4 ){
+      if( b.szCell[j]==4
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+       || bPfx
+#endif
+      ){
         assert(leafCorrection==4);
         sz = pParent->xCellSize(pParent, pCell);
       }
@@ -81334,10 +83068,19 @@ static int balance_nonroot(
         nNewCell = cntNew[iPg] - iNew;
       }
 
-      rc = editPage(apNew[iPg], iOld, iNew, nNewCell, &b);
-      if( rc ) goto balance_cleanup;
-      abDone[iPg]++;
-      apNew[iPg]->nFree = usableSpace-szNew[iPg];
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+      if( bPfx ){
+        rc = balancePfxBuildPage(apNew[iPg], &b, iNew, nNewCell, nPfxGlobal);
+        if( rc ) goto balance_cleanup;
+        abDone[iPg]++;
+      }else
+#endif
+      {
+        rc = editPage(apNew[iPg], iOld, iNew, nNewCell, &b);
+        if( rc ) goto balance_cleanup;
+        abDone[iPg]++;
+        apNew[iPg]->nFree = usableSpace-szNew[iPg];
+      }
       assert( apNew[iPg]->nOverflow==0 );
       assert( apNew[iPg]->nCell==nNewCell );
     }
@@ -81410,6 +83153,9 @@ static int balance_nonroot(
   ** Cleanup before returning.
   */
 balance_cleanup:
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  sqlite3_free(aPfxSpace);
+#endif
   sqlite3StackFree(0, b.apCell);
   for(i=0; i<nOld; i++){
     releasePage(apOld[i]);
@@ -81481,7 +83227,7 @@ static int balance_deeper(MemPage *pRoot, MemPage **ppChild){
   pChild->nOverflow = pRoot->nOverflow;
 
   /* Zero the contents of pRoot. Then install pChild as the right-child. */
-  zeroPage(pRoot, pChild->aData[0] & ~PTF_LEAF);
+  zeroPage(pRoot, pChild->aData[0] & ~(PTF_LEAF|PTF_PFXLEAF));
   put4byte(&pRoot->aData[pRoot->hdrOffset+8], pgnoChild);
 
   *ppChild = pChild;
@@ -81570,14 +83316,22 @@ static int balance(BtCursor *pCur){
     }else{
       MemPage * const pParent = pCur->apPage[iPage-1];
       int const iIdx = pCur->aiIdx[iPage-1];
+      int bPfxLeaf = 0;      /* Write index leaves as PTF_PFXLEAF pages */
 
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+      bPfxLeaf = pPage->bPfx || pCur->bPfxLeaf;
+#endif
       rc = sqlite3PagerWrite(pParent->pDbPage);
       if( rc==SQLITE_OK && pParent->nFree<0 ){
         rc = btreeComputeFreeSpace(pParent);
       }
       if( rc==SQLITE_OK ){
 #ifndef SQLITE_OMIT_QUICKBALANCE
-        if( pPage->intKeyLeaf
+        if( (pPage->intKeyLeaf || (pPage->leaf && !pPage->intKey
+                                   && pPage->nCell>1 && !bPfxLeaf))
+         && pCur->nFill==0
+         && pCur->eSplit!=BTREE_SPLIT_EVEN
+         && pCur->eSplit!=BTREE_SPLIT_RIGHT
          && pPage->nOverflow==1
          && pPage->aiOvfl[0]==pPage->nCell
          && pParent->pgno!=1
@@ -81591,6 +83345,9 @@ static int balance(BtCursor *pCur){
           ** happens, the overflow cell is stored in the aBalanceQuickSpace[]
           ** buffer.
           **
+          ** The divider of an index b-tree is a whole entry, so it is kept
+          ** in a page-sized buffer instead, freed as pFree is below.
+          **
           ** The purpose of the following assert() is to check that only a
           ** single call to balance_quick() is made for each call to this
           ** function. If this were not verified, a subtle bug involving reuse
@@ -81598,7 +83355,17 @@ static int balance(BtCursor *pCur){
           */
           assert( balance_quick_called==0 );
           VVA_ONLY( balance_quick_called++ );
-          rc = balance_quick(pParent, pPage, aBalanceQuickSpace);
+          if( pPage->intKeyLeaf ){
+            rc = balance_quick(pParent, pPage, aBalanceQuickSpace);
+          }else{
+            assert( pFree==0 );
+            pFree = sqlite3PageMalloc(pCur->pBt->pageSize);
+            if( pFree==0 ){
+              rc = SQLITE_NOMEM_BKPT;
+            }else{
+              rc = balance_quick(pParent, pPage, pFree);
+            }
+          }
         }else
 #endif
         {
@@ -81620,8 +83387,21 @@ static int balance(BtCursor *pCur){
           ** pSpace buffer passed to the latter call to balance_nonroot().
           */
           u8 *pSpace = sqlite3PageMalloc(pCur->pBt->pageSize);
+          int eSplit = pCur->eSplit;
+          if( eSplit==BTREE_SPLIT_DEFAULT
+           && pPage->leaf && !pPage->intKey && bPfxLeaf
+           && pPage->nOverflow==1
+           && pPage->aiOvfl[0]==pPage->nCell
+           && pParent->nCell==iIdx
+          ){
+            /* balance_quick() does not write PTF_PFXLEAF pages.  Fill the
+            ** left pages instead, which leaves an entry appended to the
+            ** right-most leaf on a new leaf of its own just the same. */
+            eSplit = BTREE_SPLIT_LEFT;
+          }
           rc = balance_nonroot(pParent, iIdx, pSpace, iPage==1,
-                               pCur->hints&BTREE_BULKLOAD);
+                               pCur->hints&BTREE_BULKLOAD,
+                               eSplit, pCur->nFill, bPfxLeaf);
           if( pFree ){
             /* If pFree is not NULL, it points to the pSpace buffer used
             ** by a previous call to balance_nonroot(). Its contents are
@@ -81944,7 +83724,9 @@ SQLITE_PRIVATE int sqlite3BtreeInsert(
     */
     if( loc==0 ){
       getCellInfo(pCur);
-      if( pCur->info.nKey==pX->nKey ){
+      if( pCur->info.nKey==pX->nKey
+       && (!ISPFXLEAF(pCur->pPage) || pCur->info.pPayload[-1]==0)
+      ){
         BtreePayload x2;
         x2.pData = pX->pKey;
         x2.nData = (int)pX->nKey;  assert( pX->nKey<=0x7fffffff );
@@ -81979,6 +83761,16 @@ SQLITE_PRIVATE int sqlite3BtreeInsert(
   if( flags & BTREE_PREFORMAT ){
     rc = SQLITE_OK;
     szNew = p->pBt->nPreformatSize;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+    if( pPage->bPfx ){
+      /* Add the shared length, zero, after the payload size */
+      int nVar = 1;
+      while( (newCell[nVar-1]&0x80)!=0 && nVar<9 ) nVar++;
+      memmove(&newCell[nVar+1], &newCell[nVar], szNew - nVar);
+      newCell[nVar] = 0;
+      szNew++;
+    }
+#endif
     if( szNew<4 ){
       szNew = 4;
       newCell[3] = 0;
@@ -82135,6 +83927,18 @@ SQLITE_PRIVATE int sqlite3BtreeTransferRow(BtCursor *pDest, BtCursor *pSrc, i64
   if( pDest->pKeyInfo==0 ) aOut += putVarint(aOut, iKey);
   nIn = pSrc->info.nLocal;
   aIn = pSrc->info.pPayload;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( pSrc->pPage->bPfx && aIn[-1]!=0 ){
+    /* A prefix-compressed cell.  It is all local:  expand it. */
+    u8 *apSeg[3];
+    u32 anSeg[3];
+    int rc = btreePfxSplit(pSrc->pPage, &pSrc->info, apSeg, anSeg);
+    if( rc==SQLITE_OK ) rc = btreePfxAllocSpace(pSrc->pBt);
+    if( rc ) return rc;
+    btreePfxCopy(apSeg, anSeg, 0, nIn, pSrc->pBt->pPfxSpace);
+    aIn = pSrc->pBt->pPfxSpace;
+  }else
+#endif
   if( aIn+nIn>pSrc->pPage->aDataEnd ){
     return SQLITE_CORRUPT_PAGE(pSrc->pPage);
   }
@@ -82370,6 +84174,19 @@ SQLITE_PRIVATE int sqlite3BtreeDelete(BtCursor *pCur, u8 flags){
     pTmp = pBt->pTmpSpace;
     assert( pTmp!=0 );
     rc = sqlite3PagerWrite(pLeaf->pDbPage);
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+    if( rc==SQLITE_OK && pLeaf->bPfx ){
+      /* The interior page takes the cell without prefix compression */
+      int nFull;
+      rc = btreePfxAllocSpace(pBt);
+      if( rc==SQLITE_OK ){
+        rc = btreePfxExpandCell(pLeaf, pCell, &pBt->pPfxSpace[4], &nFull);
+      }
+      if( rc==SQLITE_OK ){
+        rc = insertCell(pPage, iCellIdx, pBt->pPfxSpace, nFull+4, pTmp, n);
+      }
+    }else
+#endif
     if( rc==SQLITE_OK ){
       rc = insertCell(pPage, iCellIdx, pCell-4, nCell+4, pTmp, n);
     }
@@ -82435,6 +84252,282 @@ SQLITE_PRIVATE int sqlite3BtreeDelete(BtCursor *pCur, u8 flags){
   return rc;
 }
 
+#ifndef SQLITE_OMIT_KV
+/*
+** A BtreeLoader builds an index b-tree bottom-up from entries supplied in
+** ascending order, instead of inserting them one at a time through a
+** cursor.  Each level of the tree has one node being filled.  Entries go
+** into the current leaf until it holds nFill bytes; the next entry then
+** becomes a divider in the level above and a new leaf is started, and so
+** on up the tree when an interior node fills.  Pages are written once,
+** in key order, and never rebalanced.
+**
+** A divider needs an entry to its right, so the entry that fills a node
+** is held back in aPend[] until the next one at the same level arrives.
+** When the input ends with an entry held back, the last cell of the full
+** node is moved up in its place.  The single node left at the top level
+** is finally copied onto the root page of the b-tree.
+*/
+struct BtreeLoader {
+  Btree *pBtree;            /* Btree being written */
+  BtShared *pBt;            /* Its shared content */
+  Pgno iTable;              /* Root page of the index b-tree being built */
+  int nFill;                /* Bytes of a node to fill before the next one */
+  int nLevel;               /* Number of levels in aLevel[] */
+  Pgno pgnoPrev;            /* Last page allocated, as a hint for the next */
+  u8 *aCell;                /* Space for one cell with a child pointer */
+  struct BtreeLoaderLevel {
+    MemPage *pNode;         /* Node being filled, or NULL */
+    MemPage *pFull;         /* Node filled by aPend[], if nPend>0 */
+    u8 *aPend;              /* Entry held back, as a leaf cell at aPend[4] */
+    int nPend;              /* Size of that cell, or 0 */
+  } aLevel[BTCURSOR_MAX_DEPTH];
+};
+
+/*
+** Begin building index b-tree iTable of p, which must be empty, with each
+** node filled to nFill percent of the usable page size.  The caller must
+** hold a write transaction on p.
+*/
+SQLITE_PRIVATE int sqlite3BtreeLoaderOpen(
+  Btree *p,
+  Pgno iTable,
+  int nFill,
+  BtreeLoader **ppLoader
+){
+  BtShared *pBt = p->pBt;
+  BtreeLoader *pL;
+
+  assert( sqlite3BtreeHoldsMutex(p) );
+  assert( p->inTrans==TRANS_WRITE );
+  assert( nFill>0 && nFill<=100 );
+  *ppLoader = 0;
+  pL = (BtreeLoader*)sqlite3MallocZero(sizeof(*pL) + pBt->pageSize + 4);
+  if( pL==0 ) return SQLITE_NOMEM_BKPT;
+  pL->pBtree = p;
+  pL->pBt = pBt;
+  pL->iTable = iTable;
+  pL->nFill = (int)(((i64)pBt->usableSize * nFill)/100);
+  pL->pgnoPrev = iTable;
+  pL->aCell = (u8*)&pL[1];
+  *ppLoader = pL;
+  return SQLITE_OK;
+}
+
+/*
+** Finish node pNode of a loader:  its content is final, so record the
+** parents of its children and overflow pages in the pointer-map.
+*/
+static int loaderFinishNode(MemPage *pNode){
+  if( ISAUTOVACUUM(pNode->pBt) ) return setChildPtrmaps(pNode);
+  return SQLITE_OK;
+}
+
+/*
+** Append the leaf cell pCell of sz bytes to node pNode, giving it left
+** child iChild if pNode is an interior node.  The 4 bytes before pCell
+** are scratch space for the child pointer.  The caller has checked that
+** the cell fits.
+*/
+static int loaderAppend(MemPage *pNode, u8 *pCell, int sz, Pgno iChild){
+  u8 *data = pNode->aData;
+  int idx = 0;
+  int rc;
+  if( !pNode->leaf ){
+    pCell -= 4;
+    sz += 4;
+    put4byte(pCell, iChild);
+  }
+  assert( sz+2<=pNode->nFree );
+  rc = allocateSpace(pNode, sz, &idx);
+  if( rc ) return rc;
+  pNode->nFree -= (u16)(2 + sz);
+  btreePrefixReset(pNode);
+  memcpy(&data[idx], pCell, sz);
+  put2byte(&pNode->aCellIdx[2*pNode->nCell], idx);
+  pNode->nCell++;
+  put2byte(&data[pNode->hdrOffset+3], pNode->nCell);
+  return SQLITE_OK;
+}
+
+static int loaderPush(BtreeLoader*, int, u8*, int, Pgno);
+
+/*
+** Make sure level iLevel of a loader has a node to add an entry to.  If
+** an entry is held back at that level, it becomes the divider between
+** the full node and the new one.
+*/
+static int loaderNode(BtreeLoader *pL, int iLevel){
+  struct BtreeLoaderLevel *pLvl = &pL->aLevel[iLevel];
+  MemPage *pNode = 0;
+  Pgno pgno = 0;
+  int rc;
+
+  if( pLvl->pNode ) return SQLITE_OK;
+  if( pLvl->nPend ){
+    MemPage *pFull = pLvl->pFull;
+    int nPend = pLvl->nPend;
+    pLvl->pFull = 0;
+    pLvl->nPend = 0;
+    rc = loaderPush(pL, iLevel+1, &pLvl->aPend[4], nPend, pFull->pgno);
+    releasePage(pFull);
+    if( rc ) return rc;
+  }
+  rc = allocateBtreePage(pL->pBt, &pNode, &pgno, pL->pgnoPrev, BTALLOC_ANY);
+  if( rc ) return rc;
+  zeroPage(pNode, iLevel==0 ? (PTF_ZERODATA|PTF_LEAF) : PTF_ZERODATA);
+  pLvl->pNode = pNode;
+  pL->pgnoPrev = pgno;
+  return SQLITE_OK;
+}
+
+/*
+** Add the leaf cell pCell of sz bytes, whose left child is iChild, to
+** level iLevel of a loader.  The 4 bytes before pCell must be writable.
+*/
+static int loaderPush(
+  BtreeLoader *pL,
+  int iLevel,
+  u8 *pCell,
+  int sz,
+  Pgno iChild
+){
+  struct BtreeLoaderLevel *pLvl;
+  MemPage *pNode;
+  int nCell;
+  int rc;
+
+  if( iLevel>=BTCURSOR_MAX_DEPTH ) return SQLITE_TOOBIG;
+  if( iLevel==pL->nLevel ) pL->nLevel++;
+  pLvl = &pL->aLevel[iLevel];
+  rc = loaderNode(pL, iLevel);
+  if( rc ) return rc;
+  pNode = pLvl->pNode;
+  nCell = sz + pNode->childPtrSize + 2;
+  if( pNode->nCell>=2
+   && (nCell>pNode->nFree
+        || (int)pL->pBt->usableSize - pNode->nFree + nCell > pL->nFill)
+  ){
+    /* The node is full.  Hold the entry back as the next divider. */
+    if( pLvl->aPend==0 ){
+      pLvl->aPend = (u8*)sqlite3Malloc(pL->pBt->pageSize + 4);
+      if( pLvl->aPend==0 ) return SQLITE_NOMEM_BKPT;
+    }
+    if( iLevel>0 ) put4byte(&pNode->aData[pNode->hdrOffset+8], iChild);
+    rc = loaderFinishNode(pNode);
+    memcpy(&pLvl->aPend[4], pCell, sz);
+    pLvl->nPend = sz;
+    pLvl->pFull = pNode;
+    pLvl->pNode = 0;
+    return rc;
+  }
+  assert( nCell<=pNode->nFree );
+  return loaderAppend(pNode, pCell, sz, iChild);
+}
+
+/*
+** Add record pRec of nRec bytes to the b-tree.  It must sort after every
+** record added before it.
+*/
+SQLITE_PRIVATE int sqlite3BtreeLoaderAdd(BtreeLoader *pL, const u8 *pRec, int nRec){
+  BtreePayload x;
+  int sz = 0;
+  int rc;
+
+  assert( sqlite3BtreeHoldsMutex(pL->pBtree) );
+  if( pL->nLevel==0 ) pL->nLevel = 1;
+  rc = loaderNode(pL, 0);
+  if( rc ) return rc;
+  memset(&x, 0, sizeof(x));
+  x.pKey = pRec;
+  x.nKey = nRec;
+  rc = fillInCell(pL->aLevel[0].pNode, &pL->aCell[4], &x, &sz);
+  if( rc ) return rc;
+  return loaderPush(pL, 0, &pL->aCell[4], sz, 0);
+}
+
+/*
+** Complete the b-tree:  close off the last node of each level, from the
+** leaves up, and copy the top node onto the root page.
+*/
+SQLITE_PRIVATE int sqlite3BtreeLoaderFinish(BtreeLoader *pL){
+  BtShared *pBt = pL->pBt;
+  Pgno iRight = 0;          /* Last node of the level below */
+  int rc = SQLITE_OK;
+  int i;
+
+  assert( sqlite3BtreeHoldsMutex(pL->pBtree) );
+  for(i=0; rc==SQLITE_OK && i<pL->nLevel; i++){
+    struct BtreeLoaderLevel *pLvl = &pL->aLevel[i];
+    MemPage *pNode;
+    if( pLvl->nPend ){
+      /* The input ended with an entry held back after pFull filled up.
+      ** Move the last cell of pFull up as the divider instead, and start
+      ** the last node of this level with the held back entry.  */
+      MemPage *pFull = pLvl->pFull;
+      int nPend = pLvl->nPend;
+      u8 *pLast = findCell(pFull, pFull->nCell-1);
+      int szLast = pFull->xCellSize(pFull, pLast);
+      Pgno iChild = 0;
+      assert( pFull->nCell>=2 );
+      pLvl->pFull = 0;
+      pLvl->nPend = 0;
+      memcpy(&pL->aCell[pFull->leaf ? 4 : 0], pLast, szLast);
+      rc = sqlite3PagerWrite(pFull->pDbPage);
+      dropCell(pFull, pFull->nCell-1, szLast, &rc);
+      if( rc==SQLITE_OK && !pFull->leaf ){
+        u8 *pRight = &pFull->aData[pFull->hdrOffset+8];
+        iChild = get4byte(pRight);
+        put4byte(pRight, get4byte(pL->aCell));
+        szLast -= 4;
+      }
+      if( rc==SQLITE_OK ) rc = loaderNode(pL, i);
+      if( rc==SQLITE_OK ){
+        rc = loaderAppend(pLvl->pNode, &pLvl->aPend[4], nPend, iChild);
+      }
+      if( rc==SQLITE_OK ){
+        rc = loaderPush(pL, i+1, &pL->aCell[4], szLast, pFull->pgno);
+      }
+      releasePage(pFull);
+      if( rc ) break;
+    }
+    pNode = pLvl->pNode;
+    if( i>0 ) put4byte(&pNode->aData[pNode->hdrOffset+8], iRight);
+    rc = loaderFinishNode(pNode);
+    iRight = pNode->pgno;
+  }
+
+  if( rc==SQLITE_OK && pL->nLevel>0 ){
+    MemPage *pTop = pL->aLevel[pL->nLevel-1].pNode;
+    MemPage *pRoot = 0;
+    rc = saveAllCursors(pBt, pL->iTable, 0);
+    if( rc==SQLITE_OK ) rc = btreeGetPage(pBt, pL->iTable, &pRoot, 0);
+    if( rc==SQLITE_OK ){
+      rc = sqlite3PagerWrite(pRoot->pDbPage);
+      copyNodeContent(pTop, pRoot, &rc);
+      freePage(pTop, &rc);
+      releasePage(pRoot);
+    }
+  }
+  return rc;
+}
+
+/*
+** Release the pages and memory held by a loader.  If it was not finished,
+** the b-tree is left inconsistent and the caller must roll back.
+*/
+SQLITE_PRIVATE void sqlite3BtreeLoaderFree(BtreeLoader *pL){
+  int i;
+  if( pL==0 ) return;
+  for(i=0; i<pL->nLevel; i++){
+    releasePage(pL->aLevel[i].pNode);
+    releasePage(pL->aLevel[i].pFull);
+    sqlite3_free(pL->aLevel[i].aPend);
+  }
+  sqlite3_free(pL);
+}
+#endif /* SQLITE_OMIT_KV */
+
 /*
 ** Create a new BTree table.  Write into *piTable the page
 ** number for the root page of the new table.
@@ -83330,6 +85423,9 @@ static int checkTreePage(
   /* EVIDENCE-OF: R-23882-45353 The cell pointer array of a b-tree page
   ** immediately follows the b-tree page header. */
   cellStart = hdr + 12 - 4*pPage->leaf;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  if( pPage->bPfx ) cellStart += 1 + pPage->nPfx;
+#endif
   assert( pPage->aCellIdx==&data[cellStart] );
   pCellIdx = &data[cellStart + 2*(nCell-1)];
 
@@ -89993,9 +92089,9 @@ static int vdbeCommit(sqlite3 *db, Vdbe *p){
 #ifndef NDEBUG
 static void checkActiveVdbeCnt(sqlite3 *db){
   Vdbe *p;
-  int cnt = 0;
+  int cnt = db->nKvIter;        /* Open key-value iterators count as readers */
   int nWrite = 0;
-  int nRead = 0;
+  int nRead = db->nKvIter;
   p = db->pVdbe;
   while( p ){
     if( sqlite3_stmt_busy((sqlite3_stmt*)p) ){
@@ -91219,10 +93315,10 @@ debugCompareEnd:
 ** limit given by pKeyInfo->nAllField.
 **
 ** If this constraint is not satisfied, it means that the high-speed
-** vdbeRecordCompareInt() and vdbeRecordCompareString() routines will
-** not work correctly.  If this assert() ever fires, it probably means
-** that the KeyInfo.nKeyField or KeyInfo.nAllField values were computed
-** incorrectly.
+** vdbeRecordCompareInt(), vdbeRecordCompareString() and
+** vdbeRecordCompareBlob() routines will not work correctly.  If this
+** assert() ever fires, it probably means that the KeyInfo.nKeyField or
+** KeyInfo.nAllField values were computed incorrectly.
 */
 static void vdbeAssertFieldCountWithinLimits(
   int nKey, const void *pKey,   /* The record to verify */
@@ -91935,19 +94031,134 @@ vrcs_restart:
   return res;
 }
 
+/*
+** Compare the n bytes at a[] and b[] the way memcmp() does.  Keys of up
+** to 32 bytes, which is what most BLOB keys are, are compared 8 bytes
+** at a time as big-endian integers without a library call.  Longer keys
+** go to memcmp(), which is already vectorized on most platforms.
+*/
+#if SQLITE_BYTEORDER==4321 \
+ || (SQLITE_BYTEORDER==1234 && (GCC_VERSION>=4003000 || MSVC_VERSION>=1300))
+static u64 vdbeGet8byte(const u8 *p){
+  u64 x;
+  memcpy(&x, p, 8);
+#if SQLITE_BYTEORDER==4321
+  return x;
+#elif GCC_VERSION>=4003000
+  return __builtin_bswap64(x);
+#else
+  return _byteswap_uint64(x);
+#endif
+}
+static int vdbeBlobCompare(const u8 *a, const u8 *b, int n){
+  u64 x, y;
+  int i;
+  if( n>32 ) return memcmp(a, b, n);
+  if( n>=8 ){
+    for(i=0; i<n-8; i+=8){
+      x = vdbeGet8byte(&a[i]);
+      y = vdbeGet8byte(&b[i]);
+      if( x!=y ) return x<y ? -1 : +1;
+    }
+    /* The last 8 bytes, which may overlap bytes already found equal */
+    x = vdbeGet8byte(&a[n-8]);
+    y = vdbeGet8byte(&b[n-8]);
+    return x==y ? 0 : (x<y ? -1 : +1);
+  }
+  for(i=0; i<n; i++){
+    if( a[i]!=b[i] ) return a[i]<b[i] ? -1 : +1;
+  }
+  return 0;
+}
+#else
+# define vdbeBlobCompare(A,B,N) memcmp(A,B,N)
+#endif
+
+/*
+** This function is an optimized version of sqlite3VdbeRecordCompare()
+** that (a) the first field of pPKey2 is a BLOB that is not a zeroblob
+** and (b) that the size-of-header varint at the start of (pKey1/nKey1)
+** fits in a single byte.  No collation sequence applies to BLOBs.
+*/
+static int vdbeRecordCompareBlob(
+  int nKey1, const void *pKey1, /* Left key */
+  UnpackedRecord *pPKey2        /* Right key */
+){
+  const u8 *aKey1 = (const u8*)pKey1;
+  int serial_type;
+  int res;
+
+  assert( (pPKey2->aMem[0].flags & (MEM_Blob|MEM_Zero))==MEM_Blob );
+  assert( pPKey2->aMem[0].n == pPKey2->n );
+  assert( pPKey2->aMem[0].z == pPKey2->u.z );
+  vdbeAssertFieldCountWithinLimits(nKey1, pKey1, pPKey2->pKeyInfo);
+  serial_type = (signed char)(aKey1[1]);
+
+vrcb_restart:
+  if( serial_type<12 ){
+    if( serial_type<0 ){
+      sqlite3GetVarint32(&aKey1[1], (u32*)&serial_type);
+      if( serial_type>=12 ) goto vrcb_restart;
+      assert( CORRUPT_DB );
+    }
+    res = pPKey2->r1;      /* (pKey1/nKey1) is a number or a null */
+  }else if( serial_type & 0x01 ){
+    res = pPKey2->r1;      /* (pKey1/nKey1) is a string */
+  }else{
+    int nCmp;
+    int nBlob;
+    int szHdr = aKey1[0];
+
+    nBlob = (serial_type-12) / 2;
+    if( (szHdr + nBlob) > nKey1 ){
+      pPKey2->errCode = (u8)SQLITE_CORRUPT_BKPT;
+      return 0;    /* Corruption */
+    }
+    nCmp = MIN( pPKey2->n, nBlob );
+    res = vdbeBlobCompare(&aKey1[szHdr], (const u8*)pPKey2->u.z, nCmp);
+
+    if( res>0 ){
+      res = pPKey2->r2;
+    }else if( res<0 ){
+      res = pPKey2->r1;
+    }else{
+      res = nBlob - pPKey2->n;
+      if( res==0 ){
+        if( pPKey2->nField>1 ){
+          res = sqlite3VdbeRecordCompareWithSkip(nKey1, pKey1, pPKey2, 1);
+        }else{
+          res = pPKey2->default_rc;
+          pPKey2->eqSeen = 1;
+        }
+      }else if( res>0 ){
+        res = pPKey2->r2;
+      }else{
+        res = pPKey2->r1;
+      }
+    }
+  }
+
+  assert( vdbeRecordCompareDebug(nKey1, pKey1, pPKey2, res)
+       || CORRUPT_DB
+       || pPKey2->pKeyInfo->db->mallocFailed
+  );
+  return res;
+}
+
 /*
 ** Return a pointer to an sqlite3VdbeRecordCompare() compatible function
 ** suitable for comparing serialized records to the unpacked record passed
 ** as the only argument.
 */
 SQLITE_PRIVATE RecordCompare sqlite3VdbeFindCompare(UnpackedRecord *p){
-  /* varintRecordCompareInt() and varintRecordCompareString() both assume
-  ** that the size-of-header varint that occurs at the start of each record
-  ** fits in a single byte (i.e. is 127 or less). varintRecordCompareInt()
-  ** also assumes that it is safe to overread a buffer by at least the
-  ** maximum possible legal header size plus 8 bytes. Because there is
-  ** guaranteed to be at least 74 (but not 136) bytes of padding following each
-  ** buffer passed to varintRecordCompareInt() this makes it convenient to
+  /* vdbeRecordCompareInt(), vdbeRecordCompareString() and
+  ** vdbeRecordCompareBlob() all assume that the size-of-header varint that
+  ** occurs at the start of each record fits in a single byte (i.e. is 127
+  ** or less). vdbeRecordCompareInt() also assumes that it is safe to
+  ** overread a buffer by at least the maximum possible legal header size
+  ** plus 8 bytes. Because there is guaranteed to be at least 74 (but not
+  ** 136) bytes of padding following each buffer passed to
+  ** vdbeRecordCompareInt() this makes it convenient to
   ** limit the size of the header to 64 bytes in cases where the first field
   ** is an integer.
   **
@@ -91982,6 +94193,13 @@ SQLITE_PRIVATE RecordCompare sqlite3VdbeFindCompare(UnpackedRecord *p){
       p->n = p->aMem[0].n;
       return vdbeRecordCompareString;
     }
+    if( (flags & (MEM_Blob|MEM_Zero|MEM_Str|MEM_Int|MEM_Real|MEM_IntReal
+                  |MEM_Null))==MEM_Blob
+    ){
+      p->u.z = p->aMem[0].z;
+      p->n = p->aMem[0].n;
+      return vdbeRecordCompareBlob;
+    }
   }
 
   return sqlite3VdbeRecordCompare;
@@ -186064,6 +188282,7 @@ static int connectionIsBusy(sqlite3 *db){
   int j;
   assert( sqlite3_mutex_held(db->mutex) );
   if( db->pVdbe ) return 1;
+  if( db->nKvOpen ) return 1;
   for(j=0; j<db->nDb; j++){
     Btree *pBt = db->aDb[j].pBt;
     if( pBt && sqlite3BtreeIsInBackup(pBt) ) return 1;
@@ -189989,6 +192208,2076 @@ SQLITE_API const char *sqlite3_compileoption_get(int N){
 #endif /* SQLITE_OMIT_COMPILEOPTION_DIAGS */
 
 /************** End of main.c ************************************************/
+/************** Begin file kv.c **********************************************/
+/*
+** 2026 October 16
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+*************************************************************************
+**
+** This file implements the sqlite3_kv interface: point reads and writes
+** and ordered iteration over a two-column WITHOUT ROWID table, done
+** directly on a BtCursor of the table's PRIMARY KEY b-tree without
+** preparing or running any SQL.
+**
+** Records are built and read in the ordinary record format, so a table
+** written through this interface is indistinguishable from one written
+** by "INSERT INTO t(key, value) VALUES(?, ?)" and SQL statements may read
+** and write it at the same time.  The transaction bookkeeping mirrors
+** what OP_Transaction and sqlite3VdbeHalt() do for a statement that
+** touches a single database:  each call counts as an active reader (and
+** writer) on the connection for its duration, and in autocommit mode the
+** call that opened the transaction also commits it.
+*/
+#ifndef SQLITE_OMIT_KV
+/* #include "sqliteInt.h" */
+/* #include "vdbeInt.h" */
+/* #include "btreeInt.h" */
+
+/*
+** An open key-value store.
+*/
+struct sqlite3_kv {
+  sqlite3 *db;              /* The database connection */
+  char *zDb;                /* Schema name, or NULL to search all */
+  char *zTable;             /* Table name */
+  int iDb;                  /* Index of the database holding the table */
+  Schema *pSchema;          /* Schema the root page below was read from */
+  int iGeneration;          /* pSchema->iGeneration at that time */
+  Pgno pgnoRoot;            /* Root page of the PRIMARY KEY b-tree, or 0 */
+  KeyInfo *pKeyInfo;        /* Comparison info for the key column */
+  BtCursor *pCur;           /* Cursor used by point operations */
+  u8 *aBuf;                 /* Record being written, or value being read */
+  int nBuf;                 /* Allocated size of aBuf[] */
+  int nIter;                /* Number of open iterators */
+  int nBatch;               /* Number of open write batches */
+  int nPin;                 /* Number of values pinned */
+  int iStatement;           /* Statement transaction of a batch write, or 0 */
+  u8 eSplit;                /* SQLITE_KV_SPLIT_* policy for write cursors */
+  u8 nFill;                 /* Percentage of leaves to fill, or 0 for all */
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  u8 bPfxLeaf;              /* True if opened with SQLITE_KV_COMPRESS */
+#endif
+};
+
+/*
+** An iterator over the entries of a store, in key order.
+*/
+struct sqlite3_kv_iter {
+  sqlite3_kv *pKv;          /* The store being iterated */
+  BtCursor *pCur;           /* Cursor open for the life of the iterator */
+  u8 eState;                /* KV_ITER_* value */
+  u8 *aStart;               /* First key to visit, or NULL */
+  int nStart;               /* Size of aStart[] in bytes */
+  u8 *aEnd;                 /* Key to stop before, or NULL */
+  int nEnd;                 /* Size of aEnd[] in bytes */
+  u8 *aBuf;                 /* Copy of an entry that spills to overflow */
+  int nBuf;                 /* Allocated size of aBuf[] */
+  const u8 *pKey;           /* Current key */
+  int nKey;
+  const u8 *pVal;           /* Current value */
+  int nVal;
+};
+
+typedef struct KvBatchOp KvBatchOp;
+
+#define KV_ITER_INIT 0      /* Not yet stepped */
+#define KV_ITER_ROW  1      /* Positioned on an entry */
+#define KV_ITER_EOF  2      /* Past the last entry */
+
+/* Column list of the tables created by SQLITE_KV_CREATE */
+#define KV_SCHEMA "(key BLOB PRIMARY KEY, value BLOB NOT NULL) WITHOUT ROWID"
+
+/*
+** Make sure *paBuf is at least n bytes in size.
+*/
+static int kvGrow(u8 **paBuf, int *pnBuf, i64 n){
+  if( n>*pnBuf ){
+    i64 nNew = n<64 ? 64 : n + n/4;
+    u8 *aNew = (u8*)sqlite3_realloc64(*paBuf, nNew);
+    if( aNew==0 ) return SQLITE_NOMEM_BKPT;
+    *paBuf = aNew;
+    *pnBuf = nNew>0x7fffffff ? 0x7fffffff : (int)nNew;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Return true if table pTab has a trigger attached to it, including
+** TEMP triggers, which live in the temp schema rather than in pTab's.
+*/
+static int kvHasTrigger(sqlite3 *db, Table *pTab){
+#ifndef SQLITE_OMIT_TRIGGER
+  Schema *pTmp = db->aDb[1].pSchema;
+  HashElem *p;
+  if( pTab->pTrigger ) return 1;
+  if( pTmp && pTmp!=pTab->pSchema ){
+    for(p=sqliteHashFirst(&pTmp->trigHash); p; p=sqliteHashNext(p)){
+      Trigger *pTrig = (Trigger*)sqliteHashData(p);
+      if( pTrig->pTabSchema==pTab->pSchema
+       && sqlite3StrICmp(pTrig->table, pTab->zName)==0
+      ){
+        return 1;
+      }
+    }
+  }
+#endif
+  return 0;
+}
+
+/*
+** Check the schema cookie of every attached database against the schema
+** loaded in memory, as schemaIsValid() does when a statement fails to
+** prepare, and reset the schemas found to be out of date.  Return true
+** if any was.  The caller must hold all b-tree mutexes.
+*/
+static int kvSchemaReset(sqlite3 *db){
+  int bReset = 0;
+  int iDb;
+  int cookie;
+
+  for(iDb=0; iDb<db->nDb; iDb++){
+    int openedTransaction = 0;
+    Btree *pBt = db->aDb[iDb].pBt;
+    if( pBt==0 ) continue;
+    if( sqlite3BtreeTxnState(pBt)==SQLITE_TXN_NONE ){
+      if( sqlite3BtreeBeginTrans(pBt, 0, 0)!=SQLITE_OK ) continue;
+      openedTransaction = 1;
+    }
+    sqlite3BtreeGetMeta(pBt, BTREE_SCHEMA_VERSION, (u32 *)&cookie);
+    if( cookie!=db->aDb[iDb].pSchema->schema_cookie ){
+      if( DbHasProperty(db, iDb, DB_SchemaLoaded) ) bReset = 1;
+      sqlite3ResetOneSchema(db, iDb);
+    }
+    if( openedTransaction ){
+      sqlite3BtreeCommit(pBt);
+    }
+  }
+  return bReset;
+}
+
+/*
+** Locate the table of store p in the schema, loading the schema first
+** if required, and check that it can be accessed directly.  That is, it
+** must be an ordinary WITHOUT ROWID table of exactly two columns with
+** no type affinity, the first of which is the PRIMARY KEY, with no other
+** indexes, triggers, CHECK constraints, generated columns or foreign
+** keys, as none of those would be maintained.  If the table is missing
+** or unsuitable, make sure that is not merely because the schema in
+** memory is stale before failing.
+**
+** The caller must hold the database mutex.
+*/
+static int kvResolve(sqlite3_kv *p){
+  sqlite3 *db = p->db;
+  char *zErr = 0;
+  Table *pTab;
+  Index *pPk;
+  int nRetry = 0;
+  int rc;
+
+  p->pgnoRoot = 0;
+  sqlite3BtreeEnterAll(db);
+ resolve_table:
+  rc = sqlite3Init(db, &zErr);
+  if( rc==SQLITE_OK ){
+    pTab = sqlite3FindTable(db, p->zTable, p->zDb);
+    if( pTab==0 ){
+      zErr = sqlite3MPrintf(db, "no such table: %s", p->zTable);
+      rc = SQLITE_ERROR;
+    }else{
+      pPk = IsOrdinaryTable(pTab) && !HasRowid(pTab) ?
+                sqlite3PrimaryKeyIndex(pTab) : 0;
+      if( pPk==0
+       || pTab->nCol!=2
+       || pPk->nKeyCol!=1 || pPk->nColumn!=2 || pPk->aiColumn[0]!=0
+       || pTab->pIndex!=pPk || pPk->pNext!=0
+       || pTab->aCol[0].affinity!=SQLITE_AFF_BLOB
+       || pTab->aCol[1].affinity!=SQLITE_AFF_BLOB
+       || pTab->pCheck!=0
+       || (pTab->tabFlags & TF_HasGenerated)!=0
+#ifndef SQLITE_OMIT_FOREIGN_KEY
+       || pTab->u.tab.pFKey!=0 || sqlite3FkReferences(pTab)!=0
+#endif
+       || kvHasTrigger(db, pTab)
+      ){
+        zErr = sqlite3MPrintf(db, "table %s is not a key-value table",
+                              pTab->zName);
+        rc = SQLITE_ERROR;
+      }else{
+        p->iDb = sqlite3SchemaToIndex(db, pTab->pSchema);
+        p->pSchema = pTab->pSchema;
+        p->iGeneration = pTab->pSchema->iGeneration;
+        p->pgnoRoot = pPk->tnum;
+        p->pKeyInfo->aSortFlags[0] = pPk->aSortOrder[0];
+      }
+    }
+    /* The table may only look missing or unsuitable because the schema
+    ** in memory is out of date.  */
+    if( rc==SQLITE_ERROR && nRetry++==0 && kvSchemaReset(db) ){
+      sqlite3DbFree(db, zErr);
+      zErr = 0;
+      goto resolve_table;
+    }
+  }
+  sqlite3BtreeLeaveAll(db);
+  sqlite3ErrorWithMsg(db, rc, zErr ? "%s" : 0, zErr);
+  sqlite3DbFree(db, zErr);
+  return rc;
+}
+
+/*
+** Commit the transaction of every attached database that has one.  As
+** in the single-file case of vdbeCommit(), no super-journal is needed:
+** only the caller's database can hold a write transaction here.
+*/
+static int kvCommit(sqlite3 *db, int wrFlag){
+  int rc = SQLITE_OK;
+  int i;
+  if( wrFlag && db->xCommitCallback && db->xCommitCallback(db->pCommitArg) ){
+    return SQLITE_CONSTRAINT_COMMITHOOK;
+  }
+  for(i=0; rc==SQLITE_OK && i<db->nDb; i++){
+    Btree *pBt = db->aDb[i].pBt;
+    if( sqlite3BtreeTxnState(pBt)!=SQLITE_TXN_NONE ){
+      rc = sqlite3BtreeCommitPhaseOne(pBt, 0);
+    }
+  }
+  for(i=0; rc==SQLITE_OK && i<db->nDb; i++){
+    Btree *pBt = db->aDb[i].pBt;
+    if( pBt ){
+      rc = sqlite3BtreeCommitPhaseTwo(pBt, 0);
+    }
+  }
+  return rc;
+}
+
+/*
+** Finish an operation begun by kvBegin().  rc is its outcome so far.  If
+** the connection is in autocommit mode and no other writer is active,
+** commit the transaction (or roll it back after an error), as
+** sqlite3VdbeHalt() would; errors that may have left the page cache
+** inconsistent roll back an explicit transaction as well, unless they
+** are SQLITE_NOMEM or SQLITE_FULL and p->iStatement shows that the
+** operation ran in a statement transaction, already rolled back by the
+** caller.  Cursors must be closed by the caller first.
+*/
+static int kvEnd(sqlite3_kv *p, int wrFlag, int rc){
+  sqlite3 *db = p->db;
+  int mrc = rc & 0xff;
+  int bCommit = 0;
+  if( p->iStatement && (mrc==SQLITE_NOMEM || mrc==SQLITE_FULL) ){
+    /* Only the statement is rolled back, as by sqlite3VdbeHalt() */
+  }else if( mrc==SQLITE_NOMEM || mrc==SQLITE_IOERR || mrc==SQLITE_FULL ){
+    sqlite3RollbackAll(db, SQLITE_ABORT_ROLLBACK);
+    sqlite3CloseSavepoints(db);
+    db->autoCommit = 1;
+  }else if( db->autoCommit && db->nVdbeWrite==wrFlag ){
+    if( rc==SQLITE_OK ){
+      rc = kvCommit(db, wrFlag);
+      if( rc!=SQLITE_OK ){
+        sqlite3SystemError(db, rc);
+        sqlite3RollbackAll(db, SQLITE_OK);
+      }else{
+        bCommit = wrFlag;
+      }
+    }else if( rc!=SQLITE_SCHEMA || db->nVdbeActive==1 ){
+      sqlite3RollbackAll(db, SQLITE_OK);
+    }
+    db->nStatement = 0;
+  }
+  db->nVdbeActive--;
+  db->nVdbeRead--;
+  if( wrFlag ) db->nVdbeWrite--;
+  if( bCommit && db->autoCommit ){
+    rc = doWalCallbacks(db);
+  }
+  return rc;
+}
+
+/*
+** Begin a read (wrFlag==0) or write (wrFlag==1) operation on store p:
+** register it as an active reader/writer on the connection and open or
+** join a transaction on its database.  If the schema changed on disk
+** since the table was resolved, reload it and resolve the table again.
+**
+** On success the caller must eventually call kvEnd() with the same
+** wrFlag.  On failure the registration has already been undone.
+*/
+static int kvBegin(sqlite3_kv *p, int wrFlag){
+  sqlite3 *db = p->db;
+  int nRetry = 0;
+  int rc;
+
+  if( wrFlag && (db->flags & (SQLITE_QueryOnly|SQLITE_CorruptRdOnly))!=0 ){
+    rc = (db->flags & SQLITE_QueryOnly) ? SQLITE_READONLY : SQLITE_CORRUPT;
+    sqlite3Error(db, rc);
+    return rc;
+  }
+  while( 1 ){
+    int iMeta = 0;
+    Btree *pBt;
+    if( p->pgnoRoot==0
+     || p->iDb>=db->nDb
+     || db->aDb[p->iDb].pSchema!=p->pSchema
+     || p->pSchema->iGeneration!=p->iGeneration
+    ){
+      rc = kvResolve(p);
+      if( rc ) return rc;
+    }
+    pBt = db->aDb[p->iDb].pBt;
+    db->nVdbeActive++;
+    db->nVdbeRead++;
+    if( wrFlag ) db->nVdbeWrite++;
+    rc = sqlite3BtreeBeginTrans(pBt, wrFlag, &iMeta);
+    if( rc==SQLITE_OK && iMeta!=p->pSchema->schema_cookie ) rc = SQLITE_SCHEMA;
+#ifndef SQLITE_OMIT_SHARED_CACHE
+    /* As OP_TableLock would */
+    if( rc==SQLITE_OK && (wrFlag || (db->flags & SQLITE_ReadUncommit)==0) ){
+      rc = sqlite3BtreeLockTable(pBt, p->pgnoRoot, (u8)wrFlag);
+    }
+#endif
+    if( rc==SQLITE_OK ) return SQLITE_OK;
+    kvEnd(p, wrFlag, rc);
+    if( rc!=SQLITE_SCHEMA || nRetry++>0 ){
+      sqlite3Error(db, rc);
+      return rc;
+    }
+    sqlite3BtreeEnterAll(db);
+    sqlite3ResetOneSchema(db, p->iDb);
+    sqlite3BtreeLeaveAll(db);
+    p->pgnoRoot = 0;
+  }
+}
+
+/*
+** Open a cursor on the PRIMARY KEY b-tree of store p.  pCur must point
+** to sqlite3BtreeCursorSize() bytes.
+*/
+static int kvCursor(sqlite3_kv *p, int wrFlag, BtCursor *pCur){
+  int rc;
+  sqlite3BtreeCursorZero(pCur);
+  rc = sqlite3BtreeCursor(p->db->aDb[p->iDb].pBt, p->pgnoRoot,
+                          wrFlag ? BTREE_WRCSR : 0, p->pKeyInfo, pCur);
+  if( rc==SQLITE_OK && wrFlag ){
+    sqlite3BtreeCursorSplit(pCur, p->eSplit, p->nFill);
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+    sqlite3BtreeCursorPfxLeaf(pCur, p->bPfxLeaf);
+#endif
+  }
+  return rc;
+}
+
+/*
+** Seek pCur to key pKey/nKey.  *pRes is set as by sqlite3BtreeIndexMoveto():
+** zero if the cursor is left on an entry with exactly that key.  A bias
+** of +1 instead treats an equal key as larger, as OP_SeekGE does, so the
+** cursor ends up on or just before the first entry not less than pKey.
+*/
+static int kvSeek(
+  sqlite3_kv *p,
+  BtCursor *pCur,
+  const void *pKey,
+  int nKey,
+  int bias,
+  int *pRes
+){
+  UnpackedRecord r;
+  Mem mem;
+  memset(&mem, 0, sizeof(mem));
+  mem.flags = MEM_Blob;
+  mem.z = (char*)pKey;
+  mem.n = nKey;
+  mem.enc = ENC(p->db);
+  memset(&r, 0, sizeof(r));
+  r.pKeyInfo = p->pKeyInfo;
+  r.aMem = &mem;
+  r.nField = 1;
+  r.default_rc = (i8)bias;
+  return sqlite3BtreeIndexMoveto(pCur, &r, pRes);
+}
+
+/*
+** Locate the key and value of the entry pCur points to.  The offsets
+** of the two fields within the payload are written to *piKey and *piVal
+** and their sizes to *pnKey and *pnVal.  Return SQLITE_MISMATCH if either
+** field is not a BLOB or TEXT, as SQL writers are free to store other
+** types.
+*/
+static int kvParse(
+  BtCursor *pCur,
+  u32 *piKey, int *pnKey,
+  u32 *piVal, int *pnVal
+){
+  u32 nAvail;
+  u32 nPayload = sqlite3BtreePayloadSize(pCur);
+  const u8 *a = (const u8*)sqlite3BtreePayloadFetch(pCur, &nAvail);
+  u32 nHdr, tKey, tVal, i;
+
+  if( nAvail<3 ) return SQLITE_CORRUPT_BKPT;
+  i = getVarint32(a, nHdr);
+  if( nHdr>nAvail || nHdr>nPayload ) return SQLITE_CORRUPT_BKPT;
+  i += getVarint32(&a[i], tKey);
+  if( i>=nHdr ) return SQLITE_CORRUPT_BKPT;
+  i += getVarint32(&a[i], tVal);
+  if( i>nHdr ) return SQLITE_CORRUPT_BKPT;
+  if( tKey<12 || tVal<12 ) return SQLITE_MISMATCH;
+  *piKey = nHdr;
+  *pnKey = (int)sqlite3VdbeSerialTypeLen(tKey);
+  *piVal = nHdr + (u32)*pnKey;
+  *pnVal = (int)sqlite3VdbeSerialTypeLen(tVal);
+  if( (i64)*piVal + *pnVal > nPayload ) return SQLITE_CORRUPT_BKPT;
+  return SQLITE_OK;
+}
+
+/*
+** Open a key-value store on table zTable of database zDb (NULL to search
+** all attached databases, as for an unqualified table name in SQL).
+*/
+SQLITE_API int sqlite3_kv_open(
+  sqlite3 *db,
+  const char *zDb,
+  const char *zTable,
+  int flags,
+  sqlite3_kv **ppKv
+){
+  sqlite3_kv *p = 0;
+  int rc = SQLITE_OK;
+
+#ifdef SQLITE_ENABLE_API_ARMOR
+  if( ppKv==0 ) return SQLITE_MISUSE_BKPT;
+#endif
+  *ppKv = 0;
+#ifdef SQLITE_ENABLE_API_ARMOR
+  if( !sqlite3SafetyCheckOk(db) || zTable==0 ) return SQLITE_MISUSE_BKPT;
+#endif
+  if( flags & SQLITE_KV_CREATE ){
+    char *zSql;
+    if( zDb ){
+      zSql = sqlite3_mprintf(
+          "CREATE TABLE IF NOT EXISTS \"%w\".\"%w\"" KV_SCHEMA, zDb, zTable);
+    }else{
+      zSql = sqlite3_mprintf(
+          "CREATE TABLE IF NOT EXISTS \"%w\"" KV_SCHEMA, zTable);
+    }
+    if( zSql==0 ) return SQLITE_NOMEM_BKPT;
+    rc = sqlite3_exec(db, zSql, 0, 0, 0);
+    sqlite3_free(zSql);
+    if( rc ) return rc;
+  }
+
+  sqlite3_mutex_enter(db->mutex);
+  p = (sqlite3_kv*)sqlite3MallocZero(sizeof(*p));
+  if( p ){
+    p->db = db;
+    p->zDb = zDb ? sqlite3_mprintf("%s", zDb) : 0;
+    p->zTable = sqlite3_mprintf("%s", zTable);
+    p->pKeyInfo = sqlite3KeyInfoAlloc(db, 1, 1);
+    p->pCur = (BtCursor*)sqlite3MallocZero(sqlite3BtreeCursorSize());
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+    p->bPfxLeaf = (flags & SQLITE_KV_COMPRESS)!=0;
+#endif
+  }
+  if( p==0 || (zDb && p->zDb==0) || p->zTable==0
+   || p->pKeyInfo==0 || p->pCur==0
+  ){
+    rc = SQLITE_NOMEM_BKPT;
+  }else{
+    rc = kvResolve(p);
+  }
+  if( rc==SQLITE_OK ){
+    db->nKvOpen++;
+    *ppKv = p;
+  }else if( p ){
+    sqlite3KeyInfoUnref(p->pKeyInfo);
+    sqlite3_free(p->pCur);
+    sqlite3_free(p->zDb);
+    sqlite3_free(p->zTable);
+    sqlite3_free(p);
+  }
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Close a store.  All of its iterators and batches must be closed, and
+** its pinned values released, first.
+*/
+SQLITE_API int sqlite3_kv_close(sqlite3_kv *p){
+  sqlite3 *db;
+  if( p==0 ) return SQLITE_OK;
+  db = p->db;
+  sqlite3_mutex_enter(db->mutex);
+  if( p->nIter || p->nBatch || p->nPin ){
+    sqlite3ErrorWithMsg(db, SQLITE_BUSY, "unable to close key-value store "
+                        "with open iterators, batches or pinned values");
+    sqlite3_mutex_leave(db->mutex);
+    return SQLITE_BUSY;
+  }
+  sqlite3KeyInfoUnref(p->pKeyInfo);
+  sqlite3_free(p->pCur);
+  sqlite3_free(p->aBuf);
+  sqlite3_free(p->zDb);
+  sqlite3_free(p->zTable);
+  sqlite3_free(p);
+  db->nKvOpen--;
+  sqlite3LeaveMutexAndCloseZombie(db);
+  return SQLITE_OK;
+}
+
+
+/*
+** Return the size of the record for an nKey byte key and an nVal byte
+** value, and set *pnHdr to the size of its header.  Return -1 if the
+** record would exceed SQLITE_LIMIT_LENGTH.
+*/
+static i64 kvRecordSize(sqlite3_kv *p, int nKey, int nVal, int *pnHdr){
+  if( (i64)nKey + nVal > p->db->aLimit[SQLITE_LIMIT_LENGTH] ) return -1;
+  *pnHdr = 1 + sqlite3VarintLen((u32)nKey*2 + 12)
+             + sqlite3VarintLen((u32)nVal*2 + 12);
+  return *pnHdr + (i64)nKey + nVal;
+}
+
+/*
+** Write the record for key pKey/nKey and value pVal/nVal, with an nHdr
+** byte header, to a[], exactly as OP_MakeRecord would for two BLOB
+** values.
+*/
+static void kvRecordWrite(
+  u8 *a,
+  int nHdr,
+  const void *pKey, int nKey,
+  const void *pVal, int nVal
+){
+  int i = 1;
+  a[0] = (u8)nHdr;
+  i += putVarint32(&a[i], (u32)nKey*2 + 12);
+  i += putVarint32(&a[i], (u32)nVal*2 + 12);
+  if( nKey>0 ) memcpy(&a[i], pKey, nKey);
+  if( nVal>0 ) memcpy(&a[i+nKey], pVal, nVal);
+}
+
+/*
+** Build the record for key pKey/nKey and value pVal/nVal in p->aBuf.
+*/
+static int kvRecord(
+  sqlite3_kv *p,
+  const void *pKey, int nKey,
+  const void *pVal, int nVal,
+  i64 *pnRec
+){
+  int nHdr, rc;
+  i64 nRec = kvRecordSize(p, nKey, nVal, &nHdr);
+  if( nRec<0 ) return SQLITE_TOOBIG;
+  rc = kvGrow(&p->aBuf, &p->nBuf, nRec);
+  if( rc ) return rc;
+  kvRecordWrite(p->aBuf, nHdr, pKey, nKey, pVal, nVal);
+  *pnRec = nRec;
+  return SQLITE_OK;
+}
+
+/* Point operations, for kvPoint() */
+#define KV_OP_GET    0
+#define KV_OP_EXISTS 1
+#define KV_OP_PUT    2
+#define KV_OP_DELETE 3
+
+/*
+** Perform one point operation on key pKey/nKey in its own transaction,
+** or within the connection's open transaction.  *pbFound is set to true
+** if the key was present beforehand.  KV_OP_GET leaves the value in
+** p->aBuf, and its size in *pnVal.
+*/
+static int kvPoint(
+  sqlite3_kv *p,
+  int eOp,
+  const void *pKey, int nKey,
+  const void *pVal, int *pnVal,
+  int *pbFound
+){
+  sqlite3 *db = p->db;
+  int wrFlag = eOp>=KV_OP_PUT;
+  int rc, res = 0;
+  Btree *pBt;
+
+  *pbFound = 0;
+  if( nKey<0 || (eOp==KV_OP_PUT && *pnVal<0) ) return SQLITE_MISUSE_BKPT;
+  rc = kvBegin(p, wrFlag);
+  if( rc ) return rc;
+  pBt = db->aDb[p->iDb].pBt;
+  sqlite3BtreeEnter(pBt);
+  rc = kvCursor(p, wrFlag, p->pCur);
+  if( rc==SQLITE_OK ) rc = kvSeek(p, p->pCur, pKey, nKey, 0, &res);
+  if( rc==SQLITE_OK ){
+    *pbFound = res==0 && sqlite3BtreeCursorIsValidNN(p->pCur);
+    switch( eOp ){
+      case KV_OP_GET: {
+        if( *pbFound ){
+          u32 iKey, iVal;
+          int nFound;
+          rc = kvParse(p->pCur, &iKey, &nFound, &iVal, pnVal);
+          if( rc==SQLITE_OK ) rc = kvGrow(&p->aBuf, &p->nBuf, *pnVal);
+          if( rc==SQLITE_OK && *pnVal>0 ){
+            rc = sqlite3BtreePayload(p->pCur, iVal, (u32)*pnVal, p->aBuf);
+          }
+        }
+        break;
+      }
+      case KV_OP_PUT: {
+        BtreePayload x;
+        i64 nRec = 0;
+        rc = kvRecord(p, pKey, nKey, pVal, *pnVal, &nRec);
+        if( rc==SQLITE_OK ){
+          memset(&x, 0, sizeof(x));
+          x.pKey = p->aBuf;
+          x.nKey = nRec;
+          /* When replacing, the cursor is already on the entry.  Without
+          ** BTREE_SAVEPOSITION the insert would seek again on the whole
+          ** record, miss the old value and add a second entry.  */
+          rc = sqlite3BtreeInsert(p->pCur, &x,
+                                  *pbFound ? BTREE_SAVEPOSITION : 0, res);
+        }
+        if( rc==SQLITE_OK ) sqlite3VdbeSetChanges(db, 1);
+        break;
+      }
+      case KV_OP_DELETE: {
+        if( *pbFound ){
+          rc = sqlite3BtreeDelete(p->pCur, 0);
+          if( rc==SQLITE_OK ) sqlite3VdbeSetChanges(db, 1);
+        }
+        break;
+      }
+    }
+  }
+  sqlite3BtreeCloseCursor(p->pCur);
+  sqlite3BtreeLeave(pBt);
+  return kvEnd(p, wrFlag, rc);
+}
+
+/*
+** Look up key pKey/nKey.  If it is present, set *ppVal and *pnVal to its
+** value, which remains valid until the next call on the store, and
+** return SQLITE_OK.  Otherwise return SQLITE_NOTFOUND.
+*/
+SQLITE_API int sqlite3_kv_get(
+  sqlite3_kv *p,
+  const void *pKey,
+  int nKey,
+  const void **ppVal,
+  int *pnVal
+){
+  sqlite3 *db = p->db;
+  int rc, bFound = 0, nVal = 0;
+
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvPoint(p, KV_OP_GET, pKey, nKey, 0, &nVal, &bFound);
+  if( rc==SQLITE_OK && !bFound ) rc = SQLITE_NOTFOUND;
+  *ppVal = rc==SQLITE_OK ? p->aBuf : 0;
+  *pnVal = rc==SQLITE_OK ? nVal : 0;
+  if( rc && rc!=SQLITE_NOTFOUND ) sqlite3Error(db, rc);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Set *pbExists to true if key pKey/nKey is present, false otherwise.
+*/
+SQLITE_API int sqlite3_kv_exists(
+  sqlite3_kv *p,
+  const void *pKey,
+  int nKey,
+  int *pbExists
+){
+  sqlite3 *db = p->db;
+  int rc;
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvPoint(p, KV_OP_EXISTS, pKey, nKey, 0, 0, pbExists);
+  if( rc && rc!=SQLITE_NOTFOUND ) sqlite3Error(db, rc);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Insert key pKey/nKey with value pVal/nVal, replacing any existing
+** value for the key.
+*/
+SQLITE_API int sqlite3_kv_put(
+  sqlite3_kv *p,
+  const void *pKey,
+  int nKey,
+  const void *pVal,
+  int nVal
+){
+  sqlite3 *db = p->db;
+  int rc, bFound;
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvPoint(p, KV_OP_PUT, pKey, nKey, pVal, &nVal, &bFound);
+  if( rc && rc!=SQLITE_NOTFOUND ) sqlite3Error(db, rc);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Remove key pKey/nKey.  Removing a key that is not present is not an
+** error.
+*/
+SQLITE_API int sqlite3_kv_delete(sqlite3_kv *p, const void *pKey, int nKey){
+  sqlite3 *db = p->db;
+  int rc, bFound;
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvPoint(p, KV_OP_DELETE, pKey, nKey, 0, 0, &bFound);
+  if( rc && rc!=SQLITE_NOTFOUND ) sqlite3Error(db, rc);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Replace the value of key pKey/nKey with whatever xModify makes of it,
+** positioning the cursor once.  xModify is passed the current value, or
+** NULL if the key is not present, and sets *ppNew and *pnNew to the new
+** value, or *ppNew to NULL to delete the key.  If it returns SQLITE_DONE
+** the entry is left as it is; any other code but SQLITE_OK is returned.
+** The old value is read and the new one written under the same write
+** transaction, so no other writer can come in between.  A new value of
+** the same size as the old is written over it in place.
+*/
+static int kvModify(
+  sqlite3_kv *p,
+  const void *pKey, int nKey,
+  int (*xModify)(void*, const void*, int, const void**, int*),
+  void *pCtx
+){
+  sqlite3 *db = p->db;
+  const void *pOld = 0, *pNew = 0;
+  int nOld = 0, nNew = 0;
+  u8 *aOld = 0;
+  int rc, res = 0, bFound = 0;
+  Btree *pBt;
+
+  if( nKey<0 ) return SQLITE_MISUSE_BKPT;
+  rc = kvBegin(p, 1);
+  if( rc ) return rc;
+  pBt = db->aDb[p->iDb].pBt;
+  sqlite3BtreeEnter(pBt);
+  rc = kvCursor(p, 1, p->pCur);
+  if( rc==SQLITE_OK ) rc = kvSeek(p, p->pCur, pKey, nKey, 0, &res);
+  if( rc==SQLITE_OK ){
+    bFound = res==0 && sqlite3BtreeCursorIsValidNN(p->pCur);
+  }
+  if( rc==SQLITE_OK && bFound ){
+    u32 iKey, iVal, nAvail;
+    int nFound;
+    rc = kvParse(p->pCur, &iKey, &nFound, &iVal, &nOld);
+    if( rc==SQLITE_OK ){
+      const u8 *a = (const u8*)sqlite3BtreePayloadFetch(p->pCur, &nAvail);
+      if( nOld==0 ){
+        /* An empty value after a key that spills onto overflow pages is
+        ** past the local payload, but there is nothing to copy. */
+        pOld = "";
+      }else if( iVal + (u32)nOld <= nAvail ){
+        pOld = &a[iVal];
+      }else{
+        /* The value spills onto overflow pages.  Copy it out.  Not into
+        ** p->aBuf, which the new record is built in. */
+        aOld = (u8*)sqlite3Malloc(nOld);
+        if( aOld==0 ){
+          rc = SQLITE_NOMEM_BKPT;
+        }else{
+          rc = sqlite3BtreePayload(p->pCur, iVal, (u32)nOld, aOld);
+        }
+        pOld = aOld;
+      }
+    }
+  }
+  if( rc==SQLITE_OK ){
+    rc = xModify(pCtx, pOld, nOld, &pNew, &nNew);
+    if( rc==SQLITE_DONE ){
+      rc = SQLITE_OK;
+    }else if( rc==SQLITE_OK && pNew ){
+      BtreePayload x;
+      i64 nRec = 0;
+      rc = nNew<0 ? SQLITE_MISUSE_BKPT
+                  : kvRecord(p, pKey, nKey, pNew, nNew, &nRec);
+      if( rc==SQLITE_OK ){
+        memset(&x, 0, sizeof(x));
+        x.pKey = p->aBuf;
+        x.nKey = nRec;
+        rc = sqlite3BtreeInsert(p->pCur, &x,
+                                bFound ? BTREE_SAVEPOSITION : 0, res);
+      }
+      if( rc==SQLITE_OK ) sqlite3VdbeSetChanges(db, 1);
+    }else if( rc==SQLITE_OK && bFound ){
+      rc = sqlite3BtreeDelete(p->pCur, 0);
+      if( rc==SQLITE_OK ) sqlite3VdbeSetChanges(db, 1);
+    }
+  }
+  sqlite3_free(aOld);
+  sqlite3BtreeCloseCursor(p->pCur);
+  sqlite3BtreeLeave(pBt);
+  return kvEnd(p, 1, rc);
+}
+
+/*
+** Context of kvCasModify(), for sqlite3_kv_cas().
+*/
+typedef struct KvCas KvCas;
+struct KvCas {
+  const void *pOld;         /* Expected value, or NULL for no entry */
+  int nOld;
+  const void *pNew;         /* Value to swap in, or NULL to delete */
+  int nNew;
+  int bSwapped;             /* Set if the expected value was found */
+};
+
+static int kvCasModify(
+  void *pCtx,
+  const void *pOld, int nOld,
+  const void **ppNew, int *pnNew
+){
+  KvCas *pCas = (KvCas*)pCtx;
+  if( pCas->pOld==0 ? pOld!=0
+   : (pOld==0 || nOld!=pCas->nOld
+      || (nOld>0 && memcmp(pOld, pCas->pOld, nOld)!=0))
+  ){
+    return SQLITE_DONE;
+  }
+  pCas->bSwapped = 1;
+  *ppNew = pCas->pNew;
+  *pnNew = pCas->nNew;
+  return SQLITE_OK;
+}
+
+/*
+** Set the value of key pKey/nKey to pNew/nNew, or remove the key if pNew
+** is NULL, but only if its current value is pOld/nOld, or if the key is
+** not present when pOld is NULL.  *pbSwapped is set to true if it was.
+*/
+SQLITE_API int sqlite3_kv_cas(
+  sqlite3_kv *p,
+  const void *pKey, int nKey,
+  const void *pOld, int nOld,
+  const void *pNew, int nNew,
+  int *pbSwapped
+){
+  sqlite3 *db = p->db;
+  KvCas cas;
+  int rc;
+
+  *pbSwapped = 0;
+  if( (pOld && nOld<0) || (pNew && nNew<0) ) return SQLITE_MISUSE_BKPT;
+  memset(&cas, 0, sizeof(cas));
+  cas.pOld = pOld;
+  cas.nOld = nOld;
+  cas.pNew = pNew;
+  cas.nNew = nNew;
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvModify(p, pKey, nKey, kvCasModify, (void*)&cas);
+  if( rc==SQLITE_OK ){
+    *pbSwapped = cas.bSwapped;
+  }else{
+    sqlite3Error(db, rc);
+  }
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Context of kvIncrementModify(), for sqlite3_kv_increment().
+*/
+typedef struct KvIncrement KvIncrement;
+struct KvIncrement {
+  i64 iDelta;               /* Amount to add */
+  i64 iNew;                 /* The result */
+  u8 aNew[8];               /* The result as a value */
+};
+
+static int kvIncrementModify(
+  void *pCtx,
+  const void *pOld, int nOld,
+  const void **ppNew, int *pnNew
+){
+  KvIncrement *pInc = (KvIncrement*)pCtx;
+  i64 iVal = 0;
+  u64 u;
+  if( pOld ){
+    const u8 *a = (const u8*)pOld;
+    if( nOld!=8 ) return SQLITE_MISMATCH;
+    u = ((u64)get4byte(a)<<32) | get4byte(&a[4]);
+    memcpy(&iVal, &u, 8);
+  }
+  if( sqlite3AddInt64(&iVal, pInc->iDelta) ) return SQLITE_TOOBIG;
+  pInc->iNew = iVal;
+  memcpy(&u, &iVal, 8);
+  put4byte(pInc->aNew, (u32)(u>>32));
+  put4byte(&pInc->aNew[4], (u32)u);
+  *ppNew = pInc->aNew;
+  *pnNew = 8;
+  return SQLITE_OK;
+}
+
+/*
+** Add iDelta to the counter stored as the value of key pKey/nKey and
+** set *piNew, if it is not NULL, to the result.
+*/
+SQLITE_API int sqlite3_kv_increment(
+  sqlite3_kv *p,
+  const void *pKey, int nKey,
+  sqlite3_int64 iDelta,
+  sqlite3_int64 *piNew
+){
+  sqlite3 *db = p->db;
+  KvIncrement inc;
+  int rc;
+
+  memset(&inc, 0, sizeof(inc));
+  inc.iDelta = iDelta;
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvModify(p, pKey, nKey, kvIncrementModify, (void*)&inc);
+  if( rc==SQLITE_MISMATCH ){
+    sqlite3ErrorWithMsg(db, rc, "key-value counter is not an 8-byte value");
+  }else if( rc==SQLITE_TOOBIG ){
+    sqlite3ErrorWithMsg(db, rc, "integer overflow");
+  }else if( rc ){
+    sqlite3Error(db, rc);
+  }else if( piNew ){
+    *piNew = inc.iNew;
+  }
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Replace the value of key pKey/nKey with the result of merging it with
+** xMerge.
+*/
+SQLITE_API int sqlite3_kv_merge(
+  sqlite3_kv *p,
+  const void *pKey, int nKey,
+  int (*xMerge)(void*, const void *pOld, int nOld,
+                const void **ppNew, int *pnNew),
+  void *pCtx
+){
+  sqlite3 *db = p->db;
+  int rc;
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvModify(p, pKey, nKey, xMerge, pCtx);
+  if( rc ) sqlite3Error(db, rc);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Compare two keys in the order of the PRIMARY KEY b-tree of store p:
+** the BLOB order of memcmp() then length, reversed for a DESC key.
+*/
+static int kvKeyCompare(
+  sqlite3_kv *p,
+  const void *pA, int nA,
+  const void *pB, int nB
+){
+  int c = (nA && nB) ? memcmp(pA, pB, nA<nB ? nA : nB) : 0;
+  if( c==0 ) c = nA - nB;
+  return p->pKeyInfo->aSortFlags[0] & KEYINFO_ORDER_DESC ? -c : c;
+}
+
+/*
+** Sort the nKey indexes in aIdx[] into b-tree order of the keys they
+** refer to.  aTmp[] is scratch space of the same size.  A bottom-up
+** merge sort, so that already sorted input costs one compare per key.
+*/
+static void kvSortKeys(
+  sqlite3_kv *p,
+  const void *const *apKey, const int *anKey,
+  int nKey, int *aIdx, int *aTmp
+){
+  int nRun, i;
+  for(nRun=1; nRun<nKey; nRun*=2){
+    for(i=0; i<nKey; i+=2*nRun){
+      int iA = i, iB = i+nRun, iOut = i;
+      int eA = iB<nKey ? iB : nKey;
+      int eB = i+2*nRun<nKey ? i+2*nRun : nKey;
+      while( iA<eA && iB<eB ){
+        int a = aIdx[iA], b = aIdx[iB];
+        if( kvKeyCompare(p, apKey[b], anKey[b], apKey[a], anKey[a])<0 ){
+          aTmp[iOut++] = aIdx[iB++];
+        }else{
+          aTmp[iOut++] = aIdx[iA++];
+        }
+      }
+      while( iA<eA ) aTmp[iOut++] = aIdx[iA++];
+      while( iB<eB ) aTmp[iOut++] = aIdx[iB++];
+    }
+    memcpy(aIdx, aTmp, nKey*sizeof(int));
+  }
+}
+
+/*
+** Look up nKey keys at once.  They are sorted and sought in b-tree order
+** on a single cursor with the BTREE_SEEK_ASC hint, so each seek starts
+** from the lowest ancestor page shared with the previous key instead of
+** from the root.  The values found are appended to p->aBuf; their
+** offsets are kept in aOff[] until the buffer stops moving.
+*/
+SQLITE_API int sqlite3_kv_multi_get(
+  sqlite3_kv *p,
+  int nKey,
+  const void *const *apKey,
+  const int *anKey,
+  const void **apVal,
+  int *anVal
+){
+  sqlite3 *db = p->db;
+  int *aIdx = 0;
+  i64 *aOff = 0;
+  i64 nUsed = 0;
+  Btree *pBt;
+  int i, rc;
+
+  if( nKey<0 ) return SQLITE_MISUSE_BKPT;
+  for(i=0; i<nKey; i++){
+    if( anKey[i]<0 ) return SQLITE_MISUSE_BKPT;
+    apVal[i] = 0;
+    anVal[i] = 0;
+  }
+  if( nKey==0 ) return SQLITE_OK;
+  sqlite3_mutex_enter(db->mutex);
+  aOff = (i64*)sqlite3Malloc(nKey*(sizeof(i64) + 2*sizeof(int)));
+  if( aOff==0 ){
+    rc = SQLITE_NOMEM_BKPT;
+    goto multi_get_out;
+  }
+  aIdx = (int*)&aOff[nKey];
+  for(i=0; i<nKey; i++) aIdx[i] = i;
+  rc = kvBegin(p, 0);
+  if( rc ) goto multi_get_out;
+  kvSortKeys(p, apKey, anKey, nKey, aIdx, &aIdx[nKey]);
+
+  pBt = db->aDb[p->iDb].pBt;
+  sqlite3BtreeEnter(pBt);
+  rc = kvCursor(p, 0, p->pCur);
+  if( rc==SQLITE_OK ) sqlite3BtreeCursorHintFlags(p->pCur, BTREE_SEEK_ASC);
+  for(i=0; rc==SQLITE_OK && i<nKey; i++){
+    int k = aIdx[i];
+    int res = 0;
+    aOff[k] = -1;
+    if( i>0 && kvKeyCompare(p, apKey[k], anKey[k],
+                            apKey[aIdx[i-1]], anKey[aIdx[i-1]])==0 ){
+      aOff[k] = aOff[aIdx[i-1]];
+      anVal[k] = anVal[aIdx[i-1]];
+      continue;
+    }
+    rc = kvSeek(p, p->pCur, apKey[k], anKey[k], 0, &res);
+    if( rc==SQLITE_OK && res==0 && sqlite3BtreeCursorIsValidNN(p->pCur) ){
+      u32 iKey, iVal;
+      int nFound;
+      rc = kvParse(p->pCur, &iKey, &nFound, &iVal, &anVal[k]);
+      if( rc==SQLITE_OK ) rc = kvGrow(&p->aBuf, &p->nBuf, nUsed + anVal[k] + 1);
+      if( rc==SQLITE_OK && anVal[k]>0 ){
+        rc = sqlite3BtreePayload(p->pCur, iVal, (u32)anVal[k], &p->aBuf[nUsed]);
+      }
+      aOff[k] = nUsed;
+      nUsed += anVal[k];
+    }
+  }
+  sqlite3BtreeCloseCursor(p->pCur);
+  sqlite3BtreeLeave(pBt);
+  rc = kvEnd(p, 0, rc);
+  for(i=0; i<nKey; i++){
+    if( rc==SQLITE_OK && aOff[i]>=0 ){
+      apVal[i] = &p->aBuf[aOff[i]];
+    }else{
+      anVal[i] = 0;
+    }
+  }
+
+ multi_get_out:
+  sqlite3_free(aOff);
+  if( rc ) sqlite3Error(db, rc);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** A write batch.  Puts are stored as ready-made records and deletes as
+** bare keys, back to back in aBuf[], so that applying the batch copies
+** each of them only once more, into the b-tree page.
+*/
+struct sqlite3_kv_batch {
+  sqlite3_kv *pKv;          /* Store the batch is written to */
+  u8 *aBuf;                 /* Records and keys of the batched operations */
+  int nBuf;                 /* Allocated size of aBuf[] */
+  i64 nUsed;                /* Bytes of aBuf[] in use */
+  KvBatchOp *aOp;           /* Operations in the order they were added */
+  int nOp;                  /* Number of entries in aOp[] */
+  int nOpAlloc;             /* Allocated size of aOp[] */
+};
+
+/*
+** One operation of a write batch.  The key is at aBuf[iKey].  For a put,
+** the whole record, key included, is nRec bytes at aBuf[iRec].  nRec is
+** zero for a delete.
+*/
+struct KvBatchOp {
+  i64 iRec;                 /* Offset of the record in aBuf[] */
+  i64 iKey;                 /* Offset of the key in aBuf[] */
+  int nRec;                 /* Size of the record, or 0 for a delete */
+  int nKey;                 /* Size of the key */
+};
+
+/*
+** Create a new, empty write batch for store p.
+*/
+SQLITE_API int sqlite3_kv_batch_open(sqlite3_kv *p, sqlite3_kv_batch **ppBatch){
+  sqlite3 *db = p->db;
+  sqlite3_kv_batch *pBatch;
+  int rc = SQLITE_OK;
+  sqlite3_mutex_enter(db->mutex);
+  pBatch = (sqlite3_kv_batch*)sqlite3MallocZero(sizeof(*pBatch));
+  if( pBatch==0 ){
+    rc = SQLITE_NOMEM_BKPT;
+  }else{
+    pBatch->pKv = p;
+    p->nBatch++;
+  }
+  *ppBatch = pBatch;
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Append an operation to a batch, reserving nByte bytes of aBuf[] for it.
+** Return a pointer to the reserved space, or NULL if out of memory.
+*/
+static u8 *kvBatchAppend(sqlite3_kv_batch *pBatch, i64 nByte){
+  KvBatchOp *pOp;
+  u8 *a;
+  if( pBatch->nOp==pBatch->nOpAlloc ){
+    int nNew = pBatch->nOpAlloc ? pBatch->nOpAlloc*2 : 64;
+    KvBatchOp *aNew = (KvBatchOp*)sqlite3_realloc64(pBatch->aOp,
+                                                   nNew*sizeof(KvBatchOp));
+    if( aNew==0 ) return 0;
+    pBatch->aOp = aNew;
+    pBatch->nOpAlloc = nNew;
+  }
+  /* One byte more, so that aBuf[] is allocated even if the first
+  ** operation is a delete of the empty key */
+  if( kvGrow(&pBatch->aBuf, &pBatch->nBuf, pBatch->nUsed + nByte + 1) ){
+    return 0;
+  }
+  if( pBatch->nUsed + nByte > pBatch->nBuf ) return 0;
+  a = &pBatch->aBuf[pBatch->nUsed];
+  pOp = &pBatch->aOp[pBatch->nOp++];
+  pOp->iRec = pBatch->nUsed;
+  pOp->iKey = pBatch->nUsed;
+  pOp->nRec = 0;
+  pOp->nKey = 0;
+  pBatch->nUsed += nByte;
+  return a;
+}
+
+/*
+** Add a put of key pKey/nKey with value pVal/nVal to a batch.
+*/
+SQLITE_API int sqlite3_kv_batch_put(
+  sqlite3_kv_batch *pBatch,
+  const void *pKey,
+  int nKey,
+  const void *pVal,
+  int nVal
+){
+  KvBatchOp *pOp;
+  u8 *a;
+  int nHdr;
+  i64 nRec;
+  if( nKey<0 || nVal<0 ) return SQLITE_MISUSE_BKPT;
+  nRec = kvRecordSize(pBatch->pKv, nKey, nVal, &nHdr);
+  if( nRec<0 ) return SQLITE_TOOBIG;
+  a = kvBatchAppend(pBatch, nRec);
+  if( a==0 ) return SQLITE_NOMEM_BKPT;
+  kvRecordWrite(a, nHdr, pKey, nKey, pVal, nVal);
+  pOp = &pBatch->aOp[pBatch->nOp-1];
+  pOp->iKey = pOp->iRec + nHdr;
+  pOp->nKey = nKey;
+  pOp->nRec = (int)nRec;
+  return SQLITE_OK;
+}
+
+/*
+** Add a delete of key pKey/nKey to a batch.
+*/
+SQLITE_API int sqlite3_kv_batch_delete(
+  sqlite3_kv_batch *pBatch,
+  const void *pKey,
+  int nKey
+){
+  u8 *a;
+  if( nKey<0 ) return SQLITE_MISUSE_BKPT;
+  a = kvBatchAppend(pBatch, nKey);
+  if( a==0 ) return SQLITE_NOMEM_BKPT;
+  if( nKey>0 ) memcpy(a, pKey, nKey);
+  pBatch->aOp[pBatch->nOp-1].nKey = nKey;
+  return SQLITE_OK;
+}
+
+/*
+** Discard the operations of a batch.
+*/
+SQLITE_API void sqlite3_kv_batch_reset(sqlite3_kv_batch *pBatch){
+  pBatch->nUsed = 0;
+  pBatch->nOp = 0;
+}
+
+/*
+** Return the number of operations in a batch.
+*/
+SQLITE_API int sqlite3_kv_batch_count(sqlite3_kv_batch *pBatch){
+  return pBatch->nOp;
+}
+
+/*
+** Return true if key pKey/nKey sorts after the last entry of the b-tree
+** pCur is open on, or if the b-tree is empty.  A last key that spills
+** onto overflow pages or is prefix-compressed is conservatively taken not
+** to.
+*/
+static int kvIsAppend(
+  sqlite3_kv *p,
+  BtCursor *pCur,
+  const void *pKey, int nKey
+){
+  u32 iKey, iVal, nAvail;
+  int nLast, nVal, res = 0;
+  const u8 *a;
+  if( sqlite3BtreeLast(pCur, &res) ) return 0;
+  if( res ) return 1;
+  if( kvParse(pCur, &iKey, &nLast, &iVal, &nVal) ) return 0;
+  a = (const u8*)sqlite3BtreePayloadFetch(pCur, &nAvail);
+  if( iKey + (u32)nLast > nAvail ) return 0;
+  return kvKeyCompare(p, pKey, nKey, &a[iKey], nLast)>0;
+}
+
+/*
+** Open a statement transaction for a write on store p that may fail
+** midway, as OP_Transaction does, if an explicit transaction is open or
+** other statements are active:  an error then undoes only this write.
+*/
+static int kvStmtBegin(sqlite3_kv *p, Btree *pBt){
+  sqlite3 *db = p->db;
+  if( db->autoCommit==0 || db->nVdbeRead>1 ){
+    db->nStatement++;
+    p->iStatement = db->nSavepoint + db->nStatement;
+    return sqlite3BtreeBeginStmt(pBt, p->iStatement);
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Close the statement transaction opened by kvStmtBegin(), if any,
+** rolling it back first if rc is an error code.  Return the new rc.
+*/
+static int kvStmtEnd(sqlite3_kv *p, Btree *pBt, int rc){
+  if( p->iStatement ){
+    int iSavepoint = p->iStatement-1;
+    int rc2 = SQLITE_OK;
+    if( rc ) rc2 = sqlite3BtreeSavepoint(pBt, SAVEPOINT_ROLLBACK, iSavepoint);
+    if( rc2==SQLITE_OK ){
+      rc2 = sqlite3BtreeSavepoint(pBt, SAVEPOINT_RELEASE, iSavepoint);
+    }
+    p->db->nStatement--;
+    if( rc2 ){
+      rc = rc2;
+      p->iStatement = 0;    /* Statement not rolled back: abandon it all */
+    }
+  }
+  return rc;
+}
+
+/*
+** Apply the operations of a batch to its store, atomically:  in its own
+** transaction in autocommit mode, and otherwise within a statement
+** transaction of the open one, as a single SQL statement would be.  The
+** batch is emptied if it succeeds.
+**
+** The operations are sorted into b-tree order first, the last operation
+** on each key being the one that counts, and then applied in one pass
+** with a cursor hinted BTREE_SEEK_ASC, so that each seek continues from
+** the leaf the previous operation left the cursor on.  A leaf is thus
+** visited once for all the keys that fall on it, and only rebalanced
+** when an insert overflows it.  If the whole batch sorts after the
+** current last key, the cursor is also hinted BTREE_BULKLOAD so that
+** the pages filled by the append are left full, as when an index is
+** built.
+*/
+SQLITE_API int sqlite3_kv_batch_write(sqlite3_kv_batch *pBatch){
+  sqlite3_kv *p = pBatch->pKv;
+  sqlite3 *db = p->db;
+  int nOp = pBatch->nOp;
+  const void **apKey = 0;
+  int *anKey, *aIdx;
+  int nChange = 0;
+  Btree *pBt;
+  int i, rc;
+
+  if( nOp==0 ) return SQLITE_OK;
+  sqlite3_mutex_enter(db->mutex);
+  apKey = (const void**)sqlite3Malloc(nOp*(sizeof(void*) + 3*sizeof(int)));
+  if( apKey==0 ){
+    rc = SQLITE_NOMEM_BKPT;
+    goto batch_write_out;
+  }
+  anKey = (int*)&apKey[nOp];
+  aIdx = &anKey[nOp];
+  for(i=0; i<nOp; i++){
+    apKey[i] = &pBatch->aBuf[pBatch->aOp[i].iKey];
+    anKey[i] = pBatch->aOp[i].nKey;
+    aIdx[i] = i;
+  }
+  rc = kvBegin(p, 1);
+  if( rc ) goto batch_write_out;
+  kvSortKeys(p, apKey, anKey, nOp, aIdx, &aIdx[nOp]);
+
+  pBt = db->aDb[p->iDb].pBt;
+  sqlite3BtreeEnter(pBt);
+  rc = kvStmtBegin(p, pBt);
+  if( rc==SQLITE_OK ) rc = kvCursor(p, 1, p->pCur);
+  if( rc==SQLITE_OK ){
+    int k = aIdx[0];
+    sqlite3BtreeCursorHintFlags(p->pCur,
+        kvIsAppend(p, p->pCur, apKey[k], anKey[k]) ?
+            (BTREE_SEEK_ASC|BTREE_BULKLOAD) : BTREE_SEEK_ASC);
+  }
+  for(i=0; rc==SQLITE_OK && i<nOp; i++){
+    KvBatchOp *pOp;
+    int k = aIdx[i];
+    int res = 0;
+    int bFound;
+    if( i+1<nOp && kvKeyCompare(p, apKey[k], anKey[k],
+                                apKey[aIdx[i+1]], anKey[aIdx[i+1]])==0 ){
+      continue;   /* A later operation on the same key supersedes this */
+    }
+    pOp = &pBatch->aOp[k];
+    rc = kvSeek(p, p->pCur, apKey[k], anKey[k], 0, &res);
+    if( rc ) break;
+    bFound = res==0 && sqlite3BtreeCursorIsValidNN(p->pCur);
+    if( pOp->nRec ){
+      BtreePayload x;
+      memset(&x, 0, sizeof(x));
+      x.pKey = &pBatch->aBuf[pOp->iRec];
+      x.nKey = pOp->nRec;
+      rc = sqlite3BtreeInsert(p->pCur, &x,
+                              bFound ? BTREE_SAVEPOSITION : 0, res);
+      nChange++;
+    }else if( bFound ){
+      rc = sqlite3BtreeDelete(p->pCur, 0);
+      nChange++;
+    }
+  }
+  sqlite3BtreeCloseCursor(p->pCur);
+  rc = kvStmtEnd(p, pBt, rc);
+  sqlite3BtreeLeave(pBt);
+  if( rc==SQLITE_OK ) sqlite3VdbeSetChanges(db, nChange);
+  rc = kvEnd(p, 1, rc);
+  p->iStatement = 0;
+  if( rc==SQLITE_OK ) sqlite3_kv_batch_reset(pBatch);
+
+ batch_write_out:
+  sqlite3_free(apKey);
+  if( rc ) sqlite3Error(db, rc);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Free a batch, discarding any operations it still holds.
+*/
+SQLITE_API int sqlite3_kv_batch_close(sqlite3_kv_batch *pBatch){
+  sqlite3 *db;
+  if( pBatch==0 ) return SQLITE_OK;
+  db = pBatch->pKv->db;
+  sqlite3_mutex_enter(db->mutex);
+  pBatch->pKv->nBatch--;
+  sqlite3_free(pBatch->aOp);
+  sqlite3_free(pBatch->aBuf);
+  sqlite3_free(pBatch);
+  sqlite3_mutex_leave(db->mutex);
+  return SQLITE_OK;
+}
+
+/*
+** State of a bulk load by sqlite3_kv_load().
+*/
+typedef struct KvLoad KvLoad;
+struct KvLoad {
+  sqlite3_kv *pKv;          /* Store being loaded */
+  BtreeLoader *pLoader;     /* Builds its b-tree */
+  u8 *aPrev;                /* Key of the last entry added */
+  int nPrev;                /* Size of that key */
+  int nPrevAlloc;           /* Allocated size of aPrev[] */
+  i64 nRow;                 /* Number of entries added so far */
+  char *zErr;               /* Error message, if any */
+};
+
+/*
+** Locate the key of record a[] of n bytes, written by kvRecordWrite(),
+** and set *pnKey to its size.  Return NULL if the record is malformed.
+*/
+static const u8 *kvRecordKey(const u8 *a, int n, int *pnKey){
+  u32 nHdr, t;
+  int i;
+  if( n<3 ) return 0;
+  i = getVarint32(a, nHdr);
+  getVarint32(&a[i], t);
+  if( t<12 || nHdr>(u32)n || (t-12)/2 > (u32)n-nHdr ) return 0;
+  *pnKey = (int)((t-12)/2);
+  return &a[nHdr];
+}
+
+/*
+** Add record aRec/nRec to a bulk load.  Its key must sort after that of
+** the previous record.
+*/
+static int kvLoadAdd(KvLoad *pLoad, const u8 *aRec, int nRec){
+  sqlite3_kv *p = pLoad->pKv;
+  const u8 *pKey;
+  int nKey = 0;
+  int rc;
+
+  pKey = kvRecordKey(aRec, nRec, &nKey);
+  if( pKey==0 ) return SQLITE_CORRUPT_BKPT;
+  if( pLoad->nRow>0 ){
+    int c = kvKeyCompare(p, pKey, nKey, pLoad->aPrev, pLoad->nPrev);
+    if( c<0 ){
+      pLoad->zErr = sqlite3MPrintf(p->db, "keys out of order in load of "
+                                   "table %s", p->zTable);
+      return SQLITE_ERROR;
+    }
+    if( c==0 ){
+      pLoad->zErr = sqlite3MPrintf(p->db, "duplicate key in load of "
+                                   "table %s", p->zTable);
+      return SQLITE_CONSTRAINT_PRIMARYKEY;
+    }
+  }
+  rc = sqlite3BtreeLoaderAdd(pLoad->pLoader, aRec, nRec);
+  if( rc==SQLITE_OK ) rc = kvGrow(&pLoad->aPrev, &pLoad->nPrevAlloc, nKey);
+  if( rc==SQLITE_OK ){
+    if( nKey>0 ) memcpy(pLoad->aPrev, pKey, nKey);
+    pLoad->nPrev = nKey;
+    pLoad->nRow++;
+  }
+  return rc;
+}
+
+/*
+** Fill an empty store with the entries returned by xNext, building its
+** b-tree bottom-up with each page filled to nFill percent, or completely
+** if nFill is 0.  The entries must come in key order unless
+** SQLITE_KV_LOAD_UNSORTED is set, in which case they are put in order
+** by the external merge sorter of CREATE INDEX first.  As for a batch,
+** the load is atomic.
+*/
+SQLITE_API int sqlite3_kv_load(
+  sqlite3_kv *p,
+  int nFill,
+  int flags,
+  int (*xNext)(void*, const void**, int*, const void**, int*),
+  void *pCtx
+){
+  sqlite3 *db = p->db;
+  VdbeCursor *pSort = 0;
+  KvLoad load;
+  Btree *pBt;
+  int bEmpty = 0;
+  int rc;
+
+  if( nFill<0 || nFill>100 || xNext==0 ) return SQLITE_MISUSE_BKPT;
+  if( nFill==0 ) nFill = 100;
+  memset(&load, 0, sizeof(load));
+  load.pKv = p;
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvBegin(p, 1);
+  if( rc ) goto load_out;
+
+  pBt = db->aDb[p->iDb].pBt;
+  sqlite3BtreeEnter(pBt);
+  rc = kvStmtBegin(p, pBt);
+  if( rc==SQLITE_OK ) rc = kvCursor(p, 0, p->pCur);
+  if( rc==SQLITE_OK ) rc = sqlite3BtreeIsEmpty(p->pCur, &bEmpty);
+  sqlite3BtreeCloseCursor(p->pCur);
+  if( rc==SQLITE_OK && !bEmpty ){
+    load.zErr = sqlite3MPrintf(db, "table %s is not empty", p->zTable);
+    rc = SQLITE_ERROR;
+  }
+  if( rc==SQLITE_OK ){
+    rc = sqlite3BtreeLoaderOpen(pBt, p->pgnoRoot, nFill, &load.pLoader);
+  }
+  if( rc==SQLITE_OK && (flags & SQLITE_KV_LOAD_UNSORTED) ){
+    pSort = (VdbeCursor*)sqlite3DbMallocZero(db, sizeof(VdbeCursor));
+    if( pSort==0 ){
+      rc = SQLITE_NOMEM_BKPT;
+    }else{
+      pSort->eCurType = CURTYPE_SORTER;
+      pSort->pKeyInfo = p->pKeyInfo;
+      rc = sqlite3VdbeSorterInit(db, 0, pSort);
+    }
+  }
+
+  /* Read the entries, and either add them directly or feed the sorter */
+  while( rc==SQLITE_OK ){
+    const void *pKey = 0, *pVal = 0;
+    int nKey = 0, nVal = 0;
+    i64 nRec = 0;
+    rc = xNext(pCtx, &pKey, &nKey, &pVal, &nVal);
+    if( rc!=SQLITE_ROW ){
+      if( rc==SQLITE_DONE ) rc = SQLITE_OK;
+      break;
+    }
+    if( nKey<0 || nVal<0 ){
+      rc = SQLITE_MISUSE_BKPT;
+      break;
+    }
+    rc = kvRecord(p, pKey, nKey, pVal, nVal, &nRec);
+    if( rc==SQLITE_OK ){
+      if( pSort ){
+        Mem mem;
+        memset(&mem, 0, sizeof(mem));
+        mem.flags = MEM_Blob;
+        mem.z = (char*)p->aBuf;
+        mem.n = (int)nRec;
+        rc = sqlite3VdbeSorterWrite(pSort, &mem);
+      }else{
+        rc = kvLoadAdd(&load, p->aBuf, (int)nRec);
+      }
+    }
+  }
+
+  /* Drain the sorter in key order */
+  if( rc==SQLITE_OK && pSort ){
+    Mem out;
+    int bEof = 0;
+    sqlite3VdbeMemInit(&out, db, MEM_Null);
+    rc = sqlite3VdbeSorterRewind(pSort, &bEof);
+    while( rc==SQLITE_OK && !bEof ){
+      rc = sqlite3VdbeSorterRowkey(pSort, &out);
+      if( rc==SQLITE_OK ) rc = kvLoadAdd(&load, (const u8*)out.z, out.n);
+      if( rc==SQLITE_OK ){
+        rc = sqlite3VdbeSorterNext(db, pSort);
+        if( rc==SQLITE_DONE ){
+          rc = SQLITE_OK;
+          bEof = 1;
+        }
+      }
+    }
+    sqlite3VdbeMemRelease(&out);
+  }
+  if( pSort ){
+    sqlite3VdbeSorterClose(db, pSort);
+    sqlite3DbFree(db, pSort);
+  }
+
+  if( rc==SQLITE_OK ) rc = sqlite3BtreeLoaderFinish(load.pLoader);
+  sqlite3BtreeLoaderFree(load.pLoader);
+  rc = kvStmtEnd(p, pBt, rc);
+  sqlite3BtreeLeave(pBt);
+  if( rc==SQLITE_OK ) sqlite3VdbeSetChanges(db, load.nRow);
+  rc = kvEnd(p, 1, rc);
+  p->iStatement = 0;
+
+ load_out:
+  sqlite3_free(load.aPrev);
+  if( rc ) sqlite3ErrorWithMsg(db, rc, load.zErr ? "%s" : 0, load.zErr);
+  sqlite3DbFree(db, load.zErr);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Set the split policy and leaf fill factor that rebalancing after
+** writes through store p uses from now on.
+*/
+SQLITE_API int sqlite3_kv_split(sqlite3_kv *p, int eSplit, int nFill){
+  assert( SQLITE_KV_SPLIT_DEFAULT==BTREE_SPLIT_DEFAULT );
+  assert( SQLITE_KV_SPLIT_EVEN==BTREE_SPLIT_EVEN );
+  assert( SQLITE_KV_SPLIT_LEFT==BTREE_SPLIT_LEFT );
+  assert( SQLITE_KV_SPLIT_RIGHT==BTREE_SPLIT_RIGHT );
+  assert( SQLITE_KV_SPLIT_ADAPTIVE==BTREE_SPLIT_ADAPTIVE );
+  if( eSplit<SQLITE_KV_SPLIT_DEFAULT || eSplit>SQLITE_KV_SPLIT_ADAPTIVE
+   || (nFill!=0 && (nFill<50 || nFill>100))
+  ){
+    return SQLITE_MISUSE_BKPT;
+  }
+  sqlite3_mutex_enter(p->db->mutex);
+  p->eSplit = (u8)eSplit;
+  p->nFill = (u8)(nFill==100 ? 0 : nFill);
+  sqlite3_mutex_leave(p->db->mutex);
+  return SQLITE_OK;
+}
+
+/*
+** A value pinned in place by sqlite3_kv_pin().
+*/
+struct sqlite3_kv_pinned {
+  sqlite3_kv *pKv;          /* The store the value was read from */
+  Btree *pBt;               /* Its b-tree, whose pages are referenced */
+  BtreeSpan *aSpan;         /* Extents of the value, in order */
+  int nSpan;                /* Number of entries in aSpan[] */
+  int nVal;                 /* Total size of the value */
+};
+
+/*
+** Look up key pKey/nKey and pin its value in place.  The pin holds a read
+** transaction, like an open iterator, until released.
+*/
+SQLITE_API int sqlite3_kv_pin(
+  sqlite3_kv *p,
+  const void *pKey,
+  int nKey,
+  sqlite3_kv_pinned **ppPin
+){
+  sqlite3 *db = p->db;
+  sqlite3_kv_pinned *pPin;
+  int rc, res = 0;
+
+  *ppPin = 0;
+  if( nKey<0 ) return SQLITE_MISUSE_BKPT;
+  sqlite3_mutex_enter(db->mutex);
+  pPin = (sqlite3_kv_pinned*)sqlite3MallocZero(sizeof(*pPin));
+  if( pPin==0 ){
+    rc = SQLITE_NOMEM_BKPT;
+    goto pin_out;
+  }
+  rc = kvBegin(p, 0);
+  if( rc ) goto pin_out;
+  pPin->pKv = p;
+  pPin->pBt = db->aDb[p->iDb].pBt;
+  sqlite3BtreeEnter(pPin->pBt);
+  rc = kvCursor(p, 0, p->pCur);
+  if( rc==SQLITE_OK ) rc = kvSeek(p, p->pCur, pKey, nKey, 0, &res);
+  if( rc==SQLITE_OK ){
+    if( res==0 && sqlite3BtreeCursorIsValidNN(p->pCur) ){
+      u32 iKey, iVal;
+      int nFound;
+      rc = kvParse(p->pCur, &iKey, &nFound, &iVal, &pPin->nVal);
+      if( rc==SQLITE_OK ){
+        rc = sqlite3BtreePayloadPin(p->pCur, iVal, (u32)pPin->nVal,
+                                    &pPin->aSpan, &pPin->nSpan);
+      }
+    }else{
+      rc = SQLITE_NOTFOUND;
+    }
+  }
+  sqlite3BtreeCloseCursor(p->pCur);
+  sqlite3BtreeLeave(pPin->pBt);
+  if( rc ){
+    kvEnd(p, 0, rc==SQLITE_NOTFOUND ? SQLITE_OK : rc);
+  }else{
+    p->nPin++;
+    db->nKvIter++;
+    *ppPin = pPin;
+  }
+
+ pin_out:
+  if( rc ){
+    sqlite3_free(pPin);
+    if( rc!=SQLITE_NOTFOUND ) sqlite3Error(db, rc);
+  }
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** The size of a pinned value, and the number of extents it is made of.
+*/
+SQLITE_API int sqlite3_kv_pinned_size(sqlite3_kv_pinned *pPin){
+  return pPin->nVal;
+}
+SQLITE_API int sqlite3_kv_pinned_count(sqlite3_kv_pinned *pPin){
+  return pPin->nSpan;
+}
+
+/*
+** Extent iSpan of a pinned value.  Set *pn to its size and return a
+** pointer to it, or NULL if iSpan is out of range.
+*/
+SQLITE_API const void *sqlite3_kv_pinned_extent(
+  sqlite3_kv_pinned *pPin,
+  int iSpan,
+  int *pn
+){
+  if( iSpan<0 || iSpan>=pPin->nSpan ){
+    *pn = 0;
+    return 0;
+  }
+  *pn = (int)pPin->aSpan[iSpan].n;
+  return pPin->aSpan[iSpan].z;
+}
+
+/*
+** Release a pinned value and end its read transaction.
+*/
+SQLITE_API int sqlite3_kv_unpin(sqlite3_kv_pinned *pPin){
+  sqlite3_kv *p;
+  sqlite3 *db;
+  int rc;
+  if( pPin==0 ) return SQLITE_OK;
+  p = pPin->pKv;
+  db = p->db;
+  sqlite3_mutex_enter(db->mutex);
+  sqlite3BtreeEnter(pPin->pBt);
+  sqlite3BtreePayloadUnpin(pPin->aSpan, pPin->nSpan);
+  sqlite3BtreeLeave(pPin->pBt);
+  rc = kvEnd(p, 0, SQLITE_OK);
+  p->nPin--;
+  db->nKvIter--;
+  sqlite3_free(pPin);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Open an iterator over the entries of store p with keys from pStart/nStart
+** up to but excluding pEnd/nEnd.  A NULL pStart starts from the first key
+** and a NULL pEnd runs to the last.  The iterator holds a read
+** transaction until closed.
+*/
+static int kvIterOpen(
+  sqlite3_kv *p,
+  const void *pStart, int nStart,
+  const void *pEnd, int nEnd,
+  sqlite3_kv_iter **ppIter
+){
+  sqlite3 *db = p->db;
+  sqlite3_kv_iter *pIter;
+  int rc;
+
+  *ppIter = 0;
+  if( (pStart && nStart<0) || (pEnd && nEnd<0) ) return SQLITE_MISUSE_BKPT;
+  sqlite3_mutex_enter(db->mutex);
+  pIter = (sqlite3_kv_iter*)sqlite3MallocZero(
+      ROUND8(sizeof(*pIter)) + sqlite3BtreeCursorSize()
+      + (pStart ? nStart : 0) + (pEnd ? nEnd : 0)
+  );
+  if( pIter==0 ){
+    rc = SQLITE_NOMEM_BKPT;
+  }else{
+    u8 *aKeys;
+    pIter->pKv = p;
+    pIter->pCur = (BtCursor*)&((u8*)pIter)[ROUND8(sizeof(*pIter))];
+    aKeys = &((u8*)pIter->pCur)[sqlite3BtreeCursorSize()];
+    if( pStart ){
+      pIter->aStart = aKeys;
+      pIter->nStart = nStart;
+      if( nStart>0 ) memcpy(pIter->aStart, pStart, nStart);
+      aKeys += nStart;
+    }
+    if( pEnd ){
+      pIter->aEnd = aKeys;
+      pIter->nEnd = nEnd;
+      if( nEnd>0 ) memcpy(pIter->aEnd, pEnd, nEnd);
+    }
+    rc = kvBegin(p, 0);
+    if( rc==SQLITE_OK ){
+      Btree *pBt = db->aDb[p->iDb].pBt;
+      sqlite3BtreeEnter(pBt);
+      rc = kvCursor(p, 0, pIter->pCur);
+      sqlite3BtreeLeave(pBt);
+      if( rc ) kvEnd(p, 0, rc);
+    }
+    if( rc ){
+      sqlite3_free(pIter);
+    }else{
+      p->nIter++;
+      db->nKvIter++;
+      *ppIter = pIter;
+    }
+  }
+  if( rc ) sqlite3Error(db, rc);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Open an iterator over the entries of store p, starting from the first
+** key greater than or equal to pStart/nStart, or from the first key if
+** pStart is NULL.
+*/
+SQLITE_API int sqlite3_kv_iter_open(
+  sqlite3_kv *p,
+  const void *pStart,
+  int nStart,
+  sqlite3_kv_iter **ppIter
+){
+  return kvIterOpen(p, pStart, nStart, 0, 0, ppIter);
+}
+
+/*
+** Advance iterator pIter to its first or next entry.  Return SQLITE_ROW
+** if it is positioned on an entry, or SQLITE_DONE if there are no more.
+*/
+SQLITE_API int sqlite3_kv_iter_next(sqlite3_kv_iter *pIter){
+  sqlite3_kv *p = pIter->pKv;
+  sqlite3 *db = p->db;
+  BtCursor *pCur = pIter->pCur;
+  int rc = SQLITE_OK;
+  int res = 0;
+
+  if( pIter->eState==KV_ITER_EOF ) return SQLITE_DONE;
+  sqlite3_mutex_enter(db->mutex);
+  sqlite3BtreeEnter(pCur->pBtree);
+  if( pIter->eState==KV_ITER_INIT ){
+    if( pIter->aStart ){
+      rc = kvSeek(p, pCur, pIter->aStart, pIter->nStart, +1, &res);
+      if( rc==SQLITE_OK && res<0 ) rc = sqlite3BtreeNext(pCur, 0);
+      if( rc==SQLITE_OK && !sqlite3BtreeCursorIsValidNN(pCur) ){
+        rc = SQLITE_DONE;
+      }
+    }else{
+      rc = sqlite3BtreeFirst(pCur, &res);
+      if( rc==SQLITE_OK && res ) rc = SQLITE_DONE;
+    }
+  }else{
+    rc = sqlite3BtreeNext(pCur, 0);
+  }
+  if( rc==SQLITE_OK ){
+    u32 iKey, iVal, nAvail;
+    const u8 *a;
+    rc = kvParse(pCur, &iKey, &pIter->nKey, &iVal, &pIter->nVal);
+    if( rc==SQLITE_OK ){
+      a = (const u8*)sqlite3BtreePayloadFetch(pCur, &nAvail);
+      if( iVal + (u32)pIter->nVal > nAvail ){
+        /* Part of the entry is on overflow pages, or shared with the
+        ** prefix of a compressed leaf.  Assemble a copy. */
+        rc = kvGrow(&pIter->aBuf, &pIter->nBuf, (i64)iVal + pIter->nVal);
+        if( rc==SQLITE_OK ){
+          rc = sqlite3BtreePayload(pCur, 0, iVal + (u32)pIter->nVal,
+                                   pIter->aBuf);
+        }
+        a = pIter->aBuf;
+      }
+      pIter->pKey = &a[iKey];
+      pIter->pVal = &a[iVal];
+      if( pIter->aEnd
+       && kvKeyCompare(p, pIter->pKey, pIter->nKey, pIter->aEnd, pIter->nEnd)>=0
+      ){
+        rc = SQLITE_DONE;
+      }
+    }
+  }
+  if( rc==SQLITE_OK ){
+    pIter->eState = KV_ITER_ROW;
+    rc = SQLITE_ROW;
+  }else{
+    pIter->eState = KV_ITER_EOF;
+    pIter->pKey = pIter->pVal = 0;
+    pIter->nKey = pIter->nVal = 0;
+    if( rc!=SQLITE_DONE ) sqlite3Error(db, rc);
+  }
+  sqlite3BtreeLeave(pCur->pBtree);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** The key and value of the entry an iterator is positioned on.  They
+** remain valid until the iterator is stepped or closed, or the database
+** is modified.
+*/
+SQLITE_API const void *sqlite3_kv_iter_key(sqlite3_kv_iter *pIter, int *pnKey){
+  *pnKey = pIter->nKey;
+  return pIter->pKey;
+}
+SQLITE_API const void *sqlite3_kv_iter_value(
+  sqlite3_kv_iter *pIter,
+  int *pnVal
+){
+  *pnVal = pIter->nVal;
+  return pIter->pVal;
+}
+
+/*
+** Close an iterator and end its read transaction.
+*/
+SQLITE_API int sqlite3_kv_iter_close(sqlite3_kv_iter *pIter){
+  sqlite3_kv *p;
+  sqlite3 *db;
+  Btree *pBt;
+  int rc;
+  if( pIter==0 ) return SQLITE_OK;
+  p = pIter->pKv;
+  db = p->db;
+  sqlite3_mutex_enter(db->mutex);
+  pBt = pIter->pCur->pBtree;
+  sqlite3BtreeEnter(pBt);
+  sqlite3BtreeCloseCursor(pIter->pCur);
+  sqlite3BtreeLeave(pBt);
+  rc = kvEnd(p, 0, SQLITE_OK);
+  p->nIter--;
+  db->nKvIter--;
+  sqlite3_free(pIter->aBuf);
+  sqlite3_free(pIter);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** A point-in-time view of a store.  It is a read transaction, held open
+** on a private read-only connection to the same database file so that
+** neither the connection of the store nor its writers are held up.  In
+** WAL mode, readers and writers do not block each other, and the read
+** mark of the transaction keeps the pages it sees in place.
+*/
+struct sqlite3_kv_snapshot {
+  sqlite3 *db;              /* Private connection holding the transaction */
+  sqlite3_kv *pKv;          /* Store opened on the table through it */
+};
+
+/*
+** Take a snapshot of store p, as last committed.  The database must be
+** a file in WAL mode, as in any other journal mode the read transaction
+** of the snapshot would keep writers from committing.
+*/
+SQLITE_API int sqlite3_kv_snapshot_open(
+  sqlite3_kv *p,
+  sqlite3_kv_snapshot **ppSnap
+){
+  sqlite3 *db = p->db;
+  sqlite3_kv_snapshot *pSnap = 0;
+  const char *zFile = 0;
+  const char *zVfs = 0;
+  int busyTimeout = 0;
+  int bHold = 0;
+  int rc;
+
+  *ppSnap = 0;
+  sqlite3_mutex_enter(db->mutex);
+  rc = kvBegin(p, 0);
+  if( rc==SQLITE_OK ){
+    Btree *pBt = db->aDb[p->iDb].pBt;
+    if( sqlite3PagerGetJournalMode(sqlite3BtreePager(pBt))
+                                                  ==PAGER_JOURNALMODE_WAL ){
+      zFile = sqlite3BtreeGetFilename(pBt);
+    }
+    zVfs = db->pVfs->zName;
+    busyTimeout = db->busyTimeout;
+    rc = kvEnd(p, 0, SQLITE_OK);
+  }
+  if( rc==SQLITE_OK && (zFile==0 || zFile[0]==0) ){
+    rc = SQLITE_ERROR;
+    sqlite3ErrorWithMsg(db, rc, "key-value snapshots require a database "
+                        "file in WAL mode");
+  }
+  if( rc==SQLITE_OK ){
+    pSnap = (sqlite3_kv_snapshot*)sqlite3MallocZero(sizeof(*pSnap));
+    if( pSnap==0 ) rc = SQLITE_NOMEM_BKPT;
+  }
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_open_v2(zFile, &pSnap->db, SQLITE_OPEN_READONLY, zVfs);
+    if( rc==SQLITE_OK ){
+      sqlite3_busy_timeout(pSnap->db, busyTimeout);
+      rc = sqlite3_kv_open(pSnap->db, "main", p->zTable, 0, &pSnap->pKv);
+    }
+    if( rc==SQLITE_OK ){
+      sqlite3_mutex_enter(pSnap->db->mutex);
+      rc = kvBegin(pSnap->pKv, 0);
+      bHold = rc==SQLITE_OK;
+      sqlite3_mutex_leave(pSnap->db->mutex);
+    }
+    if( rc!=SQLITE_OK ){
+      sqlite3ErrorWithMsg(db, rc, "%s", sqlite3_errmsg(pSnap->db));
+    }
+  }
+  if( rc==SQLITE_OK ){
+    *ppSnap = pSnap;
+  }else if( pSnap ){
+    if( bHold ) kvEnd(pSnap->pKv, 0, SQLITE_OK);
+    sqlite3_kv_close(pSnap->pKv);
+    sqlite3_close(pSnap->db);
+    sqlite3_free(pSnap);
+  }
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Open an iterator over the entries of a snapshot with keys from
+** pStart/nStart up to but excluding pEnd/nEnd.  It is closed with
+** sqlite3_kv_iter_close() like any other.
+*/
+SQLITE_API int sqlite3_kv_snapshot_iter(
+  sqlite3_kv_snapshot *pSnap,
+  const void *pStart, int nStart,
+  const void *pEnd, int nEnd,
+  sqlite3_kv_iter **ppIter
+){
+  return kvIterOpen(pSnap->pKv, pStart, nStart, pEnd, nEnd, ppIter);
+}
+
+/*
+** Return the number of WAL frames the snapshot keeps checkpoints from
+** copying back into the database file.
+*/
+SQLITE_API int sqlite3_kv_snapshot_frames(sqlite3_kv_snapshot *pSnap){
+  sqlite3_kv *p = pSnap->pKv;
+  u32 nFrame = 0;
+#ifndef SQLITE_OMIT_WAL
+  Btree *pBt;
+  sqlite3_mutex_enter(pSnap->db->mutex);
+  pBt = pSnap->db->aDb[p->iDb].pBt;
+  sqlite3BtreeEnter(pBt);
+  nFrame = sqlite3PagerWalPinnedFrames(sqlite3BtreePager(pBt));
+  sqlite3BtreeLeave(pBt);
+  sqlite3_mutex_leave(pSnap->db->mutex);
+#endif
+  return nFrame>0x7fffffff ? 0x7fffffff : (int)nFrame;
+}
+
+/*
+** Release a snapshot.  Its iterators must be closed first.
+*/
+SQLITE_API int sqlite3_kv_snapshot_close(sqlite3_kv_snapshot *pSnap){
+  sqlite3 *db;
+  if( pSnap==0 ) return SQLITE_OK;
+  db = pSnap->db;
+  sqlite3_mutex_enter(db->mutex);
+  if( pSnap->pKv->nIter ){
+    sqlite3ErrorWithMsg(db, SQLITE_BUSY, "unable to close key-value "
+                        "snapshot with open iterators");
+    sqlite3_mutex_leave(db->mutex);
+    return SQLITE_BUSY;
+  }
+  kvEnd(pSnap->pKv, 0, SQLITE_OK);
+  sqlite3_mutex_leave(db->mutex);
+  sqlite3_kv_close(pSnap->pKv);
+  sqlite3_close(db);
+  sqlite3_free(pSnap);
+  return SQLITE_OK;
+}
+
+#endif /* SQLITE_OMIT_KV */
+/************** End of kv.c **************************************************/
 /************** Begin file notify.c ******************************************/
 /*
 ** 2009 March 3
@@ -229339,6 +233628,12 @@ static int statDecodePage(Btree *pBt, StatPage *p){
   if( p->flags==0x0A || p->flags==0x0D ){
     isLeaf = 1;
     nHdr = 8;
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+  }else if( p->flags==0x1A ){
+    /* Prefix-compressed index leaf.  The prefix counts as header. */
+    isLeaf = 1;
+    nHdr = 9 + aHdr[8];
+#endif
   }else if( p->flags==0x05 || p->flags==0x02 ){
     isLeaf = 0;
     nHdr = 12;
@@ -229389,15 +233684,24 @@ static int statDecodePage(Btree *pBt, StatPage *p){
       }else{
         u32 nPayload;             /* Bytes of payload total (local+overflow) */
         int nLocal;               /* Bytes of payload stored locally */
+        int nShared = 0;          /* Bytes of payload in the page prefix */
         iOff += getVarint32(&aData[iOff], nPayload);
         if( p->flags==0x0D ){
           u64 dummy;
           iOff += sqlite3GetVarint(&aData[iOff], &dummy);
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+        }else if( p->flags==0x1A ){
+          nShared = aData[iOff++];
+#endif
         }
         if( nPayload>(u32)p->nMxPayload ) p->nMxPayload = nPayload;
         nLocal = getLocalPayload(nUsable, p->flags, nPayload);
         if( nLocal<0 ) goto statPageIsCorrupt;
         pCell->nLocal = nLocal;
+        if( nShared && (u32)nLocal==nPayload ){
+          if( nShared>=nPayload ) goto statPageIsCorrupt;
+          pCell->nLocal -= nShared;
+        }
         assert( nPayload>=(u32)nLocal );
         assert( nLocal<=(nUsable-35) );
         if( nPayload>(u32)nLocal ){
@@ -229626,6 +233930,9 @@ statNextRestart:
           break;
         case 0x0D:             /* table leaf */
         case 0x0A:             /* index leaf */
+#ifdef SQLITE_ENABLE_PREFIX_LEAF
+        case 0x1A:             /* prefix-compressed index leaf */
+#endif
           pCsr->zPagetype = "leaf";
           break;
         default:
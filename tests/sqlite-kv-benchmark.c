@@ -2,26 +2,142 @@
 ** SQLite Performance Benchmark
 **
 ** Tests: Sequential writes, random reads, sequential scan,
-**        random updates, random deletes, bulk operations
+**        random updates, random deletes, bulk operations,
+**        value sizes across the overflow-page threshold,
+**        reads after a restart with cold and warm caches,
+**        bounded range and prefix scans,
+**        checkpoint stalls and WAL growth under sustained writes,
+**        commit cost and syncs per commit across durability settings,
+**        fragmentation and space amplification under churn,
+**        the native sqlite3_kv_* API against the same operations in SQL
+**
+** Usage: sqlite_benchmark [--config FILE] [--name value ...]
+**
+** Every run parameter (record count, key/value sizes, batch size, the
+** PRAGMAs applied to each connection, which benchmarks run, ...) can be
+** given on the command line or in a config file of "name = value" lines;
+** run with --help for the list.  Parameters marked as lists accept
+** comma-separated values, e.g. "--page-size 4096,8192 --journal-mode
+** WAL,DELETE", and the suite runs once per point of their cross product
+** followed by a per-benchmark comparison of all points.
+**
+** With --readers/--writers the database is populated once and then
+** N reader and M writer threads, each with its own connection, run
+** against it concurrently for --duration seconds.
+**
+** With --ycsb the database is populated once and the listed YCSB core
+** workloads run against it.  --dist selects the key distribution used
+** by every benchmark (uniform, zipfian, scrambled, latest, hotspot).
+**
+** --json FILE / --csv FILE write one record per benchmark result with
+** throughput, latency percentiles, the run parameters, the SQLite
+** version and compile options and host information.  --repeat N runs
+** everything N times, and --compare BASE,NEW diffs two such files,
+** flagging changes larger than the run-to-run noise.
+**
+** --perf 1 (Linux) adds hardware and software counters per operation to
+** every result: cycles, instructions, IPC, L1d and LLC misses, branch
+** misses, context switches and page faults.
+**
+** All file I/O goes through a counting VFS layered over the default
+** one; every result is followed by its reads, writes and syncs per
+** operation and the read/write amplification against the key/value
+** bytes the benchmark moved (--io-stats 0 turns this off).
+**
+** The compile options recorded with each result tell builds apart, so
+** building once plainly and once with "make PREFIX_SEARCH=1" and running
+** "--bench kv --json FILE" against each gives two files that --compare
+** diffs for the speedup of the index b-tree search accelerator.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <math.h>
 #include <time.h>
+#include <sys/stat.h>
 #ifdef _WIN32
 #  include <windows.h>
 #else
 #  include <sys/time.h>
+#  include <sys/utsname.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <pthread.h>
+#endif
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/syscall.h>
 #endif
 #include <sqlite3.h>
 
 #define DB_FILE "benchmark_sql.db"
+#define VALUES_DB_FILE "benchmark_values.db"
+#define DURABILITY_DB_FILE "benchmark_durability.db"
+#define CHURN_DB_FILE "benchmark_churn.db"
+
+/* Defaults for the run parameters (see params[] below) */
 #define NUM_RECORDS 1000000
 #define BATCH_SIZE 1000
 #define NUM_READS 50000
 #define NUM_UPDATES 10000
 #define NUM_DELETES 5000
+#define NUM_MIXED_OPS 20000
+#define YCSB_OPERATIONS 100000
+#define NUM_SCANS 2000
+#define SCAN_LENGTHS "10,100,1000"
+#define VALUE_SIZES "100,500,1000,1500,4K,16K,64K,256K,1M"
+#define JOURNAL_MODES "DELETE,TRUNCATE,PERSIST,WAL,MEMORY,OFF"
+#define SYNC_MODES "OFF,NORMAL,FULL,EXTRA"
+#define BATCH_SIZES "1,10,100,1000"
+#define DURABILITY_ROWS 2000
+#define CHURN_ROWS 50000
+#define CHURN_CYCLES 20
+#define CHURN_RATE 0.1
+#define CHURN_SAMPLE 2
+#define MULTIGET_SIZE 100
+#define LOAD_FILL 100
+#define COUNTER_KEYS 1000
+
+#define STRINGIFY(x) #x
+#define XSTRINGIFY(x) STRINGIFY(x)
+
+#define MAX_KEY_SIZE 1024
+#define VALUE_FORMAT_MAX 128
+#define MAX_SWEEP_VALUES 16
+#define MAX_PARAM_VALUE 64
+#define MAX_VALUE_SIZES 16
+#define MAX_SCAN_LENGTHS 16
+#define MAX_MODES 8
+#define MAX_BATCH_SIZES 16
+
+/* Value data written, and read back, per size by the value-size benchmark */
+#define VALUE_SUITE_BYTES (32LL << 20)
+#define VALUE_SUITE_MIN_OPS 100
+
+#define MT_MAX_THREADS 64
+#define MT_DEFAULT_DURATION 10.0
+#define MT_WRITE_BATCH 100
+#define MT_BUSY_RETRIES 100
+
+#define CKPT_DEFAULT_SUSTAIN 10.0
+#define CKPT_SAMPLE_MS 250
+#define CKPT_READER_HOLD_MS 20
+
+/* Transactions per cell of the durability matrix, at most */
+#define DURABILITY_MAX_COMMITS 200
+
+#define YCSB_MAX_SCAN 100
+#define ZIPF_DEFAULT_THETA 0.99
+#define HOTSPOT_DEFAULT_SET 0.2
+#define HOTSPOT_DEFAULT_OPS 0.8
+
+/* Latency histogram: 2^HIST_SUB_BITS linear sub-buckets per power of two */
+#define HIST_SUB_BITS 5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
 
 #define COLOR_BLUE "\x1b[34m"
 #define COLOR_GREEN "\x1b[32m"
@@ -43,6 +159,126 @@ static double get_time(void) {
 #endif
 }
 
+/* Monotonic nanosecond clock for per-operation latencies */
+static uint64_t get_time_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/*
+** HDR-style log-bucketed latency histogram.  Values below HIST_SUB_COUNT
+** nanoseconds get a bucket each; above that every power of two is split
+** into HIST_SUB_COUNT linear sub-buckets, so any recorded value is
+** reported to within ~3% regardless of magnitude.
+*/
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+} latency_hist;
+
+static void hist_reset(latency_hist *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static int hist_msb(uint64_t v) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(v);
+#else
+    int e = 0;
+    while (v >>= 1) e++;
+    return e;
+#endif
+}
+
+static int hist_index(uint64_t v) {
+    int e;
+    if (v < HIST_SUB_COUNT) return (int)v;
+    e = hist_msb(v);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB_COUNT
+         + (int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+/* Highest value that maps to bucket idx */
+static uint64_t hist_bucket_upper(int idx) {
+    int group = idx / HIST_SUB_COUNT;
+    int shift;
+    if (group == 0) return (uint64_t)idx;
+    shift = group - 1;
+    return (((uint64_t)(HIST_SUB_COUNT + idx % HIST_SUB_COUNT)) << shift)
+         + ((uint64_t)1 << shift) - 1;
+}
+
+static void hist_record(latency_hist *h, uint64_t ns) {
+    h->counts[hist_index(ns)]++;
+    h->count++;
+    if (ns < h->min) h->min = ns;
+    if (ns > h->max) h->max = ns;
+}
+
+static void hist_merge(latency_hist *dst, const latency_hist *src) {
+    int i;
+    for (i = 0; i < HIST_BUCKETS; i++) dst->counts[i] += src->counts[i];
+    dst->count += src->count;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static uint64_t hist_percentile(const latency_hist *h, double pct) {
+    uint64_t target, seen = 0;
+    int i;
+    if (h->count == 0) return 0;
+    target = (uint64_t)(pct / 100.0 * (double)h->count + 0.5);
+    if (target < 1) target = 1;
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= target) {
+            uint64_t v = hist_bucket_upper(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+static void format_latency(uint64_t ns, char *buf, size_t size) {
+    if (ns < 1000) {
+        snprintf(buf, size, "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, size, "%.1fus", ns / 1e3);
+    } else if (ns < 1000000000) {
+        snprintf(buf, size, "%.2fms", ns / 1e6);
+    } else {
+        snprintf(buf, size, "%.2fs", ns / 1e9);
+    }
+}
+
+static void print_latency(const char *label, const latency_hist *h) {
+    static const double pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+    static const char *names[] = { "p50", "p90", "p99", "p99.9" };
+    char buf[32];
+    int i;
+
+    if (h->count == 0) return;
+    printf("  %-30s  ", label);
+    for (i = 0; i < 4; i++) {
+        format_latency(hist_percentile(h, pcts[i]), buf, sizeof(buf));
+        printf("%s %s  ", names[i], buf);
+    }
+    format_latency(h->max, buf, sizeof(buf));
+    printf("max %s\n", buf);
+}
+
 /* Format numbers with commas */
 static void format_number(long long num, char *buf, size_t size) {
     if (num >= 1000000) {
@@ -55,7 +291,673 @@ static void format_number(long long num, char *buf, size_t size) {
     }
 }
 
-static void print_result(const char *test, double elapsed, int ops) {
+/* ==================== Hardware Counters ==================== */
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_CTX_SWITCHES,
+    PERF_PAGE_FAULTS,
+    PERF_NUM_COUNTERS
+};
+
+static const char *perf_names[PERF_NUM_COUNTERS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses",
+    "context_switches", "page_faults"
+};
+static const char *perf_short_names[PERF_NUM_COUNTERS] = {
+    "cycles", "instr", "L1d-miss", "LLC-miss", "br-miss", "ctx-sw", "faults"
+};
+
+/*
+** With --perf 1 the counters run for the whole process and every
+** print_header()/print_result() takes a snapshot, so each reported
+** result gets the counter deltas of its phase divided by its operation
+** count.  Counters are inherited by the concurrent benchmark's threads
+** and include them once those have been joined.
+*/
+static int g_perf_fd[PERF_NUM_COUNTERS] = { -1, -1, -1, -1, -1, -1, -1 };
+static double g_perf_base[PERF_NUM_COUNTERS];
+static double g_perf_per_op[PERF_NUM_COUNTERS];     /* Last phase; < 0 if not counted */
+static int g_perf_enabled;
+static int g_perf_pending;                          /* g_perf_per_op not yet recorded */
+
+#ifdef __linux__
+static int perf_open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    int fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        /* perf_event_paranoid >= 2 only allows user-space counting */
+        attr.exclude_kernel = 1;
+        fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    return fd;
+}
+
+/* Counter value scaled for multiplexing; -1 if it never got scheduled */
+static double perf_read_counter(int fd) {
+    uint64_t v[3];
+    if (fd < 0 || read(fd, v, sizeof(v)) != (ssize_t)sizeof(v) || v[2] == 0) return -1;
+    return v[2] < v[1] ? (double)v[0] * v[1] / v[2] : (double)v[0];
+}
+#else
+static double perf_read_counter(int fd) {
+    (void)fd;
+    return -1;
+}
+#endif
+
+static void perf_mark(void) {
+    int i;
+    if (!g_perf_enabled) return;
+    for (i = 0; i < PERF_NUM_COUNTERS; i++) g_perf_base[i] = perf_read_counter(g_perf_fd[i]);
+}
+
+/* Open the counters; reports and returns the number that are available */
+static int perf_init(void) {
+#ifdef __linux__
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[PERF_NUM_COUNTERS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                              | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    };
+    int i, n = 0, err = 0;
+
+    for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+        g_perf_fd[i] = perf_open_counter(events[i].type, events[i].config);
+        if (g_perf_fd[i] >= 0) {
+            n++;
+        } else {
+            err = errno;
+        }
+    }
+    if (n == 0) {
+        FILE *f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+        int paranoid = 0;
+        if (f == NULL || fscanf(f, "%d", &paranoid) != 1) paranoid = -99;
+        if (f) fclose(f);
+        fprintf(stderr, "Hardware counters unavailable: %s", strerror(err));
+        if (paranoid != -99) fprintf(stderr, " (perf_event_paranoid = %d)", paranoid);
+        fprintf(stderr, "\n");
+        return 0;
+    }
+    printf("  Counters:");
+    for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (g_perf_fd[i] >= 0) printf(" %s", perf_names[i]);
+    }
+    if (n < PERF_NUM_COUNTERS) printf(" (%d unavailable: %s)", PERF_NUM_COUNTERS - n, strerror(err));
+    printf("\n");
+    g_perf_enabled = 1;
+    perf_mark();
+    return n;
+#else
+    fprintf(stderr, "Hardware counters are only supported on Linux\n");
+    return 0;
+#endif
+}
+
+static void perf_close(void) {
+#ifdef __linux__
+    int i;
+    for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (g_perf_fd[i] >= 0) close(g_perf_fd[i]);
+        g_perf_fd[i] = -1;
+    }
+#endif
+    g_perf_enabled = 0;
+}
+
+static void format_count(double v, char *buf, size_t size) {
+    if (v >= 1000) {
+        format_number((long long)(v + 0.5), buf, size);
+    } else {
+        snprintf(buf, size, "%.2f", v);
+    }
+}
+
+/* Print the counter deltas since the last snapshot per operation */
+static void perf_report(const char *label, long long ops) {
+    char buf[32];
+    int i;
+
+    if (!g_perf_enabled || ops <= 0) return;
+    for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+        double now = perf_read_counter(g_perf_fd[i]);
+        g_perf_per_op[i] = (now < 0 || g_perf_base[i] < 0) ? -1 : (now - g_perf_base[i]) / ops;
+    }
+    printf("  %-30s  ", label);
+    for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (g_perf_per_op[i] < 0) continue;
+        format_count(g_perf_per_op[i], buf, sizeof(buf));
+        printf("%s %s  ", perf_short_names[i], buf);
+        if (i == PERF_INSTRUCTIONS && g_perf_per_op[PERF_CYCLES] > 0) {
+            printf("IPC %.2f  ", g_perf_per_op[PERF_INSTRUCTIONS] / g_perf_per_op[PERF_CYCLES]);
+        }
+    }
+    printf("\n");
+    g_perf_pending = 1;
+    perf_mark();
+}
+
+/* ==================== I/O Accounting VFS ==================== */
+
+/*
+** A pass-through VFS over the default one (unix on POSIX systems) that
+** counts every xRead/xWrite/xSync/xTruncate/xFetch per file type, the
+** bytes moved and log2 histograms of request sizes and offsets, plus
+** the xShmMap/xShmLock calls of WAL mode.  It is registered as the
+** default VFS so every connection, including those of the concurrent
+** benchmark's threads, goes through it.  Like the hardware counters the
+** totals are snapshotted by print_header()/print_result(); set against
+** the logical key/value bytes the benchmarks moved they give read and
+** write amplification per phase.
+*/
+#define IO_SIZE_BUCKETS 32
+#define IO_OFFSET_BUCKETS 48
+
+enum {
+    IO_DB,
+    IO_JOURNAL,
+    IO_WAL,
+    IO_OTHER,
+    IO_NUM_TYPES
+};
+
+static const char *io_type_names[IO_NUM_TYPES] = { "db", "journal", "wal", "other" };
+
+typedef struct {
+    long long reads, read_bytes;
+    long long writes, write_bytes;
+    long long syncs;
+    long long sync_ns;          /* Time spent in xSync */
+    long long truncates;
+    long long fetches, fetch_bytes;
+} io_file_counts;
+
+typedef struct {
+    io_file_counts file[IO_NUM_TYPES];
+    long long shm_maps;
+    long long shm_locks;
+    long long read_sizes[IO_SIZE_BUCKETS];
+    long long write_sizes[IO_SIZE_BUCKETS];
+    long long read_offsets[IO_OFFSET_BUCKETS];
+    long long write_offsets[IO_OFFSET_BUCKETS];
+    long long kv_read_bytes;    /* Logical bytes, reported by the benchmarks */
+    long long kv_write_bytes;
+} io_counters;
+
+typedef struct {
+    sqlite3_file base;
+    sqlite3_file *real;         /* The underlying VFS's file, allocated right after */
+    int type;                   /* IO_* */
+} io_file;
+
+static io_counters g_io;
+static io_counters g_io_base;   /* At the last snapshot */
+static io_counters g_io_run;    /* At the start of the current run_suite() */
+static sqlite3_mutex *g_io_mutex;
+static sqlite3_vfs *g_io_real;
+static int g_io_enabled;
+static int g_io_pending;        /* g_io_last not yet recorded */
+static io_counters g_io_last;   /* Deltas of the last reported phase */
+
+/* Logical bytes moved by the single-threaded benchmarks (threads add theirs when joined) */
+#define KV_READ(n)  (g_io.kv_read_bytes += (n))
+#define KV_WRITE(n) (g_io.kv_write_bytes += (n))
+
+static int io_log2(sqlite3_int64 x, int buckets) {
+    int b = 0;
+    while (x > 1 && b < buckets - 1) {
+        x >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static int io_close(sqlite3_file *f) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods ? p->real->pMethods->xClose(p->real) : SQLITE_OK;
+}
+
+static int io_read(sqlite3_file *f, void *buf, int amt, sqlite3_int64 off) {
+    io_file *p = (io_file *)f;
+    int rc = p->real->pMethods->xRead(p->real, buf, amt, off);
+    sqlite3_mutex_enter(g_io_mutex);
+    g_io.file[p->type].reads++;
+    g_io.file[p->type].read_bytes += amt;
+    g_io.read_sizes[io_log2(amt, IO_SIZE_BUCKETS)]++;
+    g_io.read_offsets[io_log2(off, IO_OFFSET_BUCKETS)]++;
+    sqlite3_mutex_leave(g_io_mutex);
+    return rc;
+}
+
+static int io_write(sqlite3_file *f, const void *buf, int amt, sqlite3_int64 off) {
+    io_file *p = (io_file *)f;
+    int rc = p->real->pMethods->xWrite(p->real, buf, amt, off);
+    sqlite3_mutex_enter(g_io_mutex);
+    g_io.file[p->type].writes++;
+    g_io.file[p->type].write_bytes += amt;
+    g_io.write_sizes[io_log2(amt, IO_SIZE_BUCKETS)]++;
+    g_io.write_offsets[io_log2(off, IO_OFFSET_BUCKETS)]++;
+    sqlite3_mutex_leave(g_io_mutex);
+    return rc;
+}
+
+static int io_truncate(sqlite3_file *f, sqlite3_int64 size) {
+    io_file *p = (io_file *)f;
+    sqlite3_mutex_enter(g_io_mutex);
+    g_io.file[p->type].truncates++;
+    sqlite3_mutex_leave(g_io_mutex);
+    return p->real->pMethods->xTruncate(p->real, size);
+}
+
+static int io_sync(sqlite3_file *f, int flags) {
+    io_file *p = (io_file *)f;
+    uint64_t t0 = get_time_ns();
+    int rc = p->real->pMethods->xSync(p->real, flags);
+    uint64_t ns = get_time_ns() - t0;
+    sqlite3_mutex_enter(g_io_mutex);
+    g_io.file[p->type].syncs++;
+    g_io.file[p->type].sync_ns += (long long)ns;
+    sqlite3_mutex_leave(g_io_mutex);
+    return rc;
+}
+
+static int io_file_size(sqlite3_file *f, sqlite3_int64 *size) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xFileSize(p->real, size);
+}
+
+static int io_lock(sqlite3_file *f, int lock) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xLock(p->real, lock);
+}
+
+static int io_unlock(sqlite3_file *f, int lock) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xUnlock(p->real, lock);
+}
+
+static int io_check_reserved_lock(sqlite3_file *f, int *out) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xCheckReservedLock(p->real, out);
+}
+
+static int io_file_control(sqlite3_file *f, int op, void *arg) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xFileControl(p->real, op, arg);
+}
+
+static int io_sector_size(sqlite3_file *f) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xSectorSize(p->real);
+}
+
+static int io_device_characteristics(sqlite3_file *f) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xDeviceCharacteristics(p->real);
+}
+
+static int io_shm_map(sqlite3_file *f, int region, int size, int extend, void volatile **pp) {
+    io_file *p = (io_file *)f;
+    sqlite3_mutex_enter(g_io_mutex);
+    g_io.shm_maps++;
+    sqlite3_mutex_leave(g_io_mutex);
+    return p->real->pMethods->xShmMap(p->real, region, size, extend, pp);
+}
+
+static int io_shm_lock(sqlite3_file *f, int offset, int n, int flags) {
+    io_file *p = (io_file *)f;
+    sqlite3_mutex_enter(g_io_mutex);
+    g_io.shm_locks++;
+    sqlite3_mutex_leave(g_io_mutex);
+    return p->real->pMethods->xShmLock(p->real, offset, n, flags);
+}
+
+static void io_shm_barrier(sqlite3_file *f) {
+    io_file *p = (io_file *)f;
+    p->real->pMethods->xShmBarrier(p->real);
+}
+
+static int io_shm_unmap(sqlite3_file *f, int del) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xShmUnmap(p->real, del);
+}
+
+static int io_fetch(sqlite3_file *f, sqlite3_int64 off, int amt, void **pp) {
+    io_file *p = (io_file *)f;
+    int rc = p->real->pMethods->xFetch(p->real, off, amt, pp);
+    if (*pp) {
+        sqlite3_mutex_enter(g_io_mutex);
+        g_io.file[p->type].fetches++;
+        g_io.file[p->type].fetch_bytes += amt;
+        sqlite3_mutex_leave(g_io_mutex);
+    }
+    return rc;
+}
+
+static int io_unfetch(sqlite3_file *f, sqlite3_int64 off, void *ptr) {
+    io_file *p = (io_file *)f;
+    return p->real->pMethods->xUnfetch(p->real, off, ptr);
+}
+
+/* Version 1 and 2 methods stop short of the calls the real file lacks */
+static sqlite3_io_methods io_methods[3] = {
+    { 1, io_close, io_read, io_write, io_truncate, io_sync, io_file_size, io_lock, io_unlock,
+      io_check_reserved_lock, io_file_control, io_sector_size, io_device_characteristics,
+      NULL, NULL, NULL, NULL, NULL, NULL },
+    { 2, io_close, io_read, io_write, io_truncate, io_sync, io_file_size, io_lock, io_unlock,
+      io_check_reserved_lock, io_file_control, io_sector_size, io_device_characteristics,
+      io_shm_map, io_shm_lock, io_shm_barrier, io_shm_unmap, NULL, NULL },
+    { 3, io_close, io_read, io_write, io_truncate, io_sync, io_file_size, io_lock, io_unlock,
+      io_check_reserved_lock, io_file_control, io_sector_size, io_device_characteristics,
+      io_shm_map, io_shm_lock, io_shm_barrier, io_shm_unmap, io_fetch, io_unfetch },
+};
+
+static int io_open(sqlite3_vfs *vfs, sqlite3_filename name, sqlite3_file *f, int flags, int *out_flags) {
+    io_file *p = (io_file *)f;
+    int rc, version;
+
+    (void)vfs;
+    p->real = (sqlite3_file *)&p[1];
+    if (flags & SQLITE_OPEN_MAIN_DB) {
+        p->type = IO_DB;
+    } else if (flags & SQLITE_OPEN_MAIN_JOURNAL) {
+        p->type = IO_JOURNAL;
+    } else if (flags & SQLITE_OPEN_WAL) {
+        p->type = IO_WAL;
+    } else {
+        p->type = IO_OTHER;
+    }
+    rc = g_io_real->xOpen(g_io_real, name, p->real, flags, out_flags);
+    if (p->real->pMethods == NULL) {
+        p->base.pMethods = NULL;
+        return rc;
+    }
+    version = p->real->pMethods->iVersion;
+    if (version > 3) version = 3;
+    p->base.pMethods = &io_methods[version - 1];
+    return rc;
+}
+
+static int io_delete(sqlite3_vfs *vfs, const char *name, int sync_dir) {
+    (void)vfs;
+    return g_io_real->xDelete(g_io_real, name, sync_dir);
+}
+
+static int io_access(sqlite3_vfs *vfs, const char *name, int flags, int *out) {
+    (void)vfs;
+    return g_io_real->xAccess(g_io_real, name, flags, out);
+}
+
+static int io_full_pathname(sqlite3_vfs *vfs, const char *name, int n, char *out) {
+    (void)vfs;
+    return g_io_real->xFullPathname(g_io_real, name, n, out);
+}
+
+static void *io_dl_open(sqlite3_vfs *vfs, const char *path) {
+    (void)vfs;
+    return g_io_real->xDlOpen(g_io_real, path);
+}
+
+static void io_dl_error(sqlite3_vfs *vfs, int n, char *msg) {
+    (void)vfs;
+    g_io_real->xDlError(g_io_real, n, msg);
+}
+
+static void (*io_dl_sym(sqlite3_vfs *vfs, void *handle, const char *sym))(void) {
+    (void)vfs;
+    return g_io_real->xDlSym(g_io_real, handle, sym);
+}
+
+static void io_dl_close(sqlite3_vfs *vfs, void *handle) {
+    (void)vfs;
+    g_io_real->xDlClose(g_io_real, handle);
+}
+
+static int io_randomness(sqlite3_vfs *vfs, int n, char *out) {
+    (void)vfs;
+    return g_io_real->xRandomness(g_io_real, n, out);
+}
+
+static int io_sleep(sqlite3_vfs *vfs, int us) {
+    (void)vfs;
+    return g_io_real->xSleep(g_io_real, us);
+}
+
+static int io_current_time(sqlite3_vfs *vfs, double *out) {
+    (void)vfs;
+    return g_io_real->xCurrentTime(g_io_real, out);
+}
+
+static int io_get_last_error(sqlite3_vfs *vfs, int n, char *out) {
+    (void)vfs;
+    return g_io_real->xGetLastError ? g_io_real->xGetLastError(g_io_real, n, out) : 0;
+}
+
+static int io_current_time_int64(sqlite3_vfs *vfs, sqlite3_int64 *out) {
+    (void)vfs;
+    return g_io_real->xCurrentTimeInt64(g_io_real, out);
+}
+
+static sqlite3_vfs io_vfs = {
+    2, 0, 0, NULL, "iostat", NULL,
+    io_open, io_delete, io_access, io_full_pathname,
+    io_dl_open, io_dl_error, io_dl_sym, io_dl_close,
+    io_randomness, io_sleep, io_current_time, io_get_last_error,
+    io_current_time_int64, NULL, NULL, NULL
+};
+
+static int io_vfs_register(void) {
+    int rc;
+    g_io_real = sqlite3_vfs_find(NULL);
+    if (g_io_real == NULL || g_io_real->iVersion < 2 || g_io_real->xCurrentTimeInt64 == NULL) {
+        fprintf(stderr, "I/O accounting needs a version 2 default VFS\n");
+        return -1;
+    }
+    io_vfs.szOsFile = (int)sizeof(io_file) + g_io_real->szOsFile;
+    io_vfs.mxPathname = g_io_real->mxPathname;
+    rc = sqlite3_vfs_register(&io_vfs, 1);
+    if (rc != SQLITE_OK) return -1;
+    g_io_mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    g_io_enabled = 1;
+    return 0;
+}
+
+static void io_vfs_unregister(void) {
+    if (!g_io_enabled) return;
+    sqlite3_vfs_unregister(&io_vfs);
+    sqlite3_mutex_free(g_io_mutex);
+    g_io_mutex = NULL;
+    g_io_enabled = 0;
+}
+
+static void io_snapshot(io_counters *out) {
+    sqlite3_mutex_enter(g_io_mutex);
+    *out = g_io;
+    sqlite3_mutex_leave(g_io_mutex);
+}
+
+/* d = a - b, field by field (io_counters is all long long) */
+static void io_diff(io_counters *d, const io_counters *a, const io_counters *b) {
+    const long long *pa = (const long long *)a, *pb = (const long long *)b;
+    long long *pd = (long long *)d;
+    size_t i;
+    for (i = 0; i < sizeof(io_counters) / sizeof(long long); i++) pd[i] = pa[i] - pb[i];
+}
+
+static void io_totals(const io_counters *c, io_file_counts *t) {
+    int i;
+    memset(t, 0, sizeof(*t));
+    for (i = 0; i < IO_NUM_TYPES; i++) {
+        t->reads += c->file[i].reads;
+        t->read_bytes += c->file[i].read_bytes;
+        t->writes += c->file[i].writes;
+        t->write_bytes += c->file[i].write_bytes;
+        t->syncs += c->file[i].syncs;
+        t->sync_ns += c->file[i].sync_ns;
+        t->truncates += c->file[i].truncates;
+        t->fetches += c->file[i].fetches;
+        t->fetch_bytes += c->file[i].fetch_bytes;
+    }
+}
+
+static void format_bytes(double v, char *buf, size_t size) {
+    if (v >= 1024.0 * 1024.0 * 1024.0) {
+        snprintf(buf, size, "%.2f GB", v / (1024.0 * 1024.0 * 1024.0));
+    } else if (v >= 1024.0 * 1024.0) {
+        snprintf(buf, size, "%.2f MB", v / (1024.0 * 1024.0));
+    } else if (v >= 1024.0) {
+        snprintf(buf, size, "%.1f KB", v / 1024.0);
+    } else {
+        snprintf(buf, size, "%.0f B", v);
+    }
+}
+
+static void io_mark(void) {
+    if (g_io_enabled) io_snapshot(&g_io_base);
+}
+
+static void print_amplification(double device, long long logical) {
+    if (logical > 0) {
+        printf("%.2fx", device / logical);
+    } else {
+        printf("-");
+    }
+}
+
+/* Print the VFS traffic since the last snapshot per operation */
+static void io_report(const char *label, long long ops) {
+    io_counters now;
+    io_file_counts t;
+    char b1[32], b2[32];
+    int i;
+
+    if (!g_io_enabled || ops <= 0) return;
+    io_snapshot(&now);
+    io_diff(&g_io_last, &now, &g_io_base);
+    io_totals(&g_io_last, &t);
+    format_bytes((double)t.read_bytes / ops, b1, sizeof(b1));
+    format_bytes((double)t.write_bytes / ops, b2, sizeof(b2));
+    printf("  %-30s  reads %.2f (%s)  writes %.2f (%s)  syncs %.3f  amp read ",
+           label, (double)t.reads / ops, b1, (double)t.writes / ops, b2, (double)t.syncs / ops);
+    print_amplification((double)t.read_bytes, g_io_last.kv_read_bytes);
+    printf(" write ");
+    print_amplification((double)t.write_bytes, g_io_last.kv_write_bytes);
+    printf("\n");
+
+    if (t.reads + t.writes + t.fetches + g_io_last.shm_locks > 0) {
+        printf("  %-30s ", "");
+        for (i = 0; i < IO_NUM_TYPES; i++) {
+            const io_file_counts *c = &g_io_last.file[i];
+            if (c->reads + c->writes + c->syncs + c->truncates + c->fetches == 0) continue;
+            format_bytes((double)c->read_bytes, b1, sizeof(b1));
+            format_bytes((double)c->write_bytes, b2, sizeof(b2));
+            printf(" %s r %s w %s", io_type_names[i], b1, b2);
+            if (c->syncs) printf(" sync %lld", c->syncs);
+            if (c->truncates) printf(" trunc %lld", c->truncates);
+            if (c->fetches) printf(" fetch %lld", c->fetches);
+            printf(" |");
+        }
+        if (g_io_last.shm_maps + g_io_last.shm_locks > 0) {
+            printf(" shm map %lld lock %lld", g_io_last.shm_maps, g_io_last.shm_locks);
+        }
+        printf("\n");
+    }
+    g_io_pending = 1;
+    g_io_base = now;
+}
+
+/*
+** Every reported result is also logged here, tagged with the run and
+** sweep point it was measured at, for the sweep summary and the
+** --json/--csv output.
+*/
+typedef struct {
+    int run;
+    int point;
+    char name[48];
+    long long ops;
+    double elapsed;
+    double ops_per_sec;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+    int has_perf;
+    double perf[PERF_NUM_COUNTERS];     /* Per operation; < 0 if not counted */
+    int has_io;
+    io_file_counts io;                  /* VFS totals of the phase */
+    long long kv_read_bytes;
+    long long kv_write_bytes;
+} result_entry;
+
+static result_entry *g_results;
+static int g_num_results;
+static int g_results_alloc;
+static int g_run;
+static int g_point;
+
+static void record_result(const char *name, long long ops, double elapsed,
+                          double ops_per_sec, const latency_hist *h) {
+    result_entry *r;
+    if (g_num_results == g_results_alloc) {
+        int n = g_results_alloc ? g_results_alloc * 2 : 64;
+        result_entry *p = (result_entry *)realloc(g_results, n * sizeof(result_entry));
+        if (p == NULL) return;
+        g_results = p;
+        g_results_alloc = n;
+    }
+    r = &g_results[g_num_results++];
+    memset(r, 0, sizeof(*r));
+    r->run = g_run;
+    r->point = g_point;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->ops = ops;
+    r->elapsed = elapsed;
+    r->ops_per_sec = ops_per_sec;
+    if (h && h->count) {
+        r->p50 = hist_percentile(h, 50.0);
+        r->p90 = hist_percentile(h, 90.0);
+        r->p99 = hist_percentile(h, 99.0);
+        r->p999 = hist_percentile(h, 99.9);
+        r->max = h->max;
+    }
+    if (g_perf_pending) {
+        r->has_perf = 1;
+        memcpy(r->perf, g_perf_per_op, sizeof(r->perf));
+        g_perf_pending = 0;
+    }
+    if (g_io_pending) {
+        r->has_io = 1;
+        io_totals(&g_io_last, &r->io);
+        r->kv_read_bytes = g_io_last.kv_read_bytes;
+        r->kv_write_bytes = g_io_last.kv_write_bytes;
+        g_io_pending = 0;
+    }
+}
+
+static void print_result(const char *test, double elapsed, int ops, const latency_hist *h) {
     double ops_per_sec = ops / elapsed;
     char buf[32];
     format_number((long long)ops_per_sec, buf, sizeof(buf));
@@ -63,9 +965,15 @@ static void print_result(const char *test, double elapsed, int ops) {
     printf("  %-30s: ", test);
     printf(COLOR_GREEN "%s ops/sec" COLOR_RESET " ", buf);
     printf("(%.3f seconds for %d ops)\n", elapsed, ops);
+    if (h) print_latency("  latency", h);
+    perf_report("  cpu/op", ops);
+    io_report("  io/op", ops);
+    record_result(test, ops, elapsed, ops_per_sec, h);
 }
 
 static void print_header(const char *title) {
+    perf_mark();
+    io_mark();
     printf("\n" COLOR_CYAN);
     printf("════════════════════════════════════════════════════════\n");
     printf("  %s\n", title);
@@ -85,83 +993,411 @@ static int exec_sql(sqlite3 *db, const char *sql) {
     return 0;
 }
 
-/* Initialize database with table */
-static int init_database(sqlite3 *db) {
-    const char *create_table = 
-    "CREATE TABLE IF NOT EXISTS kvpairs ("
-    "  key BLOB PRIMARY KEY,"
-    "  value BLOB NOT NULL"
-    ") WITHOUT ROWID";
-    if (exec_sql(db, create_table) != 0) return -1;
-    
-    /* Enable optimizations */
-  //  exec_sql(db, "PRAGMA synchronous = NORMAL");
-  //  exec_sql(db, "PRAGMA journal_mode = WAL");
-  //  exec_sql(db, "PRAGMA cache_size = -64000");
-  //  exec_sql(db, "PRAGMA temp_store = MEMORY");
-    exec_sql(db, "PRAGMA page_size = 4096");
-    exec_sql(db, "PRAGMA cache_size = 2000");
-exec_sql(db, "PRAGMA journal_mode = WAL"); /* match rollback journal */
-exec_sql(db, "PRAGMA synchronous = NORMAL");    /* fair durability */
+static void print_io_buckets(const char *what, const long long *a, const long long *b, int buckets) {
+    char lo[32], hi[32], range[80];
+    int i;
+    printf("\n  %-24s %12s %12s\n", what, "reads", "writes");
+    for (i = 0; i < buckets; i++) {
+        if (a[i] == 0 && b[i] == 0) continue;
+        format_bytes(i ? (double)(1LL << i) : 0, lo, sizeof(lo));
+        format_bytes((double)(1LL << (i + 1)), hi, sizeof(hi));
+        snprintf(range, sizeof(range), "[%s, %s)", lo, hi);
+        printf("  %-24s %12lld %12lld\n", range, a[i], b[i]);
+    }
+}
 
-    return 0;
+/* Size and offset histograms of everything the current run did */
+static void io_print_histograms(void) {
+    io_counters now, d;
+
+    if (!g_io_enabled) return;
+    io_snapshot(&now);
+    io_diff(&d, &now, &g_io_run);
+    print_header("I/O SIZES AND OFFSETS");
+    print_io_buckets("request size", d.read_sizes, d.write_sizes, IO_SIZE_BUCKETS);
+    print_io_buckets("file offset", d.read_offsets, d.write_offsets, IO_OFFSET_BUCKETS);
 }
 
-/* ==================== BENCHMARK 1: Sequential Writes ==================== */
-static void bench_sequential_writes(sqlite3 *db) {
-    print_header("BENCHMARK 1: Sequential Writes");
-    printf("  Writing %d records in batches of %d...\n\n", NUM_RECORDS, BATCH_SIZE);
-    
-    char sql[256];
-    int i, rc;
-    double start, end;
-    sqlite3_stmt *stmt = NULL;
-    
-    /* Prepare statement */
-    const char *insert_sql = "INSERT OR REPLACE INTO kvpairs (key, value) VALUES (?, ?)";
-    rc = sqlite3_prepare_v2(db, insert_sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        return;
-    }
-    
-    start = get_time();
-    
-    for (i = 0; i < NUM_RECORDS; i++) {
-        if (i % BATCH_SIZE == 0) {
-            if (i > 0) {
-                exec_sql(db, "COMMIT");
+/* ==================== Key Distributions ==================== */
+
+/* xorshift64*: rand() is neither thread-safe nor wide enough for 1M keys */
+static uint64_t rng_next(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform double in [0, 1) */
+static double rng_double(uint64_t *state) {
+    return (rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* splitmix64 finalizer: spreads small seeds and never yields a zero state */
+static uint64_t rng_seed(uint64_t seed) {
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    seed ^= seed >> 31;
+    return seed ? seed : 1;
+}
+
+typedef enum {
+    DIST_UNIFORM,
+    DIST_ZIPFIAN,
+    DIST_SCRAMBLED,     /* Zipfian popularity, hot keys spread over the key space */
+    DIST_LATEST,        /* Zipfian over recency: newest inserts are hottest */
+    DIST_HOTSPOT        /* hot_ops of the requests go to the first hot_set keys */
+} key_dist;
+
+static const char *dist_names[] = { "uniform", "zipfian", "scrambled", "latest", "hotspot" };
+
+/*
+** Pluggable key chooser following the YCSB generators.  The Zipfian
+** variants use the method from Gray et al., "Quickly Generating
+** Billion-Record Synthetic Databases"; zeta(n) is extended incrementally
+** as inserts grow the key space.
+*/
+typedef struct {
+    key_dist dist;
+    long long items;        /* Keys are drawn from [0, items) */
+    double theta;
+    double hot_set;
+    double hot_ops;
+    long long zeta_items;   /* Number of items zetan covers */
+    double zetan, zeta2, alpha, eta;
+} key_chooser;
+
+static void key_chooser_zipf_update(key_chooser *kc) {
+    long long i;
+    for (i = kc->zeta_items + 1; i <= kc->items; i++) {
+        kc->zetan += 1.0 / pow((double)i, kc->theta);
+    }
+    kc->zeta_items = kc->items;
+    kc->eta = (1.0 - pow(2.0 / (double)kc->items, 1.0 - kc->theta))
+            / (1.0 - kc->zeta2 / kc->zetan);
+}
+
+static void key_chooser_init(key_chooser *kc, key_dist dist, long long items,
+                             double theta, double hot_set, double hot_ops) {
+    memset(kc, 0, sizeof(*kc));
+    kc->dist = dist;
+    kc->items = items;
+    kc->theta = theta;
+    kc->hot_set = hot_set;
+    kc->hot_ops = hot_ops;
+    kc->zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+    kc->alpha = 1.0 / (1.0 - theta);
+    if (dist == DIST_ZIPFIAN || dist == DIST_SCRAMBLED || dist == DIST_LATEST) {
+        key_chooser_zipf_update(kc);
+    }
+}
+
+/* Called after an insert extends the key space */
+static void key_chooser_grow(key_chooser *kc, long long items) {
+    kc->items = items;
+    if (kc->zeta_items > 0) key_chooser_zipf_update(kc);
+}
+
+static long long zipf_next(const key_chooser *kc, uint64_t *rng) {
+    double u = rng_double(rng);
+    double uz = u * kc->zetan;
+    long long v;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + pow(0.5, kc->theta)) return 1;
+    v = (long long)((double)kc->items * pow(kc->eta * u - kc->eta + 1.0, kc->alpha));
+    return v >= kc->items ? kc->items - 1 : v;
+}
+
+static uint64_t fnv1a64(uint64_t v) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    int i;
+    for (i = 0; i < 8; i++) {
+        h ^= v & 0xff;
+        h *= 0x100000001B3ULL;
+        v >>= 8;
+    }
+    return h;
+}
+
+static long long key_next(const key_chooser *kc, uint64_t *rng) {
+    long long hot;
+    switch (kc->dist) {
+    case DIST_ZIPFIAN:
+        return zipf_next(kc, rng);
+    case DIST_SCRAMBLED:
+        return (long long)(fnv1a64((uint64_t)zipf_next(kc, rng)) % (uint64_t)kc->items);
+    case DIST_LATEST:
+        return kc->items - 1 - zipf_next(kc, rng);
+    case DIST_HOTSPOT:
+        hot = (long long)(kc->items * kc->hot_set);
+        if (hot < 1) hot = 1;
+        if (hot >= kc->items || rng_double(rng) < kc->hot_ops) {
+            return (long long)(rng_next(rng) % (uint64_t)hot);
+        }
+        return hot + (long long)(rng_next(rng) % (uint64_t)(kc->items - hot));
+    case DIST_UNIFORM:
+    default:
+        return (long long)(rng_next(rng) % (uint64_t)kc->items);
+    }
+}
+
+static void describe_dist(const key_chooser *kc, char *buf, size_t size) {
+    switch (kc->dist) {
+    case DIST_ZIPFIAN:
+    case DIST_SCRAMBLED:
+    case DIST_LATEST:
+        snprintf(buf, size, "%s (theta %.2f)", dist_names[kc->dist], kc->theta);
+        break;
+    case DIST_HOTSPOT:
+        snprintf(buf, size, "hotspot (%.0f%% of ops on %.0f%% of keys)",
+                 kc->hot_ops * 100, kc->hot_set * 100);
+        break;
+    default:
+        snprintf(buf, size, "%s", dist_names[kc->dist]);
+        break;
+    }
+}
+
+/* Key distribution and RNG shared by the single-threaded benchmarks */
+static key_chooser g_keys;
+static uint64_t g_rng = 1;
+
+/* ==================== Configuration ==================== */
+enum {
+    BENCH_WRITES  = 1 << 0,
+    BENCH_READS   = 1 << 1,
+    BENCH_SCAN    = 1 << 2,
+    BENCH_UPDATES = 1 << 3,
+    BENCH_DELETES = 1 << 4,
+    BENCH_EXISTS  = 1 << 5,
+    BENCH_MIXED   = 1 << 6,
+    BENCH_BULK    = 1 << 7,
+    BENCH_VALUES  = 1 << 8,
+    BENCH_RESTART = 1 << 9,
+    BENCH_RANGE   = 1 << 10,
+    BENCH_CHECKPOINT = 1 << 11,
+    BENCH_DURABILITY = 1 << 12,
+    BENCH_CHURN   = 1 << 13,
+    BENCH_KV      = 1 << 14
+};
+
+static const char *bench_names[] = {
+    "writes", "reads", "scan", "updates", "deletes", "exists", "mixed", "bulk", "values", "restart", "range", "checkpoint",
+    "durability", "churn", "kv"
+};
+
+/* Parameters of one run (one point of a sweep) */
+typedef struct {
+    int records;
+    int batch_size;
+    int reads;
+    int updates;
+    int deletes;
+    int mixed_ops;
+    int scans;
+    int scan_lengths[MAX_SCAN_LENGTHS]; /* Rows per range scan */
+    int num_scan_lengths;
+    int key_min, key_max;           /* Key bytes; keys are never cut below "key_%08d" */
+    int value_min, value_max;       /* Value bytes; 0 keeps the built-in value formats */
+    int value_sizes[MAX_VALUE_SIZES];   /* Sizes of the value-size benchmark */
+    int num_value_sizes;
+    unsigned int cache_states;      /* CACHE_* bits of the restart benchmark */
+    int page_size;
+    int cache_size;
+    char journal_mode[16];
+    char synchronous[16];
+    long long mmap_size;
+    unsigned int benchmarks;        /* BENCH_* bits */
+    key_dist dist;
+    int dist_given;                 /* --dist overrides the YCSB defaults */
+    int bench_given;                /* --bench was set, not defaulted */
+    double theta;
+    double hot_set;
+    double hot_ops;
+    uint64_t seed;
+    char ycsb[8];
+    int ycsb_ops;
+    int readers;
+    int writers;
+    double duration;
+    double sustain;                 /* Seconds of the checkpoint benchmark */
+    int sample_ms;
+    int ckpt_readers;
+    char timeline[MAX_PARAM_VALUE]; /* CSV file for the checkpoint timeline */
+    char journal_modes[MAX_MODES][16];  /* Axes of the durability matrix */
+    int num_journal_modes;
+    char sync_modes[MAX_MODES][16];
+    int num_sync_modes;
+    int batch_sizes[MAX_BATCH_SIZES];
+    int num_batch_sizes;
+    int durability_rows;
+    int churn_rows;                 /* Table size of the churn benchmark */
+    int churn_cycles;
+    double churn_rate;              /* Fraction of the rows replaced and resized per cycle */
+    int churn_value_min, churn_value_max;
+    int churn_sample;               /* Cycles between measurements */
+    int multiget_size;              /* Keys per sqlite3_kv_multi_get() batch */
+    int load_fill;                  /* Page fill factor (%) of sqlite3_kv_load() */
+} bench_config;
+
+static bench_config g_cfg;
+
+/* Scratch value buffer of the single-threaded benchmarks and its filler */
+static char *g_value;
+static char *g_filler;
+
+static int value_capacity(void) {
+    return (g_cfg.value_max > VALUE_FORMAT_MAX ? g_cfg.value_max : VALUE_FORMAT_MAX) + 1;
+}
+
+/*
+** Keys are prefix + zero-padded index, padded to a length derived from
+** the index alone so that lookups regenerate exactly the stored key and
+** sequential indexes still produce ascending keys.
+*/
+static int make_key(char *buf, const char *prefix, long long idx) {
+    int len = snprintf(buf, MAX_KEY_SIZE + 1, "%s%08lld", prefix, idx);
+    int want = g_cfg.key_min;
+    if (g_cfg.key_max > g_cfg.key_min) {
+        want += (int)(fnv1a64((uint64_t)idx) % (uint64_t)(g_cfg.key_max - g_cfg.key_min + 1));
+    }
+    if (want > len) {
+        memset(buf + len, 'x', want - len);
+        len = want;
+    }
+    return len;
+}
+
+/*
+** Format a value into buf (value_capacity() bytes).  With a configured
+** value size the formatted text is padded with filler or truncated to a
+** length drawn uniformly from [value_min, value_max].
+*/
+static int make_value(char *buf, const char *fmt, long long idx, uint64_t *rng) {
+    int len = snprintf(buf, VALUE_FORMAT_MAX, fmt, idx);
+    int want;
+    if (g_cfg.value_max == 0) return len;
+    want = g_cfg.value_min;
+    if (g_cfg.value_max > g_cfg.value_min) {
+        want += (int)(rng_next(rng) % (uint64_t)(g_cfg.value_max - g_cfg.value_min + 1));
+    }
+    if (want > len) memcpy(buf + len, g_filler + len, want - len);
+    return want;
+}
+
+/* Per-connection settings; page_size and journal_mode live in the file */
+static void apply_connection_pragmas(sqlite3 *db) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "PRAGMA cache_size = %d", g_cfg.cache_size);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "PRAGMA synchronous = %s", g_cfg.synchronous);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "PRAGMA mmap_size = %lld", g_cfg.mmap_size);
+    exec_sql(db, sql);
+}
+
+/* Initialize database with table */
+static int init_database(sqlite3 *db) {
+    char sql[128];
+    const char *create_table = 
+    "CREATE TABLE IF NOT EXISTS kvpairs ("
+    "  key BLOB PRIMARY KEY,"
+    "  value BLOB NOT NULL"
+    ") WITHOUT ROWID";
+
+    /* page_size only takes effect before the first table is created */
+    snprintf(sql, sizeof(sql), "PRAGMA page_size = %d", g_cfg.page_size);
+    exec_sql(db, sql);
+    if (exec_sql(db, create_table) != 0) return -1;
+    
+    snprintf(sql, sizeof(sql), "PRAGMA journal_mode = %s", g_cfg.journal_mode);
+    exec_sql(db, sql);
+    apply_connection_pragmas(db);
+
+    return 0;
+}
+
+/* Result name of a read benchmark, tagged with the cache state it ran in */
+static void variant_name(char *buf, size_t size, const char *base, const char *cache_state) {
+    if (cache_state) {
+        snprintf(buf, size, "%s (%s)", base, cache_state);
+    } else {
+        snprintf(buf, size, "%s", base);
+    }
+}
+
+/* ==================== BENCHMARK 1: Sequential Writes ==================== */
+static void bench_sequential_writes(sqlite3 *db) {
+    print_header("BENCHMARK 1: Sequential Writes");
+    printf("  Writing %d records in batches of %d...\n\n", g_cfg.records, g_cfg.batch_size);
+    
+    char key[MAX_KEY_SIZE + 1];
+    int i, rc, klen, vlen;
+    double start, end;
+    uint64_t t0;
+    latency_hist hist;
+    sqlite3_stmt *stmt = NULL;
+    
+    /* Prepare statement */
+    const char *insert_sql = "INSERT OR REPLACE INTO kvpairs (key, value) VALUES (?, ?)";
+    rc = sqlite3_prepare_v2(db, insert_sql, -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return;
+    }
+    
+    hist_reset(&hist);
+    start = get_time();
+    
+    for (i = 0; i < g_cfg.records; i++) {
+        /* The batch COMMIT is charged to the op that triggers it, so
+        ** checkpoint stalls show up in the tail */
+        t0 = get_time_ns();
+        if (i % g_cfg.batch_size == 0) {
+            if (i > 0) {
+                exec_sql(db, "COMMIT");
             }
             exec_sql(db, "BEGIN TRANSACTION");
         }
         
-        snprintf(sql, sizeof(sql), "key_%08d", i);
-        sqlite3_bind_blob(stmt, 1, sql, strlen(sql), SQLITE_TRANSIENT);
+        klen = make_key(key, "key_", i);
+        sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
         
-        snprintf(sql, sizeof(sql), "value_%08d_with_some_additional_data_to_make_it_realistic", i);
-        sqlite3_bind_blob(stmt, 2, sql, strlen(sql), SQLITE_TRANSIENT);
+        vlen = make_value(g_value, "value_%08lld_with_some_additional_data_to_make_it_realistic", i, &g_rng);
+        sqlite3_bind_blob(stmt, 2, g_value, vlen, SQLITE_TRANSIENT);
+        KV_WRITE(klen + vlen);
         
         sqlite3_step(stmt);
         sqlite3_reset(stmt);
+        hist_record(&hist, get_time_ns() - t0);
     }
     
+    t0 = get_time_ns();
     exec_sql(db, "COMMIT");
+    hist_record(&hist, get_time_ns() - t0);
     
     end = get_time();
     
     sqlite3_finalize(stmt);
     
-    print_result("Sequential writes", end - start, NUM_RECORDS);
+    print_result("Sequential writes", end - start, g_cfg.records, &hist);
 }
 
 /* ==================== BENCHMARK 2: Random Reads ==================== */
-static void bench_random_reads(sqlite3 *db) {
-    print_header("BENCHMARK 2: Random Reads");
-    printf("  Reading %d random records...\n\n", NUM_READS);
+static void bench_random_reads(sqlite3 *db, const char *cache_state) {
+    if (cache_state == NULL) {
+        print_header("BENCHMARK 2: Random Reads");
+        printf("  Reading %d random records...\n\n", g_cfg.reads);
+    }
     
-    char key[32];
-    int i, rc;
+    char key[MAX_KEY_SIZE + 1], name[48];
+    int i, rc, klen;
     double start, end;
+    uint64_t t0;
+    latency_hist hist;
     sqlite3_stmt *stmt = NULL;
     
     const char *select_sql = "SELECT value FROM kvpairs WHERE key = ?";
@@ -171,36 +1407,45 @@ static void bench_random_reads(sqlite3 *db) {
         return;
     }
     
+    hist_reset(&hist);
     start = get_time();
     
-    for (i = 0; i < NUM_READS; i++) {
-        int idx = rand() % NUM_RECORDS;
-        snprintf(key, sizeof(key), "key_%08d", idx);
+    for (i = 0; i < g_cfg.reads; i++) {
+        klen = make_key(key, "key_", key_next(&g_keys, &g_rng));
         
-        sqlite3_bind_blob(stmt, 1, key, strlen(key), SQLITE_TRANSIENT);
+        t0 = get_time_ns();
+        sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
         
         if (sqlite3_step(stmt) == SQLITE_ROW) {
             /* Got the value - just consume it */
             sqlite3_column_blob(stmt, 0);
+            KV_READ(klen + sqlite3_column_bytes(stmt, 0));
         }
         
         sqlite3_reset(stmt);
+        hist_record(&hist, get_time_ns() - t0);
     }
     
     end = get_time();
     
     sqlite3_finalize(stmt);
     
-    print_result("Random reads", end - start, NUM_READS);
+    variant_name(name, sizeof(name), "Random reads", cache_state);
+    print_result(name, end - start, g_cfg.reads, &hist);
 }
 
 /* ==================== BENCHMARK 3: Sequential Scan ==================== */
-static void bench_sequential_scan(sqlite3 *db) {
-    print_header("BENCHMARK 3: Sequential Scan");
-    printf("  Scanning all records...\n\n");
+static void bench_sequential_scan(sqlite3 *db, const char *cache_state) {
+    if (cache_state == NULL) {
+        print_header("BENCHMARK 3: Sequential Scan");
+        printf("  Scanning all records...\n\n");
+    }
     
+    char name[48];
     int count = 0, rc;
     double start, end;
+    uint64_t t0;
+    latency_hist hist;
     sqlite3_stmt *stmt = NULL;
     
     const char *scan_sql = "SELECT key, value FROM kvpairs ORDER BY key";
@@ -210,30 +1455,39 @@ static void bench_sequential_scan(sqlite3 *db) {
         return;
     }
     
+    hist_reset(&hist);
     start = get_time();
     
+    /* One latency sample per row: step plus column access */
+    t0 = get_time_ns();
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         /* Access key and value to simulate real work */
         sqlite3_column_blob(stmt, 0);
         sqlite3_column_blob(stmt, 1);
+        KV_READ(sqlite3_column_bytes(stmt, 0) + sqlite3_column_bytes(stmt, 1));
         count++;
+        hist_record(&hist, get_time_ns() - t0);
+        t0 = get_time_ns();
     }
     
     end = get_time();
     
     sqlite3_finalize(stmt);
     
-    print_result("Sequential scan", end - start, count);
+    variant_name(name, sizeof(name), "Sequential scan", cache_state);
+    print_result(name, end - start, count, &hist);
 }
 
 /* ==================== BENCHMARK 4: Random Updates ==================== */
 static void bench_random_updates(sqlite3 *db) {
     print_header("BENCHMARK 4: Random Updates");
-    printf("  Updating %d random records...\n\n", NUM_UPDATES);
+    printf("  Updating %d random records...\n\n", g_cfg.updates);
     
-    char key[32], value[128];
-    int i, rc;
+    char key[MAX_KEY_SIZE + 1];
+    int i, rc, klen, vlen;
     double start, end;
+    uint64_t t0;
+    latency_hist hist;
     sqlite3_stmt *stmt = NULL;
     
     const char *update_sql = "UPDATE kvpairs SET value = ? WHERE key = ?";
@@ -245,18 +1499,22 @@ static void bench_random_updates(sqlite3 *db) {
     
     exec_sql(db, "BEGIN TRANSACTION");
     
+    hist_reset(&hist);
     start = get_time();
     
-    for (i = 0; i < NUM_UPDATES; i++) {
-        int idx = rand() % NUM_RECORDS;
-        snprintf(key, sizeof(key), "key_%08d", idx);
-        snprintf(value, sizeof(value), "updated_value_%08d", idx);
+    for (i = 0; i < g_cfg.updates; i++) {
+        long long idx = key_next(&g_keys, &g_rng);
+        klen = make_key(key, "key_", idx);
+        vlen = make_value(g_value, "updated_value_%08lld", idx, &g_rng);
         
-        sqlite3_bind_blob(stmt, 1, value, strlen(value), SQLITE_TRANSIENT);
-        sqlite3_bind_blob(stmt, 2, key, strlen(key), SQLITE_TRANSIENT);
+        t0 = get_time_ns();
+        sqlite3_bind_blob(stmt, 1, g_value, vlen, SQLITE_TRANSIENT);
+        sqlite3_bind_blob(stmt, 2, key, klen, SQLITE_TRANSIENT);
+        KV_WRITE(klen + vlen);
         
         sqlite3_step(stmt);
         sqlite3_reset(stmt);
+        hist_record(&hist, get_time_ns() - t0);
     }
     
     exec_sql(db, "COMMIT");
@@ -265,17 +1523,19 @@ static void bench_random_updates(sqlite3 *db) {
     
     sqlite3_finalize(stmt);
     
-    print_result("Random updates", end - start, NUM_UPDATES);
+    print_result("Random updates", end - start, g_cfg.updates, &hist);
 }
 
 /* ==================== BENCHMARK 5: Random Deletes ==================== */
 static void bench_random_deletes(sqlite3 *db) {
     print_header("BENCHMARK 5: Random Deletes");
-    printf("  Deleting %d random records...\n\n", NUM_DELETES);
+    printf("  Deleting %d random records...\n\n", g_cfg.deletes);
     
-    char key[32];
-    int i, rc;
+    char key[MAX_KEY_SIZE + 1];
+    int i, rc, klen;
     double start, end;
+    uint64_t t0;
+    latency_hist hist;
     sqlite3_stmt *stmt = NULL;
     
     const char *delete_sql = "DELETE FROM kvpairs WHERE key = ?";
@@ -287,15 +1547,18 @@ static void bench_random_deletes(sqlite3 *db) {
     
     exec_sql(db, "BEGIN TRANSACTION");
     
+    hist_reset(&hist);
     start = get_time();
     
-    for (i = 0; i < NUM_DELETES; i++) {
-        int idx = rand() % NUM_RECORDS;
-        snprintf(key, sizeof(key), "key_%08d", idx);
+    for (i = 0; i < g_cfg.deletes; i++) {
+        klen = make_key(key, "key_", key_next(&g_keys, &g_rng));
+        KV_WRITE(klen);
         
-        sqlite3_bind_blob(stmt, 1, key, strlen(key), SQLITE_TRANSIENT);
+        t0 = get_time_ns();
+        sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
         sqlite3_step(stmt);
         sqlite3_reset(stmt);
+        hist_record(&hist, get_time_ns() - t0);
     }
     
     exec_sql(db, "COMMIT");
@@ -304,17 +1567,21 @@ static void bench_random_deletes(sqlite3 *db) {
     
     sqlite3_finalize(stmt);
     
-    print_result("Random deletes", end - start, NUM_DELETES);
+    print_result("Random deletes", end - start, g_cfg.deletes, &hist);
 }
 
 /* ==================== BENCHMARK 6: Exists Checks ==================== */
-static void bench_exists_checks(sqlite3 *db) {
-    print_header("BENCHMARK 6: Exists Checks");
-    printf("  Checking existence of %d keys...\n\n", NUM_READS);
+static void bench_exists_checks(sqlite3 *db, const char *cache_state) {
+    if (cache_state == NULL) {
+        print_header("BENCHMARK 6: Exists Checks");
+        printf("  Checking existence of %d keys...\n\n", g_cfg.reads);
+    }
     
-    char key[32];
-    int i, rc;
+    char key[MAX_KEY_SIZE + 1], name[48];
+    int i, rc, klen;
     double start, end;
+    uint64_t t0;
+    latency_hist hist;
     sqlite3_stmt *stmt = NULL;
     
     const char *exists_sql = "SELECT 1 FROM kvpairs WHERE key = ? LIMIT 1";
@@ -324,22 +1591,26 @@ static void bench_exists_checks(sqlite3 *db) {
         return;
     }
     
+    hist_reset(&hist);
     start = get_time();
     
-    for (i = 0; i < NUM_READS; i++) {
-        int idx = rand() % NUM_RECORDS;
-        snprintf(key, sizeof(key), "key_%08d", idx);
+    for (i = 0; i < g_cfg.reads; i++) {
+        klen = make_key(key, "key_", key_next(&g_keys, &g_rng));
+        KV_READ(klen);
         
-        sqlite3_bind_blob(stmt, 1, key, strlen(key), SQLITE_TRANSIENT);
+        t0 = get_time_ns();
+        sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
         sqlite3_step(stmt);
         sqlite3_reset(stmt);
+        hist_record(&hist, get_time_ns() - t0);
     }
     
     end = get_time();
     
     sqlite3_finalize(stmt);
     
-    print_result("Exists checks", end - start, NUM_READS);
+    variant_name(name, sizeof(name), "Exists checks", cache_state);
+    print_result(name, end - start, g_cfg.reads, &hist);
 }
 
 /* ==================== BENCHMARK 7: Mixed Workload ==================== */
@@ -347,10 +1618,12 @@ static void bench_mixed_workload(sqlite3 *db) {
     print_header("BENCHMARK 7: Mixed Workload");
     printf("  70%% reads, 20%% writes, 10%% deletes...\n\n");
     
-    int total_ops = 20000;
-    char key[32], value[128];
-    int i, rc;
+    int total_ops = g_cfg.mixed_ops;
+    char key[MAX_KEY_SIZE + 1];
+    int i, klen, vlen;
     double start, end;
+    uint64_t t0;
+    latency_hist hist;
     sqlite3_stmt *select_stmt = NULL;
     sqlite3_stmt *update_stmt = NULL;
     sqlite3_stmt *delete_stmt = NULL;
@@ -362,34 +1635,40 @@ static void bench_mixed_workload(sqlite3 *db) {
     
     exec_sql(db, "BEGIN TRANSACTION");
     
+    hist_reset(&hist);
     start = get_time();
     
     for (i = 0; i < total_ops; i++) {
-        int idx = rand() % NUM_RECORDS;
-        int op = rand() % 100;
+        long long idx = key_next(&g_keys, &g_rng);
+        int op = (int)(rng_next(&g_rng) % 100);
         
-        snprintf(key, sizeof(key), "key_%08d", idx);
+        klen = make_key(key, "key_", idx);
         
+        t0 = get_time_ns();
         if (op < 70) {
             /* Read */
-            sqlite3_bind_blob(select_stmt, 1, key, strlen(key), SQLITE_TRANSIENT);
+            sqlite3_bind_blob(select_stmt, 1, key, klen, SQLITE_TRANSIENT);
             if (sqlite3_step(select_stmt) == SQLITE_ROW) {
                 sqlite3_column_blob(select_stmt, 0);
+                KV_READ(klen + sqlite3_column_bytes(select_stmt, 0));
             }
             sqlite3_reset(select_stmt);
         } else if (op < 90) {
             /* Write */
-            snprintf(value, sizeof(value), "mixed_value_%08d", idx);
-            sqlite3_bind_blob(update_stmt, 1, key, strlen(key), SQLITE_TRANSIENT);
-            sqlite3_bind_blob(update_stmt, 2, value, strlen(value), SQLITE_TRANSIENT);
+            vlen = make_value(g_value, "mixed_value_%08lld", idx, &g_rng);
+            sqlite3_bind_blob(update_stmt, 1, key, klen, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(update_stmt, 2, g_value, vlen, SQLITE_TRANSIENT);
+            KV_WRITE(klen + vlen);
             sqlite3_step(update_stmt);
             sqlite3_reset(update_stmt);
         } else {
             /* Delete */
-            sqlite3_bind_blob(delete_stmt, 1, key, strlen(key), SQLITE_TRANSIENT);
+            sqlite3_bind_blob(delete_stmt, 1, key, klen, SQLITE_TRANSIENT);
+            KV_WRITE(klen);
             sqlite3_step(delete_stmt);
             sqlite3_reset(delete_stmt);
         }
+        hist_record(&hist, get_time_ns() - t0);
     }
     
     exec_sql(db, "COMMIT");
@@ -400,19 +1679,82 @@ static void bench_mixed_workload(sqlite3 *db) {
     sqlite3_finalize(update_stmt);
     sqlite3_finalize(delete_stmt);
     
-    print_result("Mixed workload", end - start, total_ops);
+    print_result("Mixed workload", end - start, total_ops, &hist);
 }
 
 /* ==================== BENCHMARK 8: Bulk Insert ==================== */
+
+/* Rows fed to sqlite3_kv_load(), in ascending order or in order[] */
+typedef struct {
+    int next, count;
+    const int *order;
+    char key[MAX_KEY_SIZE + 1];
+} bulk_source;
+
+static int bulk_next(void *ctx, const void **key, int *klen, const void **value, int *vlen) {
+    bulk_source *src = (bulk_source *)ctx;
+    int i;
+    if (src->next >= src->count) return SQLITE_DONE;
+    i = src->order ? src->order[src->next] : src->next;
+    src->next++;
+    *klen = make_key(src->key, "bulk_key_", i);
+    *vlen = make_value(g_value, "bulk_value_%08lld", i, &g_rng);
+    KV_WRITE(*klen + *vlen);
+    *key = src->key;
+    *value = g_value;
+    return SQLITE_ROW;
+}
+
+/* File size, leaf page fill and cells per leaf of kvpairs after a bulk insert or load */
+static void bulk_space(sqlite3 *db) {
+    sqlite3_stmt *stmt = NULL;
+    long long pages = 0, leaves = 0, cells = 0;
+    double leaf_size = 0, leaf_unused = 0;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        pages = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (sqlite3_prepare_v2(db, "SELECT sum(pgsize), sum(unused), count(*), sum(ncell) FROM dbstat "
+                           "WHERE name = 'kvpairs' AND pagetype = 'leaf'", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        leaf_size = sqlite3_column_double(stmt, 0);
+        leaf_unused = sqlite3_column_double(stmt, 1);
+        leaves = sqlite3_column_int64(stmt, 2);
+        cells = sqlite3_column_int64(stmt, 3);
+    }
+    sqlite3_finalize(stmt);
+    printf("  %-30s  %lld pages", "", pages);
+    if (leaf_size > 0) printf(", leaf pages %.1f%% full", 100.0 * (1.0 - leaf_unused / leaf_size));
+    if (leaves > 0) printf(", %lld leaves, %.1f cells per leaf", leaves, (double)cells / leaves);
+    printf("\n");
+}
+
+/*
+** Insert g_cfg.records presorted rows one at a time in one transaction,
+** then again through sqlite3_kv_put() into a fresh database.  Builds with
+** SQLITE_ENABLE_PREFIX_LEAF repeat that with SQLITE_KV_COMPRESS, to
+** compare the leaf counts of the prefix-compressed leaf format with the
+** plain one.  Then load the same rows into a fresh database with
+** sqlite3_kv_load(), which writes the leaf pages in order at --load-fill
+** and builds the interior pages above them instead of descending the
+** tree and splitting pages for every row.  The load is run on the rows in order and on a
+** shuffled copy, which goes through the external merge sorter first.
+*/
 static void bench_bulk_insert(void) {
     print_header("BENCHMARK 8: Bulk Insert (Single Transaction)");
-    printf("  Inserting %d records in one transaction...\n\n", NUM_RECORDS);
+    printf("  Inserting %d records in one transaction...\n\n", g_cfg.records);
     
     sqlite3 *db = NULL;
-    char key[32], value[128];
-    int i, rc;
+    char key[MAX_KEY_SIZE + 1];
+    int i, rc, klen, vlen;
     double start, end;
+    uint64_t t0;
+    latency_hist hist;
     sqlite3_stmt *stmt = NULL;
+    int pass;
     
     remove("benchmark_bulk.db");
     
@@ -429,17 +1771,21 @@ static void bench_bulk_insert(void) {
     
     exec_sql(db, "BEGIN TRANSACTION");
     
+    hist_reset(&hist);
     start = get_time();
     
-    for (i = 0; i < NUM_RECORDS; i++) {
-        snprintf(key, sizeof(key), "bulk_key_%08d", i);
-        snprintf(value, sizeof(value), "bulk_value_%08d", i);
+    for (i = 0; i < g_cfg.records; i++) {
+        klen = make_key(key, "bulk_key_", i);
+        vlen = make_value(g_value, "bulk_value_%08lld", i, &g_rng);
         
-        sqlite3_bind_blob(stmt, 1, key, strlen(key), SQLITE_TRANSIENT);
-        sqlite3_bind_blob(stmt, 2, value, strlen(value), SQLITE_TRANSIENT);
+        t0 = get_time_ns();
+        sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
+        sqlite3_bind_blob(stmt, 2, g_value, vlen, SQLITE_TRANSIENT);
+        KV_WRITE(klen + vlen);
         
         sqlite3_step(stmt);
         sqlite3_reset(stmt);
+        hist_record(&hist, get_time_ns() - t0);
     }
     
     exec_sql(db, "COMMIT");
@@ -447,96 +1793,3712 @@ static void bench_bulk_insert(void) {
     end = get_time();
     
     sqlite3_finalize(stmt);
+    print_result("Bulk insert", end - start, g_cfg.records, &hist);
+    bulk_space(db);
     sqlite3_close(db);
-    remove("benchmark_bulk.db");
-    
-    print_result("Bulk insert", end - start, NUM_RECORDS);
-}
 
-/* ==================== Main ==================== */
-int main(void) {
-    sqlite3 *db = NULL;
-    double total_start, total_end;
-    int rc;
+    /* SQLITE_KV_COMPRESS is ignored without SQLITE_ENABLE_PREFIX_LEAF */
+    for (pass = 0; pass < (sqlite3_compileoption_used("ENABLE_PREFIX_LEAF") ? 2 : 1); pass++) {
+        sqlite3_kv *kv = NULL;
 
-#ifdef _WIN32
-    /* Set UTF-8 output so Unicode box-drawing chars render correctly */
-    SetConsoleOutputCP(CP_UTF8);
-    /* Enable ANSI escape sequence processing for colors */
-    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-    DWORD dwMode = 0;
-    GetConsoleMode(hOut, &dwMode);
-    SetConsoleMode(hOut, dwMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
-#endif
+        remove("benchmark_bulk.db");
+        if (sqlite3_open("benchmark_bulk.db", &db) != SQLITE_OK || init_database(db) != 0
+            || sqlite3_kv_open(db, NULL, "kvpairs", pass ? SQLITE_KV_COMPRESS : 0, &kv) != SQLITE_OK) {
+            fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+            sqlite3_close(db);
+            break;
+        }
+        exec_sql(db, "BEGIN TRANSACTION");
+        hist_reset(&hist);
+        start = get_time();
+        for (i = 0; i < g_cfg.records; i++) {
+            klen = make_key(key, "bulk_key_", i);
+            vlen = make_value(g_value, "bulk_value_%08lld", i, &g_rng);
+            KV_WRITE(klen + vlen);
 
-    printf("\n");
-    printf(COLOR_BLUE "╔══════════════════════════════════════════════════════════════╗\n");
-    printf("║          SQLite Performance Benchmark                        ║\n");
-    printf("║                                                              ║\n");
-    printf("║  Database: %-50s║\n", DB_FILE);
-    printf("║  Records:  %-50d║\n", NUM_RECORDS);
-    printf("╚══════════════════════════════════════════════════════════════╝\n");
-    printf(COLOR_RESET);
-    
-    srand(time(NULL));
-    
-    /* Initialize database */
-    printf("\n" COLOR_YELLOW "Initializing database..." COLOR_RESET "\n");
-    remove(DB_FILE);
-    
-    rc = sqlite3_open(DB_FILE, &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
-        return 1;
+            t0 = get_time_ns();
+            rc = sqlite3_kv_put(kv, key, klen, g_value, vlen);
+            hist_record(&hist, get_time_ns() - t0);
+            if (rc != SQLITE_OK) {
+                fprintf(stderr, "Put failed: %s\n", sqlite3_errmsg(db));
+                break;
+            }
+        }
+        exec_sql(db, "COMMIT");
+        end = get_time();
+
+        print_result(pass ? "Bulk kv_put (compressed)" : "Bulk kv_put", end - start, g_cfg.records, &hist);
+        bulk_space(db);
+        sqlite3_kv_close(kv);
+        sqlite3_close(db);
     }
-    
-    if (init_database(db) != 0) {
-        fprintf(stderr, "Failed to initialize database\n");
+    remove("benchmark_bulk.db");
+
+    int *order = (int *)malloc(g_cfg.records * sizeof(int));
+    if (order == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return;
+    }
+    for (i = 0; i < g_cfg.records; i++) order[i] = i;
+    for (i = g_cfg.records - 1; i > 0; i--) {
+        int j = (int)(rng_next(&g_rng) % (uint64_t)(i + 1));
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    printf("\n  Loading them with sqlite3_kv_load() at %d%% page fill...\n\n", g_cfg.load_fill);
+
+    for (pass = 0; pass < 2; pass++) {
+        sqlite3_kv *kv = NULL;
+        bulk_source src;
+
+        remove("benchmark_bulk.db");
+        if (sqlite3_open("benchmark_bulk.db", &db) != SQLITE_OK || init_database(db) != 0
+            || sqlite3_kv_open(db, NULL, "kvpairs", 0, &kv) != SQLITE_OK) {
+            fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+            sqlite3_close(db);
+            break;
+        }
+        memset(&src, 0, sizeof(src));
+        src.count = g_cfg.records;
+        src.order = pass ? order : NULL;
+
+        start = get_time();
+        rc = sqlite3_kv_load(kv, g_cfg.load_fill, pass ? SQLITE_KV_LOAD_UNSORTED : 0, bulk_next, &src);
+        end = get_time();
+        if (rc != SQLITE_OK) fprintf(stderr, "Bulk load failed: %s\n", sqlite3_errmsg(db));
+
+        print_result(pass ? "Bulk load (unsorted input)" : "Bulk load (sorted input)",
+                     end - start, g_cfg.records, NULL);
+        bulk_space(db);
+        sqlite3_kv_close(kv);
         sqlite3_close(db);
-        return 1;
     }
-    
-    total_start = get_time();
-    
-    /* Run benchmarks */
-    bench_sequential_writes(db);
-    bench_random_reads(db);
-    bench_sequential_scan(db);
-    bench_random_updates(db);
-    bench_random_deletes(db);
-    bench_exists_checks(db);
-    bench_mixed_workload(db);
-    
-    /* Get database stats */
+    remove("benchmark_bulk.db");
+    free(order);
+}
+
+/* ==================== BENCHMARK 9: Value Sizes and Overflow Pages ==================== */
+
+/* dbstat's count of the overflow pages of kvpairs, -1 without SQLITE_ENABLE_DBSTAT_VTAB */
+static long long count_overflow_pages(sqlite3 *db) {
     sqlite3_stmt *stmt = NULL;
-    rc = sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM kvpairs", -1, &stmt, NULL);
-    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
-        printf("  Records remaining: %d\n", sqlite3_column_int(stmt, 0));
+    long long pages = -1;
+    if (sqlite3_prepare_v2(db, "SELECT count(*) FROM dbstat WHERE name = 'kvpairs' AND pagetype = 'overflow'",
+                           -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        pages = sqlite3_column_int64(stmt, 0);
     }
     sqlite3_finalize(stmt);
-    
-    /* Get page count and size */
-    rc = sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, NULL);
-    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
-        int page_count = sqlite3_column_int(stmt, 0);
-        sqlite3_finalize(stmt);
-        
-        rc = sqlite3_prepare_v2(db, "PRAGMA page_size", -1, &stmt, NULL);
-        if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
-            int page_size = sqlite3_column_int(stmt, 0);
-            printf("  Database size: %.2f MB (%d pages × %d bytes)\n",
-                   (page_count * page_size) / (1024.0 * 1024.0),
-                   page_count, page_size);
+    return pages;
+}
+
+/* Pages fetched through the page cache since the last call */
+static long long cache_page_gets(sqlite3 *db) {
+    int hit = 0, miss = 0, hw;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &hit, &hw, 1);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &miss, &hw, 1);
+    return (long long)hit + miss;
+}
+
+typedef struct {
+    int size;
+    int rows;
+    double write_ops, read_ops;     /* ops/sec */
+    double pin_ops;                 /* ops/sec of the same reads through sqlite3_kv_pin() */
+    double write_gets, read_gets;   /* Page cache fetches per operation */
+    long long overflow;             /* Overflow pages in the table, -1 if unknown */
+    double db_mb;
+} value_size_result;
+
+/*
+** Write and then randomly read fixed-size values, one fresh database per
+** size.  A payload (record header, key and value) larger than the leaf
+** limit of an index b-tree spills everything past the first few hundred
+** bytes into a chain of overflow pages, which fillInCell() builds on
+** insert and accessPayload() walks on every read.  The reads are then
+** repeated through sqlite3_kv_pin(), which leaves the value in the pages
+** that hold it instead of copying it out.  Rows and reads per size are
+** capped at VALUE_SUITE_BYTES of value data.
+*/
+static void bench_value_sizes(void) {
+    print_header("BENCHMARK 9: Value Sizes and Overflow Pages");
+
+    int usable = g_cfg.page_size;
+    int max_local = (usable - 12) * 64 / 255 - 23;
+    int min_local = (usable - 12) * 32 / 255 - 23;
+    int max_size = 0, s, i, n;
+    value_size_result *results;
+    char *value;
+    uint64_t rng = rng_seed(g_cfg.seed ^ 0x76616c756573ULL);
+
+    if (g_cfg.num_value_sizes <= 0) {
+        printf("  No value sizes to sweep\n");
+        return;
+    }
+    for (s = 0; s < g_cfg.num_value_sizes; s++) {
+        if (g_cfg.value_sizes[s] > max_size) max_size = g_cfg.value_sizes[s];
+    }
+    value = (char *)malloc((size_t)max_size + 64);
+    results = (value_size_result *)calloc((size_t)g_cfg.num_value_sizes, sizeof(value_size_result));
+    if (value == NULL || results == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        free(value);
+        free(results);
+        return;
+    }
+    for (i = 0; i < max_size + 64; i++) value[i] = 'a' + (char)(rng_next(&rng) % 26);
+    printf("  Page size %d: payloads over %d bytes overflow, keeping %d-%d bytes on the leaf\n",
+           g_cfg.page_size, max_local, min_local, max_local);
+
+    for (s = 0; s < g_cfg.num_value_sizes; s++) {
+        value_size_result *r = &results[s];
+        sqlite3 *db = NULL;
+        sqlite3_stmt *insert_stmt = NULL, *select_stmt = NULL;
+        sqlite3_kv *kv = NULL;
+        key_chooser keys;
+        uint64_t read_rng;
+        latency_hist hist;
+        char key[MAX_KEY_SIZE + 1], name[48];
+        int klen, rc, reads;
+        long long gets, bytes = 0;
+        double start, end;
+        uint64_t t0;
+
+        r->size = g_cfg.value_sizes[s];
+        r->rows = (int)(VALUE_SUITE_BYTES / r->size);
+        if (r->rows < VALUE_SUITE_MIN_OPS) r->rows = VALUE_SUITE_MIN_OPS;
+        if (r->rows > g_cfg.records) r->rows = g_cfg.records;
+        reads = (int)(VALUE_SUITE_BYTES / r->size);
+        if (reads < VALUE_SUITE_MIN_OPS) reads = VALUE_SUITE_MIN_OPS;
+        if (reads > g_cfg.reads) reads = g_cfg.reads;
+
+        printf("\n  " COLOR_YELLOW "%d-byte values" COLOR_RESET ": %d rows, %d reads\n", r->size, r->rows, reads);
+
+        remove(VALUES_DB_FILE);
+        rc = sqlite3_open(VALUES_DB_FILE, &db);
+        if (rc != SQLITE_OK || init_database(db) != 0) {
+            fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+            sqlite3_close(db);
+            break;
+        }
+        sqlite3_prepare_v2(db, "INSERT INTO kvpairs (key, value) VALUES (?, ?)", -1, &insert_stmt, NULL);
+        sqlite3_prepare_v2(db, "SELECT value FROM kvpairs WHERE key = ?", -1, &select_stmt, NULL);
+
+        /* Write: batched transactions, the COMMIT charged to the op that triggers it */
+        hist_reset(&hist);
+        cache_page_gets(db);
+        start = get_time();
+        exec_sql(db, "BEGIN TRANSACTION");
+        for (i = 0; i < r->rows; i++) {
+            klen = make_key(key, "key_", i);
+            t0 = get_time_ns();
+            sqlite3_bind_blob(insert_stmt, 1, key, klen, SQLITE_STATIC);
+            sqlite3_bind_blob(insert_stmt, 2, value + (i & 63), r->size, SQLITE_STATIC);
+            KV_WRITE(klen + r->size);
+            rc = sqlite3_step(insert_stmt);
+            if (rc != SQLITE_DONE) {
+                fprintf(stderr, "Insert failed: %s\n", sqlite3_errmsg(db));
+            }
+            sqlite3_reset(insert_stmt);
+            if ((i + 1) % g_cfg.batch_size == 0 || i + 1 == r->rows) {
+                exec_sql(db, "COMMIT");
+                if (i + 1 < r->rows) exec_sql(db, "BEGIN TRANSACTION");
+            }
+            hist_record(&hist, get_time_ns() - t0);
+        }
+        end = get_time();
+        gets = cache_page_gets(db);
+        r->write_ops = r->rows / (end - start);
+        r->write_gets = (double)gets / r->rows;
+        snprintf(name, sizeof(name), "Value %d B write", r->size);
+        print_result(name, end - start, r->rows, &hist);
+        printf("    %.1f MB/s, %.1f page gets/op\n",
+               r->write_ops * r->size / (1024.0 * 1024.0), r->write_gets);
+
+        /* Read: random keys, the whole value fetched and touched */
+        key_chooser_init(&keys, g_cfg.dist, r->rows, g_cfg.theta, g_cfg.hot_set, g_cfg.hot_ops);
+        read_rng = rng;
+        hist_reset(&hist);
+        start = get_time();
+        for (i = 0; i < reads; i++) {
+            klen = make_key(key, "key_", key_next(&keys, &rng));
+            t0 = get_time_ns();
+            sqlite3_bind_blob(select_stmt, 1, key, klen, SQLITE_STATIC);
+            if (sqlite3_step(select_stmt) == SQLITE_ROW) {
+                const unsigned char *v = (const unsigned char *)sqlite3_column_blob(select_stmt, 0);
+                n = sqlite3_column_bytes(select_stmt, 0);
+                if (v && n > 0) bytes += v[n - 1];
+                KV_READ(klen + n);
+            }
+            sqlite3_reset(select_stmt);
+            hist_record(&hist, get_time_ns() - t0);
+        }
+        end = get_time();
+        gets = cache_page_gets(db);
+        r->read_ops = reads / (end - start);
+        r->read_gets = (double)gets / reads;
+        snprintf(name, sizeof(name), "Value %d B read", r->size);
+        print_result(name, end - start, reads, &hist);
+        printf("    %.1f MB/s, %.1f page gets/op\n",
+               r->read_ops * r->size / (1024.0 * 1024.0), r->read_gets);
+
+        /* The same reads with the value pinned in place rather than copied */
+        key_chooser_init(&keys, g_cfg.dist, r->rows, g_cfg.theta, g_cfg.hot_set, g_cfg.hot_ops);
+        rng = read_rng;
+        if (sqlite3_kv_open(db, NULL, "kvpairs", 0, &kv) == SQLITE_OK) {
+            hist_reset(&hist);
+            start = get_time();
+            for (i = 0; i < reads; i++) {
+                sqlite3_kv_pinned *pin = NULL;
+                klen = make_key(key, "key_", key_next(&keys, &rng));
+                t0 = get_time_ns();
+                if (sqlite3_kv_pin(kv, key, klen, &pin) == SQLITE_OK) {
+                    int nx = sqlite3_kv_pinned_count(pin);
+                    const unsigned char *v = (const unsigned char *)sqlite3_kv_pinned_extent(pin, nx - 1, &n);
+                    if (v && n > 0) bytes += v[n - 1];
+                    KV_READ(klen + sqlite3_kv_pinned_size(pin));
+                    sqlite3_kv_unpin(pin);
+                }
+                hist_record(&hist, get_time_ns() - t0);
+            }
+            end = get_time();
+            r->pin_ops = reads / (end - start);
+            snprintf(name, sizeof(name), "Value %d B pinned read", r->size);
+            print_result(name, end - start, reads, &hist);
+            printf("    %.1f MB/s, %.2fx the copying read\n",
+                   r->pin_ops * r->size / (1024.0 * 1024.0), r->pin_ops / r->read_ops);
+            sqlite3_kv_close(kv);
+        }
+
+        r->overflow = count_overflow_pages(db);
+        {
+            sqlite3_stmt *stmt = NULL;
+            if (sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, NULL) == SQLITE_OK
+                && sqlite3_step(stmt) == SQLITE_ROW) {
+                r->db_mb = (double)sqlite3_column_int64(stmt, 0) * g_cfg.page_size / (1024.0 * 1024.0);
+            }
+            sqlite3_finalize(stmt);
+        }
+        if (bytes == 0) printf("    (no values read back)\n");
+
+        sqlite3_finalize(insert_stmt);
+        sqlite3_finalize(select_stmt);
+        sqlite3_close(db);
+        remove(VALUES_DB_FILE);
+    }
+
+    printf("\n  %10s %10s %12s %10s %12s %10s %9s %12s %10s\n", "value", "ovfl/row", "write ops/s",
+           "write MB/s", "read ops/s", "read MB/s", "gets/read", "pinned ops/s", "db MB");
+    for (i = 0; i < s; i++) {
+        const value_size_result *r = &results[i];
+        char ovfl[32];
+        if (r->overflow < 0) {
+            snprintf(ovfl, sizeof(ovfl), "n/a");
+        } else {
+            snprintf(ovfl, sizeof(ovfl), "%.2f", (double)r->overflow / r->rows);
         }
+        printf("  %10d %10s %12.0f %10.1f %12.0f %10.1f %9.1f %12.0f %10.1f\n", r->size, ovfl,
+               r->write_ops, r->write_ops * r->size / (1024.0 * 1024.0),
+               r->read_ops, r->read_ops * r->size / (1024.0 * 1024.0), r->read_gets, r->pin_ops, r->db_mb);
+    }
+    printf("  ovfl/row is also the overflow pages each full read or write of a value walks;\n"
+           "  overflow reads that bypass the page cache (DIRECT_OVERFLOW_READ) are not in gets.\n");
+
+    free(value);
+    free(results);
+}
+
+/* ==================== BENCHMARK 10: Restart with Cold and Warm Caches ==================== */
+enum {
+    CACHE_COLD    = 1 << 0,
+    CACHE_OS_WARM = 1 << 1,
+    CACHE_WARM    = 1 << 2
+};
+
+static const char *cache_state_names[] = { "cold", "os-warm", "warm" };
+
+/* Evict path from the OS page cache; -1 where that is not possible */
+static int drop_os_cache(const char *path) {
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+    int fd = open(path, O_RDONLY);
+    int rc;
+    if (fd < 0) return -1;
+    fsync(fd);      /* Dirty pages would survive DONTNEED */
+    rc = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    return rc == 0 ? 0 : -1;
+#else
+    (void)path;
+    return -1;
+#endif
+}
+
+/* Read path end to end so the OS caches all of it */
+static void warm_os_cache(const char *path) {
+    char buf[64 * 1024];
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return;
+    while (fread(buf, 1, sizeof(buf), f) == sizeof(buf)) {
+    }
+    fclose(f);
+}
+
+/* Full scan that pulls every b-tree page through the pager cache */
+static void prewarm_pager(sqlite3 *db) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "SELECT key, value FROM kvpairs", -1, &stmt, NULL) != SQLITE_OK) return;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        sqlite3_column_blob(stmt, 1);
     }
     sqlite3_finalize(stmt);
-    
+}
+
+/*
+** Close db, as a restarting process would, and open it again in the
+** given cache state.  Closing the last connection checkpoints the WAL,
+** so afterwards the database file holds every page.
+*/
+static sqlite3 *reopen_database(sqlite3 *db, int state) {
+    static int warned;
+
     sqlite3_close(db);
-    
-    /* Run bulk insert test */
-    bench_bulk_insert();
-    total_end = get_time();
-    
+    db = NULL;
+    if (state == CACHE_COLD && drop_os_cache(DB_FILE) != 0 && !warned) {
+        printf("  " COLOR_YELLOW "Can't drop the OS cache here; cold runs are only pager-cold" COLOR_RESET "\n");
+        warned = 1;
+    }
+    if (state == CACHE_OS_WARM) warm_os_cache(DB_FILE);
+    if (sqlite3_open(DB_FILE, &db) != SQLITE_OK) {
+        fprintf(stderr, "Can't reopen database: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    apply_connection_pragmas(db);
+    if (state == CACHE_WARM) prewarm_pager(db);
+    return db;
+}
+
+/*
+** Rerun the selected read benchmarks (random reads if none is) right
+** after a reopen, in each configured cache state:
+**   cold     pager cache empty, file evicted from the OS cache
+**   os-warm  pager cache empty, file in the OS cache
+**   warm     pager cache prewarmed by a full scan
+** Returns the new connection, or NULL if the database can't be reopened.
+*/
+static sqlite3 *bench_restart(sqlite3 *db) {
+    unsigned int kinds = g_cfg.benchmarks & (BENCH_READS | BENCH_EXISTS | BENCH_SCAN);
+    long long cache_pages, page_count = 0;
+    sqlite3_stmt *stmt = NULL;
+    int s;
+
+    print_header("BENCHMARK 10: Restart with Cold and Warm Caches");
+    if (kinds == 0) kinds = BENCH_READS;
+    cache_pages = g_cfg.cache_size >= 0 ? g_cfg.cache_size
+                                        : -(long long)g_cfg.cache_size * 1024 / g_cfg.page_size;
+    if (sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, NULL) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW) {
+        page_count = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    printf("  Each read benchmark runs on a freshly reopened connection.\n");
+    printf("  Database %lld pages, pager cache %lld pages%s\n", page_count, cache_pages,
+           cache_pages < page_count ? " (warm runs only keep part of it)" : "");
+
+    for (s = 0; s < 3; s++) {
+        int state = 1 << s;
+        if (!(g_cfg.cache_states & state)) continue;
+        printf("\n  " COLOR_YELLOW "%s" COLOR_RESET "\n", cache_state_names[s]);
+        if (kinds & BENCH_READS) {
+            if ((db = reopen_database(db, state)) == NULL) return NULL;
+            perf_mark();
+            io_mark();
+            bench_random_reads(db, cache_state_names[s]);
+        }
+        if (kinds & BENCH_EXISTS) {
+            if ((db = reopen_database(db, state)) == NULL) return NULL;
+            perf_mark();
+            io_mark();
+            bench_exists_checks(db, cache_state_names[s]);
+        }
+        if (kinds & BENCH_SCAN) {
+            if ((db = reopen_database(db, state)) == NULL) return NULL;
+            perf_mark();
+            io_mark();
+            bench_sequential_scan(db, cache_state_names[s]);
+        }
+    }
+    return db;
+}
+
+/* ==================== BENCHMARK 11: Range and Prefix Scans ==================== */
+
+/*
+** Bounded scans as a KV service issues them: a range query
+** "key >= start AND key < end LIMIT n" and a prefix iteration over all
+** keys sharing the leading digits of the start key.  Start keys follow
+** --dist.  The first step of each scan is the seek
+** (sqlite3BtreeIndexMoveto); every later step is one sqlite3BtreeNext,
+** so the two are timed into separate histograms.
+*/
+static void run_scans(sqlite3 *db, int prefix, int length) {
+    char start_key[MAX_KEY_SIZE + 1], end_key[MAX_KEY_SIZE + 1], name[48];
+    int i, rc, slen, elen, digits = 0;
+    long long span = 1, idx, rows = 0;
+    double start, end, seek_total = 0;
+    uint64_t t0, t1, t;
+    latency_hist hist, seek_hist, row_hist;
+    sqlite3_stmt *stmt = NULL;
+
+    if (prefix) {
+        /* The prefix drops the last digits of the index: 10^digits keys */
+        while (span * 10 <= length && digits < 8) {
+            span *= 10;
+            digits++;
+        }
+        rc = sqlite3_prepare_v2(db, "SELECT key, value FROM kvpairs WHERE key >= ? AND key < ? ORDER BY key",
+                                -1, &stmt, NULL);
+        snprintf(name, sizeof(name), "Prefix scan %lld", span);
+    } else {
+        rc = sqlite3_prepare_v2(db, "SELECT key, value FROM kvpairs WHERE key >= ? AND key < ? ORDER BY key LIMIT ?",
+                                -1, &stmt, NULL);
+        snprintf(name, sizeof(name), "Range scan %d", length);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return;
+    }
+
+    /* Bound once: binding a LIMIT parameter expires the statement (the
+    ** planner looks at its value), so rebinding it per scan would
+    ** re-prepare every time */
+    if (!prefix) sqlite3_bind_int(stmt, 3, length);
+
+    hist_reset(&hist);
+    hist_reset(&seek_hist);
+    hist_reset(&row_hist);
+    start = get_time();
+
+    for (i = 0; i < g_cfg.scans; i++) {
+        idx = key_next(&g_keys, &g_rng);
+        if (prefix) {
+            /* "key_000012" up to, not including, "key_000013" */
+            slen = snprintf(start_key, sizeof(start_key), "key_%08lld", idx / span * span) - digits;
+            memcpy(end_key, start_key, slen);
+            elen = slen;
+            end_key[elen - 1]++;
+        } else {
+            slen = make_key(start_key, "key_", idx);
+            elen = make_key(end_key, "key_", idx + length);
+        }
+
+        t0 = get_time_ns();
+        sqlite3_bind_blob(stmt, 1, start_key, slen, SQLITE_TRANSIENT);
+        sqlite3_bind_blob(stmt, 2, end_key, elen, SQLITE_TRANSIENT);
+        rc = sqlite3_step(stmt);
+        t1 = get_time_ns();
+        hist_record(&seek_hist, t1 - t0);
+        seek_total += (double)(t1 - t0);
+        while (rc == SQLITE_ROW) {
+            sqlite3_column_blob(stmt, 0);
+            sqlite3_column_blob(stmt, 1);
+            KV_READ(sqlite3_column_bytes(stmt, 0) + sqlite3_column_bytes(stmt, 1));
+            rows++;
+            rc = sqlite3_step(stmt);
+            t = get_time_ns();
+            if (rc == SQLITE_ROW) hist_record(&row_hist, t - t1);
+            t1 = t;
+        }
+        sqlite3_reset(stmt);
+        hist_record(&hist, get_time_ns() - t0);
+    }
+
+    end = get_time();
+    sqlite3_finalize(stmt);
+
+    print_result(name, end - start, g_cfg.scans, &hist);
+    print_latency("  seek (first row)", &seek_hist);
+    print_latency("  next (per row)", &row_hist);
+    printf("    %.1f rows/scan, %.0f rows/sec, seek %.1f%% of scan time\n",
+           (double)rows / g_cfg.scans, rows / (end - start),
+           100.0 * seek_total / ((end - start) * 1e9));
+}
+
+static void bench_range_scans(sqlite3 *db) {
+    char dist_desc[64];
+    int i;
+
+    print_header("BENCHMARK 11: Range and Prefix Scans");
+    describe_dist(&g_keys, dist_desc, sizeof(dist_desc));
+    printf("  %d scans per length, start keys %s...\n", g_cfg.scans, dist_desc);
+    for (i = 0; i < g_cfg.num_scan_lengths; i++) {
+        printf("\n");
+        run_scans(db, 0, g_cfg.scan_lengths[i]);
+    }
+    for (i = 0; i < g_cfg.num_scan_lengths; i++) {
+        printf("\n");
+        run_scans(db, 1, g_cfg.scan_lengths[i]);
+    }
+}
+
+/* ==================== YCSB Core Workloads ==================== */
+typedef enum {
+    YCSB_READ,
+    YCSB_UPDATE,
+    YCSB_INSERT,
+    YCSB_SCAN,
+    YCSB_RMW,
+    YCSB_NUM_OPS
+} ycsb_op;
+
+static const char *ycsb_op_names[] = { "read", "update", "insert", "scan", "read-modify-write" };
+
+typedef struct {
+    char name;
+    const char *desc;
+    int mix[YCSB_NUM_OPS];      /* Percentage of operations of each type */
+    key_dist dist;              /* Request distribution unless --dist is given */
+} ycsb_workload;
+
+static const ycsb_workload ycsb_workloads[] = {
+    { 'A', "update heavy",      { 50, 50, 0,  0,  0  }, DIST_ZIPFIAN },
+    { 'B', "read mostly",       { 95, 5,  0,  0,  0  }, DIST_ZIPFIAN },
+    { 'C', "read only",         { 100, 0, 0,  0,  0  }, DIST_ZIPFIAN },
+    { 'D', "read latest",       { 95, 0,  5,  0,  0  }, DIST_LATEST  },
+    { 'E', "short ranges",      { 0,  0,  5,  95, 0  }, DIST_ZIPFIAN },
+    { 'F', "read-modify-write", { 50, 0,  0,  0,  50 }, DIST_ZIPFIAN },
+};
+
+static const ycsb_workload *ycsb_find(char name) {
+    size_t i;
+    for (i = 0; i < sizeof(ycsb_workloads) / sizeof(ycsb_workloads[0]); i++) {
+        if (ycsb_workloads[i].name == name) return &ycsb_workloads[i];
+    }
+    return NULL;
+}
+
+/*
+** Run one workload against the loaded kvpairs table.  Every operation is
+** its own transaction, as with a YCSB client in autocommit mode; inserts
+** append new keys and extend the key space (which is what makes
+** workload D's "latest" distribution move).  *records tracks the key
+** space across workloads.
+*/
+static void bench_ycsb(sqlite3 *db, const ycsb_workload *w, key_dist dist, long long *records) {
+    char title[64], name[48], label[64], key[MAX_KEY_SIZE + 1];
+    int i, t, rc, klen, vlen;
+    int counts[YCSB_NUM_OPS] = { 0 };
+    double start, end;
+    uint64_t t0;
+    key_chooser keys;
+    latency_hist *hist;     /* YCSB_NUM_OPS per-type histograms, then the total */
+    sqlite3_stmt *read_stmt = NULL, *update_stmt = NULL;
+    sqlite3_stmt *insert_stmt = NULL, *scan_stmt = NULL;
+
+    snprintf(name, sizeof(name), "Workload %c (%s)", w->name, w->desc);
+    snprintf(title, sizeof(title), "YCSB %s", name);
+    print_header(title);
+    key_chooser_init(&keys, dist, *records, g_keys.theta, g_keys.hot_set, g_keys.hot_ops);
+    describe_dist(&keys, label, sizeof(label));
+    printf("  %d operations, %d%% read, %d%% update, %d%% insert, %d%% scan, %d%% rmw\n",
+           g_cfg.ycsb_ops, w->mix[YCSB_READ], w->mix[YCSB_UPDATE], w->mix[YCSB_INSERT],
+           w->mix[YCSB_SCAN], w->mix[YCSB_RMW]);
+    printf("  Key distribution: %s over %lld keys...\n\n", label, *records);
+
+    hist = (latency_hist *)malloc(sizeof(latency_hist) * (YCSB_NUM_OPS + 1));
+    if (hist == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return;
+    }
+    for (t = 0; t <= YCSB_NUM_OPS; t++) hist_reset(&hist[t]);
+
+    rc = sqlite3_prepare_v2(db, "SELECT value FROM kvpairs WHERE key = ?", -1, &read_stmt, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db, "UPDATE kvpairs SET value = ? WHERE key = ?", -1, &update_stmt, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO kvpairs (key, value) VALUES (?, ?)",
+                                -1, &insert_stmt, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db, "SELECT key, value FROM kvpairs WHERE key >= ? ORDER BY key LIMIT ?",
+                                -1, &scan_stmt, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        goto done;
+    }
+
+    start = get_time();
+
+    for (i = 0; i < g_cfg.ycsb_ops; i++) {
+        int pick = (int)(rng_next(&g_rng) % 100);
+        long long idx;
+
+        for (t = 0; t < YCSB_RMW && pick >= w->mix[t]; t++) pick -= w->mix[t];
+
+        if (t == YCSB_INSERT) {
+            idx = *records;
+        } else {
+            idx = key_next(&keys, &g_rng);
+        }
+        klen = make_key(key, "key_", idx);
+        vlen = make_value(g_value, "ycsb_value_%08lld", idx, &g_rng);
+
+        t0 = get_time_ns();
+        switch (t) {
+        case YCSB_READ:
+            sqlite3_bind_blob(read_stmt, 1, key, klen, SQLITE_TRANSIENT);
+            if (sqlite3_step(read_stmt) == SQLITE_ROW) {
+                sqlite3_column_blob(read_stmt, 0);
+                KV_READ(klen + sqlite3_column_bytes(read_stmt, 0));
+            }
+            sqlite3_reset(read_stmt);
+            break;
+        case YCSB_UPDATE:
+            sqlite3_bind_blob(update_stmt, 1, g_value, vlen, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(update_stmt, 2, key, klen, SQLITE_TRANSIENT);
+            KV_WRITE(klen + vlen);
+            sqlite3_step(update_stmt);
+            sqlite3_reset(update_stmt);
+            break;
+        case YCSB_INSERT:
+            sqlite3_bind_blob(insert_stmt, 1, key, klen, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(insert_stmt, 2, g_value, vlen, SQLITE_TRANSIENT);
+            KV_WRITE(klen + vlen);
+            if (sqlite3_step(insert_stmt) == SQLITE_DONE) {
+                (*records)++;
+                key_chooser_grow(&keys, *records);
+            }
+            sqlite3_reset(insert_stmt);
+            break;
+        case YCSB_SCAN:
+            sqlite3_bind_blob(scan_stmt, 1, key, klen, SQLITE_TRANSIENT);
+            sqlite3_bind_int(scan_stmt, 2, 1 + (int)(rng_next(&g_rng) % YCSB_MAX_SCAN));
+            while (sqlite3_step(scan_stmt) == SQLITE_ROW) {
+                sqlite3_column_blob(scan_stmt, 0);
+                sqlite3_column_blob(scan_stmt, 1);
+                KV_READ(sqlite3_column_bytes(scan_stmt, 0) + sqlite3_column_bytes(scan_stmt, 1));
+            }
+            sqlite3_reset(scan_stmt);
+            break;
+        case YCSB_RMW:
+            exec_sql(db, "BEGIN");
+            sqlite3_bind_blob(read_stmt, 1, key, klen, SQLITE_TRANSIENT);
+            if (sqlite3_step(read_stmt) == SQLITE_ROW) {
+                sqlite3_column_blob(read_stmt, 0);
+                KV_READ(klen + sqlite3_column_bytes(read_stmt, 0));
+            }
+            sqlite3_reset(read_stmt);
+            sqlite3_bind_blob(update_stmt, 1, g_value, vlen, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(update_stmt, 2, key, klen, SQLITE_TRANSIENT);
+            KV_WRITE(klen + vlen);
+            sqlite3_step(update_stmt);
+            sqlite3_reset(update_stmt);
+            exec_sql(db, "COMMIT");
+            break;
+        }
+        t0 = get_time_ns() - t0;
+        hist_record(&hist[t], t0);
+        hist_record(&hist[YCSB_NUM_OPS], t0);
+        counts[t]++;
+    }
+
+    end = get_time();
+
+    print_result(name, end - start, g_cfg.ycsb_ops, &hist[YCSB_NUM_OPS]);
+    for (t = 0; t < YCSB_NUM_OPS; t++) {
+        if (counts[t] == 0) continue;
+        snprintf(label, sizeof(label), "  %s (%d ops)", ycsb_op_names[t], counts[t]);
+        print_latency(label, &hist[t]);
+    }
+
+done:
+    sqlite3_finalize(read_stmt);
+    sqlite3_finalize(update_stmt);
+    sqlite3_finalize(insert_stmt);
+    sqlite3_finalize(scan_stmt);
+    free(hist);
+}
+
+/* ==================== Multi-threaded Readers/Writers ==================== */
+
+/*
+** Each thread owns its connection and its RNG state; nothing is shared
+** between threads except the database file, so the numbers reflect
+** contention inside SQLite (WAL read marks, the WAL write lock) rather
+** than in the harness.
+*/
+typedef struct {
+    int id;
+    int is_writer;
+    double duration;
+    uint64_t rng;
+    key_chooser keys;
+    char *value;                /* Per-thread value buffer */
+    long long ops;
+    long long busy_retries;     /* Busy-handler invocations */
+    long long busy_errors;      /* SQLITE_BUSY that reached the caller */
+    long long other_errors;
+    long long kv_bytes;         /* Logical key/value bytes read or written */
+    double elapsed;
+    latency_hist hist;
+} mt_thread;
+
+static int mt_busy_handler(void *arg, int count) {
+    mt_thread *t = (mt_thread *)arg;
+    t->busy_retries++;
+    if (count >= MT_BUSY_RETRIES) return 0;
+    sqlite3_sleep(1);
+    return 1;
+}
+
+static void mt_count_error(mt_thread *t, int rc) {
+    if ((rc & 0xff) == SQLITE_BUSY) {
+        t->busy_errors++;
+    } else {
+        t->other_errors++;
+    }
+}
+
+static void mt_run_reader(mt_thread *t, sqlite3 *db) {
+    char key[MAX_KEY_SIZE + 1];
+    int rc, klen;
+    double start, deadline;
+    uint64_t t0;
+    sqlite3_stmt *stmt = NULL;
+
+    rc = sqlite3_prepare_v2(db, "SELECT value FROM kvpairs WHERE key = ?", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Reader %d: failed to prepare statement: %s\n", t->id, sqlite3_errmsg(db));
+        return;
+    }
+
+    start = get_time();
+    deadline = start + t->duration;
+
+    while (get_time() < deadline) {
+        klen = make_key(key, "key_", key_next(&t->keys, &t->rng));
+
+        t0 = get_time_ns();
+        sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
+        rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) {
+            sqlite3_column_blob(stmt, 0);
+            t->kv_bytes += klen + sqlite3_column_bytes(stmt, 0);
+        }
+        sqlite3_reset(stmt);
+        if (rc == SQLITE_ROW || rc == SQLITE_DONE) {
+            hist_record(&t->hist, get_time_ns() - t0);
+            t->ops++;
+        } else {
+            mt_count_error(t, rc);
+        }
+    }
+
+    t->elapsed = get_time() - start;
+    sqlite3_finalize(stmt);
+}
+
+static void mt_run_writer(mt_thread *t, sqlite3 *db) {
+    char key[MAX_KEY_SIZE + 1];
+    int i, rc, klen, vlen;
+    double start, deadline;
+    uint64_t t0, lat[MT_WRITE_BATCH];
+    long long bytes;
+    sqlite3_stmt *stmt = NULL;
+
+    rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO kvpairs (key, value) VALUES (?, ?)", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Writer %d: failed to prepare statement: %s\n", t->id, sqlite3_errmsg(db));
+        return;
+    }
+
+    start = get_time();
+    deadline = start + t->duration;
+
+    while (get_time() < deadline) {
+        /* BEGIN IMMEDIATE takes the WAL write lock up front */
+        rc = sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+        if (rc != SQLITE_OK) {
+            mt_count_error(t, rc);
+            continue;
+        }
+
+        bytes = 0;
+        for (i = 0; i < MT_WRITE_BATCH; i++) {
+            long long idx = key_next(&t->keys, &t->rng);
+            klen = make_key(key, "key_", idx);
+            vlen = make_value(t->value, "mt_value_%08lld", idx, &t->rng);
+
+            t0 = get_time_ns();
+            sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(stmt, 2, t->value, vlen, SQLITE_TRANSIENT);
+            rc = sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            lat[i] = get_time_ns() - t0;
+            bytes += klen + vlen;
+            if (rc != SQLITE_DONE) {
+                mt_count_error(t, rc);
+                break;
+            }
+        }
+
+        if (rc == SQLITE_DONE) {
+            t0 = get_time_ns();
+            rc = sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+            if (rc == SQLITE_OK) {
+                /* Charge the commit to the last row of the batch */
+                lat[MT_WRITE_BATCH - 1] += get_time_ns() - t0;
+                for (i = 0; i < MT_WRITE_BATCH; i++) hist_record(&t->hist, lat[i]);
+                t->ops += MT_WRITE_BATCH;
+                t->kv_bytes += bytes;
+                continue;
+            }
+            mt_count_error(t, rc);
+        }
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    }
+
+    t->elapsed = get_time() - start;
+    sqlite3_finalize(stmt);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI mt_thread_main(LPVOID arg) {
+#else
+static void *mt_thread_main(void *arg) {
+#endif
+    mt_thread *t = (mt_thread *)arg;
+    sqlite3 *db = NULL;
+
+    if (sqlite3_open(DB_FILE, &db) != SQLITE_OK) {
+        fprintf(stderr, "Thread %d: can't open database: %s\n", t->id, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return 0;
+    }
+    sqlite3_busy_handler(db, mt_busy_handler, t);
+    apply_connection_pragmas(db);
+
+    if (t->is_writer) {
+        t->value = (char *)malloc(value_capacity());
+        if (t->value) mt_run_writer(t, db);
+        free(t->value);
+    } else {
+        mt_run_reader(t, db);
+    }
+
+    sqlite3_close(db);
+    return 0;
+}
+
+static void print_mt_totals(const char *role, mt_thread *threads, int n, int want_writer) {
+    long long ops = 0, retries = 0, busy = 0;
+    double ops_per_sec = 0, elapsed = 0;
+    char buf[32];
+    latency_hist *hist;
+    int i;
+
+    hist = (latency_hist *)malloc(sizeof(*hist));
+    if (hist) hist_reset(hist);
+    for (i = 0; i < n; i++) {
+        if (threads[i].is_writer != want_writer) continue;
+        ops += threads[i].ops;
+        retries += threads[i].busy_retries;
+        busy += threads[i].busy_errors;
+        if (threads[i].elapsed > 0) ops_per_sec += threads[i].ops / threads[i].elapsed;
+        if (threads[i].elapsed > elapsed) elapsed = threads[i].elapsed;
+        if (hist) hist_merge(hist, &threads[i].hist);
+    }
+    format_number((long long)ops_per_sec, buf, sizeof(buf));
+    printf("  %-30s: ", role);
+    printf(COLOR_GREEN "%s ops/sec" COLOR_RESET " ", buf);
+    printf("(%lld ops, %lld busy retries, %lld SQLITE_BUSY)\n", ops, retries, busy);
+    if (hist) print_latency("  latency", hist);
+    record_result(role, ops, elapsed, ops_per_sec, hist);
+    free(hist);
+}
+
+static void bench_multithreaded(int num_readers, int num_writers, double duration) {
+    mt_thread *threads;
+#ifdef _WIN32
+    HANDLE *handles;
+#else
+    pthread_t *handles;
+#endif
+    int n = num_readers + num_writers;
+    int i;
+    char buf[32];
+
+    print_header("BENCHMARK: Concurrent Readers/Writers");
+    printf("  %d reader(s), %d writer(s), %.1f seconds, %d rows per write txn...\n\n",
+           num_readers, num_writers, duration, MT_WRITE_BATCH);
+
+    /* Each thread carries a latency histogram: too big for the stack */
+    threads = (mt_thread *)calloc(n, sizeof(mt_thread));
+    handles = calloc(n, sizeof(*handles));
+    if (threads == NULL || handles == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        free(threads);
+        free(handles);
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        hist_reset(&threads[i].hist);
+        threads[i].id = i;
+        threads[i].is_writer = (i >= num_readers);
+        threads[i].duration = duration;
+        threads[i].rng = rng_seed(rng_next(&g_rng));
+        threads[i].keys = g_keys;
+    }
+
+    for (i = 0; i < n; i++) {
+#ifdef _WIN32
+        handles[i] = CreateThread(NULL, 0, mt_thread_main, &threads[i], 0, NULL);
+        if (handles[i] == NULL) break;
+#else
+        if (pthread_create(&handles[i], NULL, mt_thread_main, &threads[i]) != 0) break;
+#endif
+    }
+    if (i < n) {
+        /* Report on the threads that did start */
+        fprintf(stderr, "Can't start thread %d\n", i);
+        n = i;
+    }
+    for (i = 0; i < n; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+#else
+        pthread_join(handles[i], NULL);
+#endif
+    }
+
+    for (i = 0; i < n; i++) {
+        mt_thread *t = &threads[i];
+        double ops_per_sec = t->elapsed > 0 ? t->ops / t->elapsed : 0;
+        format_number((long long)ops_per_sec, buf, sizeof(buf));
+        printf("  %s %-23d: ", t->is_writer ? "writer" : "reader", t->id);
+        printf(COLOR_GREEN "%s ops/sec" COLOR_RESET " ", buf);
+        printf("(%lld ops, %lld busy retries, %lld SQLITE_BUSY",
+               t->ops, t->busy_retries, t->busy_errors);
+        if (t->other_errors) printf(", %lld other errors", t->other_errors);
+        printf(")\n");
+        print_latency("  latency", &t->hist);
+    }
+    printf("\n");
+    if (g_perf_enabled || g_io_enabled) {
+        long long total = 0;
+        sqlite3_mutex_enter(g_io_mutex);
+        for (i = 0; i < n; i++) {
+            total += threads[i].ops;
+            if (threads[i].is_writer) {
+                g_io.kv_write_bytes += threads[i].kv_bytes;
+            } else {
+                g_io.kv_read_bytes += threads[i].kv_bytes;
+            }
+        }
+        sqlite3_mutex_leave(g_io_mutex);
+        perf_report("All threads cpu/op", total);
+        io_report("All threads io/op", total);
+        g_perf_pending = 0;
+        g_io_pending = 0;
+    }
+    if (num_readers > 0) print_mt_totals("Aggregate reads", threads, n, 0);
+    if (num_writers > 0) print_mt_totals("Aggregate writes", threads, n, 1);
+    free(handles);
+    free(threads);
+}
+
+/* ==================== BENCHMARK 12: Checkpoint Stalls and WAL Growth ==================== */
+
+/*
+** Sustained writes for --sustain seconds with a timeline sampled every
+** --sample-ms.  The benchmark replaces the default auto-checkpoint hook
+** (sqlite3WalDefaultHook) with one that runs the same PASSIVE checkpoint
+** at the same wal_autocheckpoint threshold but records when it started
+** and ended and how many frames it backfilled.  --ckpt-readers threads
+** keep read transactions open for CKPT_READER_HOLD_MS at a time; a
+** checkpoint that can't backfill the whole WAL because of them is a
+** reader-blocked event, and the WAL keeps growing until one succeeds.
+*/
+typedef struct {
+    double start, end;          /* Seconds since the benchmark started */
+    int log_frames;             /* Frames in the WAL */
+    int backfilled;             /* Frames checkpointed into the database */
+    int rc;
+} ckpt_event;
+
+typedef struct {
+    double t;                   /* End of the interval */
+    double ops_per_sec;
+    uint64_t max_latency;
+    long long wal_bytes;
+    int checkpoints;
+    long long backfilled;
+    int blocked;
+} ckpt_sample;
+
+typedef struct {
+    double t0;
+    int autockpt;
+    ckpt_event *events;
+    int num_events, alloc_events;
+} ckpt_state;
+
+typedef struct {
+    int id;
+    volatile int *stop;
+    uint64_t rng;
+    key_chooser keys;
+    long long txns;
+} ckpt_reader;
+
+static int ckpt_wal_hook(void *arg, sqlite3 *db, const char *db_name, int frames) {
+    ckpt_state *st = (ckpt_state *)arg;
+    ckpt_event *e;
+    int log_frames = 0, backfilled = 0;
+    double start;
+
+    if (frames < st->autockpt) return SQLITE_OK;
+    if (st->num_events == st->alloc_events) {
+        int n = st->alloc_events ? st->alloc_events * 2 : 64;
+        ckpt_event *p = (ckpt_event *)realloc(st->events, n * sizeof(ckpt_event));
+        if (p == NULL) return SQLITE_OK;
+        st->events = p;
+        st->alloc_events = n;
+    }
+    start = get_time();
+    e = &st->events[st->num_events++];
+    e->rc = sqlite3_wal_checkpoint_v2(db, db_name, SQLITE_CHECKPOINT_PASSIVE, &log_frames, &backfilled);
+    e->end = get_time() - st->t0;
+    e->start = start - st->t0;
+    e->log_frames = log_frames;
+    e->backfilled = backfilled;
+    return SQLITE_OK;
+}
+
+static long long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : 0;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI ckpt_reader_main(LPVOID arg) {
+#else
+static void *ckpt_reader_main(void *arg) {
+#endif
+    ckpt_reader *r = (ckpt_reader *)arg;
+    char key[MAX_KEY_SIZE + 1];
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    double until;
+    int klen;
+
+    if (sqlite3_open(DB_FILE, &db) != SQLITE_OK) {
+        fprintf(stderr, "Reader %d: can't open database: %s\n", r->id, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return 0;
+    }
+    sqlite3_busy_timeout(db, 1000);
+    apply_connection_pragmas(db);
+    sqlite3_prepare_v2(db, "SELECT value FROM kvpairs WHERE key = ?", -1, &stmt, NULL);
+
+    while (!*r->stop) {
+        /* The snapshot (and its WAL read mark) is held from the first read to COMMIT */
+        if (sqlite3_exec(db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) continue;
+        until = get_time() + CKPT_READER_HOLD_MS / 1000.0;
+        while (get_time() < until && !*r->stop) {
+            klen = make_key(key, "key_", key_next(&r->keys, &r->rng));
+            sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
+            if (sqlite3_step(stmt) == SQLITE_ROW) sqlite3_column_blob(stmt, 0);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+        r->txns++;
+        sqlite3_sleep(1);
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return 0;
+}
+
+static void bench_checkpoint_stalls(sqlite3 *db) {
+    char key[MAX_KEY_SIZE + 1], buf[32];
+    char wal_path[256];
+    int klen, vlen, i, e, n = g_cfg.ckpt_readers, num_samples = 0, alloc_samples = 0;
+    long long ops = 0, interval_ops = 0, max_wal = 0;
+    double start, end, next_sample, last_sample, interval = g_cfg.sample_ms / 1000.0;
+    uint64_t t0, lat, interval_max = 0;
+    volatile int stop = 0;
+    latency_hist hist, ckpt_hist;
+    ckpt_state st;
+    ckpt_sample *samples = NULL;
+    ckpt_reader *readers = NULL;
+    sqlite3_stmt *stmt = NULL;
+    FILE *timeline = NULL;
+#ifdef _WIN32
+    HANDLE handles[MT_MAX_THREADS];
+#else
+    pthread_t handles[MT_MAX_THREADS];
+#endif
+
+    print_header("BENCHMARK 12: Checkpoint Stalls and WAL Growth");
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode", -1, &stmt, NULL) != SQLITE_OK
+        || sqlite3_step(stmt) != SQLITE_ROW
+        || sqlite3_stricmp((const char *)sqlite3_column_text(stmt, 0), "wal") != 0) {
+        sqlite3_finalize(stmt);
+        printf("  Needs journal_mode = WAL, skipped\n");
+        return;
+    }
+    sqlite3_finalize(stmt);
+
+    memset(&st, 0, sizeof(st));
+    st.autockpt = 1000;
+    if (sqlite3_prepare_v2(db, "PRAGMA wal_autocheckpoint", -1, &stmt, NULL) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW) {
+        st.autockpt = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    if (st.autockpt <= 0) st.autockpt = 1000;
+    snprintf(wal_path, sizeof(wal_path), "%s-wal", DB_FILE);
+    printf("  Writing for %.1f seconds in batches of %d, %d reader(s) holding snapshots for %d ms,\n"
+           "  checkpoint every %d frames, sampled every %d ms...\n\n",
+           g_cfg.sustain, g_cfg.batch_size, n, CKPT_READER_HOLD_MS, st.autockpt, g_cfg.sample_ms);
+
+    if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO kvpairs (key, value) VALUES (?, ?)",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return;
+    }
+    if (g_cfg.timeline[0] && (timeline = fopen(g_cfg.timeline, "w")) == NULL) {
+        fprintf(stderr, "Can't open %s\n", g_cfg.timeline);
+    }
+    if (n > 0) readers = (ckpt_reader *)calloc(n, sizeof(ckpt_reader));
+    for (i = 0; readers && i < n; i++) {
+        readers[i].id = i;
+        readers[i].stop = &stop;
+        readers[i].rng = rng_seed(rng_next(&g_rng));
+        readers[i].keys = g_keys;
+#ifdef _WIN32
+        handles[i] = CreateThread(NULL, 0, ckpt_reader_main, &readers[i], 0, NULL);
+        if (handles[i] == NULL) break;
+#else
+        if (pthread_create(&handles[i], NULL, ckpt_reader_main, &readers[i]) != 0) break;
+#endif
+    }
+    if (readers && i < n) {
+        fprintf(stderr, "Can't start reader %d\n", i);
+        n = i;
+    }
+
+    hist_reset(&hist);
+    start = st.t0 = get_time();
+    last_sample = start;
+    next_sample = start + interval;
+    sqlite3_wal_hook(db, ckpt_wal_hook, &st);
+    e = 0;
+
+    while ((end = get_time()) < start + g_cfg.sustain) {
+        /* The COMMIT, and the checkpoint it may run, is charged to the last row */
+        t0 = get_time_ns();
+        exec_sql(db, "BEGIN");
+        for (i = 0; i < g_cfg.batch_size; i++) {
+            long long idx = key_next(&g_keys, &g_rng);
+            klen = make_key(key, "key_", idx);
+            /* Numbered by write, not key: rewriting identical content leaves
+            ** the page clean (btreeOverwriteContent) and the WAL stops growing */
+            vlen = make_value(g_value, "sustained_value_%08lld", ops + i, &g_rng);
+            sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(stmt, 2, g_value, vlen, SQLITE_TRANSIENT);
+            KV_WRITE(klen + vlen);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            if (i + 1 < g_cfg.batch_size) {
+                lat = get_time_ns() - t0;
+                hist_record(&hist, lat);
+                if (lat > interval_max) interval_max = lat;
+                t0 = get_time_ns();
+            }
+        }
+        exec_sql(db, "COMMIT");
+        lat = get_time_ns() - t0;
+        hist_record(&hist, lat);
+        if (lat > interval_max) interval_max = lat;
+        ops += g_cfg.batch_size;
+        interval_ops += g_cfg.batch_size;
+
+        end = get_time();
+        if (end >= next_sample) {
+            ckpt_sample *s;
+            if (num_samples == alloc_samples) {
+                int m = alloc_samples ? alloc_samples * 2 : 256;
+                ckpt_sample *p = (ckpt_sample *)realloc(samples, m * sizeof(ckpt_sample));
+                if (p == NULL) break;
+                samples = p;
+                alloc_samples = m;
+            }
+            s = &samples[num_samples++];
+            memset(s, 0, sizeof(*s));
+            s->t = end - start;
+            s->ops_per_sec = interval_ops / (end - last_sample);
+            s->max_latency = interval_max;
+            s->wal_bytes = file_size(wal_path);
+            for (; e < st.num_events; e++) {
+                s->checkpoints++;
+                s->backfilled += st.events[e].backfilled;
+                if (st.events[e].backfilled < st.events[e].log_frames) s->blocked++;
+            }
+            if (s->wal_bytes > max_wal) max_wal = s->wal_bytes;
+            interval_ops = 0;
+            interval_max = 0;
+            last_sample = end;
+            while (next_sample <= end) next_sample += interval;
+        }
+    }
+
+    sqlite3_wal_autocheckpoint(db, st.autockpt);
+    sqlite3_finalize(stmt);
+    stop = 1;
+    for (i = 0; readers && i < n; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+#else
+        pthread_join(handles[i], NULL);
+#endif
+    }
+
+    print_result("Sustained writes", end - start, (int)ops, &hist);
+
+    if (timeline) {
+        fputs("t_sec,ops_per_sec,max_latency_ns,wal_bytes,checkpoints,frames_backfilled,reader_blocked\n",
+              timeline);
+    }
+    printf("\n  %8s %12s %10s %10s %6s %10s %8s\n", "t (s)", "ops/sec", "max lat", "WAL MB",
+           "ckpts", "backfill", "blocked");
+    for (i = 0; i < num_samples; i++) {
+        const ckpt_sample *s = &samples[i];
+        format_latency(s->max_latency, buf, sizeof(buf));
+        printf("  %8.2f %12.0f %10s %10.2f %6d %10lld %8d\n", s->t, s->ops_per_sec, buf,
+               s->wal_bytes / (1024.0 * 1024.0), s->checkpoints, s->backfilled, s->blocked);
+        if (timeline) {
+            fprintf(timeline, "%.3f,%.1f,%llu,%lld,%d,%lld,%d\n", s->t, s->ops_per_sec,
+                    (unsigned long long)s->max_latency, s->wal_bytes, s->checkpoints, s->backfilled, s->blocked);
+        }
+    }
+
+    {
+        long long frames = 0, backfilled = 0;
+        int blocked = 0;
+        hist_reset(&ckpt_hist);
+        for (e = 0; e < st.num_events; e++) {
+            const ckpt_event *c = &st.events[e];
+            hist_record(&ckpt_hist, (uint64_t)((c->end - c->start) * 1e9));
+            frames += c->log_frames;
+            backfilled += c->backfilled;
+            if (c->backfilled < c->log_frames) blocked++;
+        }
+        printf("\n  Checkpoints: %d, %d blocked by readers, %lld of %lld WAL frames backfilled\n",
+               st.num_events, blocked, backfilled, frames);
+        print_latency("  checkpoint duration", &ckpt_hist);
+        printf("  Largest WAL sampled: %.2f MB\n", max_wal / (1024.0 * 1024.0));
+        for (i = 0; readers && i < n; i++) {
+            printf("  Reader %d: %lld snapshots\n", i, readers[i].txns);
+        }
+    }
+
+    if (timeline) fclose(timeline);
+    free(samples);
+    free(readers);
+    free(st.events);
+}
+
+/* ==================== BENCHMARK 13: Durability Matrix ==================== */
+
+/*
+** Commit cost across journal_mode x synchronous x batch size, each cell
+** on a fresh database.  The I/O accounting VFS counts the xSync calls
+** of every commit, per file: each is at least one fsync()/fdatasync()
+** in unixSync(), plus a directory fsync when a journal was just created.
+** Rows per cell are capped so a cell never runs more than
+** DURABILITY_MAX_COMMITS transactions.
+*/
+
+static void bench_durability_matrix(void) {
+    char key[MAX_KEY_SIZE + 1], sql[128], name[48], p50[32], p99[32];
+    int j, s, b, i, klen, vlen, rows, commits;
+    double start, end;
+    uint64_t t0;
+    latency_hist hist;
+    io_counters before, after, d;
+
+    print_header("BENCHMARK 13: Durability Matrix");
+    printf("  Up to %d rows and %d commits per cell on a fresh database...\n", g_cfg.durability_rows, DURABILITY_MAX_COMMITS);
+    if (!g_io_enabled) printf("  (--io-stats 0: sync counts unavailable)\n");
+    printf("\n  %-9s %-7s %6s %10s %10s %11s %11s %8s %s\n", "journal", "sync", "batch", "rows/sec",
+           "commits/s", "commit p50", "commit p99", "syncs/c", "(db/journal/wal, fsync ms/commit)");
+
+    for (j = 0; j < g_cfg.num_journal_modes; j++) {
+        for (s = 0; s < g_cfg.num_sync_modes; s++) {
+            for (b = 0; b < g_cfg.num_batch_sizes; b++) {
+                const char *journal = g_cfg.journal_modes[j], *sync = g_cfg.sync_modes[s];
+                int batch = g_cfg.batch_sizes[b];
+                sqlite3 *db = NULL;
+                sqlite3_stmt *stmt = NULL;
+                io_file_counts t;
+
+                rows = g_cfg.durability_rows;
+                if (rows > batch * DURABILITY_MAX_COMMITS) rows = batch * DURABILITY_MAX_COMMITS;
+                remove(DURABILITY_DB_FILE);
+                remove(DURABILITY_DB_FILE "-journal");
+                remove(DURABILITY_DB_FILE "-wal");
+                if (sqlite3_open(DURABILITY_DB_FILE, &db) != SQLITE_OK) {
+                    fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+                    sqlite3_close(db);
+                    return;
+                }
+                init_database(db);
+                snprintf(sql, sizeof(sql), "PRAGMA journal_mode = %s", journal);
+                exec_sql(db, sql);
+                snprintf(sql, sizeof(sql), "PRAGMA synchronous = %s", sync);
+                exec_sql(db, sql);
+                sqlite3_prepare_v2(db, "INSERT INTO kvpairs (key, value) VALUES (?, ?)", -1, &stmt, NULL);
+
+                hist_reset(&hist);
+                if (g_io_enabled) io_snapshot(&before);
+                commits = 0;
+                start = get_time();
+                for (i = 0; i < rows; i += batch) {
+                    int k;
+                    t0 = get_time_ns();
+                    exec_sql(db, "BEGIN");
+                    for (k = i; k < i + batch && k < rows; k++) {
+                        klen = make_key(key, "key_", k);
+                        vlen = make_value(g_value, "durable_value_%08lld", k, &g_rng);
+                        sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
+                        sqlite3_bind_blob(stmt, 2, g_value, vlen, SQLITE_TRANSIENT);
+                        KV_WRITE(klen + vlen);
+                        sqlite3_step(stmt);
+                        sqlite3_reset(stmt);
+                    }
+                    exec_sql(db, "COMMIT");
+                    hist_record(&hist, get_time_ns() - t0);
+                    commits++;
+                }
+                end = get_time();
+                sqlite3_finalize(stmt);
+                sqlite3_close(db);
+
+                format_latency(hist_percentile(&hist, 50.0), p50, sizeof(p50));
+                format_latency(hist_percentile(&hist, 99.0), p99, sizeof(p99));
+                printf("  %-9s %-7s %6d %10.0f %10.0f %11s %11s ", journal, sync, batch,
+                       rows / (end - start), commits / (end - start), p50, p99);
+                if (g_io_enabled) {
+                    io_snapshot(&after);
+                    io_diff(&d, &after, &before);
+                    io_totals(&d, &t);
+                    printf("%8.2f (%.2f/%.2f/%.2f, %.2f ms)\n", (double)t.syncs / commits,
+                           (double)d.file[IO_DB].syncs / commits, (double)d.file[IO_JOURNAL].syncs / commits,
+                           (double)d.file[IO_WAL].syncs / commits, t.sync_ns / 1e6 / commits);
+                } else {
+                    printf("%8s\n", "-");
+                }
+                snprintf(name, sizeof(name), "Durability %s/%s/%d", journal, sync, batch);
+                record_result(name, rows, end - start, rows / (end - start), &hist);
+            }
+        }
+    }
+    remove(DURABILITY_DB_FILE);
+    remove(DURABILITY_DB_FILE "-journal");
+    remove(DURABILITY_DB_FILE "-wal");
+    printf("\n  Latencies are per transaction; syncs/c counts xSync calls per commit.\n");
+}
+
+/* ==================== BENCHMARK 14: Churn and Fragmentation ==================== */
+
+/* Spreads sequential ids over the key space; a bijection on [0, 10^8) */
+#define CHURN_KEY(id) ((id) * 48271LL % 100000000LL)
+
+typedef struct {
+    long long pages, freelist;
+    double file_bytes, live_bytes;
+    double leaf_fill;               /* Used fraction of the leaf pages */
+    double overflow_waste;          /* Unused fraction of the overflow pages */
+    long long overflow;
+    double read_ops;                /* ops/sec */
+    uint64_t read_p99;
+    double scan_mb;                 /* MB/sec of a full scan */
+} churn_sample;
+
+/* Page counts and fill of kvpairs from dbstat, plus the free list */
+static void churn_space(sqlite3 *db, churn_sample *s) {
+    sqlite3_stmt *stmt = NULL;
+    double leaf_size = 0, leaf_unused = 0, ovfl_size = 0, ovfl_unused = 0;
+
+    s->pages = s->freelist = s->overflow = 0;
+    if (sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        s->pages = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (sqlite3_prepare_v2(db, "PRAGMA freelist_count", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        s->freelist = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    s->file_bytes = (double)s->pages * g_cfg.page_size;
+
+    if (sqlite3_prepare_v2(db, "SELECT pagetype, count(*), sum(pgsize), sum(unused) FROM dbstat "
+                           "WHERE name = 'kvpairs' GROUP BY pagetype", -1, &stmt, NULL) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char *type = (const char *)sqlite3_column_text(stmt, 0);
+            if (type && strcmp(type, "leaf") == 0) {
+                leaf_size = sqlite3_column_double(stmt, 2);
+                leaf_unused = sqlite3_column_double(stmt, 3);
+            } else if (type && strcmp(type, "overflow") == 0) {
+                s->overflow = sqlite3_column_int64(stmt, 1);
+                ovfl_size = sqlite3_column_double(stmt, 2);
+                ovfl_unused = sqlite3_column_double(stmt, 3);
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    s->leaf_fill = leaf_size > 0 ? 1.0 - leaf_unused / leaf_size : 0;
+    s->overflow_waste = ovfl_size > 0 ? ovfl_unused / ovfl_size : 0;
+}
+
+/* Random point reads of live ids and a full scan */
+static void churn_reads(sqlite3 *db, const long long *ids, int rows, int reads,
+                        churn_sample *s, latency_hist *hist) {
+    sqlite3_stmt *stmt = NULL;
+    char key[MAX_KEY_SIZE + 1];
+    double start, bytes = 0;
+    uint64_t t0;
+    int i, klen;
+
+    hist_reset(hist);
+    sqlite3_prepare_v2(db, "SELECT value FROM kvpairs WHERE key = ?", -1, &stmt, NULL);
+    start = get_time();
+    for (i = 0; i < reads; i++) {
+        klen = make_key(key, "key_", CHURN_KEY(ids[rng_next(&g_rng) % (uint64_t)rows]));
+        t0 = get_time_ns();
+        sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW) KV_READ(klen + sqlite3_column_bytes(stmt, 0));
+        sqlite3_reset(stmt);
+        hist_record(hist, get_time_ns() - t0);
+    }
+    s->read_ops = reads / (get_time() - start);
+    s->read_p99 = hist_percentile(hist, 99.0);
+    sqlite3_finalize(stmt);
+
+    stmt = NULL;
+    sqlite3_prepare_v2(db, "SELECT key, value FROM kvpairs", -1, &stmt, NULL);
+    start = get_time();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        sqlite3_column_blob(stmt, 1);
+        bytes += sqlite3_column_bytes(stmt, 0) + sqlite3_column_bytes(stmt, 1);
+    }
+    s->scan_mb = bytes / (1024.0 * 1024.0) / (get_time() - start);
+    KV_READ((long long)bytes);
+    sqlite3_finalize(stmt);
+}
+
+static void churn_print(const char *label, const churn_sample *s) {
+    char p99[32];
+    format_latency(s->read_p99, p99, sizeof(p99));
+    printf("  %-8s %9lld %6.1f%% %9.2f %9.2f %8.2fx %8.1f%% %9.1f%% %10.0f %9s %9.1f\n", label, s->pages,
+           s->pages ? 100.0 * s->freelist / s->pages : 0.0, s->file_bytes / (1024.0 * 1024.0),
+           s->live_bytes / (1024.0 * 1024.0), s->live_bytes > 0 ? s->file_bytes / s->live_bytes : 0.0,
+           100.0 * s->leaf_fill, 100.0 * s->overflow_waste, s->read_ops, p99, s->scan_mb);
+}
+
+/*
+** Delete/insert/update cycles against a table of --churn-rows rows.
+** Every cycle deletes --churn-rate of the rows and inserts as many new
+** ones at random positions in the key space, and rewrites as many
+** values with a new size, all drawn from --churn-value-size.  Every
+** --churn-sample cycles the file is measured with dbstat and PRAGMA
+** freelist_count and read throughput is taken, so space amplification
+** (file bytes / live key+value bytes), leaf fill and overflow waste can
+** be read against the read rate.  A final VACUUM shows what rebuilding
+** would recover.
+*/
+static void bench_churn(void) {
+    char key[MAX_KEY_SIZE + 1], label[16];
+    sqlite3 *db = NULL;
+    sqlite3_stmt *ins = NULL, *del = NULL, *upd = NULL;
+    long long *ids, next_id;
+    int *lens, rows = g_cfg.churn_rows, per_cycle, reads, c, i, n, klen, span, in_txn;
+    char *value;
+    churn_sample s;
+    latency_hist hist;
+    double start;
+
+    print_header("BENCHMARK 14: Churn and Fragmentation");
+    per_cycle = (int)(rows * g_cfg.churn_rate);
+    if (per_cycle < 1) per_cycle = 1;
+    reads = g_cfg.reads < rows ? g_cfg.reads : rows;
+    if (reads < 1) reads = 1;
+    span = g_cfg.churn_value_max - g_cfg.churn_value_min + 1;
+    printf("  %d rows, %d cycles of %d deletes + inserts + updates, values %d-%d bytes...\n", rows,
+           g_cfg.churn_cycles, per_cycle, g_cfg.churn_value_min, g_cfg.churn_value_max);
+
+    ids = (long long *)malloc(sizeof(long long) * rows);
+    lens = (int *)malloc(sizeof(int) * rows);
+    value = (char *)malloc(g_cfg.churn_value_max);
+    if (!ids || !lens || !value) {
+        fprintf(stderr, "Out of memory\n");
+        free(ids);
+        free(lens);
+        free(value);
+        return;
+    }
+    for (i = 0; i < g_cfg.churn_value_max; i++) value[i] = 'a' + (char)(rng_next(&g_rng) % 26);
+
+    remove(CHURN_DB_FILE);
+    remove(CHURN_DB_FILE "-wal");
+    remove(CHURN_DB_FILE "-shm");
+    if (sqlite3_open(CHURN_DB_FILE, &db) != SQLITE_OK) {
+        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        free(ids);
+        free(lens);
+        free(value);
+        return;
+    }
+    init_database(db);
+    sqlite3_prepare_v2(db, "INSERT INTO kvpairs (key, value) VALUES (?, ?)", -1, &ins, NULL);
+    sqlite3_prepare_v2(db, "DELETE FROM kvpairs WHERE key = ?", -1, &del, NULL);
+    sqlite3_prepare_v2(db, "UPDATE kvpairs SET value = ? WHERE key = ?", -1, &upd, NULL);
+
+    /* Load and VACUUM so that cycle 0 is a freshly packed file */
+    memset(&s, 0, sizeof(s));
+    exec_sql(db, "BEGIN");
+    for (i = 0; i < rows; i++) {
+        ids[i] = i;
+        lens[i] = g_cfg.churn_value_min + (int)(rng_next(&g_rng) % (uint64_t)span);
+        klen = make_key(key, "key_", CHURN_KEY(ids[i]));
+        sqlite3_bind_blob(ins, 1, key, klen, SQLITE_STATIC);
+        sqlite3_bind_blob(ins, 2, value, lens[i], SQLITE_STATIC);
+        sqlite3_step(ins);
+        sqlite3_reset(ins);
+        s.live_bytes += klen + lens[i];
+    }
+    exec_sql(db, "COMMIT");
+    exec_sql(db, "VACUUM");
+    next_id = rows;
+
+    printf("\n  %-8s %9s %7s %9s %9s %9s %9s %10s %10s %9s %9s\n", "cycle", "pages", "free", "file MB",
+           "live MB", "space amp", "leaf fill", "ovfl waste", "reads/sec", "read p99", "scan MB/s");
+    churn_space(db, &s);
+    churn_reads(db, ids, rows, reads, &s, &hist);
+    churn_print("0", &s);
+    record_result("Churn reads (packed)", reads, reads / s.read_ops, s.read_ops, &hist);
+
+    start = get_time();
+    for (c = 1; c <= g_cfg.churn_cycles; c++) {
+        in_txn = 0;
+        for (n = 0; n < per_cycle; n++) {
+            int slot = (int)(rng_next(&g_rng) % (uint64_t)rows);
+            if (!in_txn) {
+                exec_sql(db, "BEGIN");
+                in_txn = 1;
+            }
+
+            /* Replace one row with a new key elsewhere in the key space */
+            klen = make_key(key, "key_", CHURN_KEY(ids[slot]));
+            sqlite3_bind_blob(del, 1, key, klen, SQLITE_STATIC);
+            sqlite3_step(del);
+            sqlite3_reset(del);
+            s.live_bytes -= klen + lens[slot];
+            ids[slot] = next_id++;
+            lens[slot] = g_cfg.churn_value_min + (int)(rng_next(&g_rng) % (uint64_t)span);
+            klen = make_key(key, "key_", CHURN_KEY(ids[slot]));
+            sqlite3_bind_blob(ins, 1, key, klen, SQLITE_STATIC);
+            sqlite3_bind_blob(ins, 2, value, lens[slot], SQLITE_STATIC);
+            sqlite3_step(ins);
+            sqlite3_reset(ins);
+            s.live_bytes += klen + lens[slot];
+            KV_WRITE(klen + lens[slot]);
+
+            /* Resize another */
+            slot = (int)(rng_next(&g_rng) % (uint64_t)rows);
+            s.live_bytes -= lens[slot];
+            lens[slot] = g_cfg.churn_value_min + (int)(rng_next(&g_rng) % (uint64_t)span);
+            s.live_bytes += lens[slot];
+            klen = make_key(key, "key_", CHURN_KEY(ids[slot]));
+            sqlite3_bind_blob(upd, 1, value, lens[slot], SQLITE_STATIC);
+            sqlite3_bind_blob(upd, 2, key, klen, SQLITE_STATIC);
+            sqlite3_step(upd);
+            sqlite3_reset(upd);
+            KV_WRITE(klen + lens[slot]);
+
+            if ((n + 1) % g_cfg.batch_size == 0) {
+                exec_sql(db, "COMMIT");
+                in_txn = 0;
+            }
+        }
+        if (in_txn) exec_sql(db, "COMMIT");
+
+        if (c % g_cfg.churn_sample == 0 || c == g_cfg.churn_cycles) {
+            churn_space(db, &s);
+            churn_reads(db, ids, rows, reads, &s, &hist);
+            snprintf(label, sizeof(label), "%d", c);
+            churn_print(label, &s);
+        }
+    }
+    printf("  (%.1f churn cycles/sec)\n", g_cfg.churn_cycles / (get_time() - start));
+    record_result("Churn reads (churned)", reads, reads / s.read_ops, s.read_ops, &hist);
+
+    sqlite3_finalize(ins);
+    sqlite3_finalize(del);
+    sqlite3_finalize(upd);
+    exec_sql(db, "VACUUM");
+    churn_space(db, &s);
+    churn_reads(db, ids, rows, reads, &s, &hist);
+    churn_print("vacuum", &s);
+    record_result("Churn reads (vacuumed)", reads, reads / s.read_ops, s.read_ops, &hist);
+
+    printf("\n  space amp = file bytes / live key+value bytes; free = free-list pages\n");
+    sqlite3_close(db);
+    remove(CHURN_DB_FILE);
+    remove(CHURN_DB_FILE "-wal");
+    remove(CHURN_DB_FILE "-shm");
+    free(ids);
+    free(lens);
+    free(value);
+}
+
+/* ==================== BENCHMARK 15: Native Key-Value API ==================== */
+
+enum { KV_GET, KV_EXISTS, KV_PUT, KV_SCAN, KV_NUM_OPS };
+
+static const char *kv_op_names[KV_NUM_OPS] = { "get", "exists", "put", "scan" };
+
+static const char *kv_op_sql[KV_NUM_OPS] = {
+    "SELECT value FROM kvpairs WHERE key = ?",
+    "SELECT 1 FROM kvpairs WHERE key = ?",
+    "INSERT OR REPLACE INTO kvpairs (key, value) VALUES (?, ?)",
+    "SELECT key, value FROM kvpairs"
+};
+
+/*
+** One operation kind through SQL (kv == NULL) or through sqlite3_kv_*.
+** Point operations draw g_cfg.reads keys from g_rng, so the caller can
+** replay the same keys on both paths; puts commit every batch_size rows.
+** Returns the number of operations, -1 on error.
+*/
+static int kv_run(sqlite3 *db, sqlite3_kv *kv, int op, latency_hist *hist, double *elapsed) {
+    char key[MAX_KEY_SIZE + 1];
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_kv_iter *it = NULL;
+    const void *v;
+    int i, klen, vlen, n, exists, ops = 0, rc = SQLITE_OK;
+    double start;
+    uint64_t t0;
+
+    if (!kv && sqlite3_prepare_v2(db, kv_op_sql[op], -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    hist_reset(hist);
+    start = get_time();
+    if (op == KV_SCAN) {
+        t0 = get_time_ns();
+        if (kv) {
+            rc = sqlite3_kv_iter_open(kv, NULL, 0, &it);
+            while (rc == SQLITE_OK && sqlite3_kv_iter_next(it) == SQLITE_ROW) {
+                sqlite3_kv_iter_key(it, &klen);
+                sqlite3_kv_iter_value(it, &vlen);
+                KV_READ(klen + vlen);
+                ops++;
+            }
+            sqlite3_kv_iter_close(it);
+        } else {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                sqlite3_column_blob(stmt, 0);
+                sqlite3_column_blob(stmt, 1);
+                KV_READ(sqlite3_column_bytes(stmt, 0) + sqlite3_column_bytes(stmt, 1));
+                ops++;
+            }
+        }
+        hist_record(hist, get_time_ns() - t0);
+    } else {
+        for (i = 0; i < g_cfg.reads && rc == SQLITE_OK; i++) {
+            long long idx = key_next(&g_keys, &g_rng);
+            klen = make_key(key, "key_", idx);
+            if (op == KV_PUT) {
+                vlen = make_value(g_value, "kv_value_%08lld_written_through_the_key_value_api", idx + i, &g_rng);
+                if (i % g_cfg.batch_size == 0) exec_sql(db, "BEGIN");
+            }
+            t0 = get_time_ns();
+            if (kv) {
+                switch (op) {
+                case KV_GET:
+                    rc = sqlite3_kv_get(kv, key, klen, &v, &n);
+                    if (rc == SQLITE_OK) KV_READ(klen + n);
+                    if (rc == SQLITE_NOTFOUND) rc = SQLITE_OK;
+                    break;
+                case KV_EXISTS:
+                    rc = sqlite3_kv_exists(kv, key, klen, &exists);
+                    break;
+                default:
+                    rc = sqlite3_kv_put(kv, key, klen, g_value, vlen);
+                    KV_WRITE(klen + vlen);
+                    break;
+                }
+            } else {
+                sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_STATIC);
+                if (op == KV_PUT) sqlite3_bind_blob(stmt, 2, g_value, vlen, SQLITE_STATIC);
+                rc = sqlite3_step(stmt);
+                if (rc == SQLITE_ROW && op == KV_GET) {
+                    sqlite3_column_blob(stmt, 0);
+                    KV_READ(klen + sqlite3_column_bytes(stmt, 0));
+                }
+                if (op == KV_PUT) KV_WRITE(klen + vlen);
+                rc = sqlite3_reset(stmt);
+            }
+            hist_record(hist, get_time_ns() - t0);
+            if (op == KV_PUT && (i % g_cfg.batch_size == g_cfg.batch_size - 1 || i == g_cfg.reads - 1)) {
+                exec_sql(db, "COMMIT");
+            }
+            ops++;
+        }
+    }
+    *elapsed = get_time() - start;
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Key-value %s failed: %s\n", kv_op_names[op], sqlite3_errmsg(db));
+        if (!sqlite3_get_autocommit(db)) exec_sql(db, "ROLLBACK");
+        return -1;
+    }
+    return ops;
+}
+
+/*
+** g_cfg.reads lookups in batches of g_cfg.multiget_size keys: one
+** prepared SELECT per key (path 0), one sqlite3_kv_get() per key (path 1)
+** or one sqlite3_kv_multi_get() per batch (path 2).  Latency is recorded
+** per batch.  Returns the number of keys looked up, -1 on error.
+*/
+static int kv_run_multi(sqlite3 *db, sqlite3_kv *kv, int path, latency_hist *hist, double *elapsed) {
+    int n = g_cfg.multiget_size;
+    char (*keys)[MAX_KEY_SIZE + 1] = malloc(n * sizeof(*keys));
+    const void **apKey = malloc(n * sizeof(*apKey));
+    const void **apVal = malloc(n * sizeof(*apVal));
+    int *anKey = malloc(n * sizeof(*anKey));
+    int *anVal = malloc(n * sizeof(*anVal));
+    sqlite3_stmt *stmt = NULL;
+    int i, j, batch, ops = 0, rc = SQLITE_OK;
+    double start;
+    uint64_t t0;
+
+    if (!keys || !apKey || !apVal || !anKey || !anVal) {
+        fprintf(stderr, "Out of memory\n");
+        rc = SQLITE_NOMEM;
+    } else if (path == 0 && sqlite3_prepare_v2(db, kv_op_sql[KV_GET], -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        rc = SQLITE_ERROR;
+    }
+    hist_reset(hist);
+    start = get_time();
+    for (i = 0; i < g_cfg.reads && rc == SQLITE_OK; i += batch) {
+        batch = g_cfg.reads - i < n ? g_cfg.reads - i : n;
+        for (j = 0; j < batch; j++) {
+            anKey[j] = make_key(keys[j], "key_", key_next(&g_keys, &g_rng));
+            apKey[j] = keys[j];
+        }
+        t0 = get_time_ns();
+        if (path == 2) {
+            rc = sqlite3_kv_multi_get(kv, batch, apKey, anKey, apVal, anVal);
+            for (j = 0; rc == SQLITE_OK && j < batch; j++) {
+                if (apVal[j]) KV_READ(anKey[j] + anVal[j]);
+            }
+        } else {
+            for (j = 0; rc == SQLITE_OK && j < batch; j++) {
+                if (path == 1) {
+                    rc = sqlite3_kv_get(kv, apKey[j], anKey[j], &apVal[j], &anVal[j]);
+                    if (rc == SQLITE_OK) KV_READ(anKey[j] + anVal[j]);
+                    if (rc == SQLITE_NOTFOUND) rc = SQLITE_OK;
+                } else {
+                    sqlite3_bind_blob(stmt, 1, apKey[j], anKey[j], SQLITE_STATIC);
+                    if (sqlite3_step(stmt) == SQLITE_ROW) {
+                        sqlite3_column_blob(stmt, 0);
+                        KV_READ(anKey[j] + sqlite3_column_bytes(stmt, 0));
+                    }
+                    rc = sqlite3_reset(stmt);
+                }
+            }
+        }
+        hist_record(hist, get_time_ns() - t0);
+        ops += batch;
+    }
+    *elapsed = get_time() - start;
+    sqlite3_finalize(stmt);
+    free(keys);
+    free(apKey);
+    free(apVal);
+    free(anKey);
+    free(anVal);
+    if (rc != SQLITE_OK) {
+        if (rc != SQLITE_NOMEM) fprintf(stderr, "Key-value multi-get failed: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    return ops;
+}
+
+/* Decode and encode the 8-byte big-endian counters of sqlite3_kv_increment() */
+static long long counter_get(const void *p) {
+    const unsigned char *a = p;
+    uint64_t u = 0;
+    int i;
+    for (i = 0; i < 8; i++) u = (u << 8) | a[i];
+    return (long long)u;
+}
+
+static void counter_put(unsigned char *a, long long v) {
+    uint64_t u = (uint64_t)v;
+    int i;
+    for (i = 7; i >= 0; i--, u >>= 8) a[i] = (unsigned char)u;
+}
+
+/*
+** g_cfg.reads increments of COUNTER_KEYS counters in a fresh table
+** kv_counters, each in its own transaction, the way a counter is bumped
+** in production:  SELECT then INSERT OR REPLACE inside BEGIN IMMEDIATE
+** (path 0), sqlite3_kv_get() then sqlite3_kv_cas(), retried on a lost
+** race (path 1), or sqlite3_kv_increment() (path 2).  The last two read
+** and write in one descent of the b-tree, and the counter, never
+** changing size, is overwritten in place.  The counters must add up to
+** the number of increments.  Returns that number, -1 on error.
+*/
+static int kv_run_counters(sqlite3 *db, int path, latency_hist *hist, double *elapsed) {
+    char key[32];
+    unsigned char val[8], old[8];
+    sqlite3_kv *kv = NULL;
+    sqlite3_stmt *sel = NULL, *upd = NULL, *sum = NULL;
+    const void *v;
+    int i, klen, n, swapped, rc = SQLITE_OK;
+    long long total = -1;
+    double start;
+    uint64_t t0;
+
+    exec_sql(db, "DROP TABLE IF EXISTS kv_counters");
+    if (sqlite3_kv_open(db, NULL, "kv_counters", SQLITE_KV_CREATE, &kv) != SQLITE_OK
+        || sqlite3_prepare_v2(db, "SELECT value FROM kv_counters WHERE key = ?", -1, &sel, NULL) != SQLITE_OK
+        || sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO kv_counters (key, value) VALUES (?, ?)",
+                              -1, &upd, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Can't set up counter table: %s\n", sqlite3_errmsg(db));
+        rc = SQLITE_ERROR;
+    }
+    hist_reset(hist);
+    start = get_time();
+    for (i = 0; i < g_cfg.reads && rc == SQLITE_OK; i++) {
+        klen = snprintf(key, sizeof(key), "ctr_%08lld", key_next(&g_keys, &g_rng) % COUNTER_KEYS);
+        t0 = get_time_ns();
+        switch (path) {
+        case 0:
+            rc = sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+            if (rc != SQLITE_OK) break;
+            sqlite3_bind_blob(sel, 1, key, klen, SQLITE_STATIC);
+            n = 0;
+            if (sqlite3_step(sel) == SQLITE_ROW && sqlite3_column_bytes(sel, 0) == 8) {
+                n = (int)counter_get(sqlite3_column_blob(sel, 0));
+            }
+            rc = sqlite3_reset(sel);
+            counter_put(val, n + 1);
+            sqlite3_bind_blob(upd, 1, key, klen, SQLITE_STATIC);
+            sqlite3_bind_blob(upd, 2, val, 8, SQLITE_STATIC);
+            sqlite3_step(upd);
+            if (rc == SQLITE_OK) rc = sqlite3_reset(upd);
+            rc = sqlite3_exec(db, rc == SQLITE_OK ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+            break;
+        case 1:
+            do {
+                rc = sqlite3_kv_get(kv, key, klen, &v, &n);
+                if (rc == SQLITE_OK && n == 8) {
+                    memcpy(old, v, 8);
+                    counter_put(val, counter_get(old) + 1);
+                    rc = sqlite3_kv_cas(kv, key, klen, old, 8, val, 8, &swapped);
+                } else if (rc == SQLITE_NOTFOUND) {
+                    counter_put(val, 1);
+                    rc = sqlite3_kv_cas(kv, key, klen, NULL, 0, val, 8, &swapped);
+                }
+            } while (rc == SQLITE_OK && !swapped);
+            break;
+        default:
+            rc = sqlite3_kv_increment(kv, key, klen, 1, NULL);
+            break;
+        }
+        KV_READ(klen + 8);
+        KV_WRITE(klen + 8);
+        hist_record(hist, get_time_ns() - t0);
+    }
+    *elapsed = get_time() - start;
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Counter increment failed: %s\n", sqlite3_errmsg(db));
+    } else if (sqlite3_prepare_v2(db, "SELECT value FROM kv_counters", -1, &sum, NULL) == SQLITE_OK) {
+        for (total = 0; sqlite3_step(sum) == SQLITE_ROW; ) total += counter_get(sqlite3_column_blob(sum, 0));
+        if (total != g_cfg.reads) {
+            fprintf(stderr, "Counters add up to %lld, expected %d\n", total, g_cfg.reads);
+            rc = SQLITE_ERROR;
+        }
+    }
+    sqlite3_finalize(sum);
+    sqlite3_finalize(sel);
+    sqlite3_finalize(upd);
+    sqlite3_kv_close(kv);
+    exec_sql(db, "DROP TABLE IF EXISTS kv_counters");
+    return rc == SQLITE_OK ? g_cfg.reads : -1;
+}
+
+/* sqlite3_kv_merge() callback: accept an existing empty value only */
+static int merge_expect_empty(void *ctx, const void *old, int nold, const void **pnew, int *nnew) {
+    (void)pnew;
+    (void)nnew;
+    *(int *)ctx = old != NULL && nold == 0;
+    return SQLITE_DONE;
+}
+
+/*
+** Run sqlite3_kv_cas(), sqlite3_kv_increment() and sqlite3_kv_merge() on
+** an empty value stored after a key too long to fit on its page:  the
+** value starts past the local payload but has nothing to copy out.  The
+** cas must swap it, the increment must see a value that is not a
+** counter and the merge callback must be handed the empty value.
+** Returns 0 if all three behave, -1 otherwise.
+*/
+static int kv_check_overflow_rmw(sqlite3 *db) {
+    sqlite3_kv *kv = NULL;
+    sqlite3_stmt *stmt = NULL;
+    unsigned char *key = NULL;
+    int klen = 0, swapped = 0, merged = 0, rc = SQLITE_ERROR, inc = SQLITE_OK;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA page_size", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        klen = sqlite3_column_int(stmt, 0) + 1000;
+    }
+    sqlite3_finalize(stmt);
+    exec_sql(db, "DROP TABLE IF EXISTS kv_overflow");
+    if (klen > 1000 && (key = malloc(klen)) != NULL
+        && sqlite3_kv_open(db, NULL, "kv_overflow", SQLITE_KV_CREATE, &kv) == SQLITE_OK) {
+        memset(key, 'k', klen);
+        rc = sqlite3_kv_put(kv, key, klen, "", 0);
+        if (rc == SQLITE_OK) rc = sqlite3_kv_cas(kv, key, klen, "", 0, "x", 1, &swapped);
+        if (rc == SQLITE_OK && swapped) rc = sqlite3_kv_cas(kv, key, klen, "x", 1, "", 0, &swapped);
+        if (rc == SQLITE_OK) inc = sqlite3_kv_increment(kv, key, klen, 1, NULL);
+        if (rc == SQLITE_OK) rc = sqlite3_kv_merge(kv, key, klen, merge_expect_empty, &merged);
+    }
+    if (rc != SQLITE_OK || !swapped || inc != SQLITE_MISMATCH || !merged) {
+        fprintf(stderr, "Read-modify-write of an empty overflow value failed: rc %d swapped %d increment %d merged %d\n",
+                rc, swapped, inc, merged);
+        rc = SQLITE_ERROR;
+    }
+    sqlite3_kv_close(kv);
+    exec_sql(db, "DROP TABLE IF EXISTS kv_overflow");
+    free(key);
+    return rc == SQLITE_OK ? 0 : -1;
+}
+
+/*
+** Write the empty key through batches:  deleted as the first operation
+** of a new batch, put, then deleted first again once the batch is reset.
+** Returns 0 if every step succeeds and the key reads back as written,
+** -1 otherwise.
+*/
+static int kv_check_batch_empty_key(sqlite3 *db) {
+    sqlite3_kv *kv = NULL;
+    sqlite3_kv_batch *batch = NULL;
+    const void *val = NULL;
+    int vlen = 0, rc = SQLITE_ERROR, found = SQLITE_ERROR, gone = SQLITE_ERROR;
+
+    exec_sql(db, "DROP TABLE IF EXISTS kv_batch_empty");
+    if (sqlite3_kv_open(db, NULL, "kv_batch_empty", SQLITE_KV_CREATE, &kv) == SQLITE_OK
+        && sqlite3_kv_batch_open(kv, &batch) == SQLITE_OK) {
+        rc = sqlite3_kv_batch_delete(batch, "", 0);
+        if (rc == SQLITE_OK) rc = sqlite3_kv_batch_put(batch, "", 0, "v", 1);
+        if (rc == SQLITE_OK) rc = sqlite3_kv_batch_write(batch);
+        if (rc == SQLITE_OK) found = sqlite3_kv_get(kv, "", 0, &val, &vlen);
+        if (found == SQLITE_OK && (vlen != 1 || memcmp(val, "v", 1) != 0)) found = SQLITE_MISMATCH;
+        sqlite3_kv_batch_reset(batch);
+        if (rc == SQLITE_OK) rc = sqlite3_kv_batch_delete(batch, "", 0);
+        if (rc == SQLITE_OK) rc = sqlite3_kv_batch_write(batch);
+        if (rc == SQLITE_OK) gone = sqlite3_kv_get(kv, "", 0, &val, &vlen);
+    }
+    if (rc != SQLITE_OK || found != SQLITE_OK || gone != SQLITE_NOTFOUND) {
+        fprintf(stderr, "Batch with the empty key failed: rc %d put %d delete %d\n", rc, found, gone);
+        rc = SQLITE_ERROR;
+    }
+    sqlite3_kv_batch_close(batch);
+    sqlite3_kv_close(kv);
+    exec_sql(db, "DROP TABLE IF EXISTS kv_batch_empty");
+    return rc == SQLITE_OK ? 0 : -1;
+}
+
+/* Split policy for kv_ingest() and the space it left behind */
+typedef struct {
+    int policy, fill;           /* Passed to sqlite3_kv_split() */
+    long long pages;            /* Pages of kv_ingest after the load */
+    double leaf_fill;           /* Percentage of leaf bytes in use */
+} split_stats;
+
+/*
+** Load g_cfg.records rows into a fresh table kv_ingest, committing every
+** g_cfg.batch_size rows, as bench_sequential_writes() does:  through
+** INSERT OR REPLACE (batch == NULL) or through sqlite3_kv_batch_write().
+** Keys come in ascending order (order 0), scattered over the key space
+** (1) or descending (2).  Latency is recorded per transaction.  If split
+** is not NULL rows go through sqlite3_kv_put() instead of SQL, in the
+** same transactions, under its policy; batches are not used as they sort
+** their rows.  The size of the table is then measured before it is
+** dropped.  Returns the number of rows written, -1 on error.
+*/
+static int kv_ingest(sqlite3 *db, int use_batch, int order, split_stats *split, latency_hist *hist, double *elapsed) {
+    char key[MAX_KEY_SIZE + 1];
+    sqlite3_kv *kv = NULL;
+    sqlite3_kv_batch *batch = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int i, klen, vlen, rc = SQLITE_OK;
+    long long idx;
+    double start;
+    uint64_t t0 = 0;
+
+    exec_sql(db, "DROP TABLE IF EXISTS kv_ingest");
+    if (sqlite3_kv_open(db, NULL, "kv_ingest", SQLITE_KV_CREATE, &kv) != SQLITE_OK
+        || (split && sqlite3_kv_split(kv, split->policy, split->fill) != SQLITE_OK)
+        || (use_batch && sqlite3_kv_batch_open(kv, &batch) != SQLITE_OK)
+        || (!use_batch && !split && sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO kv_ingest (key, value) VALUES (?, ?)",
+                                             -1, &stmt, NULL) != SQLITE_OK)) {
+        fprintf(stderr, "Can't set up ingestion table: %s\n", sqlite3_errmsg(db));
+        sqlite3_kv_close(kv);
+        return -1;
+    }
+    hist_reset(hist);
+    start = get_time();
+    for (i = 0; i < g_cfg.records && rc == SQLITE_OK; i++) {
+        if (i % g_cfg.batch_size == 0) {
+            t0 = get_time_ns();
+            if (!use_batch) exec_sql(db, "BEGIN");
+        }
+        idx = order == 1 ? CHURN_KEY(i) : order == 2 ? g_cfg.records - 1 - i : i;
+        klen = make_key(key, "key_", idx);
+        vlen = make_value(g_value, "value_%08lld_with_some_additional_data_to_make_it_realistic", idx, &g_rng);
+        KV_WRITE(klen + vlen);
+        if (use_batch) {
+            rc = sqlite3_kv_batch_put(batch, key, klen, g_value, vlen);
+        } else if (split) {
+            rc = sqlite3_kv_put(kv, key, klen, g_value, vlen);
+        } else {
+            sqlite3_bind_blob(stmt, 1, key, klen, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(stmt, 2, g_value, vlen, SQLITE_TRANSIENT);
+            sqlite3_step(stmt);
+            rc = sqlite3_reset(stmt);
+        }
+        if (i % g_cfg.batch_size == g_cfg.batch_size - 1 || i == g_cfg.records - 1) {
+            if (rc == SQLITE_OK) {
+                rc = use_batch ? sqlite3_kv_batch_write(batch) : sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+            }
+            hist_record(hist, get_time_ns() - t0);
+        }
+    }
+    *elapsed = get_time() - start;
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Ingestion failed: %s\n", sqlite3_errmsg(db));
+        if (!sqlite3_get_autocommit(db)) exec_sql(db, "ROLLBACK");
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (split && rc == SQLITE_OK) {
+        split->pages = 0;
+        split->leaf_fill = 0;
+        if (sqlite3_prepare_v2(db, "SELECT count(*), sum(pgsize) FILTER (WHERE pagetype = 'leaf'), "
+                               "sum(unused) FILTER (WHERE pagetype = 'leaf') FROM dbstat "
+                               "WHERE name = 'kv_ingest'", -1, &stmt, NULL) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            split->pages = sqlite3_column_int64(stmt, 0);
+            if (sqlite3_column_double(stmt, 1) > 0) {
+                split->leaf_fill = 100.0 * (1.0 - sqlite3_column_double(stmt, 2) / sqlite3_column_double(stmt, 1));
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_kv_batch_close(batch);
+    sqlite3_kv_close(kv);
+    exec_sql(db, "DROP TABLE IF EXISTS kv_ingest");
+    return rc == SQLITE_OK ? g_cfg.records : -1;
+}
+
+#define SNAPSHOT_RANGES 4       /* Iterators exporting a snapshot at once */
+#define SNAPSHOT_WRITE_EVERY 64 /* Rows exported between concurrent puts */
+
+/* WAL frames held back by an open snapshot, sampled while it exports */
+typedef struct {
+    int first, peak, last;      /* At open, at most, before close */
+    long long expected;         /* Rows in the table when it was taken */
+    int writes;                 /* Rows committed while it was open */
+} snapshot_stats;
+
+/*
+** Export every row of kvpairs through a key-value snapshot, split into
+** SNAPSHOT_RANGES key ranges read round-robin by as many iterators, while
+** the same connection commits a new row every SNAPSHOT_WRITE_EVERY rows.
+** Each new row is past the last key, so it would land in the last range
+** if the snapshot let it through.  Latency is recorded per round, and
+** the WAL frames the snapshot pins are sampled along the way.  The rows
+** added are deleted again afterwards.  Needs journal_mode = WAL.
+** Returns the number of rows exported, -1 on error.
+*/
+static int kv_snapshot_export(sqlite3 *db, sqlite3_kv *kv, latency_hist *hist, double *elapsed, snapshot_stats *st) {
+    sqlite3_kv_snapshot *snap = NULL;
+    sqlite3_kv_iter *iters[SNAPSHOT_RANGES];
+    sqlite3_stmt *stmt = NULL;
+    char lo[32], hi[32], key[MAX_KEY_SIZE + 1];
+    int i, n, live, klen, vlen, rc, ops = 0;
+    long long idx;
+    double start;
+    uint64_t t0;
+
+    memset(st, 0, sizeof(*st));
+    memset(iters, 0, sizeof(iters));
+    if (sqlite3_prepare_v2(db, "SELECT count(*) FROM kvpairs", -1, &stmt, NULL) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW) {
+        st->expected = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    rc = sqlite3_kv_snapshot_open(kv, &snap);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Can't take key-value snapshot: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    st->first = st->peak = sqlite3_kv_snapshot_frames(snap);
+
+    /* Range bounds are unpadded keys, which sort before every padded key
+    ** with the same index. */
+    for (i = 0; i < SNAPSHOT_RANGES && rc == SQLITE_OK; i++) {
+        snprintf(lo, sizeof(lo), "key_%08lld", (long long)g_cfg.records * i / SNAPSHOT_RANGES);
+        snprintf(hi, sizeof(hi), "key_%08lld", (long long)g_cfg.records * (i + 1) / SNAPSHOT_RANGES);
+        rc = sqlite3_kv_snapshot_iter(snap, i ? lo : NULL, i ? (int)strlen(lo) : 0,
+                                      i < SNAPSHOT_RANGES - 1 ? hi : NULL,
+                                      i < SNAPSHOT_RANGES - 1 ? (int)strlen(hi) : 0, &iters[i]);
+    }
+
+    hist_reset(hist);
+    start = get_time();
+    for (live = SNAPSHOT_RANGES; live > 0 && rc == SQLITE_OK; ) {
+        t0 = get_time_ns();
+        for (i = 0; i < SNAPSHOT_RANGES && rc == SQLITE_OK; i++) {
+            const void *pKey, *pVal;
+            if (iters[i] == NULL) continue;
+            rc = sqlite3_kv_iter_next(iters[i]);
+            if (rc == SQLITE_ROW) {
+                pKey = sqlite3_kv_iter_key(iters[i], &klen);
+                pVal = sqlite3_kv_iter_value(iters[i], &vlen);
+                KV_READ(klen + vlen);
+                (void)pKey;
+                (void)pVal;
+                rc = SQLITE_OK;
+                if (++ops % SNAPSHOT_WRITE_EVERY == 0) {
+                    idx = (long long)g_cfg.records * 2 + st->writes++;
+                    klen = make_key(key, "key_", idx);
+                    vlen = make_value(g_value, "value_%08lld_with_some_additional_data_to_make_it_realistic", idx, &g_rng);
+                    KV_WRITE(klen + vlen);
+                    rc = sqlite3_kv_put(kv, key, klen, g_value, vlen);
+                    n = sqlite3_kv_snapshot_frames(snap);
+                    if (n > st->peak) st->peak = n;
+                }
+            } else if (rc == SQLITE_DONE) {
+                rc = sqlite3_kv_iter_close(iters[i]);
+                iters[i] = NULL;
+                live--;
+            }
+        }
+        hist_record(hist, get_time_ns() - t0);
+    }
+    *elapsed = get_time() - start;
+    st->last = sqlite3_kv_snapshot_frames(snap);
+    if (rc != SQLITE_OK) fprintf(stderr, "Snapshot export failed: %s\n", sqlite3_errmsg(db));
+
+    for (i = 0; i < SNAPSHOT_RANGES; i++) sqlite3_kv_iter_close(iters[i]);
+    sqlite3_kv_snapshot_close(snap);
+    exec_sql(db, "BEGIN");
+    for (i = 0; i < st->writes; i++) {
+        klen = make_key(key, "key_", (long long)g_cfg.records * 2 + i);
+        sqlite3_kv_delete(kv, key, klen);
+    }
+    exec_sql(db, "COMMIT");
+    return rc == SQLITE_OK ? ops : -1;
+}
+
+/*
+** The same gets, existence checks, puts and full scan, first through
+** prepared statements and then through the sqlite3_kv interface, which
+** works on the table's b-tree directly and skips the VDBE and record
+** decoding.  Both paths see the same keys.  Then batched lookups, key
+** by key and through sqlite3_kv_multi_get(), which sorts each batch and
+** walks the b-tree once for it.  Then counter increments, read and
+** written through SQL or in one step, and, in WAL mode, a full export
+** through a snapshot while the table keeps changing.  Last, bulk
+** ingestion into an empty table, row by row and through write batches.
+*/
+static void bench_kv_api(sqlite3 *db) {
+    sqlite3_kv *kv = NULL;
+    latency_hist hist;
+    double elapsed, sql_ops[KV_NUM_OPS];
+    char name[48];
+    snapshot_stats snap;
+    sqlite3_stmt *stmt = NULL;
+    static const char *multi_names[3] = { "SQL get", "KV API get", "KV API multi-get" };
+    static const char *counter_names[3] = { "SQL select+update", "KV API get+cas", "KV API increment" };
+    static const char *order_names[3] = { "Ascending", "Random", "Descending" };
+    static const char *split_names[5] = { "default", "even", "left", "right", "adaptive" };
+    /* Every policy runs in each key order, so that LEFT, meant for
+    ** ascending keys, and RIGHT, meant for descending ones, are measured
+    ** both on the order they suit and on the opposite one. */
+    static const split_stats split_runs[] = {
+        { SQLITE_KV_SPLIT_DEFAULT, 0, 0, 0.0 }, { SQLITE_KV_SPLIT_EVEN, 0, 0, 0.0 },
+        { SQLITE_KV_SPLIT_LEFT, 0, 0, 0.0 }, { SQLITE_KV_SPLIT_RIGHT, 0, 0, 0.0 },
+        { SQLITE_KV_SPLIT_ADAPTIVE, 0, 0, 0.0 }, { SQLITE_KV_SPLIT_ADAPTIVE, 90, 0, 0.0 },
+        { SQLITE_KV_SPLIT_EVEN, 70, 0, 0.0 },
+    };
+    split_stats split;
+    int op, path, ops;
+    uint64_t rng;
+
+    print_header("BENCHMARK 15: Native Key-Value API");
+    if (sqlite3_kv_open(db, NULL, "kvpairs", 0, &kv) != SQLITE_OK) {
+        fprintf(stderr, "Can't open key-value store: %s\n", sqlite3_errmsg(db));
+        return;
+    }
+    printf("  %d gets, exists checks and puts (batches of %d) and a full scan,\n"
+           "  through SQL and then through sqlite3_kv_*...\n", g_cfg.reads, g_cfg.batch_size);
+
+    for (op = 0; op < KV_NUM_OPS; op++) {
+        rng = g_rng;
+        for (path = 0; path < 2; path++) {
+            g_rng = rng;
+            printf("\n");
+            perf_mark();
+            io_mark();
+            ops = kv_run(db, path ? kv : NULL, op, &hist, &elapsed);
+            if (ops < 0) break;
+            snprintf(name, sizeof(name), "%s %s", path ? "KV API" : "SQL", kv_op_names[op]);
+            print_result(name, elapsed, ops, &hist);
+            if (path == 0) {
+                sql_ops[op] = ops / elapsed;
+            } else {
+                printf("  Speedup over SQL: " COLOR_GREEN "%.2fx" COLOR_RESET "\n", ops / elapsed / sql_ops[op]);
+            }
+        }
+    }
+
+    printf("\n  %d lookups in batches of %d keys, latency per batch...\n", g_cfg.reads, g_cfg.multiget_size);
+    rng = g_rng;
+    for (path = 0; path < 3; path++) {
+        g_rng = rng;
+        printf("\n");
+        perf_mark();
+        io_mark();
+        ops = kv_run_multi(db, kv, path, &hist, &elapsed);
+        if (ops < 0) break;
+        snprintf(name, sizeof(name), "%s x%d", multi_names[path], g_cfg.multiget_size);
+        print_result(name, elapsed, ops, &hist);
+        if (path == 0) {
+            sql_ops[0] = ops / elapsed;
+        } else {
+            printf("  Speedup over SQL: " COLOR_GREEN "%.2fx" COLOR_RESET "\n", ops / elapsed / sql_ops[0]);
+        }
+    }
+
+    printf("\n  %d increments of %d counters, one transaction each...\n", g_cfg.reads, COUNTER_KEYS);
+    printf("  Empty value behind an overflowing key: %s\n",
+           kv_check_overflow_rmw(db) == 0 ? COLOR_GREEN "cas, increment and merge ok" COLOR_RESET
+                                          : COLOR_YELLOW "FAILED" COLOR_RESET);
+    rng = g_rng;
+    for (path = 0; path < 3; path++) {
+        g_rng = rng;
+        printf("\n");
+        perf_mark();
+        io_mark();
+        ops = kv_run_counters(db, path, &hist, &elapsed);
+        if (ops < 0) break;
+        print_result(counter_names[path], elapsed, ops, &hist);
+        if (path == 0) {
+            sql_ops[0] = ops / elapsed;
+        } else {
+            printf("  Speedup over SQL: " COLOR_GREEN "%.2fx" COLOR_RESET "\n", ops / elapsed / sql_ops[0]);
+        }
+    }
+
+    printf("\n  Export through a snapshot, %d ranges in parallel, one put every %d rows...\n",
+           SNAPSHOT_RANGES, SNAPSHOT_WRITE_EVERY);
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode", -1, &stmt, NULL) != SQLITE_OK
+        || sqlite3_step(stmt) != SQLITE_ROW
+        || sqlite3_stricmp((const char *)sqlite3_column_text(stmt, 0), "wal") != 0) {
+        printf("  Needs journal_mode = WAL, skipped\n");
+    } else {
+        sqlite3_finalize(stmt);
+        stmt = NULL;
+        printf("\n");
+        perf_mark();
+        io_mark();
+        ops = kv_snapshot_export(db, kv, &hist, &elapsed, &snap);
+        if (ops >= 0) {
+            print_result("KV snapshot export", elapsed, ops, &hist);
+            printf("  Rows exported: %d of %lld at the snapshot, %d committed meanwhile %s\n",
+                   ops, snap.expected, snap.writes,
+                   ops == snap.expected ? COLOR_GREEN "(consistent)" COLOR_RESET : COLOR_YELLOW "(INCONSISTENT)" COLOR_RESET);
+            printf("  WAL frames pinned: %d at open, %d at peak, %d at close\n", snap.first, snap.peak, snap.last);
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_kv_close(kv);
+
+    printf("\n  Ingesting %d records in transactions of %d, latency per transaction...\n",
+           g_cfg.records, g_cfg.batch_size);
+    printf("  Empty key in a batch: %s\n",
+           kv_check_batch_empty_key(db) == 0 ? COLOR_GREEN "delete and put ok" COLOR_RESET
+                                             : COLOR_YELLOW "FAILED" COLOR_RESET);
+    for (op = 0; op < 2; op++) {
+        for (path = 0; path < 2; path++) {
+            printf("\n");
+            perf_mark();
+            io_mark();
+            ops = kv_ingest(db, path, op, NULL, &hist, &elapsed);
+            if (ops < 0) break;
+            snprintf(name, sizeof(name), "%s ingest (%s)", path ? "KV batch" : "SQL", op ? "random" : "sequential");
+            print_result(name, elapsed, ops, &hist);
+            if (path == 0) {
+                sql_ops[0] = ops / elapsed;
+            } else {
+                printf("  Speedup over SQL: " COLOR_GREEN "%.2fx" COLOR_RESET "\n", ops / elapsed / sql_ops[0]);
+            }
+        }
+    }
+
+    printf("\n  Ingesting %d records through sqlite3_kv_put() under each split policy\n"
+           "  and fill factor...\n", g_cfg.records);
+    for (op = 0; op < 3; op++) {
+        for (path = 0; path < (int)(sizeof(split_runs) / sizeof(split_runs[0])); path++) {
+            split = split_runs[path];
+            printf("\n");
+            perf_mark();
+            io_mark();
+            ops = kv_ingest(db, 0, op, &split, &hist, &elapsed);
+            if (ops < 0) break;
+            snprintf(name, sizeof(name), "%s %s fill %d", order_names[op], split_names[split.policy], split.fill);
+            print_result(name, elapsed, ops, &hist);
+            printf("  %-30s  %lld pages, leaf pages %.1f%% full\n", "", split.pages, split.leaf_fill);
+        }
+    }
+}
+
+/* ==================== Parameters and Sweeps ==================== */
+typedef enum {
+    P_CONFIG,
+    P_RECORDS,
+    P_BATCH,
+    P_READS,
+    P_UPDATES,
+    P_DELETES,
+    P_MIXED_OPS,
+    P_SCANS,
+    P_SCAN_LENGTHS,
+    P_KEY_SIZE,
+    P_VALUE_SIZE,
+    P_VALUE_SIZES,
+    P_CACHE_STATES,
+    P_PAGE_SIZE,
+    P_CACHE_SIZE,
+    P_JOURNAL_MODE,
+    P_SYNCHRONOUS,
+    P_MMAP_SIZE,
+    P_BENCH,
+    P_DIST,
+    P_THETA,
+    P_HOT_SET,
+    P_HOT_OPS,
+    P_SEED,
+    P_YCSB,
+    P_YCSB_OPS,
+    P_READERS,
+    P_WRITERS,
+    P_DURATION,
+    P_SUSTAIN,
+    P_SAMPLE_MS,
+    P_CKPT_READERS,
+    P_JOURNAL_MODES,
+    P_SYNC_MODES,
+    P_BATCH_SIZES,
+    P_DURABILITY_ROWS,
+    P_CHURN_ROWS,
+    P_CHURN_CYCLES,
+    P_CHURN_RATE,
+    P_CHURN_VALUE_SIZE,
+    P_CHURN_SAMPLE,
+    P_MULTIGET_SIZE,
+    P_LOAD_FILL,
+    P_JSON,
+    P_CSV,
+    P_TIMELINE,
+    P_REPEAT,
+    P_COMPARE,
+    P_THRESHOLD,
+    P_PERF,
+    P_IO_STATS,
+    P_NUM_PARAMS
+} param_id;
+
+typedef struct {
+    const char *name;       /* --name on the command line, "name =" in a config file */
+    const char *def;
+    int sweep;              /* Accepts a comma-separated list of values */
+    const char *help;
+} param_info;
+
+static const param_info params[P_NUM_PARAMS] = {
+    { "config",       NULL,                             0, "read parameters from FILE (name = value lines)" },
+    { "records",      XSTRINGIFY(NUM_RECORDS),          1, "records loaded by the sequential-write phase" },
+    { "batch",        XSTRINGIFY(BATCH_SIZE),           1, "rows per transaction while loading" },
+    { "reads",        XSTRINGIFY(NUM_READS),            0, "random reads and exists checks" },
+    { "updates",      XSTRINGIFY(NUM_UPDATES),          0, "random updates" },
+    { "deletes",      XSTRINGIFY(NUM_DELETES),          0, "random deletes" },
+    { "mixed-ops",    XSTRINGIFY(NUM_MIXED_OPS),        0, "operations in the mixed workload" },
+    { "scans",        XSTRINGIFY(NUM_SCANS),            0, "scans per length in the range benchmark" },
+    { "scan-lengths", SCAN_LENGTHS,                     0, "rows per range scan; prefix scans use powers of 10" },
+    { "key-size",     "12",                             1, "key bytes, N or MIN-MAX" },
+    { "value-size",   "0",                              1, "value bytes, N or MIN-MAX (0: built-in formats)" },
+    { "value-sizes",  VALUE_SIZES,                      0, "sizes swept by the values benchmark (K/M suffixes)" },
+    { "cache-states", "cold,os-warm,warm",              0, "cache states of the restart benchmark" },
+    { "page-size",    "4096",                           1, "PRAGMA page_size" },
+    { "cache-size",   "2000",                           1, "PRAGMA cache_size" },
+    { "journal-mode", "WAL",                            1, "PRAGMA journal_mode" },
+    { "synchronous",  "NORMAL",                         1, "PRAGMA synchronous" },
+    { "mmap-size",    "0",                              1, "PRAGMA mmap_size" },
+    { "bench",        "all",                            0, "benchmarks to run: all or reads,scan,updates,deletes,\n"
+                                                                          "                       exists,mixed,bulk,values,restart,range,checkpoint,\n"
+                                                                          "                       durability,churn,kv\n"
+                                                                          "                       (the writes load always runs)" },
+    { "dist",         "uniform",                        1, "key distribution: uniform, zipfian, scrambled,\n"
+                                                                          "                       latest, hotspot" },
+    { "theta",        XSTRINGIFY(ZIPF_DEFAULT_THETA),   1, "Zipfian skew, 0 < theta < 1" },
+    { "hot-set",      XSTRINGIFY(HOTSPOT_DEFAULT_SET),  0, "hotspot: fraction of keys that are hot" },
+    { "hot-ops",      XSTRINGIFY(HOTSPOT_DEFAULT_OPS),  0, "hotspot: fraction of operations on hot keys" },
+    { "seed",         NULL,                             0, "RNG seed (default: current time)" },
+    { "ycsb",         "",                               0, "YCSB core workloads to run, e.g. ABCDEF, instead\n"
+                                                                          "                       of the --bench suite" },
+    { "ycsb-ops",     XSTRINGIFY(YCSB_OPERATIONS),      0, "operations per YCSB workload" },
+    { "readers",      "0",                              1, "concurrent reader threads; with --writers, run\n"
+                                                                          "                       after --ycsb instead of the --bench suite" },
+    { "writers",      "0",                              1, "concurrent writer threads" },
+    { "duration",     XSTRINGIFY(MT_DEFAULT_DURATION),  0, "seconds the concurrent threads run" },
+    { "sustain",      XSTRINGIFY(CKPT_DEFAULT_SUSTAIN), 0, "seconds of writes in the checkpoint benchmark" },
+    { "sample-ms",    XSTRINGIFY(CKPT_SAMPLE_MS),       0, "checkpoint benchmark sampling interval" },
+    { "ckpt-readers", "1",                              1, "readers holding snapshots during the checkpoint\n"
+                                                                          "                       benchmark" },
+    { "journal-modes", JOURNAL_MODES,                   0, "journal modes of the durability matrix" },
+    { "sync-modes",   SYNC_MODES,                       0, "synchronous settings of the durability matrix" },
+    { "batch-sizes",  BATCH_SIZES,                      0, "rows per transaction in the durability matrix" },
+    { "durability-rows", XSTRINGIFY(DURABILITY_ROWS),   0, "rows per durability matrix cell" },
+    { "churn-rows",   XSTRINGIFY(CHURN_ROWS),           0, "rows of the churn benchmark's table" },
+    { "churn-cycles", XSTRINGIFY(CHURN_CYCLES),         0, "delete/insert/update cycles of the churn benchmark" },
+    { "churn-rate",   XSTRINGIFY(CHURN_RATE),           0, "fraction of the rows replaced and resized per cycle" },
+    { "churn-value-size", "50-2000",                    0, "value bytes written by the churn benchmark, MIN-MAX" },
+    { "churn-sample", XSTRINGIFY(CHURN_SAMPLE),         0, "cycles between churn benchmark measurements" },
+    { "multiget-size", XSTRINGIFY(MULTIGET_SIZE),       1, "keys per batch of the key-value multi-get" },
+    { "load-fill",    XSTRINGIFY(LOAD_FILL),            1, "percentage of each page filled by the bulk loader" },
+    { "json",         NULL,                             0, "write results to FILE as JSON Lines" },
+    { "csv",          NULL,                             0, "write results to FILE as CSV" },
+    { "timeline",     NULL,                             0, "write the checkpoint benchmark's samples to FILE" },
+    { "repeat",       "1",                              0, "run every sweep point N times" },
+    { "compare",      NULL,                             0, "BASE,NEW: compare two result files and exit" },
+    { "threshold",    "5",                              0, "minimum % change flagged by --compare" },
+    { "perf",         "0",                              0, "1: hardware counters per operation (Linux)" },
+    { "io-stats",     "1",                              0, "1: count VFS I/O per operation and amplification" },
+};
+
+/* Raw value of every parameter as given; NULL means the default */
+static const char *param_values[P_NUM_PARAMS];
+static uint64_t g_default_seed;
+
+/* Sweep lists, split from param_values[] */
+static char sweep_items[P_NUM_PARAMS][MAX_SWEEP_VALUES][MAX_PARAM_VALUE];
+static int sweep_counts[P_NUM_PARAMS];
+static int point_items[P_NUM_PARAMS];   /* Item of each list at the current point */
+
+static void usage(const char *argv0) {
+    int i;
+    fprintf(stderr, "Usage: %s [--name value ...]\n\n", argv0);
+    for (i = 0; i < P_NUM_PARAMS; i++) {
+        fprintf(stderr, "  --%-18s %s", params[i].name, params[i].help);
+        if (params[i].def && params[i].def[0]) fprintf(stderr, " (default %s)", params[i].def);
+        if (params[i].sweep) fprintf(stderr, " [list]");
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "\n[list] parameters take comma-separated values; the suite runs once\n"
+                    "for every combination of them.\n");
+}
+
+static int find_param(const char *name) {
+    char norm[64];
+    int i;
+    for (i = 0; name[i] && i < (int)sizeof(norm) - 1; i++) {
+        norm[i] = name[i] == '_' ? '-' : name[i];
+    }
+    norm[i] = 0;
+    for (i = 0; i < P_NUM_PARAMS; i++) {
+        if (strcmp(norm, params[i].name) == 0) return i;
+    }
+    return -1;
+}
+
+static int parse_dist(const char *name, key_dist *dist) {
+    int i;
+    for (i = 0; i < (int)(sizeof(dist_names) / sizeof(dist_names[0])); i++) {
+        if (strcmp(name, dist_names[i]) == 0) {
+            *dist = (key_dist)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* "N" or "MIN-MAX" */
+static int parse_size_range(const char *v, int *lo, int *hi) {
+    char *end;
+    long a = strtol(v, &end, 10), b = a;
+    if (end == v) return -1;
+    if (*end == '-') {
+        const char *s = end + 1;
+        b = strtol(s, &end, 10);
+        if (end == s) return -1;
+    }
+    if (*end || a < 0 || b < a) return -1;
+    *lo = (int)a;
+    *hi = (int)b;
+    return 0;
+}
+
+/* Comma-separated byte counts with optional K/M (binary) suffixes */
+static int parse_byte_list(const char *v, int *out, int max, int *count) {
+    char buf[MAX_PARAM_VALUE], *tok, *end;
+    *count = 0;
+    snprintf(buf, sizeof(buf), "%s", v);
+    for (tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        long long x = strtoll(tok, &end, 10);
+        if (end == tok || *count == max) return -1;
+        if (*end == 'K' || *end == 'k') {
+            x <<= 10;
+            end++;
+        } else if (*end == 'M' || *end == 'm') {
+            x <<= 20;
+            end++;
+        }
+        if (*end || x < 1 || x > (64 << 20)) return -1;
+        out[(*count)++] = (int)x;
+    }
+    return *count ? 0 : -1;
+}
+
+static int parse_cache_states(const char *v, unsigned int *mask) {
+    char buf[MAX_PARAM_VALUE], *tok;
+    int i;
+    snprintf(buf, sizeof(buf), "%s", v);
+    *mask = 0;
+    for (tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        for (i = 0; i < 3; i++) {
+            if (strcmp(tok, cache_state_names[i]) == 0) break;
+        }
+        if (i == 3) return -1;
+        *mask |= 1u << i;
+    }
+    return *mask ? 0 : -1;
+}
+
+/* Comma-separated PRAGMA keywords, each one of the allowed ones */
+static int parse_mode_list(const char *v, const char *const *allowed, char out[][16], int *count) {
+    char buf[MAX_PARAM_VALUE], *tok;
+    int i;
+    snprintf(buf, sizeof(buf), "%s", v);
+    *count = 0;
+    for (tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        for (i = 0; allowed[i]; i++) {
+            if (sqlite3_stricmp(tok, allowed[i]) == 0) break;
+        }
+        if (allowed[i] == NULL || *count == MAX_MODES) return -1;
+        snprintf(out[(*count)++], 16, "%s", allowed[i]);
+    }
+    return *count ? 0 : -1;
+}
+
+static const char *const journal_mode_names[] = { "DELETE", "TRUNCATE", "PERSIST", "WAL", "MEMORY", "OFF", NULL };
+static const char *const sync_mode_names[] = { "OFF", "NORMAL", "FULL", "EXTRA", NULL };
+
+static int parse_int(const char *v, long long lo, long long hi, long long *out) {
+    char *end;
+    long long x = strtoll(v, &end, 10);
+    if (end == v || *end || x < lo || x > hi) return -1;
+    *out = x;
+    return 0;
+}
+
+static int parse_benchmarks(const char *v, unsigned int *mask) {
+    char buf[256], *tok;
+    int i;
+    if (strcmp(v, "all") == 0) {
+        *mask = ~0u;
+        return 0;
+    }
+    snprintf(buf, sizeof(buf), "%s", v);
+    *mask = 0;
+    for (tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        for (i = 0; i < (int)(sizeof(bench_names) / sizeof(bench_names[0])); i++) {
+            if (strcmp(tok, bench_names[i]) == 0) break;
+        }
+        if (i == (int)(sizeof(bench_names) / sizeof(bench_names[0]))) return -1;
+        *mask |= 1u << i;
+    }
+    return *mask ? 0 : -1;
+}
+
+/* Store one value of parameter id into cfg; -1 if it is malformed */
+static int apply_param(bench_config *cfg, int id, const char *v) {
+    long long x;
+    double d;
+    int i;
+
+    switch (id) {
+    case P_RECORDS:
+        if (parse_int(v, 1, 100000000, &x)) return -1;
+        cfg->records = (int)x;
+        break;
+    case P_BATCH:
+        if (parse_int(v, 1, 100000000, &x)) return -1;
+        cfg->batch_size = (int)x;
+        break;
+    case P_READS:
+        if (parse_int(v, 0, 1000000000, &x)) return -1;
+        cfg->reads = (int)x;
+        break;
+    case P_UPDATES:
+        if (parse_int(v, 0, 1000000000, &x)) return -1;
+        cfg->updates = (int)x;
+        break;
+    case P_DELETES:
+        if (parse_int(v, 0, 1000000000, &x)) return -1;
+        cfg->deletes = (int)x;
+        break;
+    case P_MIXED_OPS:
+        if (parse_int(v, 0, 1000000000, &x)) return -1;
+        cfg->mixed_ops = (int)x;
+        break;
+    case P_KEY_SIZE:
+        if (parse_size_range(v, &cfg->key_min, &cfg->key_max) || cfg->key_max > MAX_KEY_SIZE) return -1;
+        break;
+    case P_VALUE_SIZE:
+        if (parse_size_range(v, &cfg->value_min, &cfg->value_max)) return -1;
+        if (cfg->value_max > 0 && cfg->value_min == 0) return -1;
+        break;
+    case P_VALUE_SIZES:
+        if (parse_byte_list(v, cfg->value_sizes, MAX_VALUE_SIZES, &cfg->num_value_sizes)) return -1;
+        break;
+    case P_CACHE_STATES:
+        if (parse_cache_states(v, &cfg->cache_states)) return -1;
+        break;
+    case P_PAGE_SIZE:
+        if (parse_int(v, 512, 65536, &x) || (x & (x - 1))) return -1;
+        cfg->page_size = (int)x;
+        break;
+    case P_CACHE_SIZE:
+        if (parse_int(v, -1000000000, 1000000000, &x)) return -1;
+        cfg->cache_size = (int)x;
+        break;
+    case P_JOURNAL_MODE:
+        if (strlen(v) >= sizeof(cfg->journal_mode)) return -1;
+        snprintf(cfg->journal_mode, sizeof(cfg->journal_mode), "%s", v);
+        break;
+    case P_SYNCHRONOUS:
+        if (strlen(v) >= sizeof(cfg->synchronous)) return -1;
+        snprintf(cfg->synchronous, sizeof(cfg->synchronous), "%s", v);
+        break;
+    case P_MMAP_SIZE:
+        if (parse_int(v, 0, (long long)1 << 62, &x)) return -1;
+        cfg->mmap_size = x;
+        break;
+    case P_BENCH:
+        if (parse_benchmarks(v, &cfg->benchmarks)) return -1;
+        break;
+    case P_DIST:
+        if (parse_dist(v, &cfg->dist)) return -1;
+        break;
+    case P_THETA:
+        d = atof(v);
+        if (d <= 0 || d >= 1) return -1;
+        cfg->theta = d;
+        break;
+    case P_HOT_SET:
+        d = atof(v);
+        if (d <= 0 || d > 1) return -1;
+        cfg->hot_set = d;
+        break;
+    case P_HOT_OPS:
+        d = atof(v);
+        if (d < 0 || d > 1) return -1;
+        cfg->hot_ops = d;
+        break;
+    case P_SEED:
+        cfg->seed = strtoull(v, NULL, 10);
+        break;
+    case P_YCSB:
+        if (strlen(v) >= sizeof(cfg->ycsb)) return -1;
+        for (i = 0; v[i]; i++) {
+            if (ycsb_find((char)(v[i] & ~0x20)) == NULL) return -1;
+            cfg->ycsb[i] = (char)(v[i] & ~0x20);
+        }
+        cfg->ycsb[i] = 0;
+        break;
+    case P_SCANS:
+        if (parse_int(v, 1, 100000000, &x)) return -1;
+        cfg->scans = (int)x;
+        break;
+    case P_SCAN_LENGTHS:
+        if (parse_byte_list(v, cfg->scan_lengths, MAX_SCAN_LENGTHS, &cfg->num_scan_lengths)) return -1;
+        break;
+    case P_YCSB_OPS:
+        if (parse_int(v, 1, 1000000000, &x)) return -1;
+        cfg->ycsb_ops = (int)x;
+        break;
+    case P_READERS:
+    case P_WRITERS:
+        if (parse_int(v, 0, MT_MAX_THREADS, &x)) return -1;
+        if (id == P_READERS) cfg->readers = (int)x; else cfg->writers = (int)x;
+        break;
+    case P_DURATION:
+        d = atof(v);
+        if (d <= 0) return -1;
+        cfg->duration = d;
+        break;
+    case P_SUSTAIN:
+        d = atof(v);
+        if (d <= 0) return -1;
+        cfg->sustain = d;
+        break;
+    case P_SAMPLE_MS:
+        if (parse_int(v, 1, 3600000, &x)) return -1;
+        cfg->sample_ms = (int)x;
+        break;
+    case P_CKPT_READERS:
+        if (parse_int(v, 0, MT_MAX_THREADS, &x)) return -1;
+        cfg->ckpt_readers = (int)x;
+        break;
+    case P_JOURNAL_MODES:
+        if (parse_mode_list(v, journal_mode_names, cfg->journal_modes, &cfg->num_journal_modes)) return -1;
+        break;
+    case P_SYNC_MODES:
+        if (parse_mode_list(v, sync_mode_names, cfg->sync_modes, &cfg->num_sync_modes)) return -1;
+        break;
+    case P_BATCH_SIZES:
+        if (parse_byte_list(v, cfg->batch_sizes, MAX_BATCH_SIZES, &cfg->num_batch_sizes)) return -1;
+        break;
+    case P_DURABILITY_ROWS:
+        if (parse_int(v, 1, 100000000, &x)) return -1;
+        cfg->durability_rows = (int)x;
+        break;
+    case P_CHURN_ROWS:
+        if (parse_int(v, 1, 100000000, &x)) return -1;
+        cfg->churn_rows = (int)x;
+        break;
+    case P_CHURN_CYCLES:
+        if (parse_int(v, 1, 1000000, &x)) return -1;
+        cfg->churn_cycles = (int)x;
+        break;
+    case P_CHURN_RATE:
+        d = atof(v);
+        if (d <= 0 || d > 1) return -1;
+        cfg->churn_rate = d;
+        break;
+    case P_CHURN_VALUE_SIZE:
+        if (parse_size_range(v, &cfg->churn_value_min, &cfg->churn_value_max) || cfg->churn_value_min < 1) return -1;
+        break;
+    case P_CHURN_SAMPLE:
+        if (parse_int(v, 1, 1000000, &x)) return -1;
+        cfg->churn_sample = (int)x;
+        break;
+    case P_MULTIGET_SIZE:
+        if (parse_int(v, 1, 100000, &x)) return -1;
+        cfg->multiget_size = (int)x;
+        break;
+    case P_LOAD_FILL:
+        if (parse_int(v, 1, 100, &x)) return -1;
+        cfg->load_fill = (int)x;
+        break;
+    case P_TIMELINE:
+        snprintf(cfg->timeline, sizeof(cfg->timeline), "%s", v);
+        break;
+    case P_REPEAT:
+        if (parse_int(v, 1, 1000, &x)) return -1;
+        break;
+    case P_COMPARE:
+        if (strchr(v, ',') == NULL) return -1;
+        break;
+    case P_THRESHOLD:
+        if (atof(v) < 0) return -1;
+        break;
+    case P_PERF:
+    case P_IO_STATS:
+        if (parse_int(v, 0, 1, &x)) return -1;
+        break;
+    }
+    return 0;
+}
+
+static char *dup_string(const char *s) {
+    size_t n = strlen(s) + 1;
+    char *p = (char *)malloc(n);
+    if (p) memcpy(p, s, n);
+    return p;
+}
+
+static char *trim(char *s) {
+    char *e;
+    while (*s == ' ' || *s == '\t') s++;
+    e = s + strlen(s);
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\n' || e[-1] == '\r')) e--;
+    *e = 0;
+    return s;
+}
+
+/* Config file: "name = value" (or "name value") lines, '#' starts a comment */
+static int load_config_file(const char *path) {
+    char line[512];
+    int lineno = 0;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        fprintf(stderr, "Can't open config file: %s\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *name, *value, *p;
+        int id;
+
+        lineno++;
+        if ((p = strchr(line, '#')) != NULL) *p = 0;
+        name = trim(line);
+        if (*name == 0) continue;
+        p = name + strcspn(name, "= \t");
+        value = p + strspn(p, " \t");
+        if (*value == '=') value++;
+        *p = 0;
+        value = trim(value);
+
+        id = find_param(name);
+        if (id < 0 || id == P_CONFIG || *value == 0) {
+            fprintf(stderr, "%s:%d: bad parameter line\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        param_values[id] = dup_string(value);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* Parse argv into param_values[]; later settings override earlier ones */
+static int parse_args(int argc, char **argv) {
+    int i;
+    for (i = 1; i < argc; i++) {
+        const char *arg = argv[i], *value;
+        char name[64];
+        const char *eq;
+        int id;
+
+        if (strncmp(arg, "--", 2) != 0) return -1;
+        arg += 2;
+        eq = strchr(arg, '=');
+        if (eq) {
+            snprintf(name, sizeof(name), "%.*s", (int)(eq - arg), arg);
+            value = eq + 1;
+        } else {
+            snprintf(name, sizeof(name), "%s", arg);
+            if (i + 1 >= argc) return -1;
+            value = argv[++i];
+        }
+        id = find_param(name);
+        if (id < 0) return -1;
+        if (id == P_CONFIG) {
+            if (load_config_file(value) != 0) return -1;
+        } else {
+            param_values[id] = value;
+        }
+    }
+    return 0;
+}
+
+/*
+** Split every parameter into its sweep list and validate each value.
+** Returns the number of sweep points, or 0 on error.
+*/
+static int prepare_sweep(void) {
+    bench_config scratch;
+    int id, j, points = 1;
+
+    memset(&scratch, 0, sizeof(scratch));
+    for (id = 0; id < P_NUM_PARAMS; id++) {
+        const char *v = param_values[id] ? param_values[id] : params[id].def;
+        if (v == NULL) continue;
+        if (params[id].sweep) {
+            char buf[MAX_SWEEP_VALUES * MAX_PARAM_VALUE], *tok;
+            snprintf(buf, sizeof(buf), "%s", v);
+            for (tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+                if (sweep_counts[id] == MAX_SWEEP_VALUES) {
+                    fprintf(stderr, "--%s: at most %d values\n", params[id].name, MAX_SWEEP_VALUES);
+                    return 0;
+                }
+                snprintf(sweep_items[id][sweep_counts[id]++], MAX_PARAM_VALUE, "%s", trim(tok));
+            }
+        } else {
+            snprintf(sweep_items[id][0], MAX_PARAM_VALUE, "%s", v);
+            sweep_counts[id] = 1;
+        }
+        for (j = 0; j < sweep_counts[id]; j++) {
+            if (apply_param(&scratch, id, sweep_items[id][j]) != 0) {
+                fprintf(stderr, "Invalid value for --%s: %s\n", params[id].name, sweep_items[id][j]);
+                return 0;
+            }
+        }
+        if (sweep_counts[id] > 0) points *= sweep_counts[id];
+    }
+    return points;
+}
+
+/* Load g_cfg with sweep point p and describe the swept values in label */
+static void configure_point(int p, char *label, size_t size) {
+    int id;
+    size_t n = 0;
+
+    memset(&g_cfg, 0, sizeof(g_cfg));
+    g_cfg.seed = g_default_seed;
+    label[0] = 0;
+    for (id = 0; id < P_NUM_PARAMS; id++) {
+        int k;
+        if (sweep_counts[id] == 0) continue;
+        k = p % sweep_counts[id];
+        p /= sweep_counts[id];
+        point_items[id] = k;
+        apply_param(&g_cfg, id, sweep_items[id][k]);
+        if (sweep_counts[id] > 1 && n < size) {
+            n += snprintf(label + n, size - n, "%s%s=%s", n ? " " : "", params[id].name, sweep_items[id][k]);
+        }
+    }
+    g_cfg.dist_given = param_values[P_DIST] != NULL;
+    g_cfg.bench_given = param_values[P_BENCH] != NULL;
+
+    free(g_value);
+    free(g_filler);
+    g_value = (char *)malloc(value_capacity());
+    g_filler = (char *)malloc(value_capacity());
+    if (g_value && g_filler) {
+        uint64_t rng = rng_seed(g_cfg.seed);
+        int i;
+        for (i = 0; i < value_capacity(); i++) g_filler[i] = 'a' + (char)(rng_next(&rng) % 26);
+    }
+}
+
+/* Mean throughput and p99 of benchmark name at sweep point p over all runs */
+static int point_mean(const char *name, int p, double *ops_per_sec, double *p99) {
+    int i, n = 0;
+    *ops_per_sec = *p99 = 0;
+    for (i = 0; i < g_num_results; i++) {
+        if (g_results[i].point != p || strcmp(g_results[i].name, name) != 0) continue;
+        *ops_per_sec += g_results[i].ops_per_sec;
+        *p99 += (double)g_results[i].p99;
+        n++;
+    }
+    if (n == 0) return 0;
+    *ops_per_sec /= n;
+    *p99 /= n;
+    return 1;
+}
+
+/* One line per sweep point for every benchmark, best throughput marked */
+static void print_sweep_summary(char labels[][256], int points) {
+    int i, j, p;
+
+    print_header("SWEEP SUMMARY");
+    for (i = 0; i < g_num_results; i++) {
+        double best = 0, tput, p99;
+        int best_point = -1;
+
+        for (j = 0; j < i; j++) {
+            if (strcmp(g_results[j].name, g_results[i].name) == 0) break;
+        }
+        if (j < i) continue;
+        for (p = 0; p < points; p++) {
+            if (point_mean(g_results[i].name, p, &tput, &p99) && tput > best) {
+                best = tput;
+                best_point = p;
+            }
+        }
+        printf("\n  %s\n", g_results[i].name);
+        for (p = 0; p < points; p++) {
+            char ops[32], lat[32];
+            if (!point_mean(g_results[i].name, p, &tput, &p99)) continue;
+            format_number((long long)tput, ops, sizeof(ops));
+            format_latency((uint64_t)p99, lat, sizeof(lat));
+            printf("    %s%-48s %12s ops/sec  p99 %-9s%s" COLOR_RESET "\n",
+                   p == best_point ? COLOR_GREEN : "", labels[p], ops, lat,
+                   p == best_point ? " *" : "");
+        }
+    }
+}
+
+/* ==================== Structured Output ==================== */
+typedef struct {
+    char os[64];
+    char release[64];
+    char machine[64];
+    char hostname[128];
+    int cpus;
+} host_info;
+
+static void get_host_info(host_info *h) {
+    memset(h, 0, sizeof(*h));
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    DWORD n = sizeof(h->hostname);
+    GetSystemInfo(&si);
+    h->cpus = (int)si.dwNumberOfProcessors;
+    snprintf(h->os, sizeof(h->os), "Windows");
+    snprintf(h->machine, sizeof(h->machine), "%u", (unsigned)si.wProcessorArchitecture);
+    GetComputerNameA(h->hostname, &n);
+#else
+    struct utsname u;
+    if (uname(&u) == 0) {
+        snprintf(h->os, sizeof(h->os), "%.63s", u.sysname);
+        snprintf(h->release, sizeof(h->release), "%.63s", u.release);
+        snprintf(h->machine, sizeof(h->machine), "%.63s", u.machine);
+        snprintf(h->hostname, sizeof(h->hostname), "%s", u.nodename);
+    }
+    h->cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(f, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+/* CSV field, quoted when it contains a separator, quote or newline */
+static void csv_field(FILE *f, const char *s) {
+    if (strpbrk(s, ",\"\n") == NULL) {
+        fputs(s, f);
+        return;
+    }
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static FILE *g_json_out;
+static FILE *g_csv_out;
+static host_info g_host;
+
+static const char *csv_columns =
+    "run,point,benchmark,ops,elapsed_sec,ops_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns";
+
+/* Parameters recorded with each result: the ones shaping the workload */
+static int is_config_param(int id) {
+    return id != P_CONFIG && id != P_SEED && id < P_JSON && sweep_counts[id] > 0;
+}
+
+static void csv_write_header(FILE *f) {
+    int id;
+    fputs(csv_columns, f);
+    if (g_perf_enabled) {
+        for (id = 0; id < PERF_NUM_COUNTERS; id++) fprintf(f, ",%s_per_op", perf_names[id]);
+    }
+    if (g_io_enabled) {
+        fputs(",io_reads,io_read_bytes,io_writes,io_write_bytes,io_syncs,io_truncates,io_fetches,"
+              "kv_read_bytes,kv_write_bytes", f);
+    }
+    for (id = 0; id < P_NUM_PARAMS; id++) {
+        if (is_config_param(id)) fprintf(f, ",%s", params[id].name);
+    }
+    fputs(",seed,sqlite_version,source_id,compile_options,os,release,machine,hostname,cpus\n", f);
+}
+
+/*
+** One JSON object per line (JSON Lines) and one CSV row per benchmark
+** result of the current sweep point; g_cfg still holds that point.
+*/
+static void emit_results(int first, const char *label) {
+    int i, id, k;
+    const char *opt;
+    char ts[32];
+    time_t now = time(NULL);
+
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    for (i = first; i < g_num_results; i++) {
+        const result_entry *r = &g_results[i];
+        if (g_json_out) {
+            FILE *f = g_json_out;
+            fprintf(f, "{\"run\":%d,\"point\":", r->run);
+            json_string(f, label);
+            fprintf(f, ",\"bench\":");
+            json_string(f, r->name);
+            fprintf(f, ",\"ops\":%lld,\"elapsed_sec\":%.6f,\"ops_per_sec\":%.3f",
+                    r->ops, r->elapsed, r->ops_per_sec);
+            fprintf(f, ",\"latency_ns\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p99.9\":%llu,\"max\":%llu}",
+                    (unsigned long long)r->p50, (unsigned long long)r->p90,
+                    (unsigned long long)r->p99, (unsigned long long)r->p999,
+                    (unsigned long long)r->max);
+            if (r->has_perf) {
+                fprintf(f, ",\"perf_per_op\":{");
+                for (id = 0, k = 0; id < PERF_NUM_COUNTERS; id++) {
+                    if (r->perf[id] < 0) continue;
+                    fprintf(f, "%s\"%s\":%.3f", k++ ? "," : "", perf_names[id], r->perf[id]);
+                }
+                if (r->perf[PERF_CYCLES] > 0 && r->perf[PERF_INSTRUCTIONS] >= 0) {
+                    fprintf(f, "%s\"ipc\":%.3f", k ? "," : "", r->perf[PERF_INSTRUCTIONS] / r->perf[PERF_CYCLES]);
+                }
+                fputc('}', f);
+            }
+            if (r->has_io) {
+                fprintf(f, ",\"io\":{\"reads\":%lld,\"read_bytes\":%lld,\"writes\":%lld,\"write_bytes\":%lld,"
+                        "\"syncs\":%lld,\"truncates\":%lld,\"fetches\":%lld,"
+                        "\"kv_read_bytes\":%lld,\"kv_write_bytes\":%lld}",
+                        r->io.reads, r->io.read_bytes, r->io.writes, r->io.write_bytes,
+                        r->io.syncs, r->io.truncates, r->io.fetches,
+                        r->kv_read_bytes, r->kv_write_bytes);
+            }
+            fprintf(f, ",\"config\":{");
+            for (id = 0, k = 0; id < P_NUM_PARAMS; id++) {
+                if (!is_config_param(id)) continue;
+                fprintf(f, "%s\"%s\":", k++ ? "," : "", params[id].name);
+                json_string(f, sweep_items[id][point_items[id]]);
+            }
+            fprintf(f, ",\"seed\":%llu}", (unsigned long long)g_cfg.seed);
+            fprintf(f, ",\"sqlite\":{\"version\":");
+            json_string(f, sqlite3_libversion());
+            fprintf(f, ",\"source_id\":");
+            json_string(f, sqlite3_sourceid());
+            fprintf(f, ",\"compile_options\":[");
+            for (k = 0; (opt = sqlite3_compileoption_get(k)) != NULL; k++) {
+                if (k) fputc(',', f);
+                json_string(f, opt);
+            }
+            fprintf(f, "]},\"host\":{\"os\":");
+            json_string(f, g_host.os);
+            fprintf(f, ",\"release\":");
+            json_string(f, g_host.release);
+            fprintf(f, ",\"machine\":");
+            json_string(f, g_host.machine);
+            fprintf(f, ",\"hostname\":");
+            json_string(f, g_host.hostname);
+            fprintf(f, ",\"cpus\":%d},\"timestamp\":\"%s\"}\n", g_host.cpus, ts);
+        }
+        if (g_csv_out) {
+            FILE *f = g_csv_out;
+            fprintf(f, "%d,", r->run);
+            csv_field(f, label);
+            fputc(',', f);
+            csv_field(f, r->name);
+            fprintf(f, ",%lld,%.6f,%.3f,%llu,%llu,%llu,%llu,%llu", r->ops, r->elapsed, r->ops_per_sec,
+                    (unsigned long long)r->p50, (unsigned long long)r->p90,
+                    (unsigned long long)r->p99, (unsigned long long)r->p999,
+                    (unsigned long long)r->max);
+            for (id = 0; g_perf_enabled && id < PERF_NUM_COUNTERS; id++) {
+                fputc(',', f);
+                if (r->has_perf && r->perf[id] >= 0) fprintf(f, "%.3f", r->perf[id]);
+            }
+            if (g_io_enabled && r->has_io) {
+                fprintf(f, ",%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld",
+                        r->io.reads, r->io.read_bytes, r->io.writes, r->io.write_bytes,
+                        r->io.syncs, r->io.truncates, r->io.fetches,
+                        r->kv_read_bytes, r->kv_write_bytes);
+            } else if (g_io_enabled) {
+                fputs(",,,,,,,,,", f);
+            }
+            for (id = 0; id < P_NUM_PARAMS; id++) {
+                if (!is_config_param(id)) continue;
+                fputc(',', f);
+                csv_field(f, sweep_items[id][point_items[id]]);
+            }
+            fprintf(f, ",%llu,%s,%s,", (unsigned long long)g_cfg.seed,
+                    sqlite3_libversion(), sqlite3_sourceid());
+            for (k = 0; (opt = sqlite3_compileoption_get(k)) != NULL; k++) {
+                if (k) fputc(';', f);
+                csv_field(f, opt);
+            }
+            fputc(',', f);
+            csv_field(f, g_host.os);
+            fputc(',', f);
+            csv_field(f, g_host.release);
+            fputc(',', f);
+            csv_field(f, g_host.machine);
+            fputc(',', f);
+            csv_field(f, g_host.hostname);
+            fprintf(f, ",%d\n", g_host.cpus);
+        }
+    }
+    if (g_json_out) fflush(g_json_out);
+    if (g_csv_out) fflush(g_csv_out);
+}
+
+/* ==================== Regression Comparison ==================== */
+
+/* Samples of one (point, benchmark) pair, across repeated runs */
+typedef struct {
+    char key[320];
+    int n;
+    double tput_sum, tput_sumsq;
+    double p99_sum, p99_sumsq;
+} cmp_series;
+
+typedef struct {
+    cmp_series *series;
+    int count;
+    int alloc;
+} cmp_set;
+
+static void cmp_add(cmp_set *set, const char *point, const char *bench, double tput, double p99) {
+    char key[320];
+    cmp_series *s = NULL;
+    int i;
+
+    snprintf(key, sizeof(key), "%s%s%s", point, point[0] ? " | " : "", bench);
+    for (i = 0; i < set->count; i++) {
+        if (strcmp(set->series[i].key, key) == 0) {
+            s = &set->series[i];
+            break;
+        }
+    }
+    if (s == NULL) {
+        if (set->count == set->alloc) {
+            int n = set->alloc ? set->alloc * 2 : 32;
+            cmp_series *p = (cmp_series *)realloc(set->series, n * sizeof(cmp_series));
+            if (p == NULL) return;
+            set->series = p;
+            set->alloc = n;
+        }
+        s = &set->series[set->count++];
+        memset(s, 0, sizeof(*s));
+        snprintf(s->key, sizeof(s->key), "%s", key);
+    }
+    s->n++;
+    s->tput_sum += tput;
+    s->tput_sumsq += tput * tput;
+    s->p99_sum += p99;
+    s->p99_sumsq += p99 * p99;
+}
+
+/* Extract "name":"string" from one of our JSON lines */
+static int json_get_string(const char *line, const char *name, char *out, size_t size) {
+    char pat[64];
+    const char *p;
+    size_t n = 0;
+
+    snprintf(pat, sizeof(pat), "\"%s\":\"", name);
+    if ((p = strstr(line, pat)) == NULL) return -1;
+    for (p += strlen(pat); *p && *p != '"' && n + 1 < size; p++) {
+        if (*p == '\\' && p[1]) p++;
+        out[n++] = *p;
+    }
+    out[n] = 0;
+    return 0;
+}
+
+static int json_get_number(const char *line, const char *name, double *out) {
+    char pat[64];
+    const char *p;
+
+    snprintf(pat, sizeof(pat), "\"%s\":", name);
+    if ((p = strstr(line, pat)) == NULL) return -1;
+    *out = atof(p + strlen(pat));
+    return 0;
+}
+
+/* Split one CSV line in place; returns the number of fields */
+static int csv_split(char *line, char **fields, int max) {
+    int n = 0;
+    char *p = line, *w;
+
+    while (n < max) {
+        fields[n++] = w = p;
+        if (*p == '"') {
+            for (p++; *p; p++) {
+                if (*p == '"' && p[1] == '"') {
+                    *w++ = '"';
+                    p++;
+                } else if (*p == '"') {
+                    p++;
+                    break;
+                } else {
+                    *w++ = *p;
+                }
+            }
+        } else {
+            while (*p && *p != ',' && *p != '\n' && *p != '\r') *w++ = *p++;
+        }
+        if (*p != ',') {
+            *w = 0;
+            break;
+        }
+        *w = 0;
+        p++;
+    }
+    return n;
+}
+
+/* Load a results file written with --json or --csv */
+static int cmp_load(const char *path, cmp_set *set) {
+    static char line[65536];
+    char *fields[256];
+    int col_point = -1, col_bench = -1, col_tput = -1, col_p99 = -1;
+    int is_csv = -1;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        fprintf(stderr, "Can't open results file: %s\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (is_csv < 0) {
+            is_csv = line[0] != '{';
+            if (is_csv) {
+                int i, n = csv_split(line, fields, 256);
+                for (i = 0; i < n; i++) {
+                    if (strcmp(fields[i], "point") == 0) col_point = i;
+                    if (strcmp(fields[i], "benchmark") == 0) col_bench = i;
+                    if (strcmp(fields[i], "ops_per_sec") == 0) col_tput = i;
+                    if (strcmp(fields[i], "p99_ns") == 0) col_p99 = i;
+                }
+                if (col_point < 0 || col_bench < 0 || col_tput < 0 || col_p99 < 0) break;
+                continue;
+            }
+        }
+        if (is_csv) {
+            int n = csv_split(line, fields, 256);
+            if (n > col_p99 && n > col_tput) {
+                cmp_add(set, fields[col_point], fields[col_bench],
+                        atof(fields[col_tput]), atof(fields[col_p99]));
+            }
+        } else {
+            char point[256], bench[64];
+            double tput, p99;
+            if (json_get_string(line, "point", point, sizeof(point)) == 0
+                && json_get_string(line, "bench", bench, sizeof(bench)) == 0
+                && json_get_number(line, "ops_per_sec", &tput) == 0
+                && json_get_number(line, "p99", &p99) == 0) {
+                cmp_add(set, point, bench, tput, p99);
+            }
+        }
+    }
+    fclose(f);
+    if (set->count == 0) {
+        fprintf(stderr, "No benchmark results in %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static double series_mean(double sum, int n) {
+    return n ? sum / n : 0;
+}
+
+/* Coefficient of variation (sample standard deviation / mean) */
+static double series_cv(double sum, double sumsq, int n) {
+    double mean, var;
+    if (n < 2) return 0;
+    mean = sum / n;
+    var = (sumsq - n * mean * mean) / (n - 1);
+    return (mean > 0 && var > 0) ? sqrt(var) / mean : 0;
+}
+
+/*
+** Compare two result files.  A difference counts only when it exceeds
+** the noise band: three times the larger coefficient of variation seen
+** across the repeated runs in either file, and never less than the
+** --threshold floor.  Returns 1 when anything regressed.
+*/
+static int compare_results(const char *base_path, const char *new_path, double floor_pct) {
+    cmp_set base, cur;
+    int i, j, regressions = 0, single = 0;
+
+    memset(&base, 0, sizeof(base));
+    memset(&cur, 0, sizeof(cur));
+    if (cmp_load(base_path, &base) != 0 || cmp_load(new_path, &cur) != 0) {
+        free(base.series);
+        free(cur.series);
+        return 2;
+    }
+
+    print_header("REGRESSION COMPARISON");
+    printf("  base: %s\n  new:  %s\n\n", base_path, new_path);
+    printf("  %-44s %12s %12s %8s %7s  %s\n", "benchmark", "base ops/s", "new ops/s", "delta", "noise", "p99 delta");
+
+    for (i = 0; i < base.count; i++) {
+        const cmp_series *b = &base.series[i], *n = NULL;
+        double bt, nt, bp, np, dt, dp, noise_t, noise_p;
+        const char *verdict = "";
+
+        for (j = 0; j < cur.count; j++) {
+            if (strcmp(cur.series[j].key, b->key) == 0) n = &cur.series[j];
+        }
+        if (n == NULL) {
+            printf("  %-44s (missing from new results)\n", b->key);
+            continue;
+        }
+        if (b->n < 2 || n->n < 2) single = 1;
+
+        bt = series_mean(b->tput_sum, b->n);
+        nt = series_mean(n->tput_sum, n->n);
+        bp = series_mean(b->p99_sum, b->n);
+        np = series_mean(n->p99_sum, n->n);
+        dt = bt > 0 ? (nt - bt) / bt * 100 : 0;
+        dp = bp > 0 ? (np - bp) / bp * 100 : 0;
+        noise_t = 300 * fmax(series_cv(b->tput_sum, b->tput_sumsq, b->n),
+                             series_cv(n->tput_sum, n->tput_sumsq, n->n));
+        noise_p = 300 * fmax(series_cv(b->p99_sum, b->p99_sumsq, b->n),
+                             series_cv(n->p99_sum, n->p99_sumsq, n->n));
+        if (noise_t < floor_pct) noise_t = floor_pct;
+        if (noise_p < floor_pct) noise_p = floor_pct;
+
+        if (dt < -noise_t || dp > noise_p) {
+            verdict = COLOR_YELLOW "  REGRESSION" COLOR_RESET;
+            regressions++;
+        } else if (dt > noise_t) {
+            verdict = COLOR_GREEN "  improved" COLOR_RESET;
+        }
+        printf("  %-44.44s %12.0f %12.0f %+7.1f%% %6.1f%%  %+7.1f%% (noise %.1f%%)%s\n",
+               b->key, bt, nt, dt, noise_t, dp, noise_p, verdict);
+    }
+
+    printf("\n  %d regression(s) beyond the noise band\n", regressions);
+    if (single) {
+        printf("  Some results have a single run; only the %.1f%% floor applies to them"
+               " (use --repeat to measure noise)\n", floor_pct);
+    }
+    free(base.series);
+    free(cur.series);
+    return regressions ? 1 : 0;
+}
+
+/* ==================== Main ==================== */
+
+/* Run the configured benchmarks once against a fresh database */
+static int run_suite(void) {
+    sqlite3 *db = NULL;
+    int rc, i;
+    char dist_desc[64];
+
+    if (g_value == NULL || g_filler == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    g_rng = rng_seed(g_cfg.seed);
+    if (g_io_enabled) io_snapshot(&g_io_run);
+    key_chooser_init(&g_keys, g_cfg.dist, g_cfg.records, g_cfg.theta, g_cfg.hot_set, g_cfg.hot_ops);
+    describe_dist(&g_keys, dist_desc, sizeof(dist_desc));
+    printf("  Key distribution: %s, seed %llu\n", dist_desc, (unsigned long long)g_cfg.seed);
+    printf("  page_size %d, cache_size %d, journal_mode %s, synchronous %s, mmap_size %lld\n",
+           g_cfg.page_size, g_cfg.cache_size, g_cfg.journal_mode, g_cfg.synchronous, g_cfg.mmap_size);
+    
+    /* Initialize database */
+    printf("\n" COLOR_YELLOW "Initializing database..." COLOR_RESET "\n");
+    remove(DB_FILE);
+    
+    rc = sqlite3_open(DB_FILE, &db);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    
+    if (init_database(db) != 0) {
+        fprintf(stderr, "Failed to initialize database\n");
+        sqlite3_close(db);
+        return 1;
+    }
+    
+    /* Every other benchmark reads what the sequential writes load */
+    bench_sequential_writes(db);
+
+    if (g_cfg.ycsb[0] || g_cfg.readers + g_cfg.writers > 0) {
+        long long records = g_cfg.records;
+
+        if (g_cfg.bench_given) {
+            printf("  --bench ignored: --ycsb, --readers and --writers replace the benchmark suite\n");
+        }
+        for (i = 0; g_cfg.ycsb[i]; i++) {
+            const ycsb_workload *w = ycsb_find(g_cfg.ycsb[i]);
+            bench_ycsb(db, w, g_cfg.dist_given ? g_cfg.dist : w->dist, &records);
+        }
+        sqlite3_close(db);
+        if (g_cfg.readers + g_cfg.writers > 0) {
+            bench_multithreaded(g_cfg.readers, g_cfg.writers, g_cfg.duration);
+        }
+        io_print_histograms();
+        remove(DB_FILE);
+        return 0;
+    }
+    
+    /* Run benchmarks */
+    if (g_cfg.benchmarks & BENCH_READS) bench_random_reads(db, NULL);
+    if (g_cfg.benchmarks & BENCH_SCAN) bench_sequential_scan(db, NULL);
+    if (g_cfg.benchmarks & BENCH_RANGE) bench_range_scans(db);
+    if (g_cfg.benchmarks & BENCH_UPDATES) bench_random_updates(db);
+    if (g_cfg.benchmarks & BENCH_DELETES) bench_random_deletes(db);
+    if (g_cfg.benchmarks & BENCH_EXISTS) bench_exists_checks(db, NULL);
+    if (g_cfg.benchmarks & BENCH_MIXED) bench_mixed_workload(db);
+    if (g_cfg.benchmarks & BENCH_KV) bench_kv_api(db);
+    if ((g_cfg.benchmarks & BENCH_RESTART) && (db = bench_restart(db)) == NULL) {
+        remove(DB_FILE);
+        return 1;
+    }
+    if (g_cfg.benchmarks & BENCH_CHECKPOINT) bench_checkpoint_stalls(db);
+    
+    /* Get database stats */
+    sqlite3_stmt *stmt = NULL;
+    rc = sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM kvpairs", -1, &stmt, NULL);
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        printf("  Records remaining: %d\n", sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    
+    /* Get page count and size */
+    rc = sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, NULL);
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        int page_count = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+        
+        rc = sqlite3_prepare_v2(db, "PRAGMA page_size", -1, &stmt, NULL);
+        if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+            int page_size = sqlite3_column_int(stmt, 0);
+            printf("  Database size: %.2f MB (%d pages × %d bytes)\n",
+                   ((double)page_count * page_size) / (1024.0 * 1024.0),
+                   page_count, page_size);
+        }
+    }
+    sqlite3_finalize(stmt);
+    
+    sqlite3_close(db);
+    
+    /* Run bulk insert test */
+    if (g_cfg.benchmarks & BENCH_BULK) bench_bulk_insert();
+    if (g_cfg.benchmarks & BENCH_VALUES) bench_value_sizes();
+    if (g_cfg.benchmarks & BENCH_DURABILITY) bench_durability_matrix();
+    if (g_cfg.benchmarks & BENCH_CHURN) bench_churn();
+    io_print_histograms();
+    
+    /* Cleanup */
+    remove(DB_FILE);
+    
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    double total_start, total_end;
+    char (*labels)[256];
+    char label[256];
+    int points, p, run, repeat, first, rc = 0;
+
+    if (parse_args(argc, argv) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    g_default_seed = (uint64_t)time(NULL);
+    points = prepare_sweep();
+    if (points == 0) return 1;
+    repeat = atoi(sweep_items[P_REPEAT][0]);
+
+    if (param_values[P_COMPARE]) {
+        char base[1024];
+        const char *comma = strchr(param_values[P_COMPARE], ',');
+        snprintf(base, sizeof(base), "%.*s", (int)(comma - param_values[P_COMPARE]),
+                 param_values[P_COMPARE]);
+        return compare_results(base, comma + 1, atof(sweep_items[P_THRESHOLD][0]));
+    }
+
+    get_host_info(&g_host);
+    if (param_values[P_JSON] && (g_json_out = fopen(param_values[P_JSON], "w")) == NULL) {
+        fprintf(stderr, "Can't open %s\n", param_values[P_JSON]);
+        return 1;
+    }
+    if (param_values[P_CSV]) {
+        if ((g_csv_out = fopen(param_values[P_CSV], "w")) == NULL) {
+            fprintf(stderr, "Can't open %s\n", param_values[P_CSV]);
+            return 1;
+        }
+    }
+    labels = (char (*)[256])calloc(points, sizeof(*labels));
+    if (labels == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+#ifdef _WIN32
+    /* Set UTF-8 output so Unicode box-drawing chars render correctly */
+    SetConsoleOutputCP(CP_UTF8);
+    /* Enable ANSI escape sequence processing for colors */
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD dwMode = 0;
+    GetConsoleMode(hOut, &dwMode);
+    SetConsoleMode(hOut, dwMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#endif
+
+    configure_point(0, label, sizeof(label));
+    printf("\n");
+    printf(COLOR_BLUE "╔══════════════════════════════════════════════════════════════╗\n");
+    printf("║          SQLite Performance Benchmark                        ║\n");
+    printf("║                                                              ║\n");
+    printf("║  Database: %-50s║\n", DB_FILE);
+    printf("║  Records:  %-50d║\n", g_cfg.records);
+    printf("║  Points:   %-50d║\n", points);
+    printf("║  Runs:     %-50d║\n", repeat);
+    printf("╚══════════════════════════════════════════════════════════════╝\n");
+    printf(COLOR_RESET);
+    if (atoi(sweep_items[P_PERF][0])) perf_init();
+    if (atoi(sweep_items[P_IO_STATS][0]) && io_vfs_register() != 0) return 1;
+    if (g_csv_out) csv_write_header(g_csv_out);
+    
+    total_start = get_time();
+    
+    for (run = 1; run <= repeat && rc == 0; run++) {
+        for (p = 0; p < points && rc == 0; p++) {
+            configure_point(p, labels[p], sizeof(labels[p]));
+            g_run = run;
+            g_point = p;
+            if (points > 1 || repeat > 1) {
+                printf("\n" COLOR_YELLOW "Run %d/%d, sweep point %d/%d: %s" COLOR_RESET "\n",
+                       run, repeat, p + 1, points, labels[p]);
+            }
+            first = g_num_results;
+            rc = run_suite();
+            emit_results(first, labels[p]);
+        }
+    }
+    
+    total_end = get_time();
+    
+    if (points > 1) print_sweep_summary(labels, points);
+    
     /* Summary */
     printf("\n" COLOR_CYAN);
     printf("════════════════════════════════════════════════════════\n");
@@ -547,10 +5509,16 @@ int main(void) {
            total_end - total_start);
     
     
-    printf("\n" COLOR_GREEN "✓ Benchmark complete!" COLOR_RESET "\n\n");
+    if (rc == 0) printf("\n" COLOR_GREEN "✓ Benchmark complete!" COLOR_RESET "\n\n");
     
-    /* Cleanup */
-    remove(DB_FILE);
+    perf_close();
+    io_vfs_unregister();
+    if (g_json_out) fclose(g_json_out);
+    if (g_csv_out) fclose(g_csv_out);
+    free(labels);
+    free(g_value);
+    free(g_filler);
+    free(g_results);
     
-    return 0;
+    return rc;
 }